@@ -5,12 +5,16 @@
 
 #include "config.h"
 #include "src/AudioController.h"
+#include "src/AudioPrefetcher.h"
+#include "src/AudioTranscoder.h"
 #include "src/BootLoopDetector.h"
+#include "src/BootTimeline.h"
 #include "src/ConnectivityManager.h"
 #include "src/DccController.h"
 #include "src/LightingController.h"
 #include "src/Logger.h"
 #include "src/MotorController.h"
+#include "src/PerfMonitor.h"
 #include "src/SystemContext.h"
 
 #include "Arduino.h"
@@ -31,11 +35,16 @@ extern TaskHandle_t loopTaskHandle; // Defined in Arduino core main.cpp
 void controlPlaneTask(void *pvParameters) {
   // Initialize DCC hardware on Core 0 for interrupt affinity
   DccController::getInstance().setup();
+  BootTimeline::getInstance().mark(BOOT_DCC);
+  PerfLoop &perfLoop = PerfMonitor::getInstance().loop("ControlPlane");
 
   for (;;) {
-    DccController::getInstance().loop();
-    MotorController::getInstance().loop();
-    lightingController.loop();
+    {
+      PerfScope perf(perfLoop);
+      DccController::getInstance().loop();
+      MotorController::getInstance().loop();
+      lightingController.loop();
+    }
     vTaskDelay(pdMS_TO_TICKS(1));
   }
 }
@@ -43,30 +52,49 @@ void controlPlaneTask(void *pvParameters) {
 // Standard Arduino Loop Task
 void arduinoLoopTask(void *pvParameters) {
   setup();
+  PerfLoop &perfLoop = PerfMonitor::getInstance().loop("loopTask");
   for (;;) {
-    loop();
+    {
+      PerfScope perf(perfLoop);
+      loop();
+    }
     if (serialEventRun)
       serialEventRun();
   }
 }
 
 void setup() {
-  // 0. Immediate hardware check
+  BootTimeline &boot = BootTimeline::getInstance();
+  boot.mark(BOOT_SETUP);
   Serial.begin(115200);
-  delay(100);
 
   // 1. Logging is already started in app_main
   Log.println("NIMRS Decoder Starting...");
 
+  // 2. What the loco needs to answer the track, from the CVs in flash. The
+  // control plane runs from here on, above everything that follows.
   DccController::getInstance().setupStorage();
-  connectivityManager.setup();
+  boot.mark(BOOT_CVS);
   MotorController::getInstance().setup();
+  boot.mark(BOOT_MOTOR);
   lightingController.setup();
-  AudioController::getInstance().setup();
-
+  boot.mark(BOOT_LIGHTS);
   xTaskCreatePinnedToCore(controlPlaneTask, "ControlPlane", 16384, NULL, 5,
                           &ControlPlaneTaskHandle, 0);
 
+  // 3. The rest, at this task's priority. WiFi associates in the background
+  // while the sounds load.
+  connectivityManager.startWifi();
+  connectivityManager.mountFilesystem();
+  AudioController::getInstance().setup();
+  AudioTranscoder::getInstance().startTask();
+  AudioPrefetcher::getInstance().startTask();
+  boot.mark(BOOT_AUDIO);
+  connectivityManager.setup();
+  PerfMonitor::getInstance().start();
+  boot.mark(BOOT_READY);
+  boot.log();
+
 #ifdef STATUS_LED_PIN
   pinMode(STATUS_LED_PIN, OUTPUT);
 #endif
@@ -75,6 +103,7 @@ void setup() {
 void loop() {
   connectivityManager.loop();
   AudioController::getInstance().loop();
+  MotorController::getInstance().streamTelemetry(); // Off ControlPlane
 
   static unsigned long lastHeartbeat = 0;
   if (millis() - lastHeartbeat > 1000) {
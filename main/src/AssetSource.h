@@ -0,0 +1,119 @@
+#ifndef ASSET_SOURCE_H
+#define ASSET_SOURCE_H
+
+#include "AudioPrefetcher.h"
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @brief Read cursor over one sound file: a LittleFS file, read ahead by
+ * AudioPrefetcher when it has a stream free, or a span of the memory-mapped
+ * sound pack. A mapped source hands out pointers into the flash cache
+ * instead of copying into the caller's buffer.
+ */
+class AssetSource {
+public:
+  AssetSource() {}
+  explicit AssetSource(File file) : _file(file) {
+    _stream = AudioPrefetcher::getInstance().open(_file);
+  }
+  AssetSource(const uint8_t *data, size_t size) : _data(data), _size(size) {}
+
+  explicit operator bool() const {
+    return _data != nullptr || _stream >= 0 || (bool)_file;
+  }
+  bool mapped() const { return _data != nullptr; }
+
+  /**
+   * @brief Up to @p len bytes from the cursor. @p out points into the
+   * mapping, or at @p scratch after a file read.
+   * @return Bytes available at @p out; 0 at the end, or while pending().
+   */
+  size_t next(uint8_t *scratch, size_t len, const uint8_t *&out) {
+    if (_data) {
+      size_t n = std::min(len, _size - _pos);
+      out = _data + _pos;
+      _pos += n;
+      return n;
+    }
+    out = scratch;
+    if (_stream >= 0)
+      return AudioPrefetcher::getInstance().read(_stream, scratch, len);
+    return _file.read(scratch, len);
+  }
+
+  size_t read(uint8_t *buf, size_t len) {
+    const uint8_t *at;
+    size_t n = next(buf, len, at);
+    if (at != buf)
+      memcpy(buf, at, n);
+    return n;
+  }
+
+  /**
+   * @brief Copies up to @p len bytes without moving the cursor.
+   */
+  size_t peek(uint8_t *buf, size_t len) {
+    if (_data) {
+      size_t n = std::min(len, _size - _pos);
+      memcpy(buf, _data + _pos, n);
+      return n;
+    }
+    if (_stream >= 0)
+      return AudioPrefetcher::getInstance().peek(_stream, buf, len);
+    size_t pos = _file.position();
+    size_t n = _file.read(buf, len);
+    _file.seek(pos);
+    return n;
+  }
+
+  /**
+   * @brief true when next() came back empty only because the read-ahead
+   * has not caught up yet.
+   */
+  bool pending() const {
+    return _stream >= 0 && AudioPrefetcher::getInstance().pending(_stream);
+  }
+
+  bool seek(size_t pos) {
+    if (_stream >= 0)
+      return AudioPrefetcher::getInstance().seek(_stream, pos);
+    if (!_data)
+      return _file.seek(pos);
+    if (pos > _size)
+      return false;
+    _pos = pos;
+    return true;
+  }
+
+  /**
+   * @brief Offset the next pass over the file starts at, so the read-ahead
+   * can continue there past the end; -1 for none.
+   */
+  void setLoop(int32_t pos) {
+    if (_stream >= 0)
+      AudioPrefetcher::getInstance().setLoop(_stream, pos);
+  }
+
+  void close() {
+    if (_stream >= 0)
+      AudioPrefetcher::getInstance().close(_stream);
+    if (_file)
+      _file.close();
+    _file = File();
+    _stream = -1;
+    _data = nullptr;
+    _size = _pos = 0;
+  }
+
+private:
+  File _file; // Handed to the prefetcher when it has a stream free
+  int8_t _stream = -1;
+  const uint8_t *_data = nullptr;
+  size_t _size = 0;
+  size_t _pos = 0;
+};
+
+#endif
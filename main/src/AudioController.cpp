@@ -1,16 +1,19 @@
 #include "AudioController.h"
+#include "AudioTranscoder.h"
 #include "AudioUtils.h"
 #include "CvRegistry.h"
 #include "DccController.h"
+#include "LatencyMonitor.h"
 #include "Logger.h"
-#include <ArduinoJson.h>
+#include "SoundManifest.h"
+#include "SoundPack.h"
+#include "TraceRecorder.h"
 #include <LittleFS.h>
+#include <algorithm>
+#include <cmath>
 #include <cstring>
-#include <strings.h>
 
-AudioController::AudioController()
-    : _i2s(nullptr), _volume(nullptr), _decoder(nullptr), _mp3(nullptr),
-      _wav(nullptr), _copier(nullptr) {}
+AudioController::AudioController() : _i2s(nullptr), _volume(nullptr) {}
 
 void AudioController::setup() {
   Log.println("AudioController: Initializing...");
@@ -22,24 +25,18 @@ void AudioController::setup() {
   config.pin_ws = Pinout::AMP_LRCLK;
   config.pin_data = Pinout::AMP_DIN;
   config.channels = 1;
-  config.sample_rate = 44100;
+  config.sample_rate = OUTPUT_RATE;
   _i2s->begin(config);
 
   _volume = new VolumeStream(*_i2s);
   _volume->begin(config); // VolumeStream uses the same config
 
-  _mp3 = new MP3DecoderHelix();
-  _wav = new WAVDecoder();
-  _decoder = new EncodedAudioStream(_volume, _mp3); // Default decoder
-
-  _copier = new StreamCopy(*_decoder, _file);
-
   // Initial Volume from CV
-  uint8_t vol = DccController::getInstance().getDcc().getCV(CV::MASTER_VOL);
-  float gain = (vol / 255.0f); // Map 0-255 to 0.0-1.0
-  _volume->setVolume(gain);
+  _cvMasterVol = DccController::getInstance().getDcc().getCV(CV::MASTER_VOL);
+  _volume->setVolume(_cvMasterVol / 255.0f); // Map 0-255 to 0.0-1.0
 
-  // Load Assets
+  // Load Assets (an installed sound pack takes precedence over the JSON)
+  SoundPack::getInstance().mount();
   loadAssets();
 
   // Enable Amp (Initially LOW/Muted until playback)
@@ -50,102 +47,347 @@ void AudioController::setup() {
 }
 
 void AudioController::loop() {
-  // Update Volume dynamically
-  if (_volume) {
-    uint8_t vol = DccController::getInstance().getDcc().getCV(CV::MASTER_VOL);
-    _volume->setVolume((vol / 255.0f));
-  }
+  _refreshCvCache();
 
-  // Check for Function Changes
-  SystemContext &ctx = SystemContext::getInstance();
-  bool currentFunctions[29];
+  // Snapshot F0-F28 as a bitmask so an idle pass is a single compare
+  uint32_t functionMask = 0;
+  uint32_t cause = 0;
+  uint8_t speed;
+  float momentum, load;
   {
+    SystemContext &ctx = SystemContext::getInstance();
     ScopedLock lock(ctx);
-    memcpy(currentFunctions, ctx.getState().functions, 29 * sizeof(bool));
+    const SystemState &state = ctx.getState();
+    for (uint8_t i = 0; i < 29; i++) {
+      functionMask |= (uint32_t)state.functions[i] << i;
+    }
+    uint32_t started = functionMask & ~_lastFunctionMask & _mappedMask;
+    if (started)
+      cause = state.functionCause[__builtin_ctz(started)];
+    speed = state.speed;
+    momentum = state.momentumSpeed;
+    load = state.loadFactor;
   }
 
-  for (auto const &[id, asset] : _assets) {
-    uint16_t cvId = CV::AUDIO_MAP_BASE + id;
-    int funcIdx = DccController::getInstance().getDcc().getCV(cvId);
-
-    if (funcIdx >= 0 && funcIdx <= 28) {
-      bool state = currentFunctions[funcIdx];
-      bool lastState = _lastFunctions[funcIdx];
-
-      if (state != lastState) {
-        Log.printf(
-            "Audio: Function F%d Changed to %d. Triggering Asset %d (%s)\n",
-            funcIdx, state, id, asset.name.c_str());
-
-        if (asset.type == "toggle") {
-          if (state)
-            playFile(asset.fileLoop.c_str());
-          else
-            stop();
-        } else if (asset.type == "simple" || asset.type == "complex_loop") {
-          if (state) {
-            if (asset.fileIntro.length() > 0)
-              playFile(asset.fileIntro.c_str());
-            else
-              playFile(asset.fileLoop.c_str());
-          } else if (!state && asset.type == "complex_loop") {
-            stop();
-          }
-        }
-      }
+  // Only visit functions that both changed and have a sound bound to them
+  uint32_t changed = (functionMask ^ _lastFunctionMask) & _mappedMask;
+  _lastFunctionMask = functionMask;
+
+  while (changed) {
+    uint8_t funcIdx = __builtin_ctz(changed);
+    changed &= changed - 1;
+    bool active = (functionMask >> funcIdx) & 1;
+    for (uint16_t i = _slotStart[funcIdx]; i < _slotStart[funcIdx + 1]; i++) {
+      _dispatch(_slots[i], active);
     }
   }
+  // Timed to the block that first carries the sound
+  if (cause && !_pendingCause)
+    _pendingCause = cause;
 
-  memcpy(_lastFunctions, currentFunctions, 29 * sizeof(bool));
+  _engine.update(speed, momentum, load, _cvNotchTime * 100u, _cvLoadNotches);
+  _loadTarget = load;
+  for (auto &voice : _voices)
+    voice.service();
+  _render();
+}
 
-  if (_playing && _copier) {
-    if (!_copier->copy()) {
-      stop();
-      Log.println("Audio: Playback Finished");
+void AudioController::_render() {
+  bool any = _engine.active();
+  for (auto &voice : _voices)
+    any |= voice.active();
+  if (!any) {
+    // The block the limiter still holds goes out before the amp idles
+    if (_amp == AmpState::ON && _master.holding()) {
+      _writeBlock(0);
+      return;
     }
+    _pendingCause = 0; // Nothing started after all
+    _idleAmp();
+    return;
   }
+
+  _wakeAmp();
+  if (_amp == AmpState::WAKING) {
+    if (millis() - _ampSince < AMP_WARMUP_MS) {
+      // Voices keep decoding ahead; the DMA gets silence until the amp is up
+      int16_t silence[RENDER_FRAMES] = {0};
+      _volume->write((const uint8_t *)silence, sizeof(silence));
+      return;
+    }
+    _amp = AmpState::ON;
+    _writeBlock(1);
+    return;
+  }
+  _writeBlock(0);
 }
 
-void AudioController::loadAssets() {
-  if (!LittleFS.exists("/sound_assets.json")) {
-    Log.println("Audio: No sound_assets.json found.");
+void AudioController::_writeBlock(int8_t ramp) {
+  TraceScope trace(TRACE_AUDIO, "audio.block");
+  // Each source is shaped on its own, then summed into the master bus
+  float bus[RENDER_FRAMES] = {0};
+  int32_t acc[RENDER_FRAMES];
+  _load += (_loadTarget - _load) * LOAD_SMOOTHING;
+  for (uint8_t v = 0; v < MAX_VOICES; v++) {
+    if (!_voices[v].active()) {
+      _voiceDsp[v].reset();
+      continue;
+    }
+    memset(acc, 0, sizeof(acc));
+    _voices[v].mix(acc, RENDER_FRAMES, OUTPUT_RATE);
+    _voiceDsp[v].process(acc, bus, RENDER_FRAMES, _voiceTone, _load);
+  }
+  if (_engine.active()) {
+    memset(acc, 0, sizeof(acc));
+    _engine.mix(acc, RENDER_FRAMES, OUTPUT_RATE);
+    _engineDsp.process(acc, bus, RENDER_FRAMES, _engineTone, _load);
+  } else {
+    _engineDsp.reset();
+  }
+  // ramp > 0 fades the new block in, ahead of the limiter's lookahead;
+  // ramp < 0 fades out the block that comes out of it
+  if (ramp > 0) {
+    for (size_t i = 0; i < RAMP_FRAMES; i++)
+      bus[i] = bus[i] * i / RAMP_FRAMES;
+  }
+  _master.process(bus, RENDER_FRAMES);
+
+  int16_t out[RENDER_FRAMES];
+  for (size_t i = 0; i < RENDER_FRAMES; i++) {
+    float s = bus[i];
+    if (ramp < 0)
+      s = i < RAMP_FRAMES ? s * (RAMP_FRAMES - i) / RAMP_FRAMES : 0.0f;
+    out[i] = (int16_t)constrain(lrintf(s), -32768L, 32767L);
+  }
+
+  // Blocks on the I2S DMA queue, which paces this loop to the sample clock
+  _volume->write((const uint8_t *)out, sizeof(out));
+  // A sound mixed into this block is heard with the next one
+  if (_heldCause)
+    LatencyMonitor::getInstance().record(LATENCY_FUNCTION, _heldCause);
+  _heldCause = _pendingCause;
+  _pendingCause = 0;
+}
+
+AudioVoice &AudioController::_allocVoice(uint8_t assetId) {
+  for (auto &voice : _voices) {
+    if (voice.active() && assetId != 0 && voice.assetId() == assetId)
+      return voice;
+  }
+  for (auto &voice : _voices) {
+    if (!voice.active())
+      return voice;
+  }
+  // All busy: steal round-robin
+  AudioVoice &victim = _voices[_nextSteal];
+  _nextSteal = (_nextSteal + 1) % MAX_VOICES;
+  return victim;
+}
+
+void AudioController::_wakeAmp() {
+  switch (_amp) {
+  case AmpState::OFF:
+    // No wait here: _render() feeds silence until the warmup has passed
+    digitalWrite(Pinout::AMP_SD_MODE, HIGH);
+    _amp = AmpState::WAKING;
+    _ampSince = millis();
+    break;
+  case AmpState::HANGOVER:
+    _amp = AmpState::ON;
+    break;
+  default:
+    break;
+  }
+}
+
+void AudioController::_idleAmp() {
+  switch (_amp) {
+  case AmpState::ON:
+  case AmpState::WAKING:
+    _amp = AmpState::HANGOVER;
+    _ampSince = millis();
+    Log.println("Audio: Playback Finished");
+    break;
+  case AmpState::HANGOVER:
+    if (millis() - _ampSince >= _cvAmpHangover * 100u) {
+      digitalWrite(Pinout::AMP_SD_MODE, LOW);
+      _amp = AmpState::OFF;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void AudioController::_dispatch(const SoundSlot &slot, bool active) {
+  const SoundAsset &asset = *slot.asset;
+  Log.printf("Audio: Function F%d Changed to %d. Triggering Asset %d (%s)\n",
+             asset.function, active, asset.id, asset.name.c_str());
+
+  // The engine owns its layers and never takes a voice
+  if (asset.type == SoundType::DIESEL) {
+    if (!active) {
+      _engine.release();
+      return;
+    }
+    // Layers that were missing at load (an MP3 whose rendition was still
+    // being built) get another chance when the engine is started
+    if (!_engine.loaded() && !_engine.load(asset))
+      return;
+    _wakeAmp();
+    _engine.start();
     return;
   }
 
-  File file = LittleFS.open("/sound_assets.json", "r");
-  if (!file) {
-    Log.println("Audio: Failed to open sound_assets.json");
+  if (active) {
+    _wakeAmp();
+    _allocVoice(asset.id).start(asset);
     return;
   }
 
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, file);
-  if (error) {
-    Log.printf("Audio: JSON parse error: %s\n", error.c_str());
-    file.close();
+  // Release lets the loop finish its pass and run into the outro
+  if (asset.type == SoundType::SIMPLE)
     return;
+  for (auto &voice : _voices) {
+    if (voice.active() && voice.assetId() == asset.id)
+      voice.release();
   }
+}
 
-  JsonArray assets = doc["assets"];
+void AudioController::_refreshCvCache() {
+  if (millis() - _lastCvUpdate <= 500)
+    return;
+  _lastCvUpdate = millis();
+
+  NmraDcc &dcc = DccController::getInstance().getDcc();
+  uint8_t vol = dcc.getCV(CV::MASTER_VOL);
+  if (vol != _cvMasterVol && _volume) {
+    _cvMasterVol = vol;
+    _volume->setVolume(vol / 255.0f); // Map 0-255 to 0.0-1.0
+  }
+  _cvNotchTime = dcc.getCV(CV::ENGINE_NOTCH_TIME);
+  _cvLoadNotches = dcc.getCV(CV::ENGINE_LOAD_NOTCHES);
+  _cvAmpHangover = dcc.getCV(CV::AUDIO_AMP_HANGOVER);
+
+  // Tone tables are only rebuilt when their CVs move
+  uint8_t bass = dcc.getCV(CV::AUDIO_LOAD_BASS);
+  uint8_t voices = std::min<uint8_t>(dcc.getCV(CV::AUDIO_LOAD_VOICES), 100);
+  if (bass != _cvLoadBass || voices != _cvLoadVoices) {
+    _cvLoadBass = bass;
+    _cvLoadVoices = voices;
+    _engineTone.configure(bass * 0.5f, OUTPUT_RATE);
+    _voiceTone.configure(bass * 0.5f * voices / 100, OUTPUT_RATE);
+  }
+  uint8_t highPass = dcc.getCV(CV::AUDIO_HIGH_PASS);
+  if (highPass != _cvHighPass) {
+    _cvHighPass = highPass;
+    _master.configure(highPass * 10.0f, OUTPUT_RATE, RENDER_FRAMES);
+  }
+
+  // Re-compile the dispatch table only when a mapping CV actually moved
+  bool remapped = false;
+  for (auto &[id, asset] : _assets) {
+    uint8_t funcIdx = dcc.getCV(CV::AUDIO_MAP_BASE + id);
+    if (funcIdx != asset.function) {
+      asset.function = funcIdx;
+      remapped = true;
+    }
+  }
+  if (remapped)
+    _rebuildDispatchTable();
+}
+
+void AudioController::_rebuildDispatchTable() {
+  uint8_t counts[29] = {0};
+  for (auto const &[id, asset] : _assets) {
+    if (asset.function <= 28)
+      counts[asset.function]++;
+  }
+
+  _slotStart[0] = 0;
+  for (uint8_t f = 0; f < 29; f++)
+    _slotStart[f + 1] = _slotStart[f] + counts[f];
+
+  uint16_t fill[29];
+  memcpy(fill, _slotStart, sizeof(fill));
+  _slots.assign(_slotStart[29], SoundSlot{nullptr, nullptr});
+  _mappedMask = 0;
+
+  for (auto const &[id, asset] : _assets) {
+    if (asset.function > 28)
+      continue;
+    const String *start = &asset.fileLoop;
+    if (asset.type != SoundType::TOGGLE && asset.fileIntro.length() > 0)
+      start = &asset.fileIntro;
+    else if (asset.type == SoundType::DIESEL)
+      start = &asset.notches[0];
+    _slots[fill[asset.function]++] = {&asset, start->c_str()};
+    _mappedMask |= 1UL << asset.function;
+  }
+}
+
+void AudioController::loadAssets() {
+  // A mounted pack replaces every asset but the diesel engines, which the
+  // pack format does not carry: those still come from the LittleFS manifest,
+  // unless a pack asset already holds their id
+  SoundPack &pack = SoundPack::getInstance();
+  std::vector<SoundAsset> assets;
+  uint32_t heapBefore = ESP.getFreeHeap();
+  unsigned long started = micros();
+  if (!LittleFS.exists(SoundManifest::JSON_PATH)) {
+    Log.println("Audio: No sound_assets.json found.");
+    if (!pack.mounted())
+      return;
+  } else {
+    // Compiled at upload; this only catches a JSON copied in some other way
+    String error;
+    if (SoundManifest::stale() && !SoundManifest::compile(error))
+      Log.printf("Audio: sound_assets.json rejected: %s\n", error.c_str());
+    if (!SoundManifest::load(assets)) {
+      Log.println("Audio: No valid sound asset manifest");
+      if (!pack.mounted())
+        return;
+    }
+  }
+
+  NmraDcc &dcc = DccController::getInstance().getDcc();
+  stop(); // Voices hold pointers into _assets
+  _engine.unload();
   _assets.clear();
-  for (JsonObject obj : assets) {
-    SoundAsset asset;
-    asset.id = obj["id"];
-    asset.name = obj["name"].as<String>();
-    asset.type = obj["type"].as<String>();
-
-    JsonObject files = obj["files"];
-    if (files["intro"].is<String>())
-      asset.fileIntro = files["intro"].as<String>();
-    if (files["loop"].is<String>())
-      asset.fileLoop = files["loop"].as<String>();
-    if (files["outro"].is<String>())
-      asset.fileOutro = files["outro"].as<String>();
+  if (pack.mounted()) {
+    for (SoundAsset asset : pack.assets()) {
+      asset.function = dcc.getCV(CV::AUDIO_MAP_BASE + asset.id);
+      _assets[asset.id] = asset;
+      Log.printf("Audio: Loaded Asset %d (%s) from sound pack\n", asset.id,
+                 asset.name.c_str());
+    }
+  }
 
+  for (SoundAsset &asset : assets) {
+    if (pack.mounted() &&
+        (asset.type != SoundType::DIESEL || _assets.count(asset.id)))
+      continue;
+    // Resumes renditions that were still pending at the last shutdown
+    for (const String *path :
+         {&asset.fileIntro, &asset.fileLoop, &asset.fileOutro})
+      AudioTranscoder::getInstance().enqueue(*path);
+    for (const std::vector<String> *list :
+         {&asset.notches, &asset.notchUp, &asset.notchDown}) {
+      for (const String &path : *list)
+        AudioTranscoder::getInstance().enqueue(path);
+    }
+
+    asset.function = dcc.getCV(CV::AUDIO_MAP_BASE + asset.id);
     _assets[asset.id] = asset;
+    if (asset.type == SoundType::DIESEL)
+      _engine.load(_assets[asset.id]);
     Log.printf("Audio: Loaded Asset %d (%s)\n", asset.id, asset.name.c_str());
   }
-  file.close();
+  Log.printf("Audio: %u assets loaded in %lu us, %ld bytes of heap\n",
+             (unsigned)_assets.size(), micros() - started,
+             (long)heapBefore - (long)ESP.getFreeHeap());
+
+  _rebuildDispatchTable();
 }
 
 void AudioController::playFile(const char *filename) {
@@ -154,41 +396,26 @@ void AudioController::playFile(const char *filename) {
     return;
   }
 
-  stop();
-
-  // Wake up Amp
-  digitalWrite(Pinout::AMP_SD_MODE, HIGH);
-  delay(10); // Small warmup
-
-  _file = LittleFS.open(filename, "r");
-  if (!_file) {
-    Log.printf("Audio: File not found: %s\n", filename);
-    digitalWrite(Pinout::AMP_SD_MODE, LOW);
+  if (!_allocVoice(0).startFile(filename))
     return;
-  }
-
-  if (isMp3File(filename)) {
-    Log.println("Audio: Detected MP3");
-    _decoder->setDecoder(_mp3);
-  } else {
-    Log.println("Audio: Detected WAV");
-    _decoder->setDecoder(_wav);
-  }
-
-  _decoder->begin();
-  _copier->begin(*_decoder, _file);
-  _playing = true;
+  _wakeAmp();
   Log.printf("Audio: Playing %s\n", filename);
 }
 
 void AudioController::stop() {
-  if (_playing) {
-    _playing = false;
-    _decoder->end();
-    if (_file) {
-      _file.close();
-    }
-  }
-  // Mute Amp
-  digitalWrite(Pinout::AMP_SD_MODE, LOW);
-}
\ No newline at end of file
+  // One last block ramps the mix down, so cutting the voices does not click
+  bool any = _engine.active() || _master.holding();
+  for (auto &voice : _voices)
+    any |= voice.active();
+  if (any && _amp == AmpState::ON && _volume)
+    _writeBlock(-1);
+
+  for (auto &voice : _voices)
+    voice.stop();
+  _engine.stop();
+  // The block mixed last is never heard
+  _master.reset();
+  _heldCause = 0;
+  // The amp powers down after the hangover, like after any other sound
+  _idleAmp();
+}
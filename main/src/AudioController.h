@@ -8,16 +8,16 @@
 #include <map>
 #include <vector>
 
+#include "AudioDsp.h"
 #include "AudioTools.h"
-#include "AudioTools/AudioCodecs/CodecMP3Helix.h"
-
-struct SoundAsset {
-  uint8_t id;
-  String name;
-  String type; // "simple", "complex_loop", "toggle"
-  String fileIntro;
-  String fileLoop;
-  String fileOutro;
+#include "AudioVoice.h"
+#include "EngineSound.h"
+#include "SoundAsset.h"
+
+// One function -> asset binding in the dispatch table.
+struct SoundSlot {
+  const SoundAsset *asset;
+  const char *startFile; // Played on activation (intro if present, else loop)
 };
 
 class AudioController {
@@ -38,17 +38,67 @@ public:
 private:
   AudioController();
 
+  void _refreshCvCache();
+  void _rebuildDispatchTable();
+  void _dispatch(const SoundSlot &slot, bool active);
+  AudioVoice &_allocVoice(uint8_t assetId);
+  void _wakeAmp();
+  void _idleAmp();
+  void _render();
+  void _writeBlock(int8_t ramp);
+
   I2SStream *_i2s;
   VolumeStream *_volume;
-  EncodedAudioStream *_decoder;
-  MP3DecoderHelix *_mp3;
-  WAVDecoder *_wav;
-  StreamCopy *_copier;
-  File _file; // Using LittleFS File
 
-  bool _playing = false;
+  // Mixer: every voice renders into one mono block at OUTPUT_RATE
+  static constexpr uint8_t MAX_VOICES = 4;
+  static constexpr size_t RENDER_FRAMES = 256;
+  static constexpr uint32_t OUTPUT_RATE = 44100;
+  AudioVoice _voices[MAX_VOICES];
+  EngineSound _engine; // The one DIESEL asset, if any
+  uint8_t _nextSteal = 0;
+
+  // DSP: a load-dependent tone per voice, then the master stage on the mix
+  static constexpr float LOAD_SMOOTHING = 0.1f; // Per block, ~60 ms
+  ChannelDsp _voiceDsp[MAX_VOICES];
+  ChannelDsp _engineDsp;
+  LoadTone _voiceTone;
+  LoadTone _engineTone;
+  MasterDsp _master;
+  float _loadTarget = 0.0f; // Motor load, 0-1
+  float _load = 0.0f;       // The same, smoothed per block
+
+  // Amp power (MAX98357A SD_MODE). WAKING feeds silence until the amp has
+  // settled; HANGOVER keeps it on for a while after the last sound so the
+  // next trigger starts at once.
+  enum class AmpState : uint8_t { OFF, WAKING, ON, HANGOVER };
+  static constexpr uint32_t AMP_WARMUP_MS = 10;
+  static constexpr size_t RAMP_FRAMES = 128; // Click-free start/stop, ~3 ms
+  AmpState _amp = AmpState::OFF;
+  unsigned long _ampSince = 0;
+
   std::map<uint8_t, SoundAsset> _assets;
-  bool _lastFunctions[29] = {false};
+
+  // Function-indexed dispatch table (CSR layout): the slots bound to function
+  // F are _slots[_slotStart[F] .. _slotStart[F + 1]).
+  std::vector<SoundSlot> _slots;
+  uint16_t _slotStart[30] = {0};
+  uint32_t _mappedMask = 0;       // Functions with at least one slot
+  uint32_t _lastFunctionMask = 0; // F0-F28 as bits
+  // Causality IDs of the function packet whose sound is yet to be mixed,
+  // and of the one mixed into the block the limiter holds
+  uint32_t _pendingCause = 0;
+  uint32_t _heldCause = 0;
+
+  // CV Cache
+  unsigned long _lastCvUpdate = 0;
+  uint8_t _cvMasterVol = 0;
+  uint8_t _cvNotchTime = 10;
+  uint8_t _cvLoadNotches = 2;
+  uint8_t _cvAmpHangover = 20;
+  uint8_t _cvLoadBass = 0xFF; // Out of range: the first refresh configures
+  uint8_t _cvLoadVoices = 0;
+  uint8_t _cvHighPass = 0xFF;
 };
 
 #endif
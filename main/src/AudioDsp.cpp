@@ -0,0 +1,146 @@
+#include "AudioDsp.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <esp_dsp.h>
+
+namespace {
+constexpr size_t BLOCK = 256; // Frames per kernel call
+
+// Kernel scratch, off the stack; every stage runs on the mixer's task
+float scratchX[BLOCK];
+float scratchY[BLOCK];
+float scratchZ[BLOCK];
+
+void normalise(BiquadCoeffs out, float b0, float b1, float b2, float a0,
+               float a1, float a2) {
+  out[0] = b0 / a0;
+  out[1] = b1 / a0;
+  out[2] = b2 / a0;
+  out[3] = a1 / a0;
+  out[4] = a2 / a0;
+}
+
+// Butterworth sections (RBJ cookbook)
+constexpr float Q = (float)M_SQRT1_2;
+} // namespace
+
+void biquadIdentity(BiquadCoeffs out) {
+  out[0] = 1.0f;
+  out[1] = out[2] = out[3] = out[4] = 0.0f;
+}
+
+void biquadLowPass(BiquadCoeffs out, float hz, float rate) {
+  float w0 = 2.0f * (float)M_PI * hz / rate;
+  float c = cosf(w0);
+  float alpha = sinf(w0) / (2.0f * Q);
+  normalise(out, (1 - c) / 2, 1 - c, (1 - c) / 2, 1 + alpha, -2 * c,
+            1 - alpha);
+}
+
+void biquadHighPass(BiquadCoeffs out, float hz, float rate) {
+  float w0 = 2.0f * (float)M_PI * hz / rate;
+  float c = cosf(w0);
+  float alpha = sinf(w0) / (2.0f * Q);
+  normalise(out, (1 + c) / 2, -(1 + c), (1 + c) / 2, 1 + alpha, -2 * c,
+            1 - alpha);
+}
+
+void LoadTone::configure(float bassDb, uint32_t rate) {
+  _bassDb = bassDb;
+  biquadLowPass(_lowPass, LOW_HZ, rate);
+  biquadHighPass(_highPass, HIGH_HZ, rate);
+}
+
+LoadTone::Gains LoadTone::at(float load) const {
+  float db = _bassDb * constrain(load, 0.0f, 1.0f);
+  return {powf(10.0f, db / 20.0f) - 1.0f, powf(10.0f, -db / 40.0f) - 1.0f,
+          powf(10.0f, db / 80.0f)};
+}
+
+void ChannelDsp::process(const int32_t *in, float *bus, size_t frames,
+                         LoadTone &tone, float load) {
+  if (frames == 0)
+    return;
+  LoadTone::Gains to = tone.at(load);
+  float *x = scratchX, *low = scratchY, *high = scratchZ;
+
+  // Envelope: ramp to the new gains across the whole call, so they never
+  // step, whatever the number of kernel blocks it takes
+  LoadTone::Gains g = _gains;
+  float dLow = (to.low - g.low) / frames;
+  float dHigh = (to.high - g.high) / frames;
+  float dOut = (to.out - g.out) / frames;
+  for (size_t done = 0; done < frames; done += BLOCK) {
+    size_t n = std::min(BLOCK, frames - done);
+    for (size_t i = 0; i < n; i++)
+      x[i] = (float)in[done + i];
+    dsps_biquad_f32(x, low, n, tone.lowPass(), _wLow);
+    dsps_biquad_f32(x, high, n, tone.highPass(), _wHigh);
+
+    for (size_t i = 0; i < n; i++) {
+      g.low += dLow;
+      g.high += dHigh;
+      g.out += dOut;
+      bus[done + i] += (x[i] + g.low * low[i] + g.high * high[i]) * g.out;
+    }
+  }
+  _gains = to;
+}
+
+void ChannelDsp::reset() {
+  _wLow[0] = _wLow[1] = 0.0f;
+  _wHigh[0] = _wHigh[1] = 0.0f;
+}
+
+void MasterDsp::configure(float highPassHz, uint32_t rate,
+                          size_t blockFrames) {
+  if (highPassHz > 0)
+    biquadHighPass(_hp, highPassHz, rate);
+  else
+    biquadIdentity(_hp);
+  _release = expf(-1000.0f * blockFrames / rate / RELEASE_MS);
+}
+
+void MasterDsp::process(float *bus, size_t frames) {
+  static_assert(LOOKAHEAD >= BLOCK, "a block must fit in the lookahead");
+  float *y = scratchY;
+  for (size_t done = 0; done < frames; done += BLOCK) {
+    size_t n = std::min(BLOCK, frames - done);
+    float *x = bus + done;
+    dsps_biquad_f32(x, y, n, _hp, _w);
+
+    // The gain suits every frame still to come out: those held, which
+    // include the ones leaving now, and the new ones. It ramps there across
+    // the block, so it never steps; the frames leaving already fit the gain
+    // it starts from.
+    float held = 0.0f, peak = 0.0f;
+    for (size_t i = 0; i < LOOKAHEAD; i++)
+      held = std::max(held, fabsf(_line[i]));
+    for (size_t i = 0; i < n; i++)
+      peak = std::max(peak, fabsf(y[i]));
+    float top = std::max(held, peak);
+    float want = top > CEILING ? CEILING / top : 1.0f;
+    float to = want < _gain ? want : want + (_gain - want) * _release;
+    float step = (to - _gain) / n;
+    float g = _gain;
+    for (size_t i = 0; i < n; i++) {
+      float out = _line[_pos];
+      _line[_pos] = y[i];
+      _pos = (_pos + 1) % LOOKAHEAD;
+      g += step;
+      x[i] = out * g;
+    }
+    _gain = to;
+    // Under half a step of the output is silence
+    _holding = peak >= 0.5f || (n < LOOKAHEAD && held >= 0.5f);
+  }
+}
+
+void MasterDsp::reset() {
+  memset(_line, 0, sizeof(_line));
+  _pos = 0;
+  _w[0] = _w[1] = 0.0f;
+  _gain = 1.0f;
+  _holding = false;
+}
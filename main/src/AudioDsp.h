@@ -0,0 +1,124 @@
+#ifndef AUDIO_DSP_H
+#define AUDIO_DSP_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Block DSP for the mixer: a tone stage per voice and a master stage
+ * on the mix.
+ *
+ * Filters run through the esp-dsp biquad kernel, which uses the S3's SIMD
+ * instructions. Every stage does the same work each block whatever its
+ * settings: a flat tone still runs its filters, and parameters only move
+ * gains, which ramp across the block. Motor load never changes the cost of a
+ * block.
+ */
+
+// Coefficients in esp-dsp order: b0, b1, b2, a1, a2 (a0 normalised to 1)
+using BiquadCoeffs = float[5];
+
+void biquadIdentity(BiquadCoeffs out);
+void biquadLowPass(BiquadCoeffs out, float hz, float rate);
+void biquadHighPass(BiquadCoeffs out, float hz, float rate);
+
+/**
+ * @brief Tone for a motor load from 0 to 1. At full load the band below
+ * LOW_HZ is raised by the bass depth, the band above HIGH_HZ is cut by half
+ * of it, and the gain is raised by a quarter of it, which makes a working
+ * engine sound heavier.
+ *
+ * The band filters are fixed; load only moves the gains they are mixed back
+ * in with. Retuning a biquad mid-stream makes it click, ramping a gain does
+ * not.
+ */
+class LoadTone {
+public:
+  static constexpr float LOW_HZ = 150.0f;
+  static constexpr float HIGH_HZ = 3000.0f;
+
+  LoadTone() { configure(0.0f, 44100); }
+
+  void configure(float bassDb, uint32_t rate);
+  float bassDb() const { return _bassDb; }
+
+  struct Gains {
+    float low;  // Low band added on top of the dry signal (0 = flat)
+    float high; // Likewise for the high band
+    float out;
+  };
+  Gains at(float load) const; // @p load is clamped to 0..1
+
+  float *lowPass() { return _lowPass; }
+  float *highPass() { return _highPass; }
+
+private:
+  float _bassDb = 0.0f;
+  BiquadCoeffs _lowPass;
+  BiquadCoeffs _highPass;
+};
+
+/**
+ * @brief Per-voice stage: splits off the low and high band, then mixes them
+ * back with gains that ramp to the new load over each block.
+ */
+class ChannelDsp {
+public:
+  /**
+   * @brief Converts @p frames of @p in, shapes them, and adds the result to
+   * @p bus.
+   */
+  void process(const int32_t *in, float *bus, size_t frames, LoadTone &tone,
+               float load);
+
+  void reset(); // Clears filter state; the next sound starts clean
+
+private:
+  float _wLow[2] = {0, 0};
+  float _wHigh[2] = {0, 0};
+  LoadTone::Gains _gains = {0.0f, 0.0f, 1.0f};
+};
+
+/**
+ * @brief Master stage on the mixed bus: an optional high-pass to keep bass
+ * out of a small speaker, then a peak limiter in place of hard clipping.
+ *
+ * The limiter looks LOOKAHEAD frames ahead: the bus comes out that much
+ * later, so the gain can ramp down across the block before a peak instead
+ * of stepping at its first frame.
+ */
+class MasterDsp {
+public:
+  static constexpr float CEILING = 31000.0f; // About -0.5 dBFS
+  static constexpr float RELEASE_MS = 150.0f;
+  static constexpr size_t LOOKAHEAD = 256; // Frames; 5.8 ms at 44.1 kHz
+
+  /**
+   * @param highPassHz 0 for a flat response.
+   */
+  void configure(float highPassHz, uint32_t rate, size_t blockFrames);
+
+  /**
+   * @brief Filters @p frames of @p bus and replaces them with the limited
+   * frames of LOOKAHEAD frames earlier.
+   */
+  void process(float *bus, size_t frames);
+
+  void reset(); // Drops the held frames and the filter state
+
+  // true while frames given to process() have yet to come out
+  bool holding() const { return _holding; }
+
+  // Gain applied to the last block (1 = no limiting)
+  float limiterGain() const { return _gain; }
+
+private:
+  BiquadCoeffs _hp = {1, 0, 0, 0, 0};
+  float _w[2] = {0, 0};
+  float _gain = 1.0f;
+  float _release = 0.0f; // Share of the gain reduction kept per block
+  float _line[LOOKAHEAD] = {0}; // Filtered frames not yet out, a ring
+  size_t _pos = 0;
+  bool _holding = false;
+};
+
+#endif
@@ -0,0 +1,311 @@
+#include "AudioPrefetcher.h"
+#include "CvRegistry.h"
+#include "DccController.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+// Ring per stream from CV 56, as a power of two within MIN_RING..MAX_RING
+size_t ringBytes() {
+  NmraDcc &dcc = DccController::getInstance().getDcc();
+  uint8_t kb = dcc.getCV(CV::AUDIO_READ_AHEAD);
+  if (kb == 0)
+    return 0;
+  size_t want = std::min((size_t)kb * 1024, AudioPrefetcher::MAX_RING);
+  size_t size = AudioPrefetcher::MIN_RING;
+  while (size * 2 <= want)
+    size *= 2;
+  return size;
+}
+} // namespace
+
+AudioPrefetcher::AudioPrefetcher() { _mutex = xSemaphoreCreateMutex(); }
+
+void AudioPrefetcher::startTask() {
+  _running = true;
+  if (_taskHandle == NULL) {
+    xTaskCreatePinnedToCore(_taskEntry, "Prefetch", 4096, this,
+                            2, // Above the transcoder, below the control plane
+                            &_taskHandle,
+                            0 // Core 0, away from the audio render loop
+    );
+  }
+}
+
+void AudioPrefetcher::_taskEntry(void *param) {
+  AudioPrefetcher *self = (AudioPrefetcher *)param;
+  for (;;) {
+    // Sleep a tick even while busy so the idle task (and its watchdog) runs
+    vTaskDelay(self->step() ? 1 : pdMS_TO_TICKS(5));
+  }
+}
+
+AudioPrefetcher::Slot *AudioPrefetcher::_slot(int8_t id) {
+  if (id < 0 || id >= MAX_STREAMS || _slots[id].state != State::OPEN)
+    return nullptr;
+  return &_slots[id];
+}
+
+int8_t AudioPrefetcher::open(File &file) {
+  size_t size = ringBytes();
+  if (!_running || !file || size == 0)
+    return -1;
+
+  // Reserve a slot; busy keeps the task away until the first chunk is in
+  int8_t id = -1;
+  _lock();
+  for (uint8_t i = 0; i < MAX_STREAMS && id < 0; i++) {
+    Slot &s = _slots[i];
+    if (s.state == State::CLOSING && !s.busy) {
+      s.file.close();
+      s.file = File();
+      s.state = State::FREE;
+    }
+    if (s.state == State::FREE) {
+      s.state = State::OPEN;
+      s.busy = true;
+      id = i;
+    }
+  }
+  _unlock();
+  if (id < 0)
+    return -1;
+
+  Slot &s = _slots[id];
+  if (s.size != size) {
+    free(s.ring);
+    s.ring = (uint8_t *)malloc(size);
+    s.size = s.ring ? size : 0;
+  }
+  if (!s.ring) {
+    _lock();
+    s.state = State::FREE;
+    s.busy = false;
+    _unlock();
+    return -1;
+  }
+
+  s.file = file;
+  s.fileSize = file.size();
+  s.head = s.tail = 0;
+  s.offset = s.readPos = 0;
+  s.loopFrom = -1;
+  s.wrapped = false;
+  s.generation++;
+  s.starved = false;
+  s.stalls = 0;
+  s.lowWater = SIZE_MAX;
+  // The header is needed right away to pick the decoder
+  _fill(s);
+
+  _lock();
+  s.busy = false;
+  _unlock();
+  file = File();
+  return id;
+}
+
+void AudioPrefetcher::close(int8_t id) {
+  _lock();
+  // The task closes the file, so the audio path never waits on it
+  if (Slot *s = _slot(id))
+    s->state = State::CLOSING;
+  _unlock();
+}
+
+size_t AudioPrefetcher::_available(const Slot &s) const {
+  return (s.wrapped ? s.wrapAt : s.head) - s.tail;
+}
+
+size_t AudioPrefetcher::_copy(const Slot &s, uint8_t *buf, size_t len) const {
+  size_t n = std::min(len, _available(s));
+  size_t at = s.tail & (s.size - 1);
+  size_t first = std::min(n, s.size - at);
+  memcpy(buf, s.ring + at, first);
+  memcpy(buf + first, s.ring, n - first);
+  return n;
+}
+
+size_t AudioPrefetcher::read(int8_t id, uint8_t *buf, size_t len) {
+  _lock();
+  Slot *s = _slot(id);
+  size_t n = s ? _copy(*s, buf, len) : 0;
+  if (s) {
+    s->tail += n;
+    s->offset += n;
+    s->lowWater = std::min(s->lowWater, s->head - s->tail);
+    if (n > 0) {
+      s->starved = false;
+    } else if (len > 0 && s->offset < s->fileSize && !s->starved) {
+      // Counted once per dry spell, not once per retry
+      s->starved = true;
+      s->stalls++;
+      _stalls++;
+    }
+  }
+  _unlock();
+  return n;
+}
+
+size_t AudioPrefetcher::peek(int8_t id, uint8_t *buf, size_t len) {
+  _lock();
+  Slot *s = _slot(id);
+  size_t n = s ? _copy(*s, buf, len) : 0;
+  _unlock();
+  return n;
+}
+
+bool AudioPrefetcher::pending(int8_t id) {
+  _lock();
+  Slot *s = _slot(id);
+  bool pending = s && _available(*s) == 0 && s->offset < s->fileSize;
+  _unlock();
+  return pending;
+}
+
+bool AudioPrefetcher::seek(int8_t id, size_t pos) {
+  _lock();
+  Slot *s = _slot(id);
+  if (!s || pos > s->fileSize) {
+    _unlock();
+    return false;
+  }
+  size_t ahead = _available(*s);
+  if (pos >= s->offset && pos - s->offset <= ahead) {
+    // Forward within this pass
+    s->tail += pos - s->offset;
+  } else if (s->wrapped && pos >= s->wrapFrom &&
+             pos - s->wrapFrom <= s->head - s->wrapAt) {
+    // Into the next pass, read ahead past the end of the file
+    s->tail = s->wrapAt + (pos - s->wrapFrom);
+    s->wrapped = false;
+  } else {
+    s->generation++; // Drops a read in flight
+    s->head = s->tail = 0;
+    s->readPos = pos;
+    s->wrapped = false;
+  }
+  s->offset = pos;
+  _unlock();
+  return true;
+}
+
+void AudioPrefetcher::setLoop(int8_t id, int32_t pos) {
+  _lock();
+  if (Slot *s = _slot(id))
+    s->loopFrom = pos;
+  _unlock();
+}
+
+bool AudioPrefetcher::_fill(Slot &s) {
+  _lock();
+  if (s.readPos >= s.fileSize && s.loopFrom >= 0 && !s.wrapped &&
+      (uint32_t)s.loopFrom < s.fileSize) {
+    s.wrapped = true;
+    s.wrapAt = s.head;
+    s.wrapFrom = s.loopFrom;
+    s.readPos = s.loopFrom;
+  }
+  uint32_t generation = s.generation;
+  uint32_t pos = s.readPos;
+  size_t at = s.head;
+  size_t space = s.size - (s.head - s.tail);
+  _unlock();
+
+  // Block aligned: the read ends on a READ_CHUNK boundary of the file
+  if (pos >= s.fileSize)
+    return false;
+  size_t n =
+      std::min<size_t>(READ_CHUNK - pos % READ_CHUNK, s.fileSize - pos);
+  if (space < n)
+    return false;
+  size_t index = at & (s.size - 1);
+  size_t first = std::min(n, s.size - index);
+
+  unsigned long started = micros();
+  size_t got = 0;
+  if (s.file.position() == pos || s.file.seek(pos)) {
+    got = s.file.read(s.ring + index, first);
+    if (got == first && first < n)
+      got += s.file.read(s.ring, n - first);
+  }
+  uint32_t took = micros() - started;
+
+  _lock();
+  if (generation == s.generation) {
+    if (got < n)
+      s.fileSize = pos + got; // Read error: treat as the end of the file
+    s.head += got;
+    s.readPos += got;
+  }
+  _reads++;
+  _bytes += got;
+  _readMaxUs = std::max(_readMaxUs, took);
+  _unlock();
+  return true;
+}
+
+bool AudioPrefetcher::step() {
+  Slot *pick = nullptr;
+  bool closed = false;
+  _lock();
+  for (Slot &s : _slots) {
+    if (s.state == State::CLOSING && !s.busy) {
+      s.file.close();
+      s.file = File();
+      s.state = State::FREE;
+      closed = true;
+    }
+    if (s.state != State::OPEN || s.busy)
+      continue;
+    uint32_t pos = s.readPos;
+    if (pos >= s.fileSize) {
+      if (s.loopFrom < 0 || s.wrapped || (uint32_t)s.loopFrom >= s.fileSize)
+        continue;
+      pos = s.loopFrom;
+    }
+    size_t want = std::min<size_t>(READ_CHUNK - pos % READ_CHUNK,
+                                   s.fileSize - pos);
+    size_t level = s.head - s.tail;
+    if (s.size - level < want)
+      continue;
+    // Emptiest ring first
+    if (!pick || level * pick->size < (pick->head - pick->tail) * s.size)
+      pick = &s;
+  }
+  if (pick)
+    pick->busy = true;
+  _unlock();
+
+  if (!pick)
+    return closed;
+  _fill(*pick);
+  _lock();
+  pick->busy = false;
+  _unlock();
+  return true;
+}
+
+void AudioPrefetcher::getStatus(JsonObject out) {
+  out["ring"] = ringBytes();
+  out["running"] = _running;
+  _lock();
+  out["stalls"] = _stalls;
+  out["reads"] = _reads;
+  out["bytes"] = _bytes;
+  out["read_max_us"] = _readMaxUs;
+  JsonArray streams = out["streams"].to<JsonArray>();
+  for (const Slot &s : _slots) {
+    if (s.state != State::OPEN)
+      continue;
+    JsonObject stream = streams.add<JsonObject>();
+    size_t level = s.head - s.tail;
+    stream["file"] = s.file.name();
+    stream["size"] = s.size;
+    stream["level"] = level;
+    stream["low_water"] = std::min(s.lowWater, level);
+    stream["stalls"] = s.stalls;
+  }
+  _unlock();
+}
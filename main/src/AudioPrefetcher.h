@@ -0,0 +1,135 @@
+#ifndef AUDIO_PREFETCHER_H
+#define AUDIO_PREFETCHER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+/**
+ * @brief Read-ahead for sound files played from LittleFS.
+ *
+ * Each open file gets a byte ring that a low-priority task keeps full, in
+ * reads of up to READ_CHUNK that end on a READ_CHUNK boundary of the file
+ * (one LittleFS block). The audio path only copies out of the ring, so an
+ * upload or a directory listing holding the file system delays the refill,
+ * not the decoder. When the ring runs dry, read() returns nothing and
+ * pending() tells the caller to come back, rather than blocking on flash.
+ *
+ * A looping file names the offset its next pass starts from with
+ * setLoop(). At the end of the file the task carries on from there, so the
+ * seek back to the loop start is served from the ring as well.
+ *
+ * CV 56 sets the ring per file in KB (0 = off). Streams are handed out by id
+ * and only while the task runs; otherwise callers read the File directly.
+ */
+class AudioPrefetcher {
+public:
+  static constexpr uint8_t MAX_STREAMS = 8; // Current + next file per voice
+  static constexpr size_t READ_CHUNK = 4096;
+  static constexpr size_t MIN_RING = 2 * READ_CHUNK;
+  static constexpr size_t MAX_RING = 64 * 1024;
+
+  static AudioPrefetcher &getInstance() {
+    static AudioPrefetcher instance;
+    return instance;
+  }
+
+  void startTask();
+
+  /**
+   * @brief Takes over @p file and reads its first chunk before returning.
+   * @return Stream id, or -1 if read-ahead is off, not running, or out of
+   * streams or memory. The caller keeps @p file in that case.
+   */
+  int8_t open(File &file);
+  void close(int8_t id);
+
+  /**
+   * @brief Copies up to @p len buffered bytes. Never touches the file.
+   * @return 0 at the end of the file, or while pending().
+   */
+  size_t read(int8_t id, uint8_t *buf, size_t len);
+  size_t peek(int8_t id, uint8_t *buf, size_t len);
+
+  /**
+   * @brief true while the ring is empty before the end of the file.
+   */
+  bool pending(int8_t id);
+
+  /**
+   * @brief Moves the read position. Within the buffered bytes this only
+   * moves the cursor; elsewhere the ring is dropped and refilled from @p pos.
+   */
+  bool seek(int8_t id, size_t pos);
+
+  /**
+   * @brief Where the next pass over the file starts; -1 to stop at the end.
+   */
+  void setLoop(int8_t id, int32_t pos);
+
+  /**
+   * @brief Tops up the emptiest ring by one read, and closes released
+   * files. The task calls this in a loop; tests call it directly.
+   * @return false when there was nothing to do.
+   */
+  bool step();
+
+  /**
+   * @brief Fills @p out with ring levels, stall and read counters.
+   */
+  void getStatus(JsonObject out);
+
+  uint32_t stalls() const { return _stalls; }
+
+private:
+  enum class State : uint8_t { FREE, OPEN, CLOSING };
+
+  struct Slot {
+    State state = State::FREE;
+    bool busy = false; // Task reading into the ring, outside the lock
+    File file;
+    uint32_t fileSize = 0;
+    uint8_t *ring = nullptr;
+    size_t size = 0; // Power of two
+    // Ring positions count bytes since the last reset; index = pos & mask
+    size_t head = 0; // Written by the task
+    size_t tail = 0; // Read by the audio path
+    uint32_t offset = 0;  // File offset at tail
+    uint32_t readPos = 0; // File offset the task reads next
+    int32_t loopFrom = -1;
+    bool wrapped = false; // Ring holds the next pass from wrapAt on
+    size_t wrapAt = 0;
+    uint32_t wrapFrom = 0; // File offset at wrapAt
+    uint32_t generation = 0; // Bumped by seeks that drop the ring
+    bool starved = false;
+    uint32_t stalls = 0;
+    size_t lowWater = SIZE_MAX;
+  };
+
+  AudioPrefetcher();
+
+  void _lock() { xSemaphoreTake(_mutex, portMAX_DELAY); }
+  void _unlock() { xSemaphoreGive(_mutex); }
+
+  Slot *_slot(int8_t id);
+  size_t _available(const Slot &s) const;
+  size_t _copy(const Slot &s, uint8_t *buf, size_t len) const;
+  bool _fill(Slot &s);
+  static void _taskEntry(void *param);
+
+  SemaphoreHandle_t _mutex;
+  TaskHandle_t _taskHandle = NULL;
+  bool _running = false;
+  Slot _slots[MAX_STREAMS];
+
+  // Totals since boot
+  uint32_t _stalls = 0;
+  uint32_t _reads = 0;
+  uint32_t _bytes = 0;
+  uint32_t _readMaxUs = 0; // Slowest single LittleFS read
+};
+
+#endif
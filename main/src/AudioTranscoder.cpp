@@ -0,0 +1,401 @@
+#include "AudioTranscoder.h"
+#include "AudioUtils.h"
+#include "CvRegistry.h"
+#include "DccController.h"
+#include "Logger.h"
+#include "Mp3Sidecar.h"
+
+namespace {
+using Format = AudioTranscoder::Format;
+
+constexpr size_t PCM_CHUNK = 256; // Frames per PCM write
+constexpr size_t PCM_HEADER = 44;
+constexpr size_t ADPCM_HEADER = 60; // fmt with cbSize, fact, data
+
+void put16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+void put32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+size_t adpcmFramesPerBlock() {
+  return imaAdpcmFramesPerBlock(AudioTranscoder::ADPCM_BLOCK, 1);
+}
+
+uint32_t dataBytes(Format format, uint32_t frames) {
+  if (format == Format::PCM)
+    return frames * sizeof(int16_t);
+  size_t per = adpcmFramesPerBlock();
+  return ((frames + per - 1) / per) * AudioTranscoder::ADPCM_BLOCK;
+}
+
+uint32_t renditionBytes(Format format, uint32_t frames) {
+  return dataBytes(format, frames) +
+         (format == Format::PCM ? PCM_HEADER : ADPCM_HEADER);
+}
+
+// The sizes are known up front, so the header is final when it is written
+bool writeWavHeader(File &f, Format format, uint32_t rate, uint32_t frames) {
+  uint8_t h[ADPCM_HEADER];
+  size_t len;
+  memcpy(h, "RIFF", 4);
+  memcpy(h + 8, "WAVE", 4);
+  memcpy(h + 12, "fmt ", 4);
+  put16(h + 22, 1); // Mono
+  put32(h + 24, rate);
+  if (format == Format::PCM) {
+    put32(h + 16, 16);
+    put16(h + 20, WAV_FORMAT_PCM);
+    put32(h + 28, rate * sizeof(int16_t));
+    put16(h + 32, sizeof(int16_t));
+    put16(h + 34, 16);
+    len = 36;
+  } else {
+    size_t per = adpcmFramesPerBlock();
+    put32(h + 16, 20);
+    put16(h + 20, WAV_FORMAT_IMA_ADPCM);
+    put32(h + 28, rate * AudioTranscoder::ADPCM_BLOCK / per);
+    put16(h + 32, AudioTranscoder::ADPCM_BLOCK);
+    put16(h + 34, 4);
+    put16(h + 36, 2);
+    put16(h + 38, per);
+    memcpy(h + 40, "fact", 4);
+    put32(h + 44, 4);
+    put32(h + 48, frames);
+    len = 52;
+  }
+  memcpy(h + len, "data", 4);
+  put32(h + len + 4, dataBytes(format, frames));
+  len += 8;
+  put32(h + 4, len - 8 + dataBytes(format, frames));
+  return f.write(h, len) == len;
+}
+
+uint8_t transcodeMode() {
+  return DccController::getInstance().getDcc().getCV(CV::AUDIO_TRANSCODE);
+}
+
+uint32_t renditionBudget() {
+  NmraDcc &dcc = DccController::getInstance().getDcc();
+  return (uint32_t)dcc.getCV(CV::AUDIO_RENDITION_BUDGET) *
+         AudioTranscoder::BUDGET_UNIT;
+}
+
+// Space taken by finished and in-progress renditions
+uint32_t renditionSpace() {
+  uint32_t used = 0;
+  File root = LittleFS.open("/");
+  if (!root || !root.isDirectory())
+    return 0;
+  for (File f = root.openNextFile(); f; f = root.openNextFile()) {
+    String name = f.name();
+    name.toLowerCase();
+    if (name.endsWith(".mp3.wav") || name.endsWith(".mp3.wav.tmp"))
+      used += f.size();
+  }
+  return used;
+}
+} // namespace
+
+String audioRenditionPath(const String &mp3Path) { return mp3Path + ".wav"; }
+
+AudioTranscoder::AudioTranscoder() { _mutex = xSemaphoreCreateMutex(); }
+
+void AudioTranscoder::startTask() {
+  if (_taskHandle == NULL) {
+    xTaskCreatePinnedToCore(_taskEntry, "Transcoder", 8192, this,
+                            1, // Below the control plane; idle time only
+                            &_taskHandle,
+                            0 // Core 0, away from the audio render loop
+    );
+  }
+}
+
+void AudioTranscoder::_taskEntry(void *param) {
+  AudioTranscoder *self = (AudioTranscoder *)param;
+  for (;;) {
+    // Sleep a tick even while busy so the idle task (and its watchdog) runs
+    vTaskDelay(self->step() ? 1 : pdMS_TO_TICKS(250));
+  }
+}
+
+void AudioTranscoder::enqueue(const String &mp3Path) {
+  if (!isMp3File(mp3Path.c_str()) || transcodeMode() == 0 ||
+      LittleFS.exists(audioRenditionPath(mp3Path)))
+    return;
+
+  _lock();
+  bool known = _state == State::RUNNING && _path == mp3Path;
+  for (const String &queued : _queue)
+    known |= queued == mp3Path;
+  if (!known)
+    _queue.push_back(mp3Path);
+  _unlock();
+}
+
+void AudioTranscoder::cancel(const String &mp3Path) {
+  _lock();
+  for (auto it = _queue.begin(); it != _queue.end();) {
+    if (*it == mp3Path)
+      it = _queue.erase(it);
+    else
+      ++it;
+  }
+  if (_state == State::RUNNING && _path == mp3Path)
+    _cancel = true;
+  _unlock();
+}
+
+bool AudioTranscoder::step() {
+  String next;
+  _lock();
+  bool running = _state == State::RUNNING;
+  bool cancelled = _cancel;
+  if (!running && !_queue.empty()) {
+    next = _queue.front();
+    _queue.pop_front();
+  }
+  _unlock();
+
+  if (!running) {
+    if (next.length() == 0)
+      return false;
+    _begin(next);
+    return true;
+  }
+  if (cancelled) {
+    _abort(State::IDLE, "cancelled");
+    return true;
+  }
+
+  uint8_t buf[READ_CHUNK];
+  size_t n = _src.read(buf, sizeof(buf));
+  if (n == 0) {
+    _finish();
+    return true;
+  }
+  _stream.write(buf, n);
+  if (_writeError) {
+    _abort(State::FAILED, "write failed (FS full?)");
+    return true;
+  }
+
+  uint8_t progress = (uint64_t)_src.position() * 100 / _src.size();
+  _lock();
+  _progress = progress;
+  _unlock();
+  return true;
+}
+
+bool AudioTranscoder::_begin(const String &mp3Path) {
+  _lock();
+  _path = mp3Path;
+  _state = State::RUNNING;
+  _format = Format::NONE;
+  _result = "";
+  _progress = 0;
+  _cancel = false;
+  _unlock();
+
+  uint8_t mode = transcodeMode();
+  if (mode == 0) {
+    _abort(State::SKIPPED, "disabled");
+    return false;
+  }
+
+  // The index gives the exact length and the priming/padding to cut
+  Mp3Index index;
+  if (!loadMp3Sidecar(mp3Path, index) &&
+      !(buildMp3Sidecar(mp3Path) && loadMp3Sidecar(mp3Path, index))) {
+    _abort(State::FAILED, "no MP3 frames");
+    return false;
+  }
+  _frames = index.validSamples();
+  _skip = index.primingSamples();
+
+  // PCM when asked for and it fits, else ADPCM, else leave the MP3 alone
+  uint32_t budget = renditionBudget();
+  uint32_t used = renditionSpace();
+  size_t fsTotal = LittleFS.totalBytes();
+  size_t fsUsed = LittleFS.usedBytes();
+  uint32_t fsFree =
+      fsTotal > fsUsed + FS_RESERVE ? fsTotal - fsUsed - FS_RESERVE : 0;
+  auto fits = [&](Format format) {
+    uint32_t need = renditionBytes(format, _frames);
+    return used + need <= budget && need <= fsFree;
+  };
+  Format format = Format::NONE;
+  if (mode == 2 && fits(Format::PCM))
+    format = Format::PCM;
+  else if (fits(Format::ADPCM))
+    format = Format::ADPCM;
+  if (format == Format::NONE) {
+    _abort(State::SKIPPED, "over space budget");
+    return false;
+  }
+
+  _lock();
+  _format = format;
+  _unlock();
+
+  // Written under a temporary name so a voice never opens a partial file
+  _tmpPath = audioRenditionPath(mp3Path) + ".tmp";
+  _src = LittleFS.open(mp3Path, "r");
+  _out = LittleFS.open(_tmpPath, "w");
+  if (!_src || !_out ||
+      !writeWavHeader(_out, format, index.sampleRate(), _frames)) {
+    _abort(State::FAILED, "open failed");
+    return false;
+  }
+  _src.seek(index.frameOffset(0)); // Past ID3 and the Xing/Info frame
+
+  _chunkFrames = format == Format::ADPCM ? adpcmFramesPerBlock() : PCM_CHUNK;
+  _pcm.clear();
+  _pcm.reserve(_chunkFrames);
+  _block.resize(format == Format::ADPCM ? ADPCM_BLOCK : 0);
+  _adpcm = ImaAdpcmState();
+  _written = 0;
+  _carryLen = 0;
+  _writeError = false;
+  _startMs = millis();
+  _stream.begin();
+  _decoding = true;
+
+  Log.printf("Audio: Transcoding %s to %s (%u frames)\n", mp3Path.c_str(),
+             format == Format::PCM ? "PCM" : "ADPCM", (unsigned)_frames);
+  return true;
+}
+
+size_t AudioTranscoder::write(const uint8_t *data, size_t len) {
+  uint8_t channels = _mp3.audioInfo().channels == 2 ? 2 : 1;
+  const size_t frameBytes = 2 * channels;
+  auto frame = [&](const uint8_t *pcm) {
+    int32_t sample = (int16_t)(pcm[0] | (pcm[1] << 8));
+    if (channels == 2)
+      sample = (sample + (int16_t)(pcm[2] | (pcm[3] << 8))) >> 1;
+    _sample((int16_t)sample);
+  };
+
+  size_t i = 0;
+  while (_carryLen > 0 && i < len) {
+    _carry[_carryLen++] = data[i++];
+    if (_carryLen == frameBytes) {
+      frame(_carry);
+      _carryLen = 0;
+    }
+  }
+  for (; i + frameBytes <= len; i += frameBytes)
+    frame(data + i);
+  while (i < len)
+    _carry[_carryLen++] = data[i++];
+  return len;
+}
+
+void AudioTranscoder::_sample(int16_t sample) {
+  if (_skip > 0) {
+    _skip--; // Encoder delay + decoder priming
+    return;
+  }
+  if (_written >= _frames)
+    return; // Encoder padding
+  _pcm.push_back(sample);
+  _written++;
+  if (_pcm.size() == _chunkFrames)
+    _flush();
+}
+
+void AudioTranscoder::_flush() {
+  if (_pcm.empty())
+    return;
+  if (_format == Format::ADPCM) {
+    imaAdpcmEncodeBlock(_pcm.data(), _pcm.size(), 1, &_adpcm, _block.data(),
+                        ADPCM_BLOCK);
+    _writeError |= _out.write(_block.data(), ADPCM_BLOCK) != ADPCM_BLOCK;
+  } else {
+    size_t bytes = _pcm.size() * sizeof(int16_t);
+    _writeError |= _out.write((const uint8_t *)_pcm.data(), bytes) != bytes;
+  }
+  _pcm.clear();
+}
+
+void AudioTranscoder::_finish() {
+  _stream.end(); // Helix decodes the frames it still buffers
+  _decoding = false;
+
+  // A short decode (damaged frames) is padded so the file matches its header
+  uint32_t missing = _frames - _written;
+  _skip = 0;
+  while (_written < _frames && !_writeError)
+    _sample(0);
+  _flush();
+  _out.close();
+  _src.close();
+
+  String target = audioRenditionPath(_path);
+  if (_writeError || !LittleFS.rename(_tmpPath, target)) {
+    _abort(State::FAILED, "write failed (FS full?)");
+    return;
+  }
+  if (missing > 0)
+    Log.printf("Audio: %s decoded %u frames short\n", _path.c_str(),
+               (unsigned)missing);
+  Log.printf("Audio: Transcoded %s in %lu ms\n", _path.c_str(),
+             millis() - _startMs);
+
+  _release();
+  _lock();
+  _state = State::DONE;
+  _progress = 100;
+  _result = target;
+  _unlock();
+}
+
+void AudioTranscoder::_abort(State state, const char *reason) {
+  if (_decoding) {
+    _stream.end();
+    _decoding = false;
+  }
+  if (_src)
+    _src.close();
+  if (_out) {
+    _out.close();
+    LittleFS.remove(_tmpPath);
+  }
+  _release();
+  Log.printf("Audio: Transcode of %s stopped: %s\n", _path.c_str(), reason);
+
+  _lock();
+  _state = state;
+  _result = reason;
+  _unlock();
+}
+
+void AudioTranscoder::_release() {
+  _src = File();
+  _out = File();
+  std::vector<int16_t>().swap(_pcm);
+  std::vector<uint8_t>().swap(_block);
+}
+
+void AudioTranscoder::getStatus(JsonObject out) {
+  static const char *const STATES[] = {"idle", "running", "done", "skipped",
+                                       "failed"};
+  static const char *const FORMATS[] = {"none", "pcm", "adpcm"};
+  _lock();
+  out["state"] = STATES[(uint8_t)_state];
+  out["file"] = _path;
+  out["progress"] = _progress;
+  out["format"] = FORMATS[(uint8_t)_format];
+  out["result"] = _result;
+  JsonArray queue = out["queue"].to<JsonArray>();
+  for (const String &queued : _queue)
+    queue.add(queued);
+  _unlock();
+
+  out["mode"] = transcodeMode();
+  out["budget"] = renditionBudget();
+  out["used"] = renditionSpace();
+}
@@ -0,0 +1,125 @@
+#ifndef AUDIO_TRANSCODER_H
+#define AUDIO_TRANSCODER_H
+
+#include "ImaAdpcm.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <deque>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <vector>
+
+#include "AudioTools.h"
+#include "AudioTools/AudioCodecs/CodecMP3Helix.h"
+
+/**
+ * @brief Decodes uploaded MP3s once into a WAV rendition next to them.
+ *
+ * "/horn.mp3" gets "/horn.mp3.wav": mono PCM16 or IMA-ADPCM at the source
+ * rate, with the encoder delay and padding already cut so its frames line up
+ * with the asset's loop points. AudioVoice plays the rendition instead of the
+ * MP3 whenever it exists, which turns a Helix decode into a copy or an ADPCM
+ * table lookup.
+ *
+ * Jobs run one at a time on a low-priority task, one read chunk per tick.
+ * CV 51 picks the format (0 = off, 1 = ADPCM, 2 = PCM when it fits) and
+ * CV 52 caps the space all renditions may take, in 64 KB units.
+ */
+class AudioTranscoder : public Print {
+public:
+  enum class State : uint8_t { IDLE, RUNNING, DONE, SKIPPED, FAILED };
+  enum class Format : uint8_t { NONE, PCM, ADPCM };
+
+  static constexpr size_t READ_CHUNK = 512;
+  static constexpr uint16_t ADPCM_BLOCK = 512; // 1017 mono frames per block
+  static constexpr uint32_t BUDGET_UNIT = 64 * 1024;
+  static constexpr uint32_t FS_RESERVE = 64 * 1024; // Kept free for uploads
+
+  static AudioTranscoder &getInstance() {
+    static AudioTranscoder instance;
+    return instance;
+  }
+
+  void startTask();
+
+  /**
+   * @brief Queues @p mp3Path unless transcoding is off, it is already
+   * queued, or its rendition exists.
+   */
+  void enqueue(const String &mp3Path);
+
+  /**
+   * @brief Drops a queued or running job (file deleted or re-uploaded).
+   */
+  void cancel(const String &mp3Path);
+
+  /**
+   * @brief Runs one chunk of the current job, starting the next queued one
+   * if needed. The task calls this in a loop; tests call it directly.
+   * @return false when there was nothing to do.
+   */
+  bool step();
+
+  /**
+   * @brief Fills @p out with the current job, queue and space figures.
+   */
+  void getStatus(JsonObject out);
+
+  // Decoder output (Print)
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t *data, size_t len) override;
+
+private:
+  AudioTranscoder();
+
+  void _lock() { xSemaphoreTake(_mutex, portMAX_DELAY); }
+  void _unlock() { xSemaphoreGive(_mutex); }
+
+  bool _begin(const String &mp3Path);
+  void _finish();
+  void _abort(State state, const char *reason);
+  void _sample(int16_t sample);
+  void _flush();
+  void _release();
+  static void _taskEntry(void *param);
+
+  SemaphoreHandle_t _mutex;
+  TaskHandle_t _taskHandle = NULL;
+  std::deque<String> _queue;
+  bool _cancel = false;
+
+  // Status, shared with the web task under _mutex
+  State _state = State::IDLE;
+  Format _format = Format::NONE;
+  String _path;
+  String _result;
+  uint8_t _progress = 0;
+
+  // Current job, touched only by step()
+  File _src;
+  File _out;
+  String _tmpPath;
+  MP3DecoderHelix _mp3;
+  EncodedAudioStream _stream{(Print *)this, (AudioDecoder *)&_mp3};
+  bool _decoding = false;
+  unsigned long _startMs = 0;
+  uint32_t _skip = 0;   // Priming samples still to drop
+  uint32_t _frames = 0; // Frames the rendition declares
+  uint32_t _written = 0;
+  bool _writeError = false;
+  uint8_t _carry[4];
+  uint8_t _carryLen = 0;
+  std::vector<int16_t> _pcm; // Pending frames, written _chunkFrames at a time
+  size_t _chunkFrames = 0;
+  std::vector<uint8_t> _block;
+  ImaAdpcmState _adpcm;
+};
+
+/**
+ * @brief Where the rendition of @p mp3Path lives ("/a.mp3" -> "/a.mp3.wav").
+ */
+String audioRenditionPath(const String &mp3Path);
+
+#endif
@@ -1,9 +1,29 @@
 #ifndef AUDIO_UTILS_H
 #define AUDIO_UTILS_H
 
+#include <cstdint>
 #include <cstring>
 #include <strings.h>
 
+enum class AudioCodec : uint8_t { UNKNOWN, WAV_PCM, WAV_IMA_ADPCM, MP3 };
+
+/**
+ * @brief Fields of a RIFF/WAVE header needed to pick and drive a decoder.
+ */
+struct WavInfo {
+  uint16_t formatTag = 0;
+  uint16_t channels = 0;
+  uint32_t sampleRate = 0;
+  uint16_t blockAlign = 0;
+  uint16_t bitsPerSample = 0;
+  uint32_t dataOffset = 0; // Byte offset of the first sample
+  uint32_t dataSize = 0;
+  uint32_t frameCount = 0; // From a fact chunk before data, 0 if absent
+};
+
+static constexpr uint16_t WAV_FORMAT_PCM = 0x0001;
+static constexpr uint16_t WAV_FORMAT_IMA_ADPCM = 0x0011;
+
 /**
  * @brief Checks if the given filename has an .mp3 extension (case-insensitive).
  *
@@ -20,4 +40,116 @@ inline bool isMp3File(const char *filename) {
   return (len >= 4 && strcasecmp(filename + len - 4, ".mp3") == 0);
 }
 
+namespace audio_utils_detail {
+inline uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+inline uint32_t le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+} // namespace audio_utils_detail
+
+/**
+ * @brief Standard CRC-32 (zlib.crc32 on the host), a nibble at a time.
+ * Guards the sound pack and the compiled asset manifest.
+ */
+inline uint32_t audioCrc32(const uint8_t *data, size_t len) {
+  static const uint32_t TABLE[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+      0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+      0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+/**
+ * @brief Walks the RIFF chunk list of a WAV header.
+ *
+ * Works on a partial buffer: the fmt fields are filled as soon as the fmt
+ * chunk is inside @p len, and dataOffset stays 0 until the data chunk header
+ * is reached.
+ *
+ * @return true once both the fmt and data chunks have been located.
+ */
+inline bool parseWavHeader(const uint8_t *buf, size_t len, WavInfo &info) {
+  using namespace audio_utils_detail;
+  if (!buf || len < 12 || memcmp(buf, "RIFF", 4) != 0 ||
+      memcmp(buf + 8, "WAVE", 4) != 0)
+    return false;
+
+  size_t pos = 12;
+  while (pos + 8 <= len) {
+    const uint8_t *chunk = buf + pos;
+    uint32_t size = le32(chunk + 4);
+    if (memcmp(chunk, "fmt ", 4) == 0) {
+      if (pos + 8 + 16 > len)
+        return false;
+      info.formatTag = le16(chunk + 8);
+      info.channels = le16(chunk + 10);
+      info.sampleRate = le32(chunk + 12);
+      info.blockAlign = le16(chunk + 20);
+      info.bitsPerSample = le16(chunk + 22);
+    } else if (memcmp(chunk, "fact", 4) == 0 && size >= 4 &&
+               pos + 12 <= len) {
+      info.frameCount = le32(chunk + 8);
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      info.dataOffset = pos + 8;
+      info.dataSize = size;
+      return info.formatTag != 0;
+    }
+    pos += 8 + size + (size & 1); // Chunks are word aligned
+  }
+  return false;
+}
+
+/**
+ * @brief Reads the first sustain loop from the body of a WAV smpl chunk.
+ *
+ * @param body Chunk payload (after the 8-byte chunk header).
+ * @param start First frame of the loop.
+ * @param end One past the last frame (smpl stores it inclusive).
+ * @return true if the chunk declares at least one loop.
+ */
+inline bool parseSmplLoop(const uint8_t *body, size_t len, uint32_t &start,
+                          uint32_t &end) {
+  using namespace audio_utils_detail;
+  // 36-byte sampler header, then 24-byte loop records
+  if (!body || len < 36 + 24 || le32(body + 28) == 0)
+    return false;
+  uint32_t first = le32(body + 36 + 8);
+  uint32_t last = le32(body + 36 + 12);
+  if (last < first)
+    return false;
+  start = first;
+  end = last + 1;
+  return true;
+}
+
+/**
+ * @brief Picks a codec from the file name and its first bytes.
+ *
+ * A RIFF header wins over the name, so an ADPCM asset can keep its .wav name
+ * and a transcoded rendition can stand in for its MP3. Anything else named
+ * .mp3 is MP3.
+ */
+inline AudioCodec detectAudioCodec(const char *filename, const uint8_t *header,
+                                   size_t len) {
+  WavInfo info;
+  bool riff = header && len >= 12 && memcmp(header, "RIFF", 4) == 0;
+  if (!riff)
+    return isMp3File(filename) ? AudioCodec::MP3 : AudioCodec::UNKNOWN;
+  parseWavHeader(header, len, info);
+  switch (info.formatTag) {
+  case WAV_FORMAT_PCM:
+    return AudioCodec::WAV_PCM;
+  case WAV_FORMAT_IMA_ADPCM:
+    return AudioCodec::WAV_IMA_ADPCM;
+  default:
+    return AudioCodec::UNKNOWN;
+  }
+}
+
 #endif // AUDIO_UTILS_H
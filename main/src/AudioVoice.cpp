@@ -0,0 +1,381 @@
+#include "AudioVoice.h"
+#include "AudioTranscoder.h"
+#include "AudioUtils.h"
+#include "Logger.h"
+#include "Mp3Sidecar.h"
+#include "SoundPack.h"
+#include <algorithm>
+
+namespace {
+constexpr size_t RING_MASK = AudioVoice::RING_FRAMES - 1;
+static_assert((AudioVoice::RING_FRAMES & RING_MASK) == 0,
+              "RING_FRAMES must be a power of two");
+} // namespace
+
+bool AudioVoice::start(const SoundAsset &asset) {
+  stop();
+  _asset = &asset;
+  _assetId = asset.id;
+
+  Segment first;
+  switch (asset.type) {
+  case SoundType::COMPLEX_LOOP:
+    first = asset.fileIntro.length() > 0 ? Segment::INTRO : Segment::LOOP;
+    break;
+  case SoundType::TOGGLE:
+    first = Segment::LOOP;
+    break;
+  default:
+    _oneShot =
+        asset.fileIntro.length() > 0 ? asset.fileIntro : asset.fileLoop;
+    first = Segment::ONESHOT;
+    break;
+  }
+  return _beginSegment(first);
+}
+
+bool AudioVoice::startFile(const char *path) {
+  stop();
+  _asset = nullptr;
+  _assetId = 0;
+  _oneShot = path;
+  return _beginSegment(Segment::ONESHOT);
+}
+
+void AudioVoice::release() {
+  _released = true;
+  // Read ahead into the tail instead of another pass over the loop
+  if (_segment == Segment::LOOP)
+    _file.setLoop(_asset && _asset->loopEnd > 0
+                      ? (int32_t)_passOffset(_asset->loopEnd, nullptr)
+                      : -1);
+}
+
+void AudioVoice::stop() {
+  if (_active) {
+    _stream.end();
+    _active = nullptr;
+  }
+  if (_file)
+    _file.close();
+  if (_next)
+    _next.close();
+  _nextPath = nullptr;
+  _filePath = nullptr;
+  _segment = Segment::IDLE;
+  _released = false;
+  _head = _tail = 0;
+  _phase = 0;
+  _rate = 0;
+  _carryLen = 0;
+}
+
+const String *AudioVoice::_pathFor(Segment seg) const {
+  const String *path = nullptr;
+  switch (seg) {
+  case Segment::INTRO:
+    path = _asset ? &_asset->fileIntro : nullptr;
+    break;
+  case Segment::LOOP:
+  case Segment::TAIL:
+    path = _asset ? &_asset->fileLoop : nullptr;
+    break;
+  case Segment::OUTRO:
+    path = _asset ? &_asset->fileOutro : nullptr;
+    break;
+  case Segment::ONESHOT:
+    path = &_oneShot;
+    break;
+  case Segment::IDLE:
+    break;
+  }
+  return (path && path->length() > 0) ? path : nullptr;
+}
+
+AudioVoice::Segment AudioVoice::_nextSegment() const {
+  Segment next = Segment::IDLE;
+  switch (_segment) {
+  case Segment::INTRO:
+    next = _released ? Segment::OUTRO : Segment::LOOP;
+    break;
+  case Segment::LOOP:
+    if (!_released)
+      next = Segment::LOOP;
+    else if (_asset->loopEnd > 0)
+      next = Segment::TAIL;
+    else
+      next = Segment::OUTRO;
+    break;
+  case Segment::TAIL:
+    next = Segment::OUTRO;
+    break;
+  default:
+    break;
+  }
+  // A missing loop file falls through to the outro
+  if (next == Segment::LOOP && !_pathFor(next))
+    next = Segment::OUTRO;
+  if (next != Segment::IDLE && !_pathFor(next))
+    next = Segment::IDLE;
+  return next;
+}
+
+bool AudioVoice::_beginSegment(Segment seg) {
+  const String *path = _pathFor(seg);
+  if (!path) {
+    stop();
+    return false;
+  }
+
+  bool repeat = (seg == Segment::LOOP && _segment == Segment::LOOP);
+  bool sameFile = path == _filePath && _file; // Loop repeat or tail
+  if (sameFile) {
+    // Still open; _openPass seeks to the start of the pass
+  } else if (path == _nextPath && _next) {
+    _file.close();
+    _file = _next;
+    _next = AssetSource();
+    _nextPath = nullptr;
+    std::swap(_index, _nextIndex);
+  } else {
+    _file.close();
+    _file = _openSource(*path, _index);
+  }
+  if (!_file) {
+    Log.printf("Audio: File not found: %s\n", path->c_str());
+    stop();
+    return false;
+  }
+  if (!sameFile) {
+    uint8_t header[64];
+    size_t len = _file.peek(header, sizeof(header));
+    _codec = detectAudioCodec(path->c_str(), header, len);
+  }
+  _filePath = path;
+  _segment = seg;
+
+  // Frame window of this pass within the file's audio
+  uint32_t from = 0;
+  uint32_t to = UINT32_MAX;
+  if (_asset && _asset->loopEnd > 0) {
+    if (seg == Segment::LOOP) {
+      from = repeat ? _asset->loopStart : 0;
+      to = _asset->loopEnd;
+    } else if (seg == Segment::TAIL) {
+      from = _asset->loopEnd;
+    }
+  }
+
+  // Open the following file now so the boundary never waits on the FS
+  const String *upcoming = nullptr;
+  if (seg == Segment::INTRO)
+    upcoming = _pathFor(Segment::LOOP) ? _pathFor(Segment::LOOP)
+                                       : _pathFor(Segment::OUTRO);
+  else if (seg == Segment::LOOP || seg == Segment::TAIL)
+    upcoming = _pathFor(Segment::OUTRO);
+  if (upcoming && upcoming != _filePath && upcoming != _nextPath) {
+    if (_next)
+      _next.close();
+    _next = _openSource(*upcoming, _nextIndex);
+    _nextPath = _next ? upcoming : nullptr;
+  }
+
+  _openPass(from, to);
+  // Let the read-ahead run on into the next pass of the loop
+  if (seg == Segment::LOOP && !_released)
+    _file.setLoop(_passOffset(_asset->loopEnd > 0 ? _asset->loopStart : 0,
+                              nullptr));
+  return true;
+}
+
+AssetSource AudioVoice::_openSource(const String &path, Mp3Index &index) {
+  index.clear();
+  // Pack files are decoded straight out of the mapped flash
+  if (SoundPack::isPackPath(path)) {
+    const SoundPack::Entry *entry = SoundPack::getInstance().find(path);
+    if (!entry)
+      return AssetSource();
+    index = entry->index;
+    return AssetSource(entry->data, entry->size);
+  }
+
+  // A decode-once rendition is far cheaper to play than the MP3 itself. It
+  // is already trimmed, so it needs no index.
+  if (isMp3File(path.c_str())) {
+    File file = LittleFS.open(audioRenditionPath(path), "r");
+    if (file)
+      return AssetSource(file);
+  }
+
+  File file = LittleFS.open(path, "r");
+  if (file && isMp3File(path.c_str()))
+    loadMp3Sidecar(path, index);
+  return AssetSource(file);
+}
+
+uint32_t AudioVoice::_passOffset(uint32_t from,
+                                 uint32_t *outputSample) const {
+  Mp3SeekPlan plan;
+  if (_codec == AudioCodec::MP3 && _index.valid()) {
+    uint32_t start = _index.primingSamples() +
+                     std::min(from, _index.validSamples());
+    plan.byteOffset = _index.frameOffset(0);
+    if (start >= _index.samplesPerFrame())
+      _index.planSeek(start, plan);
+  }
+  if (outputSample)
+    *outputSample = plan.outputSample;
+  return plan.byteOffset;
+}
+
+void AudioVoice::_openPass(uint32_t from, uint32_t to) {
+  AudioDecoder *decoder;
+  switch (_codec) {
+  case AudioCodec::MP3:
+    decoder = &_mp3;
+    break;
+  case AudioCodec::WAV_IMA_ADPCM:
+    decoder = &_adpcm;
+    break;
+  default:
+    decoder = &_wav;
+    break;
+  }
+
+  // Every pass starts a fresh decoder so the output can be counted exactly
+  _stream.setDecoder(decoder);
+  _stream.begin();
+  _active = decoder;
+
+  _passFrame = 0;
+  _passDone = false;
+  _carryLen = 0;
+  _windowStart = from;
+  _windowEnd = to;
+
+  // Indexed MP3: skip ID3/Xing frames, trim encoder priming and padding, and
+  // jump straight to the frame that holds the window start.
+  if (decoder == &_mp3 && _index.valid()) {
+    uint32_t prime = _index.primingSamples();
+    uint32_t valid = _index.validSamples();
+    uint32_t decoded = _index.frameCount() * _index.samplesPerFrame();
+    _windowStart = prime + std::min(from, valid);
+    _windowEnd = std::min(prime + std::min(to, valid), decoded);
+  }
+  _file.seek(_passOffset(from, &_passFrame));
+}
+
+void AudioVoice::_advance() {
+  // end() makes Helix decode the frames it still buffers into this pass
+  if (_active) {
+    _stream.end();
+    _active = nullptr;
+  }
+
+  Segment next = _nextSegment();
+  if (next == Segment::IDLE) {
+    // Let the ring drain; the voice goes inactive once it is empty
+    size_t head = _head, tail = _tail;
+    uint32_t rate = _rate, phase = _phase;
+    stop();
+    _head = head;
+    _tail = tail;
+    _rate = rate;
+    _phase = phase;
+    return;
+  }
+  _beginSegment(next);
+}
+
+void AudioVoice::service(uint8_t maxChunks) {
+  if (_segment == Segment::IDLE)
+    return;
+  if (!_ring)
+    _ring = new int16_t[RING_FRAMES];
+
+  uint8_t buf[DECODE_CHUNK];
+  while (_segment != Segment::IDLE && maxChunks-- > 0) {
+    if (RING_FRAMES - buffered() < DECODE_HEADROOM)
+      break;
+    const uint8_t *chunk = buf; // Into the flash mapping for pack files
+    size_t n = _passDone ? 0 : _file.next(buf, sizeof(buf), chunk);
+    if (n == 0 && !_passDone && _file.pending())
+      break; // Read-ahead behind; the PCM ring plays on meanwhile
+    if (n == 0) {
+      _advance();
+      continue;
+    }
+    _stream.write(chunk, n);
+  }
+}
+
+size_t AudioVoice::write(const uint8_t *data, size_t len) {
+  if (_passDone || !_active || !_ring)
+    return len;
+
+  AudioInfo info = _active->audioInfo();
+  uint8_t channels = info.channels == 2 ? 2 : 1;
+  if (_rate == 0)
+    _rate = info.sample_rate;
+  else if (info.sample_rate != 0 && (uint32_t)info.sample_rate != _rate)
+    Log.printf("Audio: Segment rate %d differs from %u\n", info.sample_rate,
+               (unsigned)_rate);
+
+  const size_t frameBytes = 2 * channels;
+  size_t i = 0;
+  while (_carryLen > 0 && i < len) {
+    _carry[_carryLen++] = data[i++];
+    if (_carryLen == frameBytes) {
+      _frame(_carry, channels);
+      _carryLen = 0;
+    }
+  }
+  for (; i + frameBytes <= len; i += frameBytes)
+    _frame(data + i, channels);
+  while (i < len)
+    _carry[_carryLen++] = data[i++];
+  return len;
+}
+
+void AudioVoice::_frame(const uint8_t *pcm, uint8_t channels) {
+  if (_passDone)
+    return;
+  int32_t sample = (int16_t)(pcm[0] | (pcm[1] << 8));
+  if (channels == 2)
+    sample = (sample + (int16_t)(pcm[2] | (pcm[3] << 8))) >> 1;
+
+  if (_passFrame >= _windowStart && buffered() < RING_FRAMES)
+    _ring[_head++ & RING_MASK] = (int16_t)sample;
+  if (++_passFrame >= _windowEnd)
+    _passDone = true;
+}
+
+size_t AudioVoice::mix(int32_t *acc, size_t frames, uint32_t outRate) {
+  if (!_ring || _rate == 0 || outRate == 0)
+    return 0;
+
+  const uint32_t step = ((uint64_t)_rate << 16) / outRate;
+  size_t n = 0;
+  while (n < frames) {
+    size_t avail = buffered();
+    if (avail < 2) {
+      if (_segment != Segment::IDLE) {
+        _underruns++; // Decoder fell behind; the gap is audible
+        break;
+      }
+      if (avail == 1)
+        acc[n++] += _ring[_tail++ & RING_MASK];
+      break;
+    }
+    // Linear interpolation between the two ring samples around the phase
+    int32_t s0 = _ring[_tail & RING_MASK];
+    int32_t s1 = _ring[(_tail + 1) & RING_MASK];
+    acc[n++] += s0 + (((s1 - s0) * (int32_t)(_phase >> 2)) >> 14);
+    _phase += step;
+    _tail += _phase >> 16;
+    _phase &= 0xFFFF;
+    if (_tail > _head)
+      _tail = _head;
+  }
+  return n;
+}
@@ -0,0 +1,122 @@
+#ifndef AUDIO_VOICE_H
+#define AUDIO_VOICE_H
+
+#include "AssetSource.h"
+#include "AudioUtils.h"
+#include "ImaAdpcmDecoder.h"
+#include "Mp3Index.h"
+#include "SoundAsset.h"
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include "AudioTools.h"
+#include "AudioTools/AudioCodecs/CodecMP3Helix.h"
+
+/**
+ * @brief One playing sound: decodes intro -> loop -> outro into a PCM ring.
+ *
+ * The voice is its own decoder sink. Decoded frames are downmixed to mono
+ * and queued in a ring that the mixer drains, so the decoder always runs
+ * ahead of playback. When a segment's file ends, the next one (opened when
+ * the previous segment started) is decoded straight into the same ring, so
+ * segment boundaries are sample exact with no gap or seek on the audio path.
+ *
+ * The loop segment repeats until release(). Release takes effect at the end
+ * of the current loop pass, then the tail after the loop points (if any) and
+ * the outro play out.
+ */
+class AudioVoice : public Print {
+public:
+  static constexpr size_t RING_FRAMES = 8192; // Power of two
+  static constexpr size_t DECODE_CHUNK = 128; // Compressed bytes per write
+  // Worst-case frames one decoder write can emit (two MP3 frames)
+  static constexpr size_t DECODE_HEADROOM = 2 * 1152;
+
+  enum class Segment : uint8_t { IDLE, INTRO, LOOP, TAIL, OUTRO, ONESHOT };
+
+  /**
+   * @brief Starts an asset. COMPLEX_LOOP plays intro/loop/outro, TOGGLE
+   * skips the intro, SIMPLE plays its first file once.
+   */
+  bool start(const SoundAsset &asset);
+
+  /**
+   * @brief Plays a single file once (used by /api/audio/play).
+   */
+  bool startFile(const char *path);
+
+  void release(); // Leave the loop at its next boundary
+  void stop();    // Immediate silence
+
+  /**
+   * @brief Decodes ahead until the ring is nearly full.
+   * @param maxChunks Upper bound on decoder writes this call.
+   */
+  void service(uint8_t maxChunks = 16);
+
+  /**
+   * @brief Adds up to @p frames samples into @p acc at @p outRate.
+   * @return Frames produced; fewer than requested only once finished.
+   */
+  size_t mix(int32_t *acc, size_t frames, uint32_t outRate);
+
+  bool active() const { return _segment != Segment::IDLE || buffered() > 0; }
+  bool released() const { return _released; }
+  uint8_t assetId() const { return _assetId; }
+  Segment segment() const { return _segment; }
+  size_t buffered() const { return _head - _tail; }
+  uint32_t underruns() const { return _underruns; }
+
+  // Decoder output (Print)
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t *data, size_t len) override;
+
+private:
+  bool _beginSegment(Segment seg);
+  void _advance();
+  void _openPass(uint32_t from, uint32_t to);
+  uint32_t _passOffset(uint32_t from, uint32_t *outputSample) const;
+  AssetSource _openSource(const String &path, Mp3Index &index);
+  const String *_pathFor(Segment seg) const;
+  Segment _nextSegment() const;
+  void _frame(const uint8_t *pcm, uint8_t channels);
+
+  // Sequence
+  const SoundAsset *_asset = nullptr;
+  String _oneShot;
+  uint8_t _assetId = 0;
+  Segment _segment = Segment::IDLE;
+  bool _released = false;
+  bool _passDone = false;
+  AssetSource _file;
+  AssetSource _next; // Pre-opened file for the following segment
+  const String *_filePath = nullptr;
+  const String *_nextPath = nullptr;
+  Mp3Index _index; // Sidecar of _file when it is an indexed MP3
+  Mp3Index _nextIndex;
+
+  // Frame window of the current pass in decoded-output frames
+  uint32_t _passFrame = 0;
+  uint32_t _windowStart = 0;
+  uint32_t _windowEnd = UINT32_MAX;
+
+  // Decoders
+  MP3DecoderHelix _mp3;
+  WAVDecoder _wav;
+  ImaAdpcmDecoder _adpcm;
+  AudioDecoder *_active = nullptr;
+  AudioCodec _codec = AudioCodec::UNKNOWN; // Of _file
+  EncodedAudioStream _stream{(Print *)this, (AudioDecoder *)&_wav};
+  uint8_t _carry[4];
+  uint8_t _carryLen = 0;
+
+  // PCM ring (mono, source rate) drained with a 16.16 resampler
+  int16_t *_ring = nullptr;
+  size_t _head = 0;
+  size_t _tail = 0;
+  uint32_t _phase = 0;
+  uint32_t _rate = 0;
+  uint32_t _underruns = 0;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "BootTimeline.h"
+#include "Logger.h"
+#include <algorithm>
+#include <esp_timer.h>
+
+void BootTimeline::mark(BootPhase phase) {
+  if (_us[phase].load(std::memory_order_relaxed))
+    return;
+  // Never 0, which means "not yet"
+  uint32_t now = std::max<uint32_t>(1, (uint32_t)esp_timer_get_time());
+  uint32_t expected = 0;
+  _us[phase].compare_exchange_strong(expected, now);
+}
+
+const char *BootTimeline::phaseName(BootPhase phase) {
+  switch (phase) {
+  case BOOT_SETUP:
+    return "setup";
+  case BOOT_CVS:
+    return "cvs";
+  case BOOT_MOTOR:
+    return "motor";
+  case BOOT_LIGHTS:
+    return "lights";
+  case BOOT_DCC:
+    return "dcc";
+  case BOOT_FILESYSTEM:
+    return "filesystem";
+  case BOOT_AUDIO:
+    return "audio";
+  case BOOT_NETWORK:
+    return "network";
+  case BOOT_READY:
+    return "ready";
+  case BOOT_WIFI:
+    return "wifi";
+  case BOOT_FIRST_PACKET:
+    return "first_packet";
+  case BOOT_FIRST_RESPONSE:
+    return "first_response";
+  default:
+    return "?";
+  }
+}
+
+void BootTimeline::log() {
+  String line = "Boot (ms):";
+  for (uint8_t p = 0; p < BOOT_PHASES; p++) {
+    uint32_t at = _us[p].load();
+    if (at)
+      line += String(" ") + phaseName((BootPhase)p) + " " + String(at / 1000);
+  }
+  Log.println(line.c_str());
+  uint32_t dcc = _us[BOOT_DCC].load() / 1000;
+  if (dcc > TARGET_MS)
+    Log.printf("Boot: DCC up at %lu ms, past the %lu ms target\n",
+               (unsigned long)dcc, (unsigned long)TARGET_MS);
+}
+
+void BootTimeline::getStatus(JsonObject out) {
+  // Flat: a "<phase>_ms" key per phase reached
+  for (uint8_t p = 0; p < BOOT_PHASES; p++) {
+    uint32_t at = _us[p].load();
+    if (at)
+      out[String(phaseName((BootPhase)p)) + "_ms"] = at / 1000.0f;
+  }
+  out["target_ms"] = TARGET_MS;
+  uint32_t dcc = _us[BOOT_DCC].load();
+  out["target_met"] = dcc && dcc <= TARGET_MS * 1000;
+}
@@ -0,0 +1,61 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+
+// Boot milestones, in the order the staged boot reaches them
+enum BootPhase : uint8_t {
+  BOOT_SETUP,          // setup() entered
+  BOOT_CVS,            // CVs read from flash
+  BOOT_MOTOR,          // MotorTask running
+  BOOT_LIGHTS,         // Outputs set from the CVs
+  BOOT_DCC,            // Decoding on the control plane: the loco answers
+  BOOT_FILESYSTEM,     // LittleFS mounted (or formatted)
+  BOOT_AUDIO,          // Sounds loaded, mixer running
+  BOOT_NETWORK,        // Routes registered, server listening
+  BOOT_READY,          // All of the above
+  BOOT_WIFI,           // Joined the stored network
+  BOOT_FIRST_PACKET,   // First DCC speed packet
+  BOOT_FIRST_RESPONSE, // First motor duty that followed one
+  BOOT_PHASES,
+};
+
+/**
+ * @brief When each boot phase was first reached, in esp_timer µs (from the
+ * application's start, the second-stage bootloader not included).
+ *
+ * The control plane is up before the filesystem, audio and network, so that
+ * after a power blip on dirty track the loco answers DCC at once; the target
+ * is BOOT_DCC within TARGET_MS. mark() may be called from any task, and as
+ * often as convenient: only the first call for a phase counts.
+ */
+class BootTimeline {
+public:
+  static constexpr uint32_t TARGET_MS = 250; // To BOOT_DCC
+
+  static BootTimeline &getInstance() {
+    static BootTimeline instance;
+    return instance;
+  }
+
+  void mark(BootPhase phase);
+  bool reached(BootPhase phase) const { return _us[phase].load(); }
+  uint32_t us(BootPhase phase) const { return _us[phase].load(); }
+  void log(); // The phases so far, one line
+
+  void getStatus(JsonObject out);
+
+  static const char *phaseName(BootPhase phase);
+
+  BootTimeline(const BootTimeline &) = delete;
+  BootTimeline &operator=(const BootTimeline &) = delete;
+
+private:
+  BootTimeline() = default;
+
+  std::atomic<uint32_t> _us[BOOT_PHASES] = {}; // 0: not yet
+};
+
+#endif
@@ -1,15 +1,28 @@
 #include "ConnectivityManager.h"
 #include "AudioController.h"
+#include "AudioPrefetcher.h"
+#include "AudioTranscoder.h"
+#include "AudioUtils.h"
 #include "BootLoopDetector.h"
+#include "BootTimeline.h"
 #include "CvRegistry.h"
 #include "DccController.h"
-#include "LameJs.h"
+#include "LatencyMonitor.h"
+#include "MotorCapture.h"
 #include "MotorController.h"
-#include "WebAssets.h"
+#include "Mp3Sidecar.h"
+#include "PerfMonitor.h"
+#include "SoundManifest.h"
+#include "SoundPack.h"
+#include "Telemetry.h"
+#include "TelemetryStream.h"
+#include "TraceRecorder.h"
+#include "WebAssetsGz.h"
 #include <ArduinoJson.h>
 #include <LittleFS.h>
 #include <Preferences.h>
 #include <esp_app_format.h>
+#include <esp_heap_caps.h>
 #include <esp_ota_ops.h>
 #include <esp_partition.h>
 
@@ -17,6 +30,15 @@
 #define BUILD_VERSION "dev"
 #endif
 
+// Part of the embedded assets' ETags, so they change with the firmware; a
+// build without a hash still gets a tag of its own (spaces are dropped, as
+// a tag may not hold them)
+#ifdef GIT_HASH
+#define ASSET_BUILD_TAG GIT_HASH
+#else
+#define ASSET_BUILD_TAG __DATE__ " " __TIME__
+#endif
+
 #ifndef GIT_HASH
 #define GIT_HASH "unknown"
 #endif
@@ -25,10 +47,19 @@
   if (!isAuthenticated())                                                      \
   return
 
+namespace {
+// Stack budgets of the handlers that run on a web worker
+constexpr uint32_t UPLOAD_STACK = 8192; // Manifest compile, MP3 index
+constexpr uint32_t FIRMWARE_STACK = 6144;
+constexpr uint32_t STREAM_STACK = 4096; // Static files, slow calls
+} // namespace
+
 ConnectivityManager::ConnectivityManager() : _server(80) {}
 
-void ConnectivityManager::setup() {
-  Log.println("ConnectivityManager: Initializing...");
+void ConnectivityManager::mountFilesystem() {
+  if (_fsMounted)
+    return;
+  _fsMounted = true;
 
   // 1. Initialize File System
   // We attempt to mount WITHOUT formatting first.
@@ -53,6 +84,13 @@ void ConnectivityManager::setup() {
                (unsigned long)LittleFS.usedBytes());
   }
 
+  BootTimeline::getInstance().mark(BOOT_FILESYSTEM);
+}
+
+void ConnectivityManager::startWifi() {
+  if (_wifiState != WIFI_INIT)
+    return;
+
   // 2. WiFi Setup
   Preferences prefs;
   prefs.begin("config", true); // Read-only mode
@@ -72,18 +110,28 @@ void ConnectivityManager::setup() {
   _wifiState = WIFI_CONNECTING;
 
   Log.println("ConnectivityManager: Attempting connection...");
+}
+
+void ConnectivityManager::setup() {
+  Log.println("ConnectivityManager: Initializing...");
+  startWifi();
+  mountFilesystem();
 
   // 3. Web Server Handlers
 
-  // Embedded UI
+  // Embedded UI, gzipped at build time. Each asset's ETag is the build's
+  // hash and its content digest, so a browser revalidates with a 304 until
+  // the firmware changes.
   /**
    * @api {GET} / Root Index
    * @apiGroup System
-   * @apiDescription Serves the main web interface.
+   * @apiDescription Serves the main web interface, gzipped, with an ETag.
+   * Answers 304 when If-None-Match holds the current ETag.
    */
   _server.on("/", HTTP_GET, [this]() {
     AUTH_CHECK();
-    _server.send(200, "text/html", INDEX_HTML);
+    sendAsset("text/html", INDEX_HTML_GZ, INDEX_HTML_GZ_LEN,
+              INDEX_HTML_DIGEST);
   });
   /**
    * @api {GET} /index.html Index HTML
@@ -92,19 +140,22 @@ void ConnectivityManager::setup() {
    */
   _server.on("/index.html", HTTP_GET, [this]() {
     AUTH_CHECK();
-    _server.send(200, "text/html", INDEX_HTML);
+    sendAsset("text/html", INDEX_HTML_GZ, INDEX_HTML_GZ_LEN,
+              INDEX_HTML_DIGEST);
   });
   _server.on("/style.css", HTTP_GET, [this]() {
     AUTH_CHECK();
-    _server.send(200, "text/css", STYLE_CSS);
+    sendAsset("text/css", STYLE_CSS_GZ, STYLE_CSS_GZ_LEN, STYLE_CSS_DIGEST);
   });
   _server.on("/app.js", HTTP_GET, [this]() {
     AUTH_CHECK();
-    _server.send(200, "application/javascript", APP_JS);
+    sendAsset("application/javascript", APP_JS_GZ, APP_JS_GZ_LEN,
+              APP_JS_DIGEST);
   });
   _server.on("/lame.min.js", HTTP_GET, [this]() {
     AUTH_CHECK();
-    _server.send_P(200, "application/javascript", LAME_MIN_JS);
+    sendAsset("application/javascript", LAME_MIN_JS_GZ, LAME_MIN_JS_GZ_LEN,
+              LAME_MIN_JS_DIGEST);
   });
 
   // API: System Status
@@ -122,6 +173,10 @@ void ConnectivityManager::setup() {
    * @apiSuccess {String} hostname Device hostname.
    * @apiSuccess {Number} fs_total Total filesystem size.
    * @apiSuccess {Number} fs_used Used filesystem size.
+   * @apiSuccess {Number} heap_free Free heap in bytes.
+   * @apiSuccess {Number} heap_largest_block Largest free block in bytes.
+   * @apiSuccess {Number} heap_fragmentation Percent of the free heap not in
+   * the largest block (0 = one contiguous region).
    * @apiSuccess {Array} functions Array of 29 booleans (F0-F28).
    */
   _server.on("/api/status", HTTP_GET, [this]() {
@@ -214,7 +269,9 @@ void ConnectivityManager::setup() {
       else if (type == "debug")
         filter = "DCC:"; // Example: filter for DCC debug
     }
-    _server.send(200, "application/json", Log.getLogsJSON(filter));
+    JsonDocument doc(_server.allocator());
+    Log.getLogsJSON(doc.to<JsonArray>(), filter);
+    sendJson(doc);
   });
   /**
    * @api {DELETE} /api/logs Clear Logs
@@ -273,10 +330,13 @@ void ConnectivityManager::setup() {
    * @apiDescription Formats the LittleFS partition. DANGER: Deletes all files.
    * @apiSuccess {String} text "Formatting started..."
    */
-  _server.on("/api/files/format", HTTP_POST, [this]() {
-    AUTH_CHECK();
-    handleFileFormat();
-  });
+  _server.on(
+      "/api/files/format", HTTP_POST,
+      [this]() {
+        AUTH_CHECK();
+        handleFileFormat();
+      },
+      nullptr, STREAM_STACK);
 
   // API: File Upload
   /**
@@ -307,7 +367,47 @@ void ConnectivityManager::setup() {
         // AUTH_CHECK removed here to prevent repeated auth calls during
         // streaming
         handleFileUpload();
-      });
+      },
+      UPLOAD_STACK);
+
+  // API: Sound Pack
+  /**
+   * @api {GET} /api/sounds/pack Sound Pack Status
+   * @apiGroup Files
+   * @apiDescription Describes the pack in the raw "sounds" partition.
+   * @apiSuccess {Boolean} installed A valid pack is mapped.
+   * @apiSuccess {Number} size Pack size in bytes.
+   * @apiSuccess {Number} capacity Partition size in bytes.
+   * @apiSuccess {Array} files Packed file names, codecs and sizes.
+   * @apiSuccess {Number} assets Asset count.
+   */
+  _server.on("/api/sounds/pack", HTTP_GET, [this]() {
+    AUTH_CHECK();
+    handleSoundPackStatus();
+  });
+  /**
+   * @api {POST} /api/sounds/pack Install Sound Pack
+   * @apiGroup Files
+   * @apiDescription Streams a pack built by tools/mksoundpack.py
+   * (multipart/form-data) straight into the "sounds" partition, then
+   * reloads the assets from it. The old pack is gone once the upload starts.
+   * @apiParam {File} file The pack.
+   * @apiSuccess {String} text "Pack OK"
+   * @apiError {String} text Why the pack was rejected.
+   */
+  _server.on(
+      "/api/sounds/pack", HTTP_POST,
+      [this]() {
+        if (_uploadError == "Unauthorized")
+          return;
+        AUTH_CHECK();
+        if (_uploadError.length() > 0) {
+          _server.send(500, "text/plain", _uploadError);
+        } else {
+          _server.send(200, "text/plain", "Pack OK");
+        }
+      },
+      [this]() { handleSoundPackUpload(); }, UPLOAD_STACK);
 
   // API: WiFi Management
   /**
@@ -338,10 +438,13 @@ void ConnectivityManager::setup() {
    * @apiDescription Scans for available networks.
    * @apiSuccess {Array} networks Array of {ssid, rssi, enc}.
    */
-  _server.on("/api/wifi/scan", HTTP_GET, [this]() {
-    AUTH_CHECK();
-    handleWifiScan();
-  });
+  _server.on(
+      "/api/wifi/scan", HTTP_GET,
+      [this]() {
+        AUTH_CHECK();
+        handleWifiScan();
+      },
+      nullptr, STREAM_STACK); // Scanning takes seconds
 
   // API: Control
   /**
@@ -422,31 +525,349 @@ void ConnectivityManager::setup() {
     AUTH_CHECK();
     handleAudioPlay();
   });
+  /**
+   * @api {GET} /api/audio/transcode Transcode Status
+   * @apiGroup Control
+   * @apiDescription Progress of the background MP3 -> WAV rendition job.
+   * @apiSuccess {String} state "idle", "running", "done", "skipped" or
+   * "failed".
+   * @apiSuccess {String} file MP3 of the current or last job.
+   * @apiSuccess {Number} progress Percent of the MP3 decoded.
+   * @apiSuccess {String} format "pcm" or "adpcm".
+   * @apiSuccess {String} result Rendition path, or why the job stopped.
+   * @apiSuccess {Array} queue MP3s waiting.
+   * @apiSuccess {Number} mode CV 51 (0=Off, 1=ADPCM, 2=PCM).
+   * @apiSuccess {Number} budget Rendition space budget in bytes (CV 52).
+   * @apiSuccess {Number} used Bytes taken by renditions.
+   */
+  _server.on("/api/audio/transcode", HTTP_GET, [this]() {
+    AUTH_CHECK();
+    handleAudioTranscode();
+  });
+  /**
+   * @api {GET} /api/audio/prefetch Read-ahead Status
+   * @apiGroup Control
+   * @apiDescription Read-ahead buffers of the files being played.
+   * @apiSuccess {Number} ring Buffer per file in bytes (CV 56, 0 = off).
+   * @apiSuccess {Number} stalls Times a decoder found its buffer empty.
+   * @apiSuccess {Number} reads LittleFS reads issued by the prefetch task.
+   * @apiSuccess {Number} bytes Bytes read.
+   * @apiSuccess {Number} read_max_us Slowest single read.
+   * @apiSuccess {Array} streams Open files: file, size, level and low_water
+   * (bytes buffered now and at the lowest), stalls.
+   */
+  _server.on("/api/audio/prefetch", HTTP_GET, [this]() {
+    AUTH_CHECK();
+    handleAudioPrefetch();
+  });
 
-  // API: Motor Test
   /**
-   * @api {POST} /api/motor/test Start Motor Test
-   * @apiGroup Motor
-   * @apiDescription Starts the motor test profile.
-   * @apiSuccess {JSON} status {"status": "started"}
+   * @api {GET} /api/http Web Server Status
+   * @apiGroup Status
+   * @apiDescription Connections, workers and per-route timings of the web
+   * server.
+   * @apiSuccess {Number} sockets Open connections (of max_sockets).
+   * @apiSuccess {Number} workers Tasks for uploads and file streams.
+   * @apiSuccess {Number} worker_stack Stack per worker in bytes.
+   * @apiSuccess {Number} busy_workers Workers handling a request now.
+   * @apiSuccess {Number} queued Requests waiting for a worker.
+   * @apiSuccess {Number} requests Requests handled since boot.
+   * @apiSuccess {Number} rejected Requests answered 503 (workers busy, or an
+   * upload already running).
+   * @apiSuccess {Array} arenas JSON arenas, the server task's then each
+   * worker's: capacity and peak in bytes, and overflows (allocations that
+   * did not fit and went to the heap).
+   * @apiSuccess {Array} routes Routes used so far: uri, method, hits, avg_us
+   * and max_us (from arrival to reply), worker, stack_budget and stack_peak
+   * in bytes (0 until the route is measured), and heap_peak, the most heap
+   * taken while it ran (an upper bound when requests overlap).
+   */
+  _server.on("/api/http", HTTP_GET, [this]() {
+    AUTH_CHECK();
+    handleHttpStatus();
+  });
+
+  /**
+   * @api {GET} /api/perf CPU and Loop Timing
+   * @apiGroup Status
+   * @apiDescription Where the CPU goes, sampled every second. With
+   * ?format=bin, the same report as a binary blob: a 16-byte header, 28-byte
+   * task records, then 332-byte loop records, all little-endian. See
+   * tools/perf_report.py.
+   * @apiSuccess {Number} window_ms The last sampling window.
+   * @apiSuccess {Array} cores Load of each core over the window, in percent.
+   * @apiSuccess {Array} tasks Every task: name, core (absent if unpinned),
+   * priority, load_pct over the window, peak_pct since reset, and
+   * stack_free_min, the fewest bytes of stack it has had left.
+   * @apiSuccess {Array} loops Instrumented loops: name, window_count
+   * iterations, load_pct, and period and busy histograms (count, mean_us over
+   * the window, max_us, buckets) since reset.
+   * @apiSuccess {Array} bucket_edges_us Where each bucket starts; the last
+   * one is open-ended.
+   */
+  _server.on(
+      "/api/perf", HTTP_GET,
+      [this]() {
+        AUTH_CHECK();
+        PerfMonitor &perf = PerfMonitor::getInstance();
+        if (_server.arg("format") == "bin") {
+          _server.sendStream(200, "application/octet-stream",
+                             [&](Print &out) { perf.write(out); });
+          return;
+        }
+        JsonDocument doc(_server.allocator());
+        perf.getStatus(doc.to<JsonObject>());
+        sendJson(doc);
+      },
+      nullptr, STREAM_STACK);
+
+  /**
+   * @api {DELETE} /api/perf Reset CPU and Loop Timing
+   * @apiGroup Status
+   * @apiDescription Clears the histograms and peaks, to measure from now.
+   */
+  _server.on("/api/perf", HTTP_DELETE, [this]() {
+    AUTH_CHECK();
+    PerfMonitor::getInstance().reset();
+    _server.send(200, "application/json", "{\"status\":\"reset\"}");
+  });
+
+  /**
+   * @api {GET} /api/boot Boot Timeline
+   * @apiGroup Status
+   * @apiDescription When each boot phase was reached, in ms from the
+   * application's start. The control plane comes up first (setup, cvs,
+   * motor, lights, dcc), then filesystem, audio and network at a lower
+   * priority, then ready. wifi, first_packet (DCC speed) and first_response
+   * (the motor duty that followed) come when they come. A phase not yet
+   * reached is absent.
+   * @apiSuccess {Number} dcc_ms When the loco started answering DCC.
+   * @apiSuccess {Number} target_ms The goal for dcc_ms.
+   * @apiSuccess {Boolean} target_met Whether dcc_ms met it.
+   */
+  _server.on("/api/boot", HTTP_GET, [this]() {
+    AUTH_CHECK();
+    JsonDocument doc(_server.allocator());
+    BootTimeline::getInstance().getStatus(doc.to<JsonObject>());
+    sendJson(doc);
+  });
+
+  /**
+   * @api {GET} /api/latency End-to-End Latency
+   * @apiGroup Status
+   * @apiDescription Time from a DCC packet to its effect, per path: speed
+   * (a speed or direction change, to the first motor duty that follows it;
+   * with momentum, to its first step) and function (a function switched
+   * on, to the first block of its sound queued to the I2S DMA, amp warm-up
+   * included). Percentiles are read from the histogram, to within a bucket.
+   * @apiSuccess {Number} speed_count Packets timed since reset.
+   * @apiSuccess {Number} speed_p50_us Median.
+   * @apiSuccess {Number} speed_p99_us 99th percentile.
+   * @apiSuccess {Number} speed_max_us Slowest.
+   * @apiSuccess {Array} speed_buckets Histogram; see bucket_edges_us.
+   * @apiSuccess {Number} function_count The same for the function path.
+   * @apiSuccess {Array} bucket_edges_us Where each bucket starts; the last
+   * one is open-ended.
+   */
+  _server.on("/api/latency", HTTP_GET, [this]() {
+    AUTH_CHECK();
+    JsonDocument doc(_server.allocator());
+    LatencyMonitor::getInstance().getStatus(doc.to<JsonObject>());
+    sendJson(doc);
+  });
+
+  /**
+   * @api {DELETE} /api/latency Reset End-to-End Latency
+   * @apiGroup Status
+   * @apiDescription Clears the histograms, to measure from now.
+   */
+  _server.on("/api/latency", HTTP_DELETE, [this]() {
+    AUTH_CHECK();
+    LatencyMonitor::getInstance().reset();
+    _server.send(200, "application/json", "{\"status\":\"reset\"}");
+  });
+
+  // API: Event Trace
+  /**
+   * @api {POST} /api/trace Start Event Trace
+   * @apiGroup Status
+   * @apiDescription Starts recording events into a ring per core, the newest
+   * overwriting the oldest, until the trace is downloaded.
+   * @apiParam {String} [categories=motor,dcc,http,audio] Comma-separated list
+   * of isr, motor, dcc, http, audio, or all. The ISR fills a ring in ~25 ms.
+   * @apiParam {Number} [events=1024] Ring size per core, 16 to 4096.
+   * @apiError 409 Out of memory.
+   */
+  _server.on("/api/trace", HTTP_POST, [this]() {
+    AUTH_CHECK();
+    uint8_t categories = TRACE_DEFAULT;
+    if (_server.hasArg("categories"))
+      categories =
+          TraceRecorder::parseCategories(_server.arg("categories").c_str());
+    uint16_t events = TraceRecorder::DEFAULT_EVENTS;
+    if (_server.hasArg("events"))
+      events = (uint16_t)std::max<long>(
+          0, std::min<long>(_server.arg("events").toInt(),
+                            TraceRecorder::MAX_EVENTS));
+    TraceRecorder &trace = TraceRecorder::getInstance();
+    if (!categories || !trace.start(categories, events)) {
+      _server.send(409, "text/plain", "No categories, or out of memory");
+      return;
+    }
+    JsonDocument doc(_server.allocator());
+    trace.getStatus(doc.to<JsonObject>());
+    sendJson(doc);
+  });
+
+  /**
+   * @api {GET} /api/trace Get Event Trace Status
+   * @apiGroup Status
+   * @apiSuccess {String} state "idle", "recording" or "stopped".
+   * @apiSuccess {Number} categories Recorded (bits: 1 isr, 2 motor, 4 dcc,
+   * 8 http, 16 audio).
+   * @apiSuccess {Number} capacity Events per core.
+   * @apiSuccess {Number} events Events held.
+   * @apiSuccess {Boolean} wrapped Whether older events were overwritten.
+   */
+  _server.on("/api/trace", HTTP_GET, [this]() {
+    AUTH_CHECK();
+    JsonDocument doc(_server.allocator());
+    TraceRecorder::getInstance().getStatus(doc.to<JsonObject>());
+    sendJson(doc);
+  });
+
+  /**
+   * @api {GET} /api/trace/data Download Event Trace
+   * @apiGroup Status
+   * @apiDescription Stops recording and sends the trace as a binary blob: a
+   * 16-byte header, a 16-byte clock anchor per core, the event names, 16-byte
+   * task names, then 16-byte events, all little-endian. tools/trace_dump.py
+   * turns it into Chrome trace JSON, for chrome://tracing or Perfetto.
+   * @apiError 409 No trace recorded.
+   */
+  _server.on(
+      "/api/trace/data", HTTP_GET,
+      [this]() {
+        AUTH_CHECK();
+        TraceRecorder &trace = TraceRecorder::getInstance();
+        if (!trace.hasTrace()) {
+          _server.send(409, "text/plain", "No trace recorded");
+          return;
+        }
+        _server.sendHeader("Content-Disposition",
+                           "attachment; filename=\"trace.bin\"");
+        _server.sendStream(200, "application/octet-stream",
+                           [&](Print &out) { trace.write(out); });
+      },
+      nullptr, STREAM_STACK);
+
+  /**
+   * @api {DELETE} /api/trace Clear Event Trace
+   * @apiGroup Status
+   * @apiDescription Stops recording and frees the rings.
    */
+  _server.on("/api/trace", HTTP_DELETE, [this]() {
+    AUTH_CHECK();
+    TraceRecorder::getInstance().clear();
+    _server.send(200, "application/json", "{\"status\":\"cleared\"}");
+  });
+
+  // API: Motor Capture
   /**
-   * @api {GET} /api/motor/test Get Motor Test Data
+   * @api {POST} /api/motor/capture Arm Motor Capture
    * @apiGroup Motor
-   * @apiDescription Retrieves motor test telemetry data.
-   * @apiSuccess {JSON} data Telemetry JSON.
+   * @apiDescription Starts recording raw motor current (20 kHz) and each
+   * control tick, and waits for a trigger. Keeps pre + post ticks (under
+   * 40) around it.
+   * @apiParam {String} [trigger="manual,stall,fault"] Any of manual, stall,
+   * fault, zone, cv.
+   * @apiParam {Number} [pre=20] Ticks (20 ms) kept before the trigger.
+   * @apiParam {Number} [post=15] Ticks kept after it.
+   * @apiSuccess {JSON} status As GET.
+   * @apiError 409 A capture is already running.
    */
-  _server.on("/api/motor/test", [this]() {
+  _server.on("/api/motor/capture", HTTP_POST, [this]() {
     AUTH_CHECK();
-    if (_server.method() == HTTP_POST) {
-      MotorController::getInstance().startTest();
-      _server.send(200, "application/json", "{\"status\":\"started\"}");
-    } else if (_server.method() == HTTP_GET) {
-      String json = MotorController::getInstance().getTestJSON();
-      _server.send(200, "application/json", json);
-    } else {
-      _server.send(405, "text/plain", "Method Not Allowed");
+    String list = _server.hasArg("trigger") ? _server.arg("trigger")
+                                            : "manual,stall,fault";
+    int pre = _server.hasArg("pre") ? _server.arg("pre").toInt() : 20;
+    int post = _server.hasArg("post") ? _server.arg("post").toInt() : 15;
+    uint8_t triggers = MotorCapture::parseTriggers(list.c_str());
+    if (triggers == 0) {
+      _server.send(400, "text/plain", "No known trigger");
+      return;
+    }
+    MotorCapture &capture = MotorCapture::getInstance();
+    if (!capture.arm(triggers, constrain(pre, 0, MotorCapture::CYCLES - 1),
+                     constrain(post, 0, MotorCapture::CYCLES - 1))) {
+      _server.send(409, "text/plain", "Capture running or out of memory");
+      return;
     }
+    JsonDocument doc(_server.allocator());
+    capture.getStatus(doc.to<JsonObject>());
+    sendJson(doc);
+  });
+
+  /**
+   * @api {GET} /api/motor/capture Get Motor Capture Status
+   * @apiGroup Motor
+   * @apiSuccess {String} state "idle", "armed", "triggered" or "done".
+   * @apiSuccess {Number} triggers Armed conditions (bits: 1 manual, 2 stall,
+   * 4 fault, 8 zone, 16 cv).
+   * @apiSuccess {Number} fired The conditions that triggered it.
+   * @apiSuccess {Number} size Bytes to download, once done.
+   */
+  _server.on("/api/motor/capture", HTTP_GET, [this]() {
+    AUTH_CHECK();
+    JsonDocument doc(_server.allocator());
+    MotorCapture::getInstance().getStatus(doc.to<JsonObject>());
+    sendJson(doc);
+  });
+
+  /**
+   * @api {POST} /api/motor/capture/trigger Trigger Motor Capture
+   * @apiGroup Motor
+   * @apiDescription Fires the manual trigger of an armed capture.
+   */
+  _server.on("/api/motor/capture/trigger", HTTP_POST, [this]() {
+    AUTH_CHECK();
+    MotorCapture::getInstance().trigger(CAPTURE_MANUAL);
+    _server.send(200, "application/json", "{\"status\":\"triggered\"}");
+  });
+
+  /**
+   * @api {GET} /api/motor/capture/data Download Motor Capture
+   * @apiGroup Motor
+   * @apiDescription The finished capture as a binary blob: a 20-byte header,
+   * 40-byte tick records, then the raw 16-bit samples, all little-endian.
+   * See tools/motor_capture.py.
+   * @apiError 409 No finished capture.
+   */
+  _server.on(
+      "/api/motor/capture/data", HTTP_GET,
+      [this]() {
+        AUTH_CHECK();
+        MotorCapture &capture = MotorCapture::getInstance();
+        if (capture.state() != MotorCapture::State::DONE) {
+          _server.send(409, "text/plain", "No finished capture");
+          return;
+        }
+        _server.sendHeader("Content-Disposition",
+                           "attachment; filename=\"capture.bin\"");
+        _server.sendStream(200, "application/octet-stream",
+                           [&](Print &out) { capture.write(out); });
+      },
+      nullptr, STREAM_STACK);
+
+  /**
+   * @api {DELETE} /api/motor/capture Cancel Motor Capture
+   * @apiGroup Motor
+   * @apiDescription Stops a capture and frees its memory.
+   */
+  _server.on("/api/motor/capture", HTTP_DELETE, [this]() {
+    AUTH_CHECK();
+    MotorCapture::getInstance().cancel();
+    _server.send(200, "application/json", "{\"status\":\"cancelled\"}");
   });
 
   _server.on("/api/motor/reset_model", HTTP_POST, [this]() {
@@ -475,7 +896,7 @@ void ConnectivityManager::setup() {
       MotorController::getInstance().measureResistance();
       _server.send(200, "application/json", "{\"status\":\"started\"}");
     } else if (_server.method() == HTTP_GET) {
-      JsonDocument doc;
+      JsonDocument doc(_server.allocator());
       auto state = MotorController::getInstance().getResistanceState();
       switch (state) {
       case MotorController::ResistanceState::IDLE:
@@ -493,9 +914,7 @@ void ConnectivityManager::setup() {
       }
       doc["resistance"] =
           MotorController::getInstance().getMeasuredResistance();
-      String output;
-      serializeJson(doc, output);
-      _server.send(200, "application/json", output);
+      sendJson(doc);
     } else {
       _server.send(405, "text/plain", "Method Not Allowed");
     }
@@ -505,27 +924,28 @@ void ConnectivityManager::setup() {
   /**
    * @api {GET} /api/telemetry Get Live Telemetry
    * @apiGroup Status
-   * @apiDescription Retrieves live motor and system telemetry as JSON.
+   * @apiDescription Retrieves the latest value of every telemetry channel,
+   * keyed by channel name. See /api/telemetry/schema.
    */
   _server.on("/api/telemetry", HTTP_GET, [this]() {
     AUTH_CHECK();
-    MotorTask::Status status = MotorTask::getInstance().getStatus();
-    SystemState &state = SystemContext::getInstance().getState();
-
-    JsonDocument doc;
-    doc["target_speed"] = state.speed;
-    doc["duty"] = status.duty;
-    doc["current"] = status.current;
-    doc["voltage"] = status.appliedVoltage;
-    doc["rpm"] = status.estimatedRpm;
-    doc["ripple_freq"] = status.rippleFreq;
-    doc["learned_r"] = MotorTask::getInstance().getLearnedResistance();
-    doc["stalled"] = status.stalled;
-    doc["moving"] = status.isMoving;
-
-    String output;
-    serializeJson(doc, output);
-    _server.send(200, "application/json", output);
+    JsonDocument doc(_server.allocator());
+    Telemetry::getInstance().toJson(doc.to<JsonObject>());
+    sendJson(doc);
+  });
+
+  /**
+   * @api {GET} /api/telemetry/schema Get Telemetry Schema
+   * @apiGroup Status
+   * @apiDescription Lists the telemetry channels the firmware publishes.
+   * @apiSuccess {Array} channels Array of {name, unit, type ("bool", "u8",
+   * "u32" or "f32"), rate_hz}.
+   */
+  _server.on("/api/telemetry/schema", HTTP_GET, [this]() {
+    AUTH_CHECK();
+    JsonDocument doc(_server.allocator());
+    Telemetry::getInstance().schemaJson(doc.to<JsonArray>());
+    sendJson(doc);
   });
 
   // API: CV Definitions
@@ -537,7 +957,7 @@ void ConnectivityManager::setup() {
    */
   _server.on("/api/cv/defs", HTTP_GET, [this]() {
     AUTH_CHECK();
-    JsonDocument doc;
+    JsonDocument doc(_server.allocator());
     JsonArray arr = doc.to<JsonArray>();
     for (size_t i = 0; i < CV_DEFS_COUNT; i++) {
       JsonObject obj = arr.add<JsonObject>();
@@ -564,20 +984,56 @@ void ConnectivityManager::setup() {
       [this]() {
         // Handle upload
         handleFirmwareUpdate();
+      },
+      FIRMWARE_STACK);
+
+  // Live telemetry
+  /**
+   * @api {GET} /ws/telemetry Telemetry Stream (WebSocket)
+   * @apiGroup Status
+   * @apiDescription Binary messages of motor control frames, a batch every
+   * 20 ms: an 8-byte header (magic "NT", version, frame count, frames
+   * dropped so far) then 36-byte frames (sequence, micros, target, zone,
+   * flags, duty, current, RPM, ripple Hz, Ke, R), all little-endian. See
+   * tools/telemetry_stream.py. Send a number as a text message to change
+   * the decimation. Two clients at most.
+   * @apiParam {Number} [decimate=1] Send every Nth control frame.
+   */
+  _server.onWebSocket(
+      "/ws/telemetry",
+      [this](int fd) {
+        if (!isAuthenticated())
+          return false;
+        int decimate =
+            _server.hasArg("decimate") ? _server.arg("decimate").toInt() : 1;
+        return TelemetryStream::getInstance().addClient(
+            fd, constrain(decimate, 1, 255));
+      },
+      [](int fd, const char *text, size_t len) {
+        TelemetryStream::getInstance().setDecimation(
+            fd, constrain(atoi(text), 1, 255));
       });
 
   // Static File Catch-All (For serving audio files or other assets from FS)
-  _server.onNotFound([this]() {
-    AUTH_CHECK();
-    handleStaticFile();
-  });
+  _server.onNotFound(
+      [this]() {
+        AUTH_CHECK();
+        handleStaticFile();
+      },
+      STREAM_STACK);
 
   _server.begin();
+  TelemetryStream::getInstance().startTask(
+      [this](int fd, const uint8_t *data, size_t len) {
+        return _server.sendBinary(fd, data, len);
+      });
   Log.println("ConnectivityManager: Web Server started on port 80");
+  BootTimeline::getInstance().mark(BOOT_NETWORK);
 }
 
 void ConnectivityManager::loop() {
-  _server.handleClient();
+  // Handlers run on the server's tasks; this runs what they left for the loop
+  _server.poll();
 
   if (_wifiState == WIFI_CONNECTING) {
     if (WiFi.status() == WL_CONNECTED) {
@@ -585,6 +1041,7 @@ void ConnectivityManager::loop() {
       Log.println(WiFi.localIP());
       SystemContext::getInstance().getState().wifiConnected = true;
       _wifiState = WIFI_CONNECTED;
+      BootTimeline::getInstance().mark(BOOT_WIFI);
     } else if (millis() - _connectStartTime > 10000 ||
                WiFi.status() == WL_CONNECT_FAILED) {
       // Timeout after 10 seconds or immediate failure
@@ -612,7 +1069,7 @@ void ConnectivityManager::loop() {
  * Helper to bridge ArduinoJson serialization and WebServer chunked streaming.
  */
 void ConnectivityManager::handleFileList() {
-  JsonDocument doc;
+  JsonDocument doc(_server.allocator());
   JsonArray array = doc.to<JsonArray>();
 
   File root = LittleFS.open("/");
@@ -633,9 +1090,7 @@ void ConnectivityManager::handleFileList() {
     file = root.openNextFile();
   }
 
-  String output;
-  serializeJson(doc, output);
-  _server.send(200, "application/json", output);
+  sendJson(doc);
 }
 
 void ConnectivityManager::handleFileDelete() {
@@ -644,28 +1099,54 @@ void ConnectivityManager::handleFileDelete() {
     return;
   }
   String path = _server.arg("path");
-  if (LittleFS.exists(path)) {
+  bool found = false;
+  // On the loop, with the voices stopped: they, the prefetcher and the
+  // manifest may have the file, its sidecar or its rendition open
+  _server.runInLoop([&] {
+    if (!LittleFS.exists(path))
+      return;
+    found = true;
+    AudioController &audio = AudioController::getInstance();
+    audio.stop();
     LittleFS.remove(path);
+    if (path == SoundManifest::JSON_PATH &&
+        LittleFS.exists(SoundManifest::PATH))
+      LittleFS.remove(SoundManifest::PATH);
+    if (isMp3File(path.c_str())) {
+      AudioTranscoder::getInstance().cancel(path);
+      if (LittleFS.exists(mp3SidecarPath(path)))
+        LittleFS.remove(mp3SidecarPath(path));
+      if (LittleFS.exists(audioRenditionPath(path)))
+        LittleFS.remove(audioRenditionPath(path));
+    }
+    audio.loadAssets();
+  });
+  if (found)
     _server.send(200, "text/plain", "Deleted");
-  } else {
+  else
     _server.send(404, "text/plain", "File not found");
-  }
 }
 
 void ConnectivityManager::handleFileFormat() {
   Log.println("Files: Formatting LittleFS...");
   _server.send(200, "text/plain", "Formatting started...");
 
-  // Format is blocking and can take time
-  if (LittleFS.format()) {
-    Log.println("Files: Format Success");
-  } else {
-    Log.println("Files: Format Failed");
-  }
+  // Format is blocking and can take time. It runs on the loop, with the
+  // voices stopped, as they read the files it wipes.
+  _server.runInLoop([] {
+    AudioController &audio = AudioController::getInstance();
+    audio.stop();
+    if (LittleFS.format()) {
+      Log.println("Files: Format Success");
+    } else {
+      Log.println("Files: Format Failed");
+    }
 
-  // Re-mount to be safe
-  LittleFS.end();
-  LittleFS.begin(true);
+    // Re-mount to be safe
+    LittleFS.end();
+    LittleFS.begin(true);
+    audio.loadAssets();
+  });
 }
 
 void ConnectivityManager::handleFileUpload() {
@@ -734,6 +1215,12 @@ void ConnectivityManager::handleFileUpload() {
     if (LittleFS.exists(filename)) {
       LittleFS.remove(filename);
     }
+    // A replaced MP3 must not keep playing from the old rendition
+    if (isMp3File(filename.c_str())) {
+      AudioTranscoder::getInstance().cancel(filename);
+      if (LittleFS.exists(audioRenditionPath(filename)))
+        LittleFS.remove(audioRenditionPath(filename));
+    }
 
     Log.printf("Upload Start: %s\n", filename.c_str());
     _uploadFile = LittleFS.open(filename, "w");
@@ -781,15 +1268,93 @@ void ConnectivityManager::handleFileUpload() {
         LittleFS.remove(upload.filename.c_str()); // Cleanup broken file
       }
 
-      // Hot-reload sound assets if the config file was just uploaded
+      // Compile the config once, here, then hot-reload from the manifest.
+      // A rejected config leaves the previous manifest playing.
       if (upload.filename.endsWith("sound_assets.json")) {
-        Log.println("Audio: Hot-reloading assets...");
-        AudioController::getInstance().loadAssets();
+        String error;
+        if (_uploadBytesWritten != upload.totalSize) {
+          _uploadError = "sound_assets.json: incomplete upload";
+        } else if (SoundManifest::compile(error)) {
+          Log.println("Audio: Hot-reloading assets...");
+          _server.runInLoop(
+              [] { AudioController::getInstance().loadAssets(); });
+        } else {
+          Log.printf("Audio: sound_assets.json rejected: %s\n", error.c_str());
+          _uploadError = "sound_assets.json: " + error;
+        }
+      } else if (isMp3File(upload.filename.c_str()) &&
+                 _uploadBytesWritten == upload.totalSize) {
+        // Index once here so playback can seek and loop without scanning,
+        // then decode it once in the background
+        String path = upload.filename.startsWith("/") ? upload.filename
+                                                      : "/" + upload.filename;
+        buildMp3Sidecar(path);
+        AudioTranscoder::getInstance().enqueue(path);
       }
     }
   }
 }
 
+void ConnectivityManager::handleSoundPackUpload() {
+  HTTPUpload &upload = _server.upload();
+  SoundPack &pack = SoundPack::getInstance();
+
+  if (upload.status == UPLOAD_FILE_START) {
+    _uploadError = "";
+    if (!isAuthenticated()) {
+      _uploadError = "Unauthorized";
+      return;
+    }
+    Log.printf("SoundPack: Receiving %s\n", upload.filename.c_str());
+    // Voices read the pack through the mapping that is about to go away,
+    // so it is unmapped on the loop, once they are stopped
+    bool ok = false;
+    _server.runInLoop([&] {
+      AudioController::getInstance().stop();
+      ok = pack.beginInstall();
+    });
+    if (!ok)
+      _uploadError = pack.installError();
+  } else if (upload.status == UPLOAD_FILE_WRITE) {
+    if (_uploadError.length() == 0 &&
+        !pack.writeInstall(upload.buf, upload.currentSize))
+      _uploadError = pack.installError();
+  } else if (upload.status == UPLOAD_FILE_END) {
+    if (_uploadError.length() > 0)
+      return;
+    // Mounted on the loop, where the voices look files up. Falls back to
+    // sound_assets.json when the pack did not mount.
+    bool ok = false;
+    _server.runInLoop([&] {
+      ok = pack.endInstall();
+      AudioController::getInstance().loadAssets();
+    });
+    if (!ok)
+      _uploadError = pack.installError();
+  }
+}
+
+void ConnectivityManager::handleSoundPackStatus() {
+  SoundPack &pack = SoundPack::getInstance();
+  JsonDocument doc(_server.allocator());
+  // The file table is only stable on the loop, which (un)mounts the pack
+  _server.runInLoop([&] {
+    doc["installed"] = pack.mounted();
+    doc["size"] = pack.size();
+    doc["capacity"] = pack.partitionSize();
+    doc["assets"] = pack.assets().size();
+    static const char *CODECS[] = {"unknown", "pcm", "adpcm", "mp3"};
+    JsonArray files = doc["files"].to<JsonArray>();
+    for (const SoundPack::Entry &entry : pack.files()) {
+      JsonObject f = files.add<JsonObject>();
+      f["name"] = entry.name;
+      f["codec"] = CODECS[(uint8_t)entry.codec & 3];
+      f["size"] = entry.size;
+    }
+  });
+  sendJson(doc);
+}
+
 void ConnectivityManager::handleFirmwareUpdate() {
   HTTPUpload &upload = _server.upload();
   if (upload.status == UPLOAD_FILE_START) {
@@ -864,12 +1429,29 @@ void ConnectivityManager::handleStaticFile() {
     contentType = "audio/mpeg";
 
   File file = LittleFS.open(path, "r");
-  if (file) {
-    _server.streamFile(file, contentType);
-    file.close();
-  } else {
+  if (!file || file.isDirectory()) {
     _server.send(404, "text/plain", "404: Not Found");
+    return;
   }
+
+  _server.sendHeader("Cache-Control", "no-cache");
+  _server.serveFile(file, contentType);
+  file.close();
+}
+
+void ConnectivityManager::sendAsset(const char *contentType,
+                                    const uint8_t *gz, size_t len,
+                                    const char *digest) {
+  String etag = String("\"") + ASSET_BUILD_TAG + "-" + digest + "\"";
+  etag.replace(" ", "");
+  if (_server.notModified(etag))
+    return;
+  // Every browser accepts gzip, so there is no uncompressed copy to fall
+  // back on
+  _server.sendHeader("Content-Encoding", "gzip");
+  _server.sendHeader("Cache-Control", "no-cache"); // Always revalidate
+  _server.sendHeader("ETag", etag);
+  _server.send_P(200, contentType, (const char *)gz, len);
 }
 
 void ConnectivityManager::handleWifiSave() {
@@ -906,7 +1488,7 @@ void ConnectivityManager::handleWifiScan() {
   Log.println("Scanning WiFi Networks...");
   int n = WiFi.scanNetworks();
 
-  JsonDocument doc;
+  JsonDocument doc(_server.allocator());
   JsonArray array = doc.to<JsonArray>();
 
   for (int i = 0; i < n; ++i) {
@@ -925,8 +1507,9 @@ void ConnectivityManager::handleControl() {
     return;
   }
 
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, _server.arg("plain"));
+  JsonDocument doc(_server.allocator());
+  DeserializationError error =
+      deserializeJson(doc, _server.body(), _server.bodyLength());
 
   if (error) {
     _server.send(400, "text/plain", "Invalid JSON");
@@ -934,35 +1517,8 @@ void ConnectivityManager::handleControl() {
   }
 
   String action = doc["action"];
-  SystemContext &ctx = SystemContext::getInstance();
-  ScopedLock lock(ctx);
-  SystemState &state = ctx.getState();
-
-  if (action == "stop") {
-    state.speed = 0;
-    state.speedSource = SOURCE_WEB;
-    Log.println("Web: STOP");
-  } else if (action == "toggle_lights") {
-    state.functions[0] = !state.functions[0];
-    Log.printf("Web: Lights %s\n", state.functions[0] ? "ON" : "OFF");
-  } else if (action == "set_function") {
-    int idx = doc["index"];
-    bool val = doc["value"];
-    if (idx >= 0 && idx < 29) {
-      state.functions[idx] = val;
-      Log.printf("Web: F%d %s\n", idx, val ? "ON" : "OFF");
-    }
-  } else if (action == "set_speed") {
-    int val = doc["value"];
-    // Map 0-126 (DCC steps) to 0-255 (PWM)
-    state.speed = map(val, 0, 126, 0, 255);
-    state.speedSource = SOURCE_WEB;
-    Log.printf("Web: Speed Step %d -> PWM %d\n", val, state.speed);
-  } else if (action == "set_direction") {
-    state.direction = doc["value"];
-    state.speedSource = SOURCE_WEB;
-    Log.printf("Web: Dir %s\n", state.direction ? "FWD" : "REV");
-  } else if (action == "set_log_level") {
+  bool known = true;
+  if (action == "set_log_level") {
     int level = doc["value"]; // 0=Debug, 1=Info
     Log.setLevel((LogLevel)level);
     Log.printf("Web: Log Level %d\n", level);
@@ -970,6 +1526,41 @@ void ConnectivityManager::handleControl() {
     BootLoopDetector::clearRollback();
     Log.println("Web: Rollback Flag Cleared");
   } else {
+    // Locked for the state change only, not for NVS or the reply
+    SystemContext &ctx = SystemContext::getInstance();
+    ScopedLock lock(ctx);
+    SystemState &state = ctx.getState();
+
+    if (action == "stop") {
+      state.speed = 0;
+      state.speedSource = SOURCE_WEB;
+      Log.println("Web: STOP");
+    } else if (action == "toggle_lights") {
+      state.functions[0] = !state.functions[0];
+      Log.printf("Web: Lights %s\n", state.functions[0] ? "ON" : "OFF");
+    } else if (action == "set_function") {
+      int idx = doc["index"];
+      bool val = doc["value"];
+      if (idx >= 0 && idx < 29) {
+        state.functions[idx] = val;
+        Log.printf("Web: F%d %s\n", idx, val ? "ON" : "OFF");
+      }
+    } else if (action == "set_speed") {
+      int val = doc["value"];
+      // Map 0-126 (DCC steps) to 0-255 (PWM)
+      state.speed = map(val, 0, 126, 0, 255);
+      state.speedSource = SOURCE_WEB;
+      Log.printf("Web: Speed Step %d -> PWM %d\n", val, state.speed);
+    } else if (action == "set_direction") {
+      state.direction = doc["value"];
+      state.speedSource = SOURCE_WEB;
+      Log.printf("Web: Dir %s\n", state.direction ? "FWD" : "REV");
+    } else {
+      known = false;
+    }
+  }
+
+  if (!known) {
     _server.send(400, "text/plain", "Unknown action");
     return;
   }
@@ -983,8 +1574,8 @@ void ConnectivityManager::handleCV() {
     return;
   }
 
-  JsonDocument doc;
-  deserializeJson(doc, _server.arg("plain"));
+  JsonDocument doc(_server.allocator());
+  deserializeJson(doc, _server.body(), _server.bodyLength());
   String cmd = doc["cmd"];
 
   if (cmd == "read") {
@@ -1005,7 +1596,7 @@ void ConnectivityManager::handleCV() {
 
 void ConnectivityManager::handleCvAll() {
   if (_server.method() == HTTP_GET) {
-    JsonDocument doc;
+    JsonDocument doc(_server.allocator());
     NmraDcc &dcc = DccController::getInstance().getDcc();
 
     // Loop through ALL defined CVs in our Registry
@@ -1023,8 +1614,8 @@ void ConnectivityManager::handleCvAll() {
       return;
     }
 
-    JsonDocument doc;
-    deserializeJson(doc, _server.arg("plain"));
+    JsonDocument doc(_server.allocator());
+    deserializeJson(doc, _server.body(), _server.bodyLength());
     JsonObject obj = doc.as<JsonObject>();
     NmraDcc &dcc = DccController::getInstance().getDcc();
 
@@ -1046,19 +1637,43 @@ void ConnectivityManager::handleAudioPlay() {
     return;
   }
   String file = _server.arg("file");
-  // Ensure leading slash
-  if (!file.startsWith("/"))
+  // Ensure leading slash (pack files are named "pack:<name>")
+  if (!file.startsWith("/") && !SoundPack::isPackPath(file))
     file = "/" + file;
 
-  AudioController::getInstance().playFile(file.c_str());
+  _server.runInLoop(
+      [&file] { AudioController::getInstance().playFile(file.c_str()); });
   _server.send(200, "text/plain", "Playing");
 }
 
+void ConnectivityManager::handleAudioTranscode() {
+  JsonDocument doc(_server.allocator());
+  AudioTranscoder::getInstance().getStatus(doc.to<JsonObject>());
+  sendJson(doc);
+}
+
+void ConnectivityManager::handleAudioPrefetch() {
+  JsonDocument doc(_server.allocator());
+  AudioPrefetcher::getInstance().getStatus(doc.to<JsonObject>());
+  sendJson(doc);
+}
+
+void ConnectivityManager::handleHttpStatus() {
+  JsonDocument doc(_server.allocator());
+  _server.getStatus(doc.to<JsonObject>());
+  sendJson(doc);
+}
+
 void ConnectivityManager::handleStatus() {
-  SystemContext &ctx = SystemContext::getInstance();
-  ScopedLock lock(ctx);
-  SystemState &state = ctx.getState();
-  JsonDocument doc;
+  // A copy, so that NVS, the file system and the response are not waited on
+  // with the state locked against ControlPlane
+  SystemState state;
+  {
+    SystemContext &ctx = SystemContext::getInstance();
+    ScopedLock lock(ctx);
+    state = ctx.getState();
+  }
+  JsonDocument doc(_server.allocator());
 
   // Use the configured address from NmraDcc, not just the last packet address
   doc["address"] = DccController::getInstance().getDcc().getAddr();
@@ -1087,6 +1702,13 @@ void ConnectivityManager::handleStatus() {
   doc["fs_total"] = LittleFS.totalBytes();
   doc["fs_used"] = LittleFS.usedBytes();
 
+  size_t heapFree = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  size_t heapLargest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+  doc["heap_free"] = heapFree;
+  doc["heap_largest_block"] = heapLargest;
+  doc["heap_fragmentation"] =
+      heapFree > 0 ? 100 - (uint32_t)(heapLargest * 100 / heapFree) : 0;
+
   JsonArray funcs = doc["functions"].to<JsonArray>();
   for (int i = 0; i < 29; i++)
     funcs.add(state.functions[i]);
@@ -1095,9 +1717,7 @@ void ConnectivityManager::handleStatus() {
 }
 
 void ConnectivityManager::sendJson(const JsonDocument &doc) {
-  String output;
-  serializeJson(doc, output);
-  _server.send(200, "application/json", output);
+  _server.sendJson(200, doc);
 }
 
 bool ConnectivityManager::isAuthenticated() {
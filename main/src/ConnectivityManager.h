@@ -1,22 +1,26 @@
 #ifndef CONNECTIVITY_MANAGER_H
 #define CONNECTIVITY_MANAGER_H
 
+#include "HttpServer.h"
 #include "Logger.h"
 #include "SystemContext.h"
 #include <ArduinoJson.h>
 #include <LittleFS.h>
 #include <Update.h>
-#include <WebServer.h>
 #include <WiFi.h>
 
 class ConnectivityManager {
 public:
   ConnectivityManager();
-  void setup();
+  // The staged boot runs these first, so WiFi associates while the rest of
+  // the boot goes on; setup() runs any that have not been
+  void startWifi();
+  void mountFilesystem();
+  void setup(); // Routes and the server
   void loop();
 
 private:
-  WebServer _server;
+  HttpServer _server;
   String _uploadError;
   bool _uploadAuthPassed = false;
 
@@ -29,6 +33,7 @@ private:
     WIFI_FAIL
   };
   WifiState _wifiState = WIFI_INIT;
+  bool _fsMounted = false;
   uint32_t _connectStartTime = 0;
   String _hostname;
 
@@ -38,7 +43,11 @@ private:
   void handleFirmwareUpdate();
   void handleFileDelete();
   void handleFileFormat();
+  void handleSoundPackUpload();
+  void handleSoundPackStatus();
   void handleStaticFile(); // Catch-all for FS files
+  void sendAsset(const char *contentType, const uint8_t *gz, size_t len,
+                 const char *digest); // Embedded, gzipped
 
   File _uploadFile;
   size_t _uploadBytesWritten = 0;
@@ -54,6 +63,9 @@ private:
   void handleCV();
   void handleCvAll();
   void handleAudioPlay();
+  void handleAudioTranscode();
+  void handleAudioPrefetch();
+  void handleHttpStatus();
   void sendJson(const JsonDocument &doc);
 
   // Authentication
@@ -1,6 +1,7 @@
 #ifndef CV_REGISTRY_H
 #define CV_REGISTRY_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 // 1. Constants for Code Usage
@@ -21,6 +22,15 @@ static constexpr uint16_t CONFIG = 29;
 
 // Audio
 static constexpr uint16_t MASTER_VOL = 50;
+static constexpr uint16_t AUDIO_TRANSCODE = 51;        // 0=Off, 1=ADPCM, 2=PCM
+static constexpr uint16_t AUDIO_RENDITION_BUDGET = 52; // 64 KB units
+static constexpr uint16_t ENGINE_NOTCH_TIME = 53;      // 100 ms units
+static constexpr uint16_t ENGINE_LOAD_NOTCHES = 54;    // Notches at full load
+static constexpr uint16_t AUDIO_AMP_HANGOVER = 55;     // 100 ms units
+static constexpr uint16_t AUDIO_READ_AHEAD = 56;       // KB per file
+static constexpr uint16_t AUDIO_LOAD_BASS = 47;        // 0.5 dB units
+static constexpr uint16_t AUDIO_LOAD_VOICES = 48;      // Percent
+static constexpr uint16_t AUDIO_HIGH_PASS = 49;        // 10 Hz units
 static constexpr uint16_t AUDIO_MAP_BASE =
     100; // CV = 100 + SoundID. Value = Function (0-28)
 static constexpr uint16_t CHUFF_RATE = 133;
@@ -93,6 +103,24 @@ static const CvDef CV_DEFS[] = {
     {CV::CONFIG, 38, "Configuration", "Bit 5=LongAddr, Bit 2=Analog"},
 
     {CV::MASTER_VOL, 128, "Master Volume", "Audio Volume (0-255)"},
+    {CV::AUDIO_TRANSCODE, 1, "MP3 Transcode",
+     "Decode uploaded MP3s once: 0=Off, 1=ADPCM, 2=PCM if it fits."},
+    {CV::AUDIO_RENDITION_BUDGET, 16, "Transcode Budget",
+     "Space for decoded MP3s in 64 KB units (16=1 MB)."},
+    {CV::ENGINE_NOTCH_TIME, 10, "Notch Time",
+     "Min time per diesel notch in 100 ms units (10=1 s)."},
+    {CV::ENGINE_LOAD_NOTCHES, 2, "Load Notches",
+     "Diesel notches added at full motor load (0-8)."},
+    {CV::AUDIO_AMP_HANGOVER, 20, "Amp Hangover",
+     "Keep the amp on after the last sound, 100 ms units (20=2 s)."},
+    {CV::AUDIO_READ_AHEAD, 16, "Read-ahead",
+     "Buffer per playing file in KB (0=Off, 8-64)."},
+    {CV::AUDIO_LOAD_BASS, 12, "Load Bass",
+     "Engine bass boost at full motor load, 0.5 dB units (12=6 dB)."},
+    {CV::AUDIO_LOAD_VOICES, 0, "Load on Voices",
+     "Share of the load tone applied to other sounds (0-100%)."},
+    {CV::AUDIO_HIGH_PASS, 0, "Speaker High-pass",
+     "Cut below this frequency, 10 Hz units (0=Off, 8=80 Hz)."},
 
     // Virtual Cam Settings
     {CV::CHUFF_RATE, 10, "Chuff Rate", "Sync Multiplier (PWM -> RPM)"},
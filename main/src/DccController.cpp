@@ -1,9 +1,13 @@
 #include "DccController.h"
 #include "../config.h"
 #include "BootLoopDetector.h"
+#include "BootTimeline.h"
 #include "CvRegistry.h"
+#include "LatencyMonitor.h"
 #include "Logger.h"
+#include "MotorCapture.h"
 #include "MotorHal.h"
+#include "TraceRecorder.h"
 #include "nimrs-pinout.h"
 #include <EEPROM.h>
 #include <WiFi.h>
@@ -183,6 +187,7 @@ uint8_t notifyCVWrite(uint16_t CV, uint8_t Value) {
   }
 
   Log.printf("DCC: Write CV%d = %d\n", CV, Value);
+  MotorCapture::getInstance().trigger(CAPTURE_CV_WRITE);
   EEPROM.write(CV, Value);
   EEPROM.commit();
   return Value;
@@ -190,6 +195,8 @@ uint8_t notifyCVWrite(uint16_t CV, uint8_t Value) {
 
 void notifyDccSpeed(uint16_t Addr, DCC_ADDR_TYPE AddrType, uint8_t Speed,
                     DCC_DIRECTION Dir, DCC_SPEED_STEPS SpeedSteps) {
+  TraceScope trace(TRACE_DCC, "dcc.speed", Speed | (Dir == DCC_DIR_FWD) << 8);
+  BootTimeline::getInstance().mark(BOOT_FIRST_PACKET);
   SystemContext &ctx = SystemContext::getInstance();
   bool direction = (Dir == DCC_DIR_FWD);
   uint8_t targetSpeed = 0;
@@ -224,6 +231,8 @@ void notifyDccSpeed(uint16_t Addr, DCC_ADDR_TYPE AddrType, uint8_t Speed,
     // Only take control if we are already in DCC mode, OR if the DCC change is
     // significant
     if (state.speedSource == SOURCE_DCC || isDccInternalChange) {
+      if (state.speed != targetSpeed || state.direction != direction)
+        state.speedCause = LatencyMonitor::getInstance().stamp();
       state.speed = targetSpeed;
       state.direction = direction;
       state.speedSource = SOURCE_DCC;
@@ -244,6 +253,7 @@ void notifyDccSpeed(uint16_t Addr, DCC_ADDR_TYPE AddrType, uint8_t Speed,
 
 void notifyDccFunc(uint16_t Addr, DCC_ADDR_TYPE AddrType, FN_GROUP FuncGrp,
                    uint8_t FuncState) {
+  TraceScope trace(TRACE_DCC, "dcc.func", FuncGrp << 8 | FuncState);
   SystemContext &ctx = SystemContext::getInstance();
 
   uint8_t baseIndex = 0;
@@ -272,16 +282,25 @@ void notifyDccFunc(uint16_t Addr, DCC_ADDR_TYPE AddrType, FN_GROUP FuncGrp,
   {
     ScopedLock lock(ctx);
     SystemState &state = ctx.getState();
+    // A function this packet switches on gets its causality ID
+    uint32_t cause = 0;
+    auto set = [&](uint8_t index, bool on) {
+      if (on && !state.functions[index]) {
+        if (!cause)
+          cause = LatencyMonitor::getInstance().stamp();
+        state.functionCause[index] = cause;
+      }
+      state.functions[index] = on;
+    };
     if (FuncGrp == FN_0_4) {
-      state.functions[0] = (FuncState & FN_BIT_00) ? true : false;
-      state.functions[1] = (FuncState & FN_BIT_01) ? true : false;
-      state.functions[2] = (FuncState & FN_BIT_02) ? true : false;
-      state.functions[3] = (FuncState & FN_BIT_03) ? true : false;
-      state.functions[4] = (FuncState & FN_BIT_04) ? true : false;
+      set(0, FuncState & FN_BIT_00);
+      set(1, FuncState & FN_BIT_01);
+      set(2, FuncState & FN_BIT_02);
+      set(3, FuncState & FN_BIT_03);
+      set(4, FuncState & FN_BIT_04);
     } else {
       for (int i = 0; i < 8; i++) {
-        state.functions[baseIndex + i] =
-            ((FuncState >> i) & 0x01) ? true : false;
+        set(baseIndex + i, (FuncState >> i) & 0x01);
       }
     }
   }
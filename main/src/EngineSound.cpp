@@ -0,0 +1,369 @@
+#include "EngineSound.h"
+#include "AudioTranscoder.h"
+#include "AudioUtils.h"
+#include "ImaAdpcm.h"
+#include "Logger.h"
+#include <LittleFS.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+constexpr float HALF_PI_F = 1.57079633f;
+
+int16_t monoFrame(const int16_t *pcm, size_t i, uint16_t channels) {
+  if (channels == 1)
+    return pcm[i];
+  return (int16_t)(((int32_t)pcm[2 * i] + pcm[2 * i + 1]) / 2);
+}
+
+uint32_t readPcm(File &f, const WavInfo &wav, int16_t *out, uint32_t frames) {
+  int16_t buf[256];
+  const size_t perRead = sizeof(buf) / (2 * wav.channels);
+  uint32_t done = 0;
+  while (done < frames) {
+    size_t want = std::min<size_t>(perRead, frames - done);
+    size_t n = f.read((uint8_t *)buf, want * 2 * wav.channels) /
+               (2 * wav.channels);
+    if (n == 0)
+      break;
+    for (size_t i = 0; i < n; i++)
+      out[done++] = monoFrame(buf, i, wav.channels);
+  }
+  return done;
+}
+
+uint32_t readAdpcm(File &f, const WavInfo &wav, int16_t *out,
+                   uint32_t frames) {
+  std::vector<uint8_t> block(wav.blockAlign);
+  std::vector<int16_t> pcm(
+      imaAdpcmFramesPerBlock(wav.blockAlign, wav.channels) * wav.channels);
+  uint32_t done = 0;
+  while (done < frames && f.read(block.data(), block.size()) == block.size()) {
+    size_t n = imaAdpcmDecodeBlock(block.data(), wav.blockAlign, wav.channels,
+                                   pcm.data());
+    if (n == 0)
+      break;
+    for (size_t i = 0; i < n && done < frames; i++)
+      out[done++] = monoFrame(pcm.data(), i, wav.channels);
+  }
+  return done;
+}
+} // namespace
+
+bool EngineSound::load(const SoundAsset &asset) {
+  unload();
+  size_t count = std::min(asset.notches.size(), (size_t)MAX_NOTCHES);
+  if (asset.notches.size() > MAX_NOTCHES)
+    Log.printf("Audio: Engine %d has %u notches, using the first %u\n",
+               asset.id, (unsigned)asset.notches.size(), MAX_NOTCHES);
+
+  for (size_t i = 0; i < count; i++) {
+    if (!_loadClip(asset.notches[i], _notches[i])) {
+      unload();
+      return false;
+    }
+  }
+
+  // Transitions and start/shutdown are optional: without them the engine
+  // crossfades straight between loops, or fades in and out
+  for (size_t i = 0; i + 1 < count; i++) {
+    if (i < asset.notchUp.size() && asset.notchUp[i].length() > 0)
+      _loadClip(asset.notchUp[i], _up[i]);
+    if (i < asset.notchDown.size() && asset.notchDown[i].length() > 0)
+      _loadClip(asset.notchDown[i], _down[i]);
+  }
+  if (asset.fileIntro.length() > 0)
+    _loadClip(asset.fileIntro, _start);
+  if (asset.fileOutro.length() > 0)
+    _loadClip(asset.fileOutro, _shutdown);
+
+  _notchCount = count;
+  _assetId = asset.id;
+  _crossfadeMs =
+      asset.crossfadeMs > 0 ? asset.crossfadeMs : DEFAULT_CROSSFADE_MS;
+  if (loaded())
+    Log.printf("Audio: Engine %d (%s) preloaded, %u notches, %u KB\n",
+               asset.id, asset.name.c_str(), _notchCount,
+               (unsigned)(_bytes / 1024));
+  return loaded();
+}
+
+void EngineSound::unload() {
+  stop();
+  _freeClip(_start);
+  _freeClip(_shutdown);
+  for (Clip &clip : _notches)
+    _freeClip(clip);
+  for (uint8_t i = 0; i + 1 < MAX_NOTCHES; i++) {
+    _freeClip(_up[i]);
+    _freeClip(_down[i]);
+  }
+  _notchCount = 0;
+  _assetId = 0;
+  _bytes = 0;
+}
+
+bool EngineSound::_loadClip(const String &path, Clip &clip) {
+  // Helix is far too slow to decode whole loops at load time, so MP3 layers
+  // are taken from their decode-once rendition
+  bool mp3 = isMp3File(path.c_str());
+  File f = LittleFS.open(mp3 ? audioRenditionPath(path) : path, "r");
+  if (!f) {
+    Log.printf("Audio: Engine layer %s not found%s\n", path.c_str(),
+               mp3 ? " (no rendition yet)" : "");
+    return false;
+  }
+
+  uint8_t header[512];
+  size_t len = f.read(header, sizeof(header));
+  WavInfo wav;
+  uint32_t frames = 0;
+  if (parseWavHeader(header, len, wav) && wav.sampleRate > 0 &&
+      (wav.channels == 1 || wav.channels == 2)) {
+    if (wav.formatTag == WAV_FORMAT_PCM && wav.bitsPerSample == 16) {
+      frames = wav.dataSize / (2 * wav.channels);
+    } else if (wav.formatTag == WAV_FORMAT_IMA_ADPCM && wav.blockAlign > 0) {
+      frames = wav.dataSize / wav.blockAlign *
+               imaAdpcmFramesPerBlock(wav.blockAlign, wav.channels);
+      if (wav.frameCount > 0 && wav.frameCount < frames)
+        frames = wav.frameCount;
+    }
+  }
+  if (frames == 0) {
+    Log.printf("Audio: Engine layer %s must be a PCM16 or IMA-ADPCM WAV\n",
+               path.c_str());
+    f.close();
+    return false;
+  }
+
+  // malloc rather than new so a module without PSRAM fails softly
+  int16_t *pcm = (int16_t *)malloc(frames * sizeof(int16_t));
+  if (!pcm) {
+    Log.printf("Audio: No memory to preload %s (%u KB)\n", path.c_str(),
+               (unsigned)(frames * sizeof(int16_t) / 1024));
+    f.close();
+    return false;
+  }
+
+  f.seek(wav.dataOffset);
+  uint32_t got = wav.formatTag == WAV_FORMAT_PCM
+                     ? readPcm(f, wav, pcm, frames)
+                     : readAdpcm(f, wav, pcm, frames);
+  f.close();
+  if (got < 2) {
+    free(pcm);
+    return false;
+  }
+
+  clip.pcm = pcm;
+  clip.frames = got;
+  clip.rate = wav.sampleRate;
+  _bytes += frames * sizeof(int16_t);
+  return true;
+}
+
+void EngineSound::_freeClip(Clip &clip) {
+  free(clip.pcm);
+  clip = Clip();
+}
+
+void EngineSound::start() {
+  if (!loaded())
+    return;
+  uint32_t xfade = _fadeFrames();
+  _fadeOutAll(xfade);
+  if (_start)
+    _add(&_start, false, 0, &_notches[0]);
+  else
+    _add(&_notches[0], true, xfade);
+  _notch = 0;
+  _notchSince = millis();
+  _state = State::RUNNING;
+}
+
+void EngineSound::release() {
+  if (_state != State::RUNNING)
+    return;
+  uint32_t xfade = _fadeFrames();
+  _fadeOutAll(xfade);
+  if (_shutdown)
+    _add(&_shutdown, false, xfade);
+  _state = State::STOPPING;
+}
+
+void EngineSound::stop() {
+  for (Layer &layer : _layers)
+    layer = Layer();
+  _state = State::OFF;
+  _notch = 0;
+}
+
+bool EngineSound::active() const {
+  for (const Layer &layer : _layers) {
+    if (layer.clip)
+      return true;
+  }
+  return false;
+}
+
+void EngineSound::update(uint8_t speed, float momentum, float load,
+                         uint32_t notchTimeMs, uint8_t loadNotches) {
+  // One step at a time: wait for the last crossfade to finish
+  if (_state != State::RUNNING || !_settled())
+    return;
+
+  float top = _notchCount - 1;
+  float demand = momentum / 255.0f * top + load * loadNotches;
+  if (speed > momentum + 1.0f)
+    demand += 1.0f; // Notch up ahead of the train
+  else if (speed + 1.0f < momentum)
+    demand -= 1.0f; // Throttle back while it slows
+  if (speed == 0 && momentum < 1.0f)
+    demand = 0.0f;
+
+  int target = constrain((int)lroundf(demand), 0, (int)top);
+  if (target == _notch || millis() - _notchSince < notchTimeMs)
+    return;
+  _step(target > _notch ? _notch + 1 : _notch - 1);
+}
+
+void EngineSound::_step(uint8_t to) {
+  const Clip *via = to > _notch ? &_up[_notch] : &_down[to];
+  uint32_t xfade = _fadeFrames();
+  _fadeOutAll(xfade);
+  if (*via)
+    _add(via, false, xfade, &_notches[to]);
+  else
+    _add(&_notches[to], true, xfade);
+  _notch = to;
+  _notchSince = millis();
+}
+
+void EngineSound::_add(const Clip *clip, bool loop, uint32_t fadeLen,
+                       const Clip *then) {
+  // A free slot, else the layer that is furthest into its fade-out
+  Layer *slot = &_layers[0];
+  uint32_t best = 0;
+  for (Layer &layer : _layers) {
+    if (!layer.clip) {
+      slot = &layer;
+      break;
+    }
+    if (!layer.fadeIn && layer.fadeLen > 0 && layer.fadePos >= best) {
+      best = layer.fadePos;
+      slot = &layer;
+    }
+  }
+  *slot = Layer();
+  slot->clip = clip;
+  slot->loop = loop;
+  slot->fadeLen = fadeLen;
+  slot->fadeIn = fadeLen > 0;
+  slot->then = then;
+}
+
+void EngineSound::_fadeOut(Layer &layer, uint32_t fadeLen) {
+  // Start from the layer's current gain so a fade-in cut short never jumps
+  float g = _gain(layer, layer.fadePos) / 32768.0f;
+  layer.fadeIn = false;
+  layer.fadeLen = fadeLen;
+  layer.fadePos = (uint32_t)(acosf(std::min(g, 1.0f)) / HALF_PI_F * fadeLen);
+  layer.then = nullptr;
+}
+
+void EngineSound::_fadeOutAll(uint32_t fadeLen) {
+  for (Layer &layer : _layers) {
+    if (layer.clip && (layer.fadeIn || layer.fadeLen == 0))
+      _fadeOut(layer, fadeLen);
+  }
+}
+
+bool EngineSound::_settled() const {
+  for (const Layer &layer : _layers) {
+    if (layer.clip && (!layer.loop || layer.fadeLen > 0))
+      return false;
+  }
+  return true;
+}
+
+uint32_t EngineSound::_fadeFrames() const {
+  return std::max<uint32_t>(1, (uint32_t)_crossfadeMs * _outRate / 1000);
+}
+
+int32_t EngineSound::_gain(const Layer &layer, uint32_t at) {
+  if (layer.fadeLen == 0)
+    return 32768;
+  float t = std::min(at, layer.fadeLen) / (float)layer.fadeLen;
+  float g = layer.fadeIn ? sinf(t * HALF_PI_F) : cosf(t * HALF_PI_F);
+  return (int32_t)(g * 32768.0f);
+}
+
+void EngineSound::mix(int32_t *acc, size_t frames, uint32_t outRate) {
+  _outRate = outRate;
+  uint32_t xfade = _fadeFrames();
+
+  // A one-shot hands over to its loop so that the crossfade ends exactly as
+  // the one-shot runs out
+  for (Layer &layer : _layers) {
+    if (!layer.clip || !layer.then)
+      continue;
+    const Clip &c = *layer.clip;
+    uint32_t left = (uint64_t)(c.frames - layer.pos) * outRate / c.rate;
+    if (left > xfade)
+      continue;
+    const Clip *next = layer.then;
+    _fadeOut(layer, std::max<uint32_t>(left, 1));
+    _add(next, true, layer.fadeLen);
+  }
+
+  for (Layer &layer : _layers) {
+    if (!layer.clip)
+      continue;
+    const Clip &c = *layer.clip;
+    const uint32_t step = ((uint64_t)c.rate << 16) / outRate;
+
+    // Gain ramps linearly across the block between exact curve points
+    int32_t g = _gain(layer, layer.fadePos);
+    int32_t dg = (_gain(layer, layer.fadePos + frames) - g) / (int32_t)frames;
+    uint32_t pos = layer.pos, phase = layer.phase;
+    bool ended = false;
+    for (size_t i = 0; i < frames; i++, g += dg) {
+      uint32_t next = pos + 1;
+      if (next >= c.frames)
+        next = layer.loop ? 0 : pos;
+      int32_t s0 = c.pcm[pos];
+      int32_t s1 = c.pcm[next];
+      int32_t s = s0 + (((s1 - s0) * (int32_t)(phase >> 2)) >> 14);
+      acc[i] += (s * g) >> 15;
+      phase += step;
+      pos += phase >> 16;
+      phase &= 0xFFFF;
+      if (pos >= c.frames) {
+        if (!layer.loop) {
+          ended = true;
+          break;
+        }
+        pos %= c.frames;
+      }
+    }
+    layer.pos = pos;
+    layer.phase = phase;
+
+    if (layer.fadeLen > 0) {
+      layer.fadePos += frames;
+      if (layer.fadePos >= layer.fadeLen) {
+        if (layer.fadeIn)
+          layer.fadeLen = 0;
+        else
+          ended = true;
+      }
+    }
+    if (ended)
+      layer = Layer();
+  }
+
+  if (_state == State::STOPPING && !active())
+    _state = State::OFF;
+}
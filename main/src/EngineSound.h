@@ -0,0 +1,117 @@
+#ifndef ENGINE_SOUND_H
+#define ENGINE_SOUND_H
+
+#include "SoundAsset.h"
+#include <Arduino.h>
+
+/**
+ * @brief Prime mover for DIESEL assets: one loop per throttle notch, optional
+ * rev-up/rev-down transition samples, and start/shutdown one-shots.
+ *
+ * Every layer is decoded to mono PCM16 in RAM when the asset is loaded, so a
+ * notch change only moves cursors and gains and never touches the file
+ * system. The mixer calls mix() each block. Layers are joined by equal-power
+ * (sin/cos) crossfades, so the level holds steady while the notch changes.
+ *
+ * update() picks the notch from the motor: speed after momentum sets the base
+ * notch, motor load adds notches, and the engine runs one notch ahead of the
+ * train while it accelerates (one behind while it slows). The notch moves one
+ * step at a time, and not more often than the notch time allows.
+ */
+class EngineSound {
+public:
+  static constexpr uint8_t MAX_NOTCHES = 9; // Idle + run 1-8
+  static constexpr uint8_t MAX_LAYERS = 4;
+  static constexpr uint16_t DEFAULT_CROSSFADE_MS = 250;
+
+  EngineSound() {}
+  ~EngineSound() { unload(); }
+  EngineSound(const EngineSound &) = delete;
+  EngineSound &operator=(const EngineSound &) = delete;
+
+  /**
+   * @brief Decodes every layer of a DIESEL asset into RAM.
+   * @return false if the idle loop, or any notch loop, could not be loaded.
+   */
+  bool load(const SoundAsset &asset);
+  void unload();
+  bool loaded() const { return _notchCount > 0; }
+  uint8_t assetId() const { return _assetId; }
+
+  void start();   // Startup one-shot into idle
+  void release(); // Shutdown one-shot, then silence
+  void stop();    // Immediate silence
+
+  /**
+   * @brief Follows the motor. Call at control rate.
+   * @param speed Commanded speed (0-255).
+   * @param momentum Speed after momentum (0-255).
+   * @param load Motor load, 0 = free running, 1 = near stall.
+   * @param notchTimeMs Minimum time on each notch.
+   * @param loadNotches Notches added at full load.
+   */
+  void update(uint8_t speed, float momentum, float load, uint32_t notchTimeMs,
+              uint8_t loadNotches);
+
+  /**
+   * @brief Adds @p frames samples into @p acc at @p outRate.
+   */
+  void mix(int32_t *acc, size_t frames, uint32_t outRate);
+
+  bool active() const;
+  bool running() const { return _state == State::RUNNING; }
+  uint8_t notch() const { return _notch; }
+  uint8_t notchCount() const { return _notchCount; }
+  size_t preloadBytes() const { return _bytes; }
+
+private:
+  struct Clip {
+    int16_t *pcm = nullptr;
+    uint32_t frames = 0;
+    uint32_t rate = 0;
+    explicit operator bool() const { return frames > 0; }
+  };
+
+  struct Layer {
+    const Clip *clip = nullptr;
+    bool loop = false;
+    uint32_t pos = 0;
+    uint32_t phase = 0;   // 16.16 fraction of a source frame
+    uint32_t fadeLen = 0; // Output frames, 0 = steady
+    uint32_t fadePos = 0;
+    bool fadeIn = false;
+    // Loop crossfaded in as this one-shot runs out
+    const Clip *then = nullptr;
+  };
+
+  enum class State : uint8_t { OFF, RUNNING, STOPPING };
+
+  bool _loadClip(const String &path, Clip &clip);
+  void _freeClip(Clip &clip);
+  void _step(uint8_t to);
+  void _add(const Clip *clip, bool loop, uint32_t fadeLen,
+            const Clip *then = nullptr);
+  void _fadeOut(Layer &layer, uint32_t fadeLen);
+  void _fadeOutAll(uint32_t fadeLen);
+  bool _settled() const;
+  uint32_t _fadeFrames() const;
+  static int32_t _gain(const Layer &layer, uint32_t at);
+
+  Clip _start;
+  Clip _shutdown;
+  Clip _notches[MAX_NOTCHES];
+  Clip _up[MAX_NOTCHES - 1];   // _up[i]: notch i -> i + 1
+  Clip _down[MAX_NOTCHES - 1]; // _down[i]: notch i + 1 -> i
+  uint8_t _notchCount = 0;
+  uint8_t _assetId = 0;
+  uint16_t _crossfadeMs = DEFAULT_CROSSFADE_MS;
+  size_t _bytes = 0;
+
+  Layer _layers[MAX_LAYERS];
+  State _state = State::OFF;
+  uint8_t _notch = 0;
+  unsigned long _notchSince = 0;
+  uint32_t _outRate = 44100; // Rate of the last mix(), for fade lengths
+};
+
+#endif
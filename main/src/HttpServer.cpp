@@ -0,0 +1,893 @@
+#include "HttpServer.h"
+#include "Logger.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <cstring>
+#include <esp_heap_caps.h>
+#include <mbedtls/base64.h>
+
+thread_local HttpServer::Request *HttpServer::_current = nullptr;
+
+namespace {
+constexpr size_t STREAM_CHUNK = 4096; // One LittleFS block per send
+constexpr size_t JSON_CHUNK = 1024;   // Serialized JSON per chunk
+
+// Print onto the connection as chunked transfer encoding, a fixed buffer
+// at a time, so a reply never exists whole in RAM
+class ChunkWriter : public Print {
+public:
+  explicit ChunkWriter(httpd_req_t *req) : _req(req) {}
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *data, size_t len) override {
+    for (size_t done = 0; done < len && _ok;) {
+      size_t n = std::min(len - done, sizeof(_buf) - _len);
+      memcpy(_buf + _len, data + done, n);
+      _len += n;
+      done += n;
+      if (_len == sizeof(_buf))
+        _flush();
+    }
+    return _ok ? len : 0;
+  }
+
+  bool finish() {
+    _flush();
+    return _ok && httpd_resp_send_chunk(_req, nullptr, 0) == ESP_OK;
+  }
+
+private:
+  void _flush() {
+    if (_len > 0 && _ok)
+      _ok = httpd_resp_send_chunk(_req, _buf, _len) == ESP_OK;
+    _len = 0;
+  }
+
+  httpd_req_t *_req;
+  char _buf[JSON_CHUNK];
+  size_t _len = 0;
+  bool _ok = true; // Cleared when the client goes away
+};
+
+const char *statusLine(int code) {
+  switch (code) {
+  case 200:
+    return "200 OK";
+  case 304:
+    return "304 Not Modified";
+  case 400:
+    return "400 Bad Request";
+  case 401:
+    return "401 Unauthorized";
+  case 404:
+    return "404 Not Found";
+  case 405:
+    return "405 Method Not Allowed";
+  case 413:
+    return "413 Payload Too Large";
+  case 503:
+    return "503 Service Unavailable";
+  default:
+    return code < 400 ? "200 OK" : "500 Internal Server Error";
+  }
+}
+
+// Receives up to @p len bytes, riding out a few receive timeouts
+int receive(httpd_req_t *req, char *buf, size_t len) {
+  for (int tries = 0; tries < 3; tries++) {
+    int n = httpd_req_recv(req, buf, len);
+    if (n != HTTPD_SOCK_ERR_TIMEOUT)
+      return n;
+  }
+  return -1;
+}
+
+bool sendAll(httpd_req_t *req, const char *buf, size_t len) {
+  while (len > 0) {
+    int n = httpd_send(req, buf, len);
+    if (n <= 0)
+      return false;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+String urlDecode(const char *s, size_t len) {
+  String out;
+  out.reserve(len);
+  for (size_t i = 0; i < len; i++) {
+    if (s[i] == '+') {
+      out += ' ';
+    } else if (s[i] == '%' && i + 2 < len && isxdigit(s[i + 1]) &&
+               isxdigit(s[i + 2])) {
+      char hex[3] = {s[i + 1], s[i + 2], 0};
+      out += (char)strtol(hex, nullptr, 16);
+      i += 2;
+    } else {
+      out += s[i];
+    }
+  }
+  return out;
+}
+
+// Value of @p key="..." in a Content-Disposition line
+String dispositionParam(const String &line, const char *key) {
+  String needle = String(" ") + key + "=\"";
+  int at = line.indexOf(needle);
+  if (at < 0)
+    return String();
+  at += needle.length();
+  int end = line.indexOf('"', at);
+  return end < 0 ? String() : line.substring(at, end);
+}
+
+// Buffered reader over a request body, for the multipart parser
+class BodyReader {
+public:
+  static constexpr size_t SIZE = 2048; // A part's chunk plus a boundary
+
+  explicit BodyReader(httpd_req_t *req)
+      : _req(req), _left(req->content_len), _buf((uint8_t *)malloc(SIZE)) {}
+  ~BodyReader() { free(_buf); }
+
+  bool ok() const { return _buf && !_failed; }
+
+  // Buffers at least @p n bytes, unless the body ends first
+  size_t fill(size_t n) {
+    n = std::min(n, SIZE);
+    if (_start > 0) {
+      memmove(_buf, _buf + _start, _end - _start);
+      _end -= _start;
+      _start = 0;
+    }
+    while (_end < n && _left > 0 && !_failed) {
+      int got = receive(_req, (char *)_buf + _end,
+                        std::min(SIZE - _end, _left));
+      if (got <= 0) {
+        _failed = true;
+        break;
+      }
+      _end += got;
+      _left -= got;
+    }
+    return size();
+  }
+
+  const uint8_t *data() const { return _buf + _start; }
+  size_t size() const { return _end - _start; }
+  void skip(size_t n) { _start += n; }
+
+  // Offset of @p s in the buffered bytes, or -1
+  int find(const String &s) const {
+    const uint8_t *needle = (const uint8_t *)s.c_str();
+    const uint8_t *at = std::search(data(), data() + size(), needle,
+                                    needle + s.length());
+    return at == data() + size() ? -1 : at - data();
+  }
+
+private:
+  httpd_req_t *_req;
+  size_t _left;
+  uint8_t *_buf;
+  size_t _start = 0;
+  size_t _end = 0;
+  bool _failed = false;
+};
+} // namespace
+
+HttpServer::HttpServer(uint16_t port) : _port(port) {
+  _mutex = xSemaphoreCreateMutex();
+}
+
+HttpServer::Route *HttpServer::_add(const char *uri, HTTPMethod method,
+                                    Handler handler, Handler upload,
+                                    uint32_t stack) {
+  Route *route = new Route();
+  route->server = this;
+  route->uri = uri;
+  route->method = method;
+  route->handler = handler;
+  route->upload = upload;
+  route->stack = stack;
+  return route;
+}
+
+void HttpServer::on(const char *uri, HTTPMethod method, Handler handler) {
+  _routes.push_back(_add(uri, method, handler, nullptr, 0));
+}
+
+void HttpServer::on(const char *uri, Handler handler) {
+  on(uri, HTTP_GET, handler);
+  on(uri, HTTP_POST, handler);
+}
+
+void HttpServer::on(const char *uri, HTTPMethod method, Handler handler,
+                    Handler upload, uint32_t stack) {
+  _routes.push_back(_add(uri, method, handler, upload, stack));
+}
+
+void HttpServer::onNotFound(Handler handler, uint32_t stack) {
+  _notFound = _add("/*", HTTP_GET, handler, nullptr, stack);
+}
+
+void HttpServer::onWebSocket(const char *uri, WsOpen onOpen, WsText onText) {
+  _wsRoutes.push_back(new WsRoute{this, uri, onOpen, onText});
+}
+
+void HttpServer::begin() {
+  _loopTask = xTaskGetCurrentTaskHandle();
+  _loopCalls = xQueueCreate(4, sizeof(LoopCall));
+  _arenas.push_back(new RequestArena(ARENA)); // For the server task
+  // The catch-all matches anything, so it goes last
+  if (_notFound)
+    _routes.push_back(_notFound);
+
+  for (Route *route : _routes)
+    _workerStack = std::max(_workerStack, route->stack);
+  if (_workerStack > 0) {
+    _jobs = xQueueCreate(QUEUE, sizeof(Job));
+    for (uint8_t i = 0; i < WORKERS; i++) {
+      xTaskCreatePinnedToCore(_workerEntry, "HttpWorker", _workerStack, this,
+                              1, // Below the prefetcher: audio reads first
+                              NULL,
+                              0 // Core 0, away from the audio render loop
+      );
+    }
+  }
+
+  httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  config.server_port = _port;
+  config.stack_size = SERVER_STACK;
+  config.task_priority = 3; // Below the control plane, above the prefetcher
+  config.core_id = 0;
+  config.max_open_sockets = MAX_SOCKETS;
+  config.max_uri_handlers = _routes.size() + _wsRoutes.size();
+  config.lru_purge_enable = true; // A new client closes the longest idle one
+  config.uri_match_fn = httpd_uri_match_wildcard;
+  if (httpd_start(&_handle, &config) != ESP_OK) {
+    Log.println("HttpServer: Failed to start");
+    _handle = nullptr;
+    return;
+  }
+  // Before the routes, as the catch-all would take their handshakes
+  for (WsRoute *route : _wsRoutes) {
+    httpd_uri_t uri = {};
+    uri.uri = route->uri.c_str();
+    uri.method = HTTP_GET;
+    uri.handler = _onWebSocket;
+    uri.user_ctx = route;
+    uri.is_websocket = true;
+    httpd_register_uri_handler(_handle, &uri);
+  }
+  for (Route *route : _routes) {
+    httpd_uri_t uri = {};
+    uri.uri = route->uri.c_str();
+    uri.method = route->method;
+    uri.handler = _onRequest;
+    uri.user_ctx = route;
+    httpd_register_uri_handler(_handle, &uri);
+  }
+}
+
+esp_err_t HttpServer::_onRequest(httpd_req_t *req) {
+  Route &route = *(Route *)req->user_ctx;
+  HttpServer &self = *route.server;
+  uint32_t now = micros();
+  if (route.stack == 0) {
+    self._run(req, route, now, SERVER_STACK, *self._arenas[0]);
+    return ESP_OK;
+  }
+
+  // Only the server task queues jobs, so the space checked here stays free
+  self._lock();
+  bool busy = uxQueueSpacesAvailable(self._jobs) == 0 ||
+              (route.upload && self._uploading);
+  if (busy)
+    self._rejected++;
+  else if (route.upload)
+    self._uploading = true;
+  self._unlock();
+  if (busy) {
+    httpd_resp_set_status(req, statusLine(503));
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    httpd_resp_sendstr(req, "Busy, try again");
+    return ESP_OK;
+  }
+
+  // The worker owns the socket from here; the server goes back to the rest
+  Job job = {nullptr, &route, now};
+  if (httpd_req_async_handler_begin(req, &job.req) != ESP_OK) {
+    self._lock();
+    if (route.upload)
+      self._uploading = false;
+    self._unlock();
+    return ESP_FAIL;
+  }
+  xQueueSend(self._jobs, &job, 0);
+  return ESP_OK;
+}
+
+void HttpServer::_workerEntry(void *param) {
+  HttpServer *self = (HttpServer *)param;
+  RequestArena arena(WORKER_ARENA);
+  self->_lock();
+  self->_arenas.push_back(&arena);
+  self->_unlock();
+  Job job;
+  for (;;) {
+    if (xQueueReceive(self->_jobs, &job, portMAX_DELAY) != pdTRUE)
+      continue;
+    self->_lock();
+    self->_busyWorkers++;
+    self->_unlock();
+
+    self->_run(job.req, *job.route, job.queuedAt, self->_workerStack,
+               arena);
+    httpd_req_async_handler_complete(job.req);
+
+    self->_lock();
+    self->_busyWorkers--;
+    if (job.route->upload)
+      self->_uploading = false;
+    self->_unlock();
+  }
+}
+
+void HttpServer::_run(httpd_req_t *req, Route &route, uint32_t startedAt,
+                      uint32_t taskStack, RequestArena &arena) {
+  UBaseType_t freeBefore = uxTaskGetStackHighWaterMark(NULL);
+  // The heap low-water mark is global: watched while any request runs
+  _lock();
+  if (_running++ == 0)
+    heap_caps_monitor_local_minimum_free_size_start();
+  _unlock();
+  size_t heapBefore = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+  Request r;
+  r.req = req;
+  r.route = &route;
+  r.arena = &arena;
+  _current = &r;
+
+  _parseQuery(r);
+
+  String type = header("Content-Type");
+  int at = type.indexOf("boundary=");
+  bool ok;
+  if (route.upload && type.startsWith("multipart/form-data") && at >= 0) {
+    String boundary = type.substring(at + 9);
+    boundary.trim();
+    boundary.replace("\"", "");
+    ok = _receiveMultipart(r, boundary);
+  } else {
+    ok = _receiveBody(r);
+  }
+  type = String();
+
+  if (ok) {
+    TraceScope trace(TRACE_HTTP, route.uri.c_str(), route.method);
+    route.handler();
+  }
+  if (!r.sent)
+    send(500, "text/plain", "No response");
+  UBaseType_t freeAfter = uxTaskGetStackHighWaterMark(NULL);
+  _current = nullptr;
+  delete r.upload;
+  arena.deallocate(r.body); // Only matters if it spilled onto the heap
+  arena.reset();
+
+  uint32_t took = micros() - startedAt;
+  _lock();
+  size_t heapLow = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+  if (--_running == 0)
+    heap_caps_monitor_local_minimum_free_size_stop();
+  _requests++;
+  route.hits++;
+  route.totalUs += took;
+  route.maxUs = std::max(route.maxUs, took);
+  // Overlapping requests share the mark, so this is an upper bound
+  if (heapLow < heapBefore)
+    route.heapPeak =
+        std::max(route.heapPeak, (uint32_t)(heapBefore - heapLow));
+  // The high-water mark is per task, so a route is only measured when it
+  // goes deeper than anything before it on that task
+  uint32_t used = freeAfter < freeBefore ? taskStack - freeAfter : 0;
+  // Logged the first time a route goes over its budget
+  bool over = route.stack > 0 && used > route.stack &&
+              route.stackPeak <= route.stack;
+  route.stackPeak = std::max(route.stackPeak, used);
+  _unlock();
+  if (over)
+    Log.printf("HttpServer: %s used %lu bytes of stack, budget %lu\n",
+               route.uri.c_str(), (unsigned long)used,
+               (unsigned long)route.stack);
+}
+
+esp_err_t HttpServer::_onWebSocket(httpd_req_t *req) {
+  WsRoute &route = *(WsRoute *)req->user_ctx;
+  HttpServer &self = *route.server;
+  int fd = httpd_req_to_sockfd(req);
+
+  if (req->method == HTTP_GET) {
+    // The handshake, already answered; the handler only decides to keep it
+    Request r;
+    r.req = req;
+    r.route = nullptr;
+    r.arena = self._arenas[0];
+    r.sent = true; // Nothing more can be sent as HTTP
+    _current = &r;
+    self._parseQuery(r);
+    bool keep = route.onOpen(fd);
+    _current = nullptr;
+    r.arena->reset();
+    return keep ? ESP_OK : ESP_FAIL;
+  }
+
+  httpd_ws_frame_t frame = {};
+  if (httpd_ws_recv_frame(req, &frame, 0) != ESP_OK)
+    return ESP_FAIL;
+  if (frame.len > WS_MAX_TEXT)
+    return ESP_FAIL; // Nothing we take is that long
+  char text[WS_MAX_TEXT + 1];
+  frame.payload = (uint8_t *)text;
+  if (frame.len > 0 && httpd_ws_recv_frame(req, &frame, frame.len) != ESP_OK)
+    return ESP_FAIL;
+  text[frame.len] = 0;
+  if (frame.type == HTTPD_WS_TYPE_TEXT)
+    route.onText(fd, text, frame.len);
+  return ESP_OK;
+}
+
+void HttpServer::_wsSendWork(void *arg) {
+  WsSend &job = *(WsSend *)arg;
+  httpd_ws_frame_t frame = {};
+  frame.final = true;
+  frame.type = HTTPD_WS_TYPE_BINARY;
+  frame.payload = (uint8_t *)job.data;
+  frame.len = job.len;
+  httpd_handle_t handle = job.server->_handle;
+  job.result = httpd_ws_get_fd_info(handle, job.fd) == HTTPD_WS_CLIENT_WEBSOCKET
+                   ? httpd_ws_send_frame_async(handle, job.fd, &frame)
+                   : ESP_FAIL;
+  xTaskNotifyGive(job.caller);
+}
+
+bool HttpServer::sendBinary(int fd, const uint8_t *data, size_t len) {
+  if (!_handle)
+    return false;
+  WsSend job = {this, fd, data, len, xTaskGetCurrentTaskHandle(), ESP_FAIL};
+  if (httpd_queue_work(_handle, _wsSendWork, &job) != ESP_OK)
+    return false;
+  // The job lives on this stack, so wait for it however long it takes
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  return job.result == ESP_OK;
+}
+
+void HttpServer::_parseQuery(Request &r) {
+  size_t len = httpd_req_get_url_query_len(r.req);
+  if (len == 0)
+    return;
+  std::vector<char> query(len + 1);
+  if (httpd_req_get_url_query_str(r.req, query.data(), query.size()) ==
+      ESP_OK)
+    _parseArgs(r, query.data(), len);
+}
+
+bool HttpServer::_receiveBody(Request &r) {
+  size_t len = r.req->content_len;
+  if (len == 0)
+    return true;
+  if (len > MAX_BODY) {
+    send(413, "text/plain", "Body too large");
+    return false;
+  }
+  // Received straight into the arena; handlers parse it where it lies
+  r.body = (char *)r.arena->allocate(len + 1);
+  if (!r.body) {
+    send(500, "text/plain", "Out of memory");
+    return false;
+  }
+  for (size_t got = 0; got < len;) {
+    int n = receive(r.req, r.body + got, len - got);
+    if (n <= 0) {
+      r.sent = true; // The socket is gone, there is no one to answer
+      return false;
+    }
+    got += n;
+  }
+  r.body[len] = 0;
+  r.bodyLen = len;
+  if (header("Content-Type").startsWith("application/x-www-form-urlencoded"))
+    _parseArgs(r, r.body, len);
+  else
+    r.plain = true;
+  return true;
+}
+
+bool HttpServer::_receiveMultipart(Request &r, const String &boundary) {
+  BodyReader body(r.req);
+  String open = "--" + boundary;      // Before the first part
+  String delim = "\r\n--" + boundary; // After every part
+  if (!body.ok() || delim.length() > 100) {
+    send(400, "text/plain", "Bad multipart body");
+    return false;
+  }
+
+  // Skip the preamble
+  for (;;) {
+    body.fill(BodyReader::SIZE);
+    int at = body.find(open);
+    if (at >= 0) {
+      body.skip(at + open.length());
+      break;
+    }
+    if (body.size() < open.length()) {
+      send(400, "text/plain", "Bad multipart body");
+      return false;
+    }
+    body.skip(body.size() - open.length() + 1);
+  }
+
+  for (;;) {
+    // After a boundary, "--" ends the body and CRLF starts a part
+    if (body.fill(2) < 2)
+      break;
+    if (memcmp(body.data(), "--", 2) == 0)
+      return true;
+    if (memcmp(body.data(), "\r\n", 2) != 0)
+      break;
+    body.skip(2);
+
+    String name, filename, type;
+    bool headers = true;
+    while (headers) {
+      body.fill(BodyReader::SIZE);
+      int eol = body.find("\r\n");
+      if (eol < 0) {
+        send(400, "text/plain", "Bad multipart body");
+        return false;
+      }
+      String line;
+      line.concat((const char *)body.data(), eol);
+      body.skip(eol + 2);
+      headers = line.length() > 0;
+      String lower = line;
+      lower.toLowerCase();
+      if (lower.startsWith("content-disposition:")) {
+        name = dispositionParam(line, "name");
+        filename = dispositionParam(line, "filename");
+      } else if (lower.startsWith("content-type:")) {
+        type = line.substring(13);
+        type.trim();
+      }
+    }
+
+    HTTPUpload *up = nullptr;
+    if (filename.length() > 0) {
+      if (!r.upload)
+        r.upload = new HTTPUpload();
+      up = r.upload;
+      up->status = UPLOAD_FILE_START;
+      up->filename = filename;
+      up->name = name;
+      up->type = type;
+      up->totalSize = 0;
+      up->currentSize = 0;
+      r.route->upload();
+    }
+
+    // Part data runs up to the next delimiter, which may straddle reads:
+    // only bytes that cannot be the start of one are handed on
+    String value;
+    bool ended = false;
+    while (!ended) {
+      body.fill(BodyReader::SIZE);
+      int at = body.find(delim);
+      size_t n = at;
+      if (at < 0)
+        n = body.size() >= delim.length() ? body.size() - delim.length() + 1
+                                          : 0;
+      if (at < 0 && n == 0) {
+        if (up) {
+          up->status = UPLOAD_FILE_ABORTED;
+          r.route->upload();
+        }
+        send(400, "text/plain", "Upload cut short");
+        return false;
+      }
+      while (n > 0) {
+        size_t chunk = std::min(n, HTTP_UPLOAD_BUFLEN);
+        if (up) {
+          memcpy(up->buf, body.data(), chunk);
+          up->currentSize = chunk;
+          up->totalSize += chunk;
+          up->status = UPLOAD_FILE_WRITE;
+          r.route->upload();
+        } else if (value.length() + chunk <= MAX_BODY) {
+          value.concat((const char *)body.data(), chunk);
+        }
+        body.skip(chunk);
+        n -= chunk;
+      }
+      if (at >= 0) {
+        body.skip(delim.length());
+        ended = true;
+      }
+    }
+
+    if (up) {
+      up->status = UPLOAD_FILE_END;
+      up->currentSize = 0;
+      r.route->upload();
+    } else if (name.length() > 0) {
+      r.args.push_back({name, value});
+    }
+  }
+  send(400, "text/plain", "Bad multipart body");
+  return false;
+}
+
+void HttpServer::_parseArgs(Request &r, const char *query, size_t len) {
+  size_t start = 0;
+  while (start < len) {
+    const char *amp = (const char *)memchr(query + start, '&', len - start);
+    size_t end = amp ? amp - query : len;
+    const char *eq = (const char *)memchr(query + start, '=', end - start);
+    size_t keyEnd = eq ? eq - query : end;
+    if (keyEnd > start) {
+      String key = urlDecode(query + start, keyEnd - start);
+      String value = eq ? urlDecode(eq + 1, end - keyEnd - 1) : String();
+      r.args.push_back({key, value});
+    }
+    start = end + 1;
+  }
+}
+
+void HttpServer::runInLoop(const Handler &fn) {
+  if (!_loopCalls || xTaskGetCurrentTaskHandle() == _loopTask) {
+    fn();
+    return;
+  }
+  LoopCall call = {&fn, xTaskGetCurrentTaskHandle()};
+  xQueueSend(_loopCalls, &call, portMAX_DELAY);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+void HttpServer::poll() {
+  LoopCall call;
+  while (_loopCalls && xQueueReceive(_loopCalls, &call, 0) == pdTRUE) {
+    (*call.fn)();
+    xTaskNotifyGive(call.caller);
+  }
+}
+
+HTTPMethod HttpServer::method() {
+  return _current ? (HTTPMethod)_current->req->method : HTTP_GET;
+}
+
+String HttpServer::uri() {
+  if (!_current)
+    return String();
+  const char *full = _current->req->uri;
+  const char *query = strchr(full, '?');
+  return urlDecode(full, query ? query - full : strlen(full));
+}
+
+bool HttpServer::hasArg(const String &name) {
+  if (!_current)
+    return false;
+  if (_current->plain && name == "plain")
+    return true;
+  for (const auto &arg : _current->args) {
+    if (arg.first == name)
+      return true;
+  }
+  return false;
+}
+
+String HttpServer::arg(const String &name) {
+  if (!_current)
+    return String();
+  if (_current->plain && name == "plain")
+    return String(_current->body);
+  for (const auto &arg : _current->args) {
+    if (arg.first == name)
+      return arg.second;
+  }
+  return String();
+}
+
+String HttpServer::header(const char *name) {
+  if (!_current)
+    return String();
+  size_t len = httpd_req_get_hdr_value_len(_current->req, name);
+  if (len == 0)
+    return String();
+  std::vector<char> value(len + 1);
+  if (httpd_req_get_hdr_value_str(_current->req, name, value.data(),
+                                  value.size()) != ESP_OK)
+    return String();
+  return String(value.data());
+}
+
+HTTPUpload &HttpServer::upload() {
+  static HTTPUpload none = {};
+  return _current && _current->upload ? *_current->upload : none;
+}
+
+const char *HttpServer::body() {
+  return _current && _current->body ? _current->body : "";
+}
+
+size_t HttpServer::bodyLength() { return _current ? _current->bodyLen : 0; }
+
+ArduinoJson::Allocator *HttpServer::allocator() {
+  static RequestArena heap(0); // Outside a request: plain heap
+  return _current ? _current->arena : &heap;
+}
+
+bool HttpServer::authenticate(const char *user, const char *pass) {
+  String auth = header("Authorization");
+  if (!auth.startsWith("Basic "))
+    return false;
+  String plain = String(user) + ":" + pass;
+  unsigned char expected[96];
+  size_t len = 0;
+  if (mbedtls_base64_encode(expected, sizeof(expected) - 1, &len,
+                            (const unsigned char *)plain.c_str(),
+                            plain.length()) != 0)
+    return false;
+  expected[len] = 0;
+  return auth.substring(6) == (const char *)expected;
+}
+
+void HttpServer::requestAuthentication() {
+  if (!_current || _current->sent)
+    return;
+  sendHeader("WWW-Authenticate", "Basic realm=\"Login Required\"");
+  send(401, "text/plain", "401 Unauthorized");
+}
+
+void HttpServer::send(int code, const char *contentType,
+                      const String &content) {
+  send(code, contentType, content.c_str());
+}
+
+void HttpServer::_begin(int code, const char *contentType) {
+  _current->sent = true;
+  httpd_resp_set_status(_current->req, statusLine(code));
+  httpd_resp_set_type(_current->req, contentType);
+  // The strings live in the Request until the handler returns
+  for (const auto &h : _current->headers)
+    httpd_resp_set_hdr(_current->req, h.first.c_str(), h.second.c_str());
+}
+
+void HttpServer::send(int code, const char *contentType, const char *content) {
+  if (!_current || _current->sent)
+    return;
+  _begin(code, contentType);
+  httpd_resp_send(_current->req, content, HTTPD_RESP_USE_STRLEN);
+}
+
+void HttpServer::send_P(int code, const char *contentType,
+                        const char *content) {
+  send(code, contentType, content);
+}
+
+void HttpServer::send_P(int code, const char *contentType, const char *content,
+                        size_t length) {
+  if (!_current || _current->sent)
+    return;
+  _begin(code, contentType);
+  httpd_resp_send(_current->req, content, length);
+}
+
+void HttpServer::sendJson(int code, const JsonDocument &doc) {
+  if (!_current || _current->sent)
+    return;
+  _begin(code, "application/json");
+  ChunkWriter out(_current->req);
+  serializeJson(doc, out);
+  out.finish();
+}
+
+void HttpServer::sendStream(int code, const char *contentType,
+                            const std::function<void(Print &out)> &fill) {
+  if (!_current || _current->sent)
+    return;
+  _begin(code, contentType);
+  ChunkWriter out(_current->req);
+  fill(out);
+  out.finish();
+}
+
+void HttpServer::sendHeader(const char *name, const String &value) {
+  if (_current && !_current->sent)
+    _current->headers.emplace_back(name, value);
+}
+
+void HttpServer::streamFile(File &file, const String &contentType) {
+  if (!_current || _current->sent)
+    return;
+  uint8_t *buf = (uint8_t *)malloc(STREAM_CHUNK);
+  if (!buf) {
+    send(500, "text/plain", "Out of memory");
+    return;
+  }
+  _current->sent = true;
+
+  // Written by hand to give the length, as the Arduino server did; a
+  // chunked reply would hide the size from players and progress bars
+  String head = "HTTP/1.1 200 OK\r\nContent-Type: " + contentType +
+                "\r\nContent-Length: " + String((unsigned long)file.size()) +
+                "\r\n";
+  for (const auto &h : _current->headers)
+    head += h.first + ": " + h.second + "\r\n";
+  head += "\r\n";
+  bool ok = sendAll(_current->req, head.c_str(), head.length());
+  while (ok) {
+    size_t got = file.read(buf, STREAM_CHUNK);
+    if (got == 0)
+      break;
+    ok = sendAll(_current->req, (const char *)buf, got);
+  }
+  free(buf);
+}
+
+bool HttpServer::notModified(const String &etag) {
+  String match = header("If-None-Match");
+  if (match.length() == 0 || (match != "*" && match.indexOf(etag) < 0))
+    return false;
+  sendHeader("ETag", etag);
+  send(304, "text/plain", "");
+  return true;
+}
+
+void HttpServer::serveFile(File &file, const String &contentType) {
+  char etag[32];
+  snprintf(etag, sizeof(etag), "\"%x-%lx\"", (unsigned)file.size(),
+           (unsigned long)file.getLastWrite());
+  if (notModified(etag))
+    return;
+  sendHeader("ETag", etag);
+  streamFile(file, contentType);
+}
+
+void HttpServer::getStatus(JsonObject out) {
+  size_t sockets = MAX_SOCKETS;
+  int fds[MAX_SOCKETS];
+  if (!_handle || httpd_get_client_list(_handle, &sockets, fds) != ESP_OK)
+    sockets = 0;
+  out["sockets"] = sockets;
+  out["max_sockets"] = MAX_SOCKETS;
+  out["workers"] = _jobs ? WORKERS : 0;
+  out["worker_stack"] = _workerStack;
+  _lock();
+  out["busy_workers"] = _busyWorkers;
+  out["queued"] = _jobs ? uxQueueMessagesWaiting(_jobs) : 0;
+  out["requests"] = _requests;
+  out["rejected"] = _rejected;
+  JsonArray arenas = out["arenas"].to<JsonArray>();
+  for (const RequestArena *arena : _arenas) {
+    JsonObject a = arenas.add<JsonObject>();
+    a["capacity"] = arena->capacity();
+    a["peak"] = arena->peak();
+    a["overflows"] = arena->overflows();
+  }
+  JsonArray routes = out["routes"].to<JsonArray>();
+  for (const Route *route : _routes) {
+    if (route->hits == 0)
+      continue;
+    JsonObject r = routes.add<JsonObject>();
+    r["uri"] = route->uri;
+    r["method"] = http_method_str((http_method)route->method);
+    r["hits"] = route->hits;
+    r["avg_us"] = (uint32_t)(route->totalUs / route->hits);
+    r["max_us"] = route->maxUs;
+    r["worker"] = route->stack > 0;
+    r["stack_budget"] = route->stack > 0 ? route->stack : SERVER_STACK;
+    r["stack_peak"] = route->stackPeak;
+    r["heap_peak"] = route->heapPeak;
+  }
+  _unlock();
+}
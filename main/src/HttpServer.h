@@ -0,0 +1,267 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include "RequestArena.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <esp_http_server.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <functional>
+#include <vector>
+
+// Same names as the Arduino WebServer, so handlers read the same
+typedef httpd_method_t HTTPMethod;
+
+enum HTTPUploadStatus {
+  UPLOAD_FILE_START,
+  UPLOAD_FILE_WRITE,
+  UPLOAD_FILE_END,
+  UPLOAD_FILE_ABORTED
+};
+
+static constexpr size_t HTTP_UPLOAD_BUFLEN = 1436; // One TCP segment
+
+// The file part of a multipart/form-data body, as an upload handler sees it
+struct HTTPUpload {
+  HTTPUploadStatus status;
+  String filename;
+  String name; // Form field
+  String type; // Content-Type of the part
+  size_t totalSize;
+  size_t currentSize;
+  uint8_t buf[HTTP_UPLOAD_BUFLEN];
+};
+
+/**
+ * @brief Event-driven web server on esp_http_server, with the request API of
+ * the Arduino WebServer it replaces.
+ *
+ * The server runs on its own task and holds up to MAX_SOCKETS connections
+ * open, keep-alive included; it waits on all of them at once, so an idle or
+ * slow client does not hold up the others. Quick handlers (JSON in, JSON
+ * out) run on the server task itself. A handler registered with a stack
+ * budget streams files or takes uploads: the server hands its request to one
+ * of WORKERS tasks and goes back to the other sockets. Workers get the
+ * largest budget asked for, and each route reports how deep it went.
+ *
+ * arg(), send() and the rest act on the request being handled by the calling
+ * task. Handlers no longer run on the Arduino loop, so anything owned by it
+ * goes through runInLoop().
+ */
+class HttpServer {
+public:
+  typedef std::function<void()> Handler;
+
+  static constexpr uint8_t MAX_SOCKETS = 7; // LWIP has 10; the server uses 3
+  static constexpr uint32_t SERVER_STACK = 8192; // Shared by quick handlers
+  static constexpr uint8_t WORKERS = 2;
+  static constexpr uint8_t QUEUE = 4;           // Requests waiting for one
+  static constexpr size_t MAX_BODY = 16 * 1024; // Held for arg("plain")
+  static constexpr size_t ARENA = 8 * 1024;        // Per quick request
+  static constexpr size_t WORKER_ARENA = 2 * 1024; // Per worker request
+  static constexpr size_t WS_MAX_TEXT = 64;
+
+  explicit HttpServer(uint16_t port);
+
+  /**
+   * @brief Quick handler, run on the server task. Without @p method the
+   * route answers GET and POST.
+   */
+  void on(const char *uri, HTTPMethod method, Handler handler);
+  void on(const char *uri, Handler handler);
+
+  /**
+   * @brief Handler run on a worker with @p stack bytes of budget.
+   * @p upload, if set, is called for each piece of a multipart file part,
+   * before @p handler sends the reply. One upload runs at a time.
+   */
+  void on(const char *uri, HTTPMethod method, Handler handler, Handler upload,
+          uint32_t stack);
+  void onNotFound(Handler handler, uint32_t stack); // Any other GET
+
+  typedef std::function<bool(int fd)> WsOpen;
+  typedef std::function<void(int fd, const char *text, size_t len)> WsText;
+
+  /**
+   * @brief WebSocket endpoint, handled on the server task. @p onOpen sees
+   * the handshake as the current request (arg(), authenticate()) with the
+   * client's socket; returning false closes it. @p onText gets each text
+   * message, up to WS_MAX_TEXT bytes.
+   */
+  void onWebSocket(const char *uri, WsOpen onOpen, WsText onText);
+
+  /**
+   * @brief Sends a binary message to WebSocket client @p fd, from any task
+   * but the server's. The server task writes it, so it never interleaves
+   * with a control frame; the caller waits until it has.
+   * @return false if the client has gone.
+   */
+  bool sendBinary(int fd, const uint8_t *data, size_t len);
+
+  void begin();
+
+  /**
+   * @brief Runs @p fn on the task that called begin() (the Arduino loop),
+   * at its next poll(), and waits for it. Called on that task, runs it now.
+   */
+  void runInLoop(const Handler &fn);
+  void poll(); // From the loop: runs what handlers queued
+
+  // Current request
+  HTTPMethod method();
+  String uri(); // Path, without the query
+  bool hasArg(const String &name);
+  String arg(const String &name);
+  String header(const char *name);
+  HTTPUpload &upload();
+  const char *body(); // Raw body, if not multipart; valid until reply
+  size_t bodyLength();
+
+  /**
+   * @brief Allocator for the handler's JsonDocuments: the request's arena,
+   * emptied once the reply has gone out.
+   */
+  ArduinoJson::Allocator *allocator();
+
+  bool authenticate(const char *user, const char *pass); // HTTP Basic
+  void requestAuthentication();
+
+  void send(int code, const char *contentType, const String &content);
+  void send(int code, const char *contentType, const char *content);
+  void send_P(int code, const char *contentType, const char *content);
+  void send_P(int code, const char *contentType, const char *content,
+              size_t length); // Binary, e.g. gzipped
+  void sendHeader(const char *name, const String &value); // For next send
+
+  /**
+   * @brief Serializes @p doc straight onto the connection, in chunks of
+   * about 1 KB, instead of through a String holding all of it.
+   */
+  void sendJson(int code, const JsonDocument &doc);
+
+  /**
+   * @brief Sends what @p fill prints, chunked the same way; for replies
+   * built on the fly, such as binary captures.
+   */
+  void sendStream(int code, const char *contentType,
+                  const std::function<void(Print &out)> &fill);
+  void streamFile(File &file, const String &contentType);
+
+  /**
+   * @brief Answers 304 if the request's If-None-Match holds @p etag.
+   * @return true if it did, and the handler has nothing more to send.
+   */
+  bool notModified(const String &etag);
+
+  /**
+   * @brief streamFile() with an ETag made of the file's size and write
+   * time, as a file can change without a firmware update; or 304 when the
+   * client already has that version.
+   */
+  void serveFile(File &file, const String &contentType);
+
+  /**
+   * @brief Fills @p out with socket, worker and per-route counters.
+   */
+  void getStatus(JsonObject out);
+
+private:
+  struct Route {
+    HttpServer *server;
+    String uri;
+    HTTPMethod method;
+    Handler handler;
+    Handler upload;
+    uint32_t stack; // 0 = on the server task
+    // Counters
+    uint32_t hits = 0;
+    uint64_t totalUs = 0;
+    uint32_t maxUs = 0;
+    uint32_t stackPeak = 0; // Deepest stack use seen, 0 until measured
+    uint32_t heapPeak = 0;  // Most heap taken while it ran
+  };
+
+  struct Request {
+    httpd_req_t *req;
+    Route *route;
+    std::vector<std::pair<String, String>> args;
+    std::vector<std::pair<String, String>> headers; // Set by sendHeader()
+    HTTPUpload *upload = nullptr;
+    RequestArena *arena;
+    char *body = nullptr; // In the arena
+    size_t bodyLen = 0;
+    bool plain = false; // Body is arg("plain"), not form fields
+    bool sent = false;
+  };
+
+  struct Job {
+    httpd_req_t *req; // Async copy, owned by the worker
+    Route *route;
+    uint32_t queuedAt;
+  };
+
+  struct WsRoute {
+    HttpServer *server;
+    String uri;
+    WsOpen onOpen;
+    WsText onText;
+  };
+
+  struct WsSend {
+    HttpServer *server;
+    int fd;
+    const uint8_t *data;
+    size_t len;
+    TaskHandle_t caller;
+    esp_err_t result;
+  };
+
+  struct LoopCall {
+    const Handler *fn;
+    TaskHandle_t caller;
+  };
+
+  static thread_local Request *_current; // The calling task's request
+
+  Route *_add(const char *uri, HTTPMethod method, Handler handler,
+              Handler upload, uint32_t stack);
+  static esp_err_t _onRequest(httpd_req_t *req);
+  static esp_err_t _onWebSocket(httpd_req_t *req);
+  static void _wsSendWork(void *arg);
+  void _run(httpd_req_t *req, Route &route, uint32_t startedAt,
+            uint32_t taskStack, RequestArena &arena);
+  bool _receiveBody(Request &r);
+  bool _receiveMultipart(Request &r, const String &boundary);
+  void _parseQuery(Request &r);
+  void _parseArgs(Request &r, const char *query, size_t len);
+  void _begin(int code, const char *contentType);
+  static void _workerEntry(void *param);
+
+  void _lock() { xSemaphoreTake(_mutex, portMAX_DELAY); }
+  void _unlock() { xSemaphoreGive(_mutex); }
+
+  uint16_t _port;
+  httpd_handle_t _handle = nullptr;
+  std::vector<Route *> _routes; // Registration order is match order
+  Route *_notFound = nullptr;
+  std::vector<WsRoute *> _wsRoutes;
+  std::vector<RequestArena *> _arenas; // The server task's, then workers'
+  uint32_t _workerStack = 0;
+  QueueHandle_t _jobs = nullptr;
+  QueueHandle_t _loopCalls = nullptr;
+  TaskHandle_t _loopTask = nullptr;
+  SemaphoreHandle_t _mutex;
+  bool _uploading = false;
+  uint8_t _running = 0; // Requests being handled, for the heap monitor
+
+  // Totals since boot
+  uint32_t _requests = 0;
+  uint32_t _rejected = 0; // Answered 503: workers busy or upload running
+  uint8_t _busyWorkers = 0;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "ImaAdpcm.h"
+
+namespace {
+const int16_t STEP_TABLE[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+const int8_t INDEX_TABLE[16] = {-1, -1, -1, -1, 2, 4, 6, 8,
+                                -1, -1, -1, -1, 2, 4, 6, 8};
+
+inline int16_t decodeNibble(ImaAdpcmState &s, uint8_t code) {
+  int32_t step = STEP_TABLE[s.index];
+  int32_t diff = step >> 3;
+  if (code & 4)
+    diff += step;
+  if (code & 2)
+    diff += step >> 1;
+  if (code & 1)
+    diff += step >> 2;
+
+  int32_t pred = s.predictor + ((code & 8) ? -diff : diff);
+  if (pred > 32767)
+    pred = 32767;
+  else if (pred < -32768)
+    pred = -32768;
+  s.predictor = (int16_t)pred;
+
+  int idx = s.index + INDEX_TABLE[code];
+  s.index = (uint8_t)(idx < 0 ? 0 : (idx > 88 ? 88 : idx));
+  return s.predictor;
+}
+
+inline uint8_t encodeSample(ImaAdpcmState &s, int16_t sample) {
+  int32_t step = STEP_TABLE[s.index];
+  int32_t diff = (int32_t)sample - s.predictor;
+  uint8_t code = 0;
+  if (diff < 0) {
+    code = 8;
+    diff = -diff;
+  }
+  if (diff >= step) {
+    code |= 4;
+    diff -= step;
+  }
+  step >>= 1;
+  if (diff >= step) {
+    code |= 2;
+    diff -= step;
+  }
+  step >>= 1;
+  if (diff >= step)
+    code |= 1;
+
+  // Track the decoder exactly so rounding never drifts
+  decodeNibble(s, code);
+  return code;
+}
+} // namespace
+
+size_t imaAdpcmDecodeBlock(const uint8_t *block, size_t blockAlign,
+                           uint8_t channels, int16_t *out) {
+  if (channels == 0 || channels > 2 || blockAlign < 4u * channels)
+    return 0;
+
+  ImaAdpcmState state[2];
+  for (uint8_t c = 0; c < channels; c++) {
+    const uint8_t *h = block + 4 * c;
+    state[c].predictor = (int16_t)(h[0] | (h[1] << 8));
+    state[c].index = h[2] > 88 ? 88 : h[2];
+    out[c] = state[c].predictor;
+  }
+
+  // Body: per channel 4-byte words (8 samples), channels interleaved
+  const uint8_t *p = block + 4 * channels;
+  const uint8_t *end = block + blockAlign;
+  size_t frame = 1;
+  while (p + 4 * channels <= end) {
+    for (uint8_t c = 0; c < channels; c++) {
+      int16_t *dst = out + frame * channels + c;
+      for (uint8_t b = 0; b < 4; b++) {
+        uint8_t byte = *p++;
+        dst[0] = decodeNibble(state[c], byte & 0x0F);
+        dst[channels] = decodeNibble(state[c], byte >> 4);
+        dst += 2 * channels;
+      }
+    }
+    frame += 8;
+  }
+  return frame;
+}
+
+size_t imaAdpcmEncodeBlock(const int16_t *pcm, size_t frames,
+                           uint8_t channels, ImaAdpcmState *state,
+                           uint8_t *out, size_t blockAlign) {
+  size_t blockFrames = imaAdpcmFramesPerBlock(blockAlign, channels);
+  if (blockFrames == 0 || channels > 2 || frames == 0 ||
+      (blockAlign - 4u * channels) % (4u * channels) != 0)
+    return 0;
+
+  auto sampleAt = [&](size_t f, uint8_t c) -> int16_t {
+    if (f >= frames)
+      f = frames - 1;
+    return pcm[f * channels + c];
+  };
+
+  // Header: the first frame is stored verbatim
+  for (uint8_t c = 0; c < channels; c++) {
+    int16_t first = sampleAt(0, c);
+    state[c].predictor = first;
+    uint8_t *h = out + 4 * c;
+    h[0] = (uint8_t)(first & 0xFF);
+    h[1] = (uint8_t)((first >> 8) & 0xFF);
+    h[2] = state[c].index;
+    h[3] = 0;
+  }
+
+  uint8_t *p = out + 4 * channels;
+  for (size_t frame = 1; frame < blockFrames; frame += 8) {
+    for (uint8_t c = 0; c < channels; c++) {
+      for (uint8_t b = 0; b < 4; b++) {
+        uint8_t lo = encodeSample(state[c], sampleAt(frame + 2 * b, c));
+        uint8_t hi = encodeSample(state[c], sampleAt(frame + 2 * b + 1, c));
+        *p++ = (uint8_t)(lo | (hi << 4));
+      }
+    }
+  }
+  return blockAlign;
+}
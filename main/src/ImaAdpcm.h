@@ -0,0 +1,55 @@
+#ifndef IMA_ADPCM_H
+#define IMA_ADPCM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * IMA/DVI ADPCM codec for WAVE_FORMAT_IMA_ADPCM (0x0011) files.
+ *
+ * Each block starts with a 4-byte header per channel (int16 predictor, uint8
+ * step index, reserved byte) followed by 4-bit codes packed in 4-byte words
+ * per channel. Decoding is a table lookup and a few adds per sample, roughly
+ * an order of magnitude cheaper than MP3 at a fixed 4:1 ratio against PCM16.
+ */
+
+struct ImaAdpcmState {
+  int16_t predictor = 0;
+  uint8_t index = 0;
+};
+
+/**
+ * @brief Number of sample frames carried by one block.
+ */
+inline size_t imaAdpcmFramesPerBlock(size_t blockAlign, uint8_t channels) {
+  if (channels == 0 || blockAlign < 4u * channels)
+    return 0;
+  return ((blockAlign - 4u * channels) * 2u) / channels + 1;
+}
+
+/**
+ * @brief Decodes one block into interleaved PCM16.
+ *
+ * @param block Encoded block (blockAlign bytes).
+ * @param blockAlign Block size in bytes, as declared by the fmt chunk.
+ * @param channels 1 or 2.
+ * @param out Destination, room for imaAdpcmFramesPerBlock() * channels.
+ * @return Number of frames written: fewer than imaAdpcmFramesPerBlock() when
+ * the codes end mid-word, 0 on malformed input.
+ */
+size_t imaAdpcmDecodeBlock(const uint8_t *block, size_t blockAlign,
+                           uint8_t channels, int16_t *out);
+
+/**
+ * @brief Encodes one block from interleaved PCM16.
+ *
+ * Frames beyond @p frames (short final block) are padded with the last
+ * sample. @p state carries the predictor across blocks for best quality.
+ *
+ * @return blockAlign on success, 0 on bad arguments.
+ */
+size_t imaAdpcmEncodeBlock(const int16_t *pcm, size_t frames,
+                           uint8_t channels, ImaAdpcmState *state,
+                           uint8_t *out, size_t blockAlign);
+
+#endif // IMA_ADPCM_H
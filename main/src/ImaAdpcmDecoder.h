@@ -0,0 +1,197 @@
+#ifndef IMA_ADPCM_DECODER_H
+#define IMA_ADPCM_DECODER_H
+
+#include "AudioUtils.h"
+#include "ImaAdpcm.h"
+#include <AudioTools.h>
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief Streaming decoder for IMA-ADPCM .wav files (format tag 0x0011).
+ *
+ * Plugs into EncodedAudioStream next to MP3DecoderHelix and WAVDecoder. The
+ * RIFF chunks are walked as they arrive: fmt and fact are read, and any other
+ * chunk before data (LIST, smpl, cue) is skipped by its declared size, however
+ * large. Then each complete block is expanded to PCM16 and pushed to the
+ * output in one write.
+ */
+class ImaAdpcmDecoder : public AudioDecoder {
+public:
+  static constexpr size_t MAX_FIELDS = 40; // Longest fmt (extensible) read
+
+  bool begin() override {
+    _expect(Step::RIFF, 12);
+    _skip = 0;
+    _fill = 0;
+    _remaining = 0;
+    _wav = WavInfo();
+    _state = State::HEADER;
+    return true;
+  }
+
+  void end() override { _state = State::IDLE; }
+
+  operator bool() override { return _state != State::IDLE; }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    size_t consumed = 0;
+    while (_state == State::HEADER && consumed < len) {
+      if (_skip > 0) {
+        size_t n = std::min((size_t)_skip, len - consumed);
+        _skip -= n;
+        consumed += n;
+        continue;
+      }
+      size_t take = std::min(_want - _got, len - consumed);
+      memcpy(_fields + _got, data + consumed, take);
+      _got += take;
+      consumed += take;
+      if (_got == _want)
+        _parse();
+    }
+    if (_state == State::DATA)
+      _feed(data + consumed, len - consumed);
+    return len; // Trailing chunks and bad input are swallowed
+  }
+
+private:
+  enum class State : uint8_t { IDLE, HEADER, DATA, ERROR };
+  // Where the header walk is: what _fields is being filled with
+  enum class Step : uint8_t { RIFF, CHUNK, FMT, FACT };
+
+  void _expect(Step step, size_t bytes) {
+    _step = step;
+    _want = bytes;
+    _got = 0;
+  }
+
+  // _fields holds the _want bytes of the current step
+  void _parse() {
+    using namespace audio_utils_detail;
+    switch (_step) {
+    case Step::RIFF:
+      if (memcmp(_fields, "RIFF", 4) != 0 ||
+          memcmp(_fields + 8, "WAVE", 4) != 0) {
+        _state = State::ERROR;
+        return;
+      }
+      _expect(Step::CHUNK, 8);
+      return;
+    case Step::CHUNK: {
+      uint32_t size = le32(_fields + 4);
+      _chunkLeft = size + (size & 1); // Chunks are word aligned
+      if (memcmp(_fields, "data", 4) == 0) {
+        _wav.dataSize = size;
+        _start();
+      } else if (memcmp(_fields, "fmt ", 4) == 0 && size >= 16) {
+        _expect(Step::FMT, std::min((size_t)size, MAX_FIELDS));
+        _chunkLeft -= _want;
+      } else if (memcmp(_fields, "fact", 4) == 0 && size >= 4) {
+        _expect(Step::FACT, 4);
+        _chunkLeft -= _want;
+      } else {
+        _skip = _chunkLeft;
+        _expect(Step::CHUNK, 8);
+      }
+      return;
+    }
+    case Step::FMT:
+      _wav.formatTag = le16(_fields);
+      _wav.channels = le16(_fields + 2);
+      _wav.sampleRate = le32(_fields + 4);
+      _wav.blockAlign = le16(_fields + 12);
+      _wav.bitsPerSample = le16(_fields + 14);
+      break;
+    case Step::FACT:
+      _wav.frameCount = le32(_fields);
+      break;
+    }
+    // The rest of a fmt or fact chunk
+    _skip = _chunkLeft;
+    _expect(Step::CHUNK, 8);
+  }
+
+  // The data chunk header has been read
+  void _start() {
+    const WavInfo &wav = _wav;
+    if (wav.formatTag != WAV_FORMAT_IMA_ADPCM || wav.channels == 0 ||
+        wav.channels > 2 || imaAdpcmFramesPerBlock(wav.blockAlign,
+                                                   wav.channels) == 0) {
+      _state = State::ERROR;
+      return;
+    }
+
+    _channels = wav.channels;
+    _blockAlign = wav.blockAlign;
+    _remaining = wav.dataSize;
+    _framesLeft = wav.frameCount ? wav.frameCount : UINT32_MAX;
+    _block.resize(_blockAlign);
+    _pcm.resize(imaAdpcmFramesPerBlock(_blockAlign, _channels) * _channels);
+    _fill = 0;
+    _state = State::DATA;
+
+    AudioInfo out(wav.sampleRate, _channels, 16);
+    info = out;
+    notifyAudioChange(out);
+  }
+
+  void _feed(const uint8_t *data, size_t len) {
+    if (len > _remaining)
+      len = _remaining;
+    _remaining -= len;
+
+    while (len > 0) {
+      size_t take = std::min(len, (size_t)_blockAlign - _fill);
+      memcpy(_block.data() + _fill, data, take);
+      _fill += take;
+      data += take;
+      len -= take;
+      if (_fill == _blockAlign)
+        _decode(_blockAlign);
+    }
+
+    // Encoders may truncate the last block; decode whole 4-byte groups
+    size_t group = 4u * _channels;
+    if (_remaining == 0 && _fill > group)
+      _decode(group + ((_fill - group) / group) * group);
+  }
+
+  void _decode(size_t bytes) {
+    _fill = 0;
+    size_t frames =
+        imaAdpcmDecodeBlock(_block.data(), bytes, _channels, _pcm.data());
+    // The fact chunk cuts the padding an encoder put in the last block
+    frames = std::min(frames, (size_t)_framesLeft);
+    _framesLeft -= frames;
+    if (frames == 0 || p_print == nullptr)
+      return;
+    const uint8_t *out = (const uint8_t *)_pcm.data();
+    size_t left = frames * _channels * sizeof(int16_t);
+    while (left > 0) {
+      size_t n = p_print->write(out, left);
+      if (n == 0)
+        break;
+      out += n;
+      left -= n;
+    }
+  }
+
+  State _state = State::IDLE;
+  Step _step = Step::RIFF;
+  uint8_t _fields[MAX_FIELDS];
+  size_t _want = 12; // Bytes of the current step
+  size_t _got = 0;
+  uint32_t _skip = 0;      // Bytes to drop before the next step
+  uint32_t _chunkLeft = 0; // Of the chunk being read, its pad byte included
+  WavInfo _wav;
+  std::vector<uint8_t> _block;
+  std::vector<int16_t> _pcm;
+  size_t _fill = 0;
+  uint32_t _remaining = 0;
+  uint32_t _framesLeft = 0;
+  uint16_t _blockAlign = 0;
+  uint8_t _channels = 0;
+};
+
+#endif // IMA_ADPCM_DECODER_H
@@ -0,0 +1,98 @@
+#include "LatencyMonitor.h"
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <esp_timer.h>
+
+uint32_t LatencyMonitor::stamp() {
+  uint32_t id = _nextId++;
+  if (!id) // 0 is "no cause"
+    id = _nextId++;
+  // Emptied first, so a reader never pairs the old ID with the new time
+  Slot &slot = _slots[id % SLOTS];
+  slot.id.store(0, std::memory_order_relaxed);
+  slot.us.store((uint32_t)esp_timer_get_time(), std::memory_order_relaxed);
+  slot.id.store(id, std::memory_order_release);
+  traceInstant(TRACE_DCC, "latency.cause", id);
+  return id;
+}
+
+void LatencyMonitor::record(LatencyPath path, uint32_t cause) {
+  if (!cause)
+    return;
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  const Slot &slot = _slots[cause % SLOTS];
+  if (slot.id.load(std::memory_order_acquire) != cause)
+    return;
+  uint32_t us = slot.us.load(std::memory_order_relaxed);
+  if (slot.id.load(std::memory_order_acquire) != cause)
+    return; // Reused while we read it
+  _paths[path].addUs(now - us);
+  traceInstant(path == LATENCY_SPEED ? TRACE_MOTOR : TRACE_AUDIO,
+               path == LATENCY_SPEED ? "latency.speed" : "latency.function",
+               cause);
+}
+
+void LatencyMonitor::reset() {
+  for (auto &h : _paths)
+    h.reset();
+}
+
+uint32_t LatencyMonitor::percentileUs(const PerfHistogram &h,
+                                      uint8_t percent) {
+  uint32_t total = 0;
+  for (const auto &b : h.buckets)
+    total += b.load();
+  if (!total)
+    return 0;
+  uint32_t maxUs = h.maxTicks.load();
+  // The rank'th smallest, placed linearly within its bucket
+  uint32_t rank = ((uint64_t)total * percent + 99) / 100;
+  uint32_t below = 0;
+  for (uint8_t b = 0; b < PerfHistogram::BUCKETS; b++) {
+    uint32_t n = h.buckets[b].load();
+    if (below + n < rank) {
+      below += n;
+      continue;
+    }
+    uint32_t low = perfBucketLowUs(b);
+    uint32_t high =
+        b + 1 < PerfHistogram::BUCKETS ? perfBucketLowUs(b + 1) : maxUs;
+    uint32_t at = low + (uint64_t)(high - low) * (rank - below) / n;
+    return std::min(at, maxUs);
+  }
+  return maxUs;
+}
+
+LatencySummary LatencyMonitor::summary(LatencyPath path) const {
+  const PerfHistogram &h = _paths[path];
+  LatencySummary s;
+  s.count = h.count.load();
+  s.p50Us = percentileUs(h, 50);
+  s.p99Us = percentileUs(h, 99);
+  s.maxUs = h.maxTicks.load(); // Filled with addUs()
+  return s;
+}
+
+const char *LatencyMonitor::pathName(LatencyPath path) {
+  return path == LATENCY_SPEED ? "speed" : "function";
+}
+
+void LatencyMonitor::getStatus(JsonObject out) {
+  JsonArray edges = out["bucket_edges_us"].to<JsonArray>();
+  for (uint8_t b = 0; b < PerfHistogram::BUCKETS; b++)
+    edges.add(perfBucketLowUs(b));
+
+  // Flat, a few keys per path
+  for (uint8_t p = 0; p < LATENCY_PATHS; p++) {
+    LatencyPath path = (LatencyPath)p;
+    LatencySummary s = summary(path);
+    String name = pathName(path);
+    out[name + "_count"] = s.count;
+    out[name + "_p50_us"] = s.p50Us;
+    out[name + "_p99_us"] = s.p99Us;
+    out[name + "_max_us"] = s.maxUs;
+    JsonArray buckets = out[name + "_buckets"].to<JsonArray>();
+    for (const auto &b : _paths[p].buckets)
+      buckets.add(b.load());
+  }
+}
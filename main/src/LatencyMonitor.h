@@ -0,0 +1,77 @@
+#ifndef LATENCY_MONITOR_H
+#define LATENCY_MONITOR_H
+
+#include "PerfMonitor.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+
+// The paths from a DCC packet to what the customer sees or hears
+enum LatencyPath : uint8_t {
+  LATENCY_SPEED,    // Speed packet to the first duty it moves
+  LATENCY_FUNCTION, // Function packet to the first block of its sound
+  LATENCY_PATHS,
+};
+
+struct LatencySummary {
+  uint32_t count;
+  uint32_t p50Us; // To within a half-octave bucket
+  uint32_t p99Us;
+  uint32_t maxUs;
+};
+
+/**
+ * @brief End-to-end latency, packet to actuation, per path.
+ *
+ * A DCC callback that changes the state takes a causality ID with stamp()
+ * and leaves it in SystemState beside what it changed. Whoever carries that
+ * change on (momentum, MotorTask's next cycle, the audio loop) carries the
+ * ID with it, and the actuation point hands it to record(), which files
+ * the time since the stamp in the path's histogram. An ID is a plain
+ * 32-bit value, so it crosses tasks with an atomic store, and it is the
+ * argument of the "latency.*" trace events, which tie the hops together
+ * in a trace.
+ *
+ * Times are esp_timer's, which both cores share. The last SLOTS stamps are
+ * kept; an older ID is not recorded.
+ */
+class LatencyMonitor {
+public:
+  static constexpr uint8_t SLOTS = 16;
+
+  static LatencyMonitor &getInstance() {
+    static LatencyMonitor instance;
+    return instance;
+  }
+
+  // A new ID, stamped now. From the DCC callbacks' task only
+  uint32_t stamp();
+  // Files the time since @p cause was stamped; 0 or a forgotten ID is not.
+  // One task per path
+  void record(LatencyPath path, uint32_t cause);
+  void reset(); // From any task, so roughly at once
+
+  LatencySummary summary(LatencyPath path) const;
+  void getStatus(JsonObject out);
+
+  static const char *pathName(LatencyPath path);
+  // Of a histogram filled with addUs(), so that its ticks are µs
+  static uint32_t percentileUs(const PerfHistogram &h, uint8_t percent);
+
+  LatencyMonitor(const LatencyMonitor &) = delete;
+  LatencyMonitor &operator=(const LatencyMonitor &) = delete;
+
+private:
+  LatencyMonitor() = default;
+
+  struct Slot {
+    std::atomic<uint32_t> id{0};
+    std::atomic<uint32_t> us{0}; // Low 32 bits of esp_timer
+  };
+
+  Slot _slots[SLOTS];
+  uint32_t _nextId = 1;
+  PerfHistogram _paths[LATENCY_PATHS]; // In µs
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "Logger.h"
+#include "PerfMonitor.h"
 #include <ArduinoJson.h>
 
 Logger::Logger() {
@@ -34,8 +35,10 @@ void Logger::_taskEntry(void *param) {
 
 void Logger::_processQueue() {
   LogMessage msg;
+  PerfLoop &perfLoop = PerfMonitor::getInstance().loop("LoggerTask");
   while (true) {
     if (xQueueReceive(_logQueue, &msg, portMAX_DELAY) == pdTRUE) {
+      PerfScope perf(perfLoop);
       if (_serialEnabled) {
         Serial.println(msg.text);
       }
@@ -263,8 +266,13 @@ String Logger::getLogsHTML() {
 
 String Logger::getLogsJSON(const String &filter) {
   JsonDocument doc;
-  JsonArray arr = doc.to<JsonArray>();
+  getLogsJSON(doc.to<JsonArray>(), filter);
+  String output;
+  serializeJson(doc, output);
+  return output;
+}
 
+void Logger::getLogsJSON(JsonArray arr, const String &filter) {
   if (_historyMutex != NULL &&
       xSemaphoreTake(_historyMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
     if (filter == "[NIMRS_DATA]") {
@@ -287,8 +295,4 @@ String Logger::getLogsJSON(const String &filter) {
     }
     xSemaphoreGive(_historyMutex);
   }
-
-  String output;
-  serializeJson(doc, output);
-  return output;
 }
@@ -2,6 +2,7 @@
 #define NIMRS_LOGGER_H
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
 #include <deque>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
@@ -56,6 +57,7 @@ public:
   // Access for Web Server
   String getLogsHTML();
   String getLogsJSON(const String &filter = "");
+  void getLogsJSON(JsonArray out, const String &filter = ""); // No String
   void clear();
 
 private:
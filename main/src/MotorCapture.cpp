@@ -0,0 +1,239 @@
+#include "MotorCapture.h"
+#include "TelemetryStream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+bool MotorCapture::arm(uint8_t triggers, uint16_t pre, uint16_t post) {
+  _lock();
+  State s = state();
+  if (s == State::ARMED || s == State::TRIGGERED) {
+    _unlock();
+    return false;
+  }
+  if (!_samples) {
+    _samples = (uint16_t *)malloc(SAMPLES * sizeof(uint16_t));
+    _cycles = (CaptureCycle *)malloc(CYCLES * sizeof(CaptureCycle));
+    if (!_samples || !_cycles) {
+      _free();
+      _unlock();
+      return false;
+    }
+  }
+  // The task does not touch any of this until it sees ARMED
+  _triggers = triggers;
+  _post = std::min<uint16_t>(post, CYCLES - 1);
+  _pre = std::min<uint16_t>(pre, CYCLES - 1 - _post);
+  _sampleHead = 0;
+  _cycleHead = 0;
+  _recording = false;
+  _fired = 0;
+  _pending.store(0);
+  _cancel.store(false);
+  _state.store(State::ARMED, std::memory_order_release);
+  _unlock();
+  return true;
+}
+
+void MotorCapture::cancel() {
+  _lock();
+  State s = state();
+  if (s == State::ARMED || s == State::TRIGGERED)
+    _cancel.store(true); // The task goes back to IDLE at its next tick
+  else {
+    _state.store(State::IDLE, std::memory_order_release);
+    _free();
+  }
+  _unlock();
+}
+
+void MotorCapture::_free() {
+  free(_samples);
+  free(_cycles);
+  _samples = nullptr;
+  _cycles = nullptr;
+}
+
+void MotorCapture::trigger(uint8_t source) {
+  if (state() == State::ARMED)
+    _pending.fetch_or(source);
+}
+
+void MotorCapture::addSamples(const float *raw, size_t n, float rateHz) {
+  State s = state();
+  _recording = s == State::ARMED || s == State::TRIGGERED;
+  if (!_recording)
+    return;
+  _rateHz = rateHz;
+  _tickFirst = _sampleHead;
+  _tickSamples = std::min<size_t>(n, UINT16_MAX);
+  for (size_t i = 0; i < _tickSamples; i++) {
+    float v = std::max(0.0f, std::min(raw[i], 65535.0f));
+    _samples[(_sampleHead + i) % SAMPLES] = (uint16_t)v;
+  }
+  _sampleHead += _tickSamples;
+}
+
+void MotorCapture::endCycle(CaptureCycle cycle) {
+  // Armed after this tick's samples were taken: start with the next one
+  if (!_recording)
+    return;
+  _recording = false;
+  if (_cancel.load()) {
+    _cancel.store(false);
+    _state.store(State::IDLE, std::memory_order_release);
+    return;
+  }
+
+  // Edges need a tick to compare with, so the first one never triggers
+  uint8_t seen = _pending.exchange(0);
+  if (_cycleHead > 0) {
+    uint8_t rising = cycle.flags & ~_lastFlags;
+    if (rising & TELEMETRY_STALLED)
+      seen |= CAPTURE_STALL;
+    if (rising & TELEMETRY_FAULT)
+      seen |= CAPTURE_FAULT;
+    if (cycle.zone != _lastZone)
+      seen |= CAPTURE_ZONE;
+  }
+  _lastFlags = cycle.flags;
+  _lastZone = cycle.zone;
+
+  cycle.timeUs = micros();
+  cycle.firstSample = _tickFirst;
+  cycle.samples = _tickSamples;
+  cycle.triggers = seen;
+  _cycles[_cycleHead % CYCLES] = cycle;
+  _cycleHead++;
+
+  if (state() == State::ARMED) {
+    if (!(seen & _triggers))
+      return;
+    _fired = seen & _triggers;
+    _triggerCycle = _cycleHead - 1;
+    _postLeft = _post;
+    if (_postLeft > 0) {
+      _state.store(State::TRIGGERED, std::memory_order_release);
+      return;
+    }
+  } else if (--_postLeft > 0) {
+    return;
+  }
+  // The rings are the reader's from here
+  _state.store(State::DONE, std::memory_order_release);
+}
+
+uint32_t MotorCapture::_firstCycle(uint32_t *firstSample) const {
+  uint32_t first = _triggerCycle >= _pre ? _triggerCycle - _pre : 0;
+  if (_cycleHead > CYCLES)
+    first = std::max<uint32_t>(first, _cycleHead - CYCLES);
+  // Drop ticks whose samples have since been overwritten
+  uint32_t oldest = _sampleHead > SAMPLES ? _sampleHead - SAMPLES : 0;
+  while (first < _triggerCycle &&
+         _cycles[first % CYCLES].firstSample < oldest)
+    first++;
+  *firstSample = std::max(_cycles[first % CYCLES].firstSample, oldest);
+  return first;
+}
+
+size_t MotorCapture::size() {
+  _lock();
+  size_t bytes = 0;
+  if (state() == State::DONE) {
+    uint32_t firstSample;
+    uint32_t first = _firstCycle(&firstSample);
+    bytes = sizeof(CaptureHeader) +
+            (_cycleHead - first) * sizeof(CaptureCycle) +
+            (_sampleHead - firstSample) * sizeof(uint16_t);
+  }
+  _unlock();
+  return bytes;
+}
+
+bool MotorCapture::write(Print &out) {
+  _lock();
+  if (state() != State::DONE) {
+    _unlock();
+    return false;
+  }
+  uint32_t firstSample;
+  uint32_t first = _firstCycle(&firstSample);
+
+  CaptureHeader header = {};
+  header.magic = CAPTURE_MAGIC;
+  header.version = CAPTURE_VERSION;
+  header.fired = _fired;
+  header.cycles = _cycleHead - first;
+  header.samples = _sampleHead - firstSample;
+  header.sampleRateHz = (uint32_t)_rateHz;
+  header.triggerCycle = _triggerCycle - first;
+  out.write((const uint8_t *)&header, sizeof(header));
+
+  // Sample indices are made relative to the blob's first sample
+  for (uint32_t c = first; c != _cycleHead; c++) {
+    CaptureCycle cycle = _cycles[c % CYCLES];
+    cycle.firstSample =
+        cycle.firstSample > firstSample ? cycle.firstSample - firstSample : 0;
+    out.write((const uint8_t *)&cycle, sizeof(cycle));
+  }
+
+  // The samples are at most two runs of the ring
+  for (uint32_t i = firstSample; i != _sampleHead;) {
+    uint32_t at = i % SAMPLES;
+    uint32_t run = std::min<uint32_t>(_sampleHead - i, SAMPLES - at);
+    out.write((const uint8_t *)(_samples + at), run * sizeof(uint16_t));
+    i += run;
+  }
+  _unlock();
+  return true;
+}
+
+void MotorCapture::getStatus(JsonObject out) {
+  out["size"] = (uint32_t)size();
+  _lock();
+  out["state"] = stateName(state());
+  out["triggers"] = _triggers;
+  out["fired"] = _fired;
+  out["pre"] = _pre;
+  out["post"] = _post;
+  out["max_cycles"] = CYCLES;
+  out["sample_capacity"] = (uint32_t)SAMPLES;
+  _unlock();
+}
+
+const char *MotorCapture::stateName(State state) {
+  switch (state) {
+  case State::IDLE:
+    return "idle";
+  case State::ARMED:
+    return "armed";
+  case State::TRIGGERED:
+    return "triggered";
+  case State::DONE:
+    return "done";
+  }
+  return "?";
+}
+
+uint8_t MotorCapture::parseTriggers(const char *list) {
+  static const struct {
+    const char *name;
+    uint8_t bit;
+  } NAMES[] = {{"manual", CAPTURE_MANUAL},
+               {"stall", CAPTURE_STALL},
+               {"fault", CAPTURE_FAULT},
+               {"zone", CAPTURE_ZONE},
+               {"cv", CAPTURE_CV_WRITE}};
+  uint8_t bits = 0;
+  while (*list) {
+    size_t len = strcspn(list, ",");
+    for (const auto &n : NAMES) {
+      if (strlen(n.name) == len && strncmp(list, n.name, len) == 0)
+        bits |= n.bit;
+    }
+    list += len;
+    if (*list == ',')
+      list++;
+  }
+  return bits;
+}
@@ -0,0 +1,151 @@
+#ifndef MOTOR_CAPTURE_H
+#define MOTOR_CAPTURE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// What can end a capture's wait; a capture is armed for any mix of them
+enum : uint8_t {
+  CAPTURE_MANUAL = 0x01,
+  CAPTURE_STALL = 0x02,    // Stall detected (rising edge)
+  CAPTURE_FAULT = 0x04,    // Driver fault (rising edge)
+  CAPTURE_ZONE = 0x08,     // Control zone changed
+  CAPTURE_CV_WRITE = 0x10, // Any CV written
+};
+
+/**
+ * @brief One control tick, as downloaded (little-endian, no padding).
+ * tools/motor_capture.py decodes this layout; change CAPTURE_VERSION with it.
+ */
+struct __attribute__((packed)) CaptureCycle {
+  uint32_t timeUs;      // micros() at the end of the tick
+  uint32_t firstSample; // Index of the tick's first sample in the blob
+  uint16_t samples;     // Raw ADC samples taken during the tick
+  uint8_t target;       // Speed step
+  uint8_t zone;         // As in TelemetryFrame
+  uint8_t flags;        // TELEMETRY_*
+  uint8_t triggers;     // CAPTURE_* conditions seen this tick
+  uint16_t reserved;
+  float duty;
+  float current; // A, filtered
+  float rpm;
+  float ripple;       // Hz
+  float ampsPerCount; // A sample is max(0, count - offset) * ampsPerCount A
+  float offset;       // Counts
+};
+static_assert(sizeof(CaptureCycle) == 40, "Wire layout");
+
+// The blob: this header, `cycles` CaptureCycles, then `samples` uint16_t
+struct __attribute__((packed)) CaptureHeader {
+  uint32_t magic; // "NCAP"
+  uint8_t version;
+  uint8_t fired; // CAPTURE_* that triggered it
+  uint16_t cycles;
+  uint32_t samples;
+  uint32_t sampleRateHz;
+  uint16_t triggerCycle; // Index of the triggering cycle
+  uint16_t reserved;
+};
+static_assert(sizeof(CaptureHeader) == 20, "Wire layout");
+
+static constexpr uint32_t CAPTURE_MAGIC = 0x5041434E;
+static constexpr uint8_t CAPTURE_VERSION = 1;
+
+/**
+ * @brief Triggered capture of the motor's raw current samples and per-tick
+ * control state, for diagnosing binds and stalls at full resolution.
+ *
+ * Once armed, the motor task keeps the last CYCLES ticks and SAMPLES raw
+ * current samples in two rings. When a condition it is armed for occurs,
+ * it records `post` more ticks and stops; the ticks from `pre` before the
+ * trigger to the end, and their samples, can then be downloaded as one
+ * blob. The rings are allocated when armed and freed by cancel().
+ *
+ * The motor task is the only writer and never waits: it stops touching the
+ * rings once the capture is done, and only then can they be read.
+ */
+class MotorCapture {
+public:
+  static constexpr size_t SAMPLES = 16384; // 32 KB: 0.8 s at 20 kHz
+  static constexpr uint16_t CYCLES = 40;   // Ticks; as long as SAMPLES
+  static constexpr size_t MAX_SIZE = sizeof(CaptureHeader) +
+                                     CYCLES * sizeof(CaptureCycle) +
+                                     SAMPLES * sizeof(uint16_t);
+
+  enum class State : uint8_t { IDLE, ARMED, TRIGGERED, DONE };
+
+  static MotorCapture &getInstance() {
+    static MotorCapture instance;
+    return instance;
+  }
+
+  /**
+   * @brief Starts recording and waits for any of @p triggers; keeps @p pre
+   * ticks before it and @p post after (pre + post < CYCLES).
+   * @return false while a capture is running, or out of memory.
+   */
+  bool arm(uint8_t triggers, uint16_t pre, uint16_t post);
+  void cancel(); // Drops the capture; the rings go once the task lets go
+  void trigger(uint8_t source); // From any task: CV writes, manual
+
+  State state() const { return _state.load(std::memory_order_acquire); }
+  void getStatus(JsonObject out);
+
+  /**
+   * @brief Writes the finished capture as a blob to @p out.
+   * @return false unless the capture is DONE.
+   */
+  bool write(Print &out);
+  size_t size(); // Of the blob; 0 unless DONE
+
+  // From the motor task: the raw samples of a tick, then its state
+  void addSamples(const float *raw, size_t n, float rateHz);
+  void endCycle(CaptureCycle cycle);
+
+  static const char *stateName(State state);
+  static uint8_t parseTriggers(const char *list); // "stall,fault,..."
+
+  MotorCapture(const MotorCapture &) = delete;
+  MotorCapture &operator=(const MotorCapture &) = delete;
+
+private:
+  MotorCapture() { _mutex = xSemaphoreCreateMutex(); }
+
+  void _lock() { xSemaphoreTake(_mutex, portMAX_DELAY); }
+  void _unlock() { xSemaphoreGive(_mutex); }
+  void _free();
+  // The cycles to download, [first, _cycleHead), and their first sample
+  uint32_t _firstCycle(uint32_t *firstSample) const;
+
+  // Rings, indexed by absolute count modulo their size
+  uint16_t *_samples = nullptr;
+  CaptureCycle *_cycles = nullptr;
+  uint32_t _sampleHead = 0;
+  uint32_t _cycleHead = 0;
+
+  // Set by arm(); read by the task
+  uint8_t _triggers = 0;
+  uint16_t _pre = 0;
+  uint16_t _post = 0;
+
+  // The task's own
+  bool _recording = false; // This tick's samples went in
+  uint32_t _tickFirst = 0;
+  uint16_t _tickSamples = 0;
+  uint8_t _lastFlags = 0;
+  uint8_t _lastZone = 0;
+  uint16_t _postLeft = 0;
+  uint32_t _triggerCycle = 0;
+  uint8_t _fired = 0;
+  float _rateHz = 0.0f;
+
+  std::atomic<State> _state{State::IDLE};
+  std::atomic<uint8_t> _pending{0}; // trigger() sources for the next tick
+  std::atomic<bool> _cancel{false};
+  SemaphoreHandle_t _mutex; // Control side: arm, cancel, download
+};
+
+#endif
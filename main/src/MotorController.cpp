@@ -1,11 +1,24 @@
 #include "MotorController.h"
 #include "CvRegistry.h"
 #include "Logger.h"
+#include "TraceRecorder.h"
 #include <algorithm>
 #include <cmath>
 
+namespace {
+constexpr uint32_t MOMENTUM_MS = 10;
+constexpr uint16_t LOG_HZ = 10; // [NIMRS_DATA] lines per second
+} // namespace
+
 MotorController::MotorController()
-    : _currentSpeed(0.0f), _lastMomentumUpdate(0) {}
+    : _currentSpeed(0.0f), _lastMomentumUpdate(0) {
+  Telemetry &t = Telemetry::getInstance();
+  _throttleChannel = t.add("throttle", "step", TelemetryType::U8,
+                           1000 / MOMENTUM_MS);
+  _momentumChannel = t.add("momentum_speed", "step", TelemetryType::F32,
+                           1000 / MOMENTUM_MS);
+  _logSink.follow(LOG_HZ);
+}
 
 void MotorController::setup() {
   Log.println("NIMRS: Hybrid Motor Control (MotorTask)");
@@ -16,6 +29,11 @@ void MotorController::loop() {
   SystemState &state = SystemContext::getInstance().getState();
   uint8_t targetSpeed = state.speed;
   bool direction = state.direction;
+  uint32_t cause = state.speedCause;
+  if (cause != _lastCause) {
+    _lastCause = cause;
+    _pendingCause = cause;
+  }
 
   _updateCvCache();
 
@@ -24,7 +42,8 @@ void MotorController::loop() {
   // previous implementation. Ideally CV4 should be used for decel.
   unsigned long now = millis();
   unsigned long dt = now - _lastMomentumUpdate;
-  if (dt >= 10) {
+  if (dt >= MOMENTUM_MS) {
+    TraceScope trace(TRACE_MOTOR, "motor.momentum", targetSpeed);
     _lastMomentumUpdate = now;
 
     float accelDelay = std::max(1, (int)_cvAccel) * 5.0f;
@@ -39,30 +58,56 @@ void MotorController::loop() {
       if (_currentSpeed < targetSpeed)
         _currentSpeed = (float)targetSpeed;
     }
+    Telemetry::getInstance().publish(_throttleChannel, targetSpeed);
+    Telemetry::getInstance().publish(_momentumChannel, _currentSpeed);
   }
 
   // Update MotorTask
   // _currentSpeed is 0-255 float.
-  MotorTask::getInstance().setTargetSpeed((uint8_t)_currentSpeed, direction);
+  uint8_t speed = (uint8_t)_currentSpeed;
+  if (speed != _sentSpeed || direction != _sentDirection) {
+    // Momentum has moved the motor's target: the packet's latency runs on
+    MotorTask::getInstance().setTargetSpeed(speed, direction, _pendingCause);
+    _pendingCause = 0;
+    _sentSpeed = speed;
+    _sentDirection = direction;
+  } else {
+    if (speed == targetSpeed)
+      _pendingCause = 0; // Nothing left for the packet to move
+    MotorTask::getInstance().setTargetSpeed(speed, direction);
+  }
 
-  streamTelemetry();
+  // The engine sound notches with the motor, not with the throttle
+  {
+    SystemContext &ctx = SystemContext::getInstance();
+    ScopedLock lock(ctx);
+    state.momentumSpeed = _currentSpeed;
+    state.loadFactor = MotorTask::getInstance().getStatus().load;
+  }
 }
 
 void MotorController::streamTelemetry() {
-  static unsigned long lastS = 0;
-  if (millis() - lastS > 150) {
-    lastS = millis();
-    SystemState &state = SystemContext::getInstance().getState();
-    MotorTask::Status status = MotorTask::getInstance().getStatus();
-    int pwm = (int)(fabs(status.duty) * 1023.0f);
-
-    // [NIMRS_DATA],target_speed,current_speed,pwm_val,current_amps,rpm,raw_adc,learned_r
-    Log.printf("[NIMRS_DATA],%d,%.1f,%d,%.3f,%.3f,%lu,%.2f\n", state.speed,
-               _currentSpeed, pwm, status.current, status.estimatedRpm,
-               (unsigned long)status.rawAdc,
-               MotorTask::getInstance().getLearnedResistance());
-  }
+  // Called from the Arduino loop: the JSON and the log line are built there,
+  // never on ControlPlane or MotorTask, which only publish
+  if (millis() - _lastTelemetryLog < 1000 / LOG_HZ)
+    return;
+  _lastTelemetryLog = millis();
+
+  Telemetry &t = Telemetry::getInstance();
+  JsonDocument doc;
+  JsonObject obj = doc.to<JsonObject>();
+  bool any = false;
+  _logSink.poll([&](Telemetry::Channel c) {
+    t.toJson(obj, c);
+    any = true;
+  });
+  if (!any)
+    return;
+  String line;
+  serializeJson(doc, line);
+  Log.printf("[NIMRS_DATA] %s\n", line.c_str());
 }
+
 void MotorController::stopImmediate() {
   SystemState &state = SystemContext::getInstance().getState();
   state.speed = 0;
@@ -83,10 +128,6 @@ void MotorController::_updateCvCache() {
 }
 
 // Delegation
-void MotorController::startTest() { MotorTask::getInstance().startTest(); }
-String MotorController::getTestJSON() {
-  return MotorTask::getInstance().getTestJSON();
-}
 void MotorController::measureResistance() {
   MotorTask::getInstance().measureResistance();
 }
@@ -4,6 +4,7 @@
 #include "DccController.h"
 #include "MotorTask.h"
 #include "SystemContext.h"
+#include "Telemetry.h"
 #include <Arduino.h>
 
 class MotorController {
@@ -14,14 +15,11 @@ public:
   }
 
   void setup();
-  void loop();
+  void loop(); // ControlPlane: momentum and the motor's target
+  // The [NIMRS_DATA] log line, from the registry; Arduino loop only
   void streamTelemetry();
   void stopImmediate(); // Bypass momentum
 
-  // Test Mode (Delegate to MotorTask)
-  void startTest();
-  String getTestJSON();
-
   // Resistance Measurement (Delegate to MotorTask)
   using ResistanceState = MotorTask::ResistanceState;
   void measureResistance();
@@ -44,6 +42,18 @@ private:
   float _currentSpeed = 0.0f; // Filtered speed (0-255)
   unsigned long _lastMomentumUpdate = 0;
 
+  // A speed packet's causality ID waits here for the first target it moves
+  uint32_t _lastCause = 0;
+  uint32_t _pendingCause = 0;
+  uint8_t _sentSpeed = 0;
+  bool _sentDirection = true;
+
+  // Telemetry
+  Telemetry::Channel _throttleChannel;
+  Telemetry::Channel _momentumChannel;
+  Telemetry::Subscriber _logSink;
+  unsigned long _lastTelemetryLog = 0;
+
   // CV Cache
   unsigned long _lastCvUpdate = 0;
   void _updateCvCache();
@@ -1,5 +1,7 @@
 #include "MotorHal.h"
 #include "Logger.h"
+#include "PerfMonitor.h"
+#include "TraceRecorder.h"
 #include "driver/adc.h"
 #include "nimrs-pinout.h"
 #include <Arduino.h>
@@ -15,11 +17,16 @@ MotorHal &MotorHal::getInstance() {
   return instance;
 }
 
+// The ISR's own timing: run-time stats charge it to whatever it interrupts
+static PerfLoop *isrPerf = nullptr;
+
 // ISR Callback: Pushes high-frequency samples to stream buffer
 extern "C" bool IRAM_ATTR
 motor_hal_mcpwm_cb(mcpwm_timer_handle_t timer,
                    const mcpwm_timer_event_data_t *edata, void *user_ctx) {
   MotorHal *self = (MotorHal *)user_ctx;
+  PerfScope perf(*isrPerf);
+  TraceScope trace(TRACE_ISR, "motor.isr");
 
   if (edata->count_value == 0) { // Center of ON
     int raw = adc1_get_raw(ADC1_CHANNEL_5);
@@ -39,6 +46,8 @@ motor_hal_mcpwm_cb(mcpwm_timer_handle_t timer,
 void MotorHal::init() {
   // 1. Setup Stream Buffer (4096 bytes / sizeof(float) = 1024 samples capacity)
   _adcStreamBuffer = xStreamBufferCreate(4096, sizeof(float));
+  isrPerf = &PerfMonitor::getInstance().loop("MotorIsr");
+  TraceRecorder::getInstance(); // Constructed here, not in the ISR
 
   // 2. Configure ADC1
   adc1_config_width(ADC_WIDTH_BIT_12);
@@ -1,11 +1,20 @@
 #include "MotorTask.h"
+#include "BootTimeline.h"
 #include "CvRegistry.h"
 #include "DccController.h"
-#include "Logger.h"
+#include "LatencyMonitor.h"
+#include "MotorCapture.h"
 #include "MotorHal.h"
+#include "PerfMonitor.h"
+#include "TelemetryStream.h"
+#include "TraceRecorder.h"
 #include <Arduino.h>
 #include <cmath>
 
+namespace {
+constexpr uint32_t TICK_MS = 20; // Control period
+} // namespace
+
 MotorTask &MotorTask::getInstance() {
   static uint8_t motor_task_instance_buf[sizeof(MotorTask)];
   static MotorTask *instance = new (motor_task_instance_buf) MotorTask();
@@ -21,8 +30,25 @@ MotorTask::MotorTask()
       _kp(0.002f), _ki(0.0005f), _trackVoltage(14.0f), _maxRpm(3000.0f),
       _vStart(0.0f), _cvPwmDither(0), _cvStictionKick(0), _vKickActive(false),
       _vKickStartTime(0), _resistanceState(ResistanceState::IDLE),
-      _resistanceStartTime(0), _measuredResistance(0.0f), _testMode(false),
-      _testStartTime(0), _testDataIdx(0) {}
+      _resistanceStartTime(0), _measuredResistance(0.0f) {
+  Telemetry &t = Telemetry::getInstance();
+  const uint16_t hz = 1000 / TICK_MS;
+  _channels.target = t.add("target_speed", "step", TelemetryType::U8, hz);
+  _channels.zone = t.add("zone", "", TelemetryType::U8, hz);
+  _channels.forward = t.add("forward", "", TelemetryType::BOOL, hz);
+  _channels.moving = t.add("moving", "", TelemetryType::BOOL, hz);
+  _channels.stalled = t.add("stalled", "", TelemetryType::BOOL, hz);
+  _channels.fault = t.add("fault", "", TelemetryType::BOOL, hz);
+  _channels.duty = t.add("duty", "", TelemetryType::F32, hz);
+  _channels.current = t.add("current", "A", TelemetryType::F32, hz);
+  _channels.voltage = t.add("voltage", "V", TelemetryType::F32, hz);
+  _channels.rpm = t.add("rpm", "rpm", TelemetryType::F32, hz);
+  _channels.ripple = t.add("ripple_freq", "Hz", TelemetryType::F32, hz);
+  _channels.ke = t.add("ke", "V/rpm", TelemetryType::F32, hz);
+  _channels.resistance = t.add("learned_r", "ohm", TelemetryType::F32, hz);
+  _channels.rawAdc = t.add("raw_adc", "counts", TelemetryType::U32, hz);
+  _channels.load = t.add("load", "", TelemetryType::F32, hz);
+}
 
 void MotorTask::start() {
   MotorHal::getInstance().init();
@@ -38,16 +64,23 @@ void MotorTask::_taskEntry(void *param) {
 
 void MotorTask::_loop() {
   TickType_t xLastWakeTime = xTaskGetTickCount();
-  const TickType_t xFrequency = pdMS_TO_TICKS(20); // 50Hz
+  const TickType_t xFrequency = pdMS_TO_TICKS(TICK_MS); // 50Hz
   static float adcBuffer[1024];
   float lastVControl = 0.0f;
+  float adcOffset = 0.0f;
+  PerfLoop &perfLoop = PerfMonitor::getInstance().loop("MotorTask");
 
   while (true) {
     vTaskDelayUntil(&xLastWakeTime, xFrequency);
+    PerfScope perf(perfLoop);
+    TraceScope trace(TRACE_MOTOR, "motor.cycle");
+    // Taken before the target is read, so this cycle acts on its change
+    uint32_t cause = _targetCause.exchange(0, std::memory_order_acquire);
 
     float scalar = MotorHal::getInstance().getCurrentScalar();
     size_t samples = MotorHal::getInstance().getAdcSamples(adcBuffer, 1024);
     float sampleRate = MotorHal::getInstance().getAdcSampleRate();
+    MotorCapture::getInstance().addSamples(adcBuffer, samples, sampleRate);
 
     float avgCurrent = 0.0f;
     float rippleFreq = 0.0f;
@@ -64,7 +97,6 @@ void MotorTask::_loop() {
       float instantAvg = sumCurrent / samples;
       rawMaxAdc = (uint32_t)maxSample;
 
-      static float adcOffset = 0.0f;
       if (fabs(_currentDuty) < 0.01f) {
         adcOffset = (adcOffset * 0.9f) + (instantAvg * 0.1f);
       }
@@ -87,6 +119,7 @@ void MotorTask::_loop() {
     _prevCurrent = avgCurrent;
 
     bool lowSpeedStall = false;
+    float load = 0.0f;
     if (_targetSpeedStep == 0) {
       _adaptiveState = AdaptiveMotorState::STOPPED;
     } else {
@@ -119,6 +152,10 @@ void MotorTask::_loop() {
             (_filteredDiDt > 0.5f)) {
           lowSpeedStall = true;
         }
+        if (_baselineCurrent > 0.0f)
+          load = constrain((avgCurrent / _baselineCurrent - 1.0f) /
+                               (dynamicMultiplier - 1.0f),
+                           0.0f, 1.0f);
         break;
       }
       }
@@ -252,7 +289,13 @@ void MotorTask::_loop() {
       _currentDuty = duty;
     }
 
+    // Signed, in thousandths
+    traceInstant(TRACE_MOTOR, "motor.duty", (int32_t)(_currentDuty * 1000));
     MotorHal::getInstance().setDuty(_currentDuty);
+    if (cause) {
+      LatencyMonitor::getInstance().record(LATENCY_SPEED, cause);
+      BootTimeline::getInstance().mark(BOOT_FIRST_RESPONSE);
+    }
 
     _status.appliedVoltage = _trackVoltage * fabs(_currentDuty);
     _status.current = avgCurrent;
@@ -263,35 +306,61 @@ void MotorTask::_loop() {
     _status.isMoving = rippleConfirm;
     _status.duty = _currentDuty;
     _status.rawAdc = rawMaxAdc;
-
-    // --- TELEMETRY LOGGING (10Hz) ---
-    static unsigned long lastLogTime = 0;
-    if (millis() - lastLogTime >= 100) {
-      lastLogTime = millis();
-
-      uint8_t currentZone = 1; // Default Static
-      if (_targetSpeedStep == 0)
-        currentZone = 0;
-      else if (!rippleConfirm && _targetSpeedStep < 20)
-        currentZone = 2; // Torque
-      else
-        currentZone = 3; // Velocity (PI)
-
-      Log.printf("[NIMRS_DATA] "
-                 "{\"tgt\":%d,\"cur\":%.3f,\"rpm\":%.1f,\"rip_ok\":%d,\"zone\":"
-                 "%d,\"v\":%.2f,\"ke\":%.4f,\"stall\":%d}\n",
-                 _targetSpeedStep, avgCurrent, actualRpm, rippleConfirm ? 1 : 0,
-                 currentZone, _status.appliedVoltage,
-                 _estimator.getBemfConstant(), _status.stalled ? 1 : 0);
-    }
+    _status.load = load;
+
+    // --- TELEMETRY (every tick; formatted, if at all, by the sinks) ---
+    uint8_t zone = 3; // Velocity (PI)
+    if (_targetSpeedStep == 0)
+      zone = 0;
+    else if (!rippleConfirm && _targetSpeedStep < 20)
+      zone = 2; // Torque
+    Telemetry &t = Telemetry::getInstance();
+    t.publish(_channels.target, _targetSpeedStep);
+    t.publish(_channels.zone, zone);
+    t.publish(_channels.forward, _targetDirection);
+    t.publish(_channels.moving, rippleConfirm);
+    t.publish(_channels.stalled, _status.stalled);
+    t.publish(_channels.fault, _status.hardwareFault);
+    t.publish(_channels.duty, _currentDuty);
+    t.publish(_channels.current, avgCurrent);
+    t.publish(_channels.voltage, _status.appliedVoltage);
+    t.publish(_channels.rpm, actualRpm);
+    t.publish(_channels.ripple, rippleFreq);
+    t.publish(_channels.ke, _estimator.getBemfConstant());
+    t.publish(_channels.resistance, _estimator.getMeasuredResistance());
+    t.publish(_channels.rawAdc, rawMaxAdc);
+    t.publish(_channels.load, load);
+    TelemetryStream::getInstance().sample();
+
+    // --- CAPTURE (this tick's record, if armed) ---
+    CaptureCycle cycle = {};
+    cycle.target = _targetSpeedStep;
+    cycle.zone = zone;
+    cycle.flags = (_targetDirection ? TELEMETRY_FORWARD : 0) |
+                  (rippleConfirm ? TELEMETRY_MOVING : 0) |
+                  (_status.stalled ? TELEMETRY_STALLED : 0) |
+                  (_status.hardwareFault ? TELEMETRY_FAULT : 0);
+    cycle.duty = _currentDuty;
+    cycle.current = avgCurrent;
+    cycle.rpm = actualRpm;
+    cycle.ripple = rippleFreq;
+    cycle.ampsPerCount = scalar;
+    cycle.offset = adcOffset;
+    MotorCapture::getInstance().endCycle(cycle);
   }
 }
 
-void MotorTask::setTargetSpeed(uint8_t speedStep, bool forward) {
-  if (_testMode || _resistanceState != ResistanceState::IDLE)
+void MotorTask::setTargetSpeed(uint8_t speedStep, bool forward,
+                               uint32_t cause) {
+  if (_resistanceState != ResistanceState::IDLE)
     return;
+  // Called every millisecond: only a change is worth an event
+  if (speedStep != _targetSpeedStep || forward != _targetDirection)
+    traceInstant(TRACE_MOTOR, "motor.target", speedStep | forward << 8);
   _targetSpeedStep = speedStep;
   _targetDirection = forward;
+  if (cause)
+    _targetCause.store(cause, std::memory_order_release);
 }
 
 void MotorTask::reloadCvs() {
@@ -342,26 +411,3 @@ float MotorTask::getMeasuredResistance() const { return _measuredResistance; }
 float MotorTask::getLearnedResistance() const {
   return _estimator.getMeasuredResistance();
 }
-void MotorTask::startTest() {
-  if (_testMode)
-    return;
-  _testMode = true;
-  _testStartTime = millis();
-  _testDataIdx = 0;
-}
-String MotorTask::getTestJSON() const {
-  String out = "[";
-  for (int i = 0; i < _testDataIdx; i++) {
-    char buf[128];
-    snprintf(buf, sizeof(buf),
-             "{\"t\":%lu,\"tgt\":%u,\"pwm\":%u,\"cur\":%.3f,\"spd\":%.1f}",
-             (unsigned long)_testData[i].t, _testData[i].target,
-             (uint16_t)(fabs(_testData[i].duty) * 1023.0f),
-             _testData[i].current, _testData[i].rpm);
-    out += buf;
-    if (i < _testDataIdx - 1)
-      out += ",";
-  }
-  out += "]";
-  return out;
-}
@@ -5,7 +5,9 @@
 #include "DspFilters.h"
 #include "MotorHal.h"
 #include "RippleDetector.h"
+#include "Telemetry.h"
 #include <Arduino.h>
+#include <atomic>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
@@ -14,7 +16,9 @@ public:
   static MotorTask &getInstance();
 
   void start();
-  void setTargetSpeed(uint8_t speedStep, bool forward);
+  // @p cause: the causality ID (LatencyMonitor) of the packet behind a
+  // change, timed to the first duty that follows it
+  void setTargetSpeed(uint8_t speedStep, bool forward, uint32_t cause = 0);
   void reloadCvs();
 
   struct Status {
@@ -27,6 +31,7 @@ public:
     bool isMoving;
     float duty;
     uint32_t rawAdc;
+    float load; // 0 at the learned baseline current, 1 at the stall threshold
   };
   Status getStatus() const;
 
@@ -37,9 +42,6 @@ public:
   float getMeasuredResistance() const;
   float getLearnedResistance() const;
 
-  void startTest();
-  String getTestJSON() const;
-
 private:
   MotorTask();
 
@@ -55,6 +57,7 @@ private:
 
   uint8_t _targetSpeedStep;
   bool _targetDirection;
+  std::atomic<uint32_t> _targetCause{0}; // Written after the target
   float _currentDuty;
 
   float _piErrorSum;
@@ -88,21 +91,15 @@ private:
 
   Status _status;
 
+  // Telemetry channels, declared once by the constructor
+  struct Channels {
+    Telemetry::Channel target, zone, forward, moving, stalled, fault, duty,
+        current, voltage, rpm, ripple, ke, resistance, rawAdc, load;
+  } _channels;
+
   ResistanceState _resistanceState;
   unsigned long _resistanceStartTime;
   float _measuredResistance;
-
-  bool _testMode;
-  unsigned long _testStartTime;
-  static const int MAX_TEST_POINTS = 100;
-  struct TestPoint {
-    uint32_t t;
-    uint8_t target;
-    float duty;
-    float current;
-    float rpm;
-  } _testData[MAX_TEST_POINTS];
-  int _testDataIdx;
 };
 
 #endif
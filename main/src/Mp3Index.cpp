@@ -0,0 +1,277 @@
+#include "Mp3Index.h"
+#include <cstring>
+
+namespace {
+const uint16_t BITRATE_V1[16] = {0,   32,  40,  48,  56,  64,  80,  96,
+                                 112, 128, 160, 192, 224, 256, 320, 0};
+const uint16_t BITRATE_V2[16] = {0,  8,  16, 24,  32,  40,  48,  56,
+                                 64, 80, 96, 112, 128, 144, 160, 0};
+const uint32_t SAMPLE_RATE_V1[3] = {44100, 48000, 32000};
+
+const char MAGIC[4] = {'M', 'P', '3', 'I'};
+const uint8_t FORMAT_VERSION = 1;
+const size_t SERIAL_HEADER = 28;
+
+uint32_t be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+uint32_t le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+void put32(std::vector<uint8_t> &v, uint32_t x) {
+  for (int i = 0; i < 4; i++)
+    v.push_back((x >> (8 * i)) & 0xFF);
+}
+void put16(std::vector<uint8_t> &v, uint16_t x) {
+  v.push_back(x & 0xFF);
+  v.push_back(x >> 8);
+}
+
+bool sameStream(const Mp3FrameInfo &a, const Mp3FrameInfo &b) {
+  return a.version == b.version && a.sampleRate == b.sampleRate;
+}
+
+// Reads main_data_begin from the side info that follows header (and CRC)
+uint16_t readMainDataBegin(const uint8_t *frame, const Mp3FrameInfo &info) {
+  const uint8_t *side = frame + ((frame[1] & 0x01) ? 4 : 6);
+  if (info.version == 1)
+    return (side[0] << 1) | (side[1] >> 7);
+  return side[0];
+}
+
+// Encoder delay/padding from a Xing/Info frame followed by a LAME tag
+bool parseXingLame(const uint8_t *frame, size_t len, const Mp3FrameInfo &info,
+                   uint16_t &delay, uint16_t &padding) {
+  size_t pos = info.headerBytes;
+  if (pos + 8 > len || (memcmp(frame + pos, "Xing", 4) != 0 &&
+                        memcmp(frame + pos, "Info", 4) != 0))
+    return false;
+  uint32_t flags = be32(frame + pos + 4);
+  pos += 8;
+  if (flags & 0x1)
+    pos += 4; // Frame count
+  if (flags & 0x2)
+    pos += 4; // Byte count
+  if (flags & 0x4)
+    pos += 100; // TOC
+  if (flags & 0x8)
+    pos += 4; // Quality
+
+  // LAME (and libavcodec's LAME-compatible) tag: 9-byte encoder string,
+  // then delay and padding packed as two 12-bit fields at offset 21.
+  if (pos + 24 > len || (memcmp(frame + pos, "LAME", 4) != 0 &&
+                         memcmp(frame + pos, "Lavc", 4) != 0 &&
+                         memcmp(frame + pos, "Lavf", 4) != 0))
+    return false;
+  const uint8_t *dp = frame + pos + 21;
+  delay = (dp[0] << 4) | (dp[1] >> 4);
+  padding = ((dp[1] & 0x0F) << 8) | dp[2];
+  return true;
+}
+} // namespace
+
+bool parseMp3FrameHeader(const uint8_t *h, Mp3FrameInfo &out) {
+  if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0)
+    return false;
+  uint8_t versionBits = (h[1] >> 3) & 0x03;
+  uint8_t layerBits = (h[1] >> 1) & 0x03;
+  if (versionBits == 1 || layerBits != 1) // Reserved, or not Layer III
+    return false;
+  uint8_t bitrateIdx = h[2] >> 4;
+  uint8_t rateIdx = (h[2] >> 2) & 0x03;
+  if (bitrateIdx == 0 || bitrateIdx == 15 || rateIdx == 3)
+    return false; // Free format is not supported
+
+  bool v1 = versionBits == 3;
+  out.version = v1 ? 1 : (versionBits == 2 ? 2 : 25);
+  uint8_t rateShift = v1 ? 0 : (out.version == 2 ? 1 : 2);
+  out.sampleRate = SAMPLE_RATE_V1[rateIdx] >> rateShift;
+  out.samples = v1 ? 1152 : 576;
+  out.channels = (h[3] >> 6) == 3 ? 1 : 2;
+
+  uint32_t bitrate = (v1 ? BITRATE_V1 : BITRATE_V2)[bitrateIdx] * 1000;
+  uint8_t pad = (h[2] >> 1) & 0x01;
+  out.frameLen = (v1 ? 144 : 72) * bitrate / out.sampleRate + pad;
+
+  bool crc = (h[1] & 0x01) == 0;
+  uint8_t sideInfo =
+      v1 ? (out.channels == 1 ? 17 : 32) : (out.channels == 1 ? 9 : 17);
+  out.headerBytes = 4 + (crc ? 2 : 0) + sideInfo;
+  return out.frameLen > out.headerBytes;
+}
+
+void Mp3Index::clear() {
+  _frames.clear();
+  _sampleRate = _sourceSize = 0;
+  _samplesPerFrame = _encoderDelay = _encoderPadding = 0;
+  _channels = _headerBytes = 0;
+  _gapless = false;
+}
+
+bool Mp3Index::build(const ReadFn &read, uint32_t size) {
+  clear();
+  _sourceSize = size;
+
+  // Skip an ID3v2 tag (syncsafe size, optional footer)
+  uint8_t buf[192];
+  uint32_t pos = 0;
+  if (read(0, buf, 10) == 10 && memcmp(buf, "ID3", 3) == 0) {
+    pos = 10 + (((buf[6] & 0x7F) << 21) | ((buf[7] & 0x7F) << 14) |
+                ((buf[8] & 0x7F) << 7) | (buf[9] & 0x7F));
+    if (buf[5] & 0x10)
+      pos += 10;
+  }
+
+  Mp3FrameInfo first;
+  bool haveFirst = false;
+  while (pos + 4 <= size) {
+    size_t n = read(pos, buf, sizeof(buf));
+    if (n < 4)
+      break;
+
+    Mp3FrameInfo info;
+    bool ok = parseMp3FrameHeader(buf, info) &&
+              pos + info.frameLen <= size && n >= info.headerBytes &&
+              (!haveFirst || sameStream(info, first));
+    if (ok && !haveFirst) {
+      // Confirm the first sync with the header that should follow it
+      uint8_t next[4];
+      Mp3FrameInfo nextInfo;
+      ok = pos + info.frameLen + 4 > size ||
+           (read(pos + info.frameLen, next, 4) == 4 &&
+            parseMp3FrameHeader(next, nextInfo) && sameStream(info, nextInfo));
+    }
+
+    if (!ok) {
+      // Resync: search this window for the next plausible header
+      size_t skip = 1;
+      while (skip + 4 <= n) {
+        Mp3FrameInfo probe;
+        if (parseMp3FrameHeader(buf + skip, probe) &&
+            (!haveFirst || sameStream(probe, first)))
+          break;
+        skip++;
+      }
+      pos += (skip + 4 <= n) ? skip : (n > 3 ? n - 3 : 1);
+      continue;
+    }
+
+    if (!haveFirst) {
+      haveFirst = true;
+      first = info;
+      _sampleRate = info.sampleRate;
+      _samplesPerFrame = info.samples;
+      _channels = info.channels;
+      _headerBytes = info.headerBytes;
+      // A Xing/Info frame carries metadata only; it is not indexed
+      if (parseXingLame(buf, n, info, _encoderDelay, _encoderPadding) ||
+          (n >= (size_t)info.headerBytes + 4 &&
+           (memcmp(buf + info.headerBytes, "Xing", 4) == 0 ||
+            memcmp(buf + info.headerBytes, "Info", 4) == 0))) {
+        _gapless = _encoderDelay != 0 || _encoderPadding != 0;
+        pos += info.frameLen;
+        continue;
+      }
+    }
+
+    if (pos > MAX_OFFSET) {
+      clear();
+      return false;
+    }
+    _frames.push_back(pos | ((uint32_t)readMainDataBegin(buf, info) << 23));
+    pos += info.frameLen;
+  }
+  return valid();
+}
+
+uint32_t Mp3Index::primingSamples() const {
+  return _gapless ? _encoderDelay + DECODER_DELAY : 0;
+}
+
+uint32_t Mp3Index::validSamples() const {
+  uint32_t total = frameCount() * _samplesPerFrame;
+  uint32_t trim = _gapless ? _encoderDelay + _encoderPadding : 0;
+  return total > trim ? total - trim : 0;
+}
+
+uint32_t Mp3Index::_payload(uint32_t i) const {
+  uint32_t len = (i + 1 < frameCount() ? frameOffset(i + 1) : _sourceSize) -
+                 frameOffset(i);
+  return len > _headerBytes ? len - _headerBytes : 0;
+}
+
+bool Mp3Index::planSeek(uint32_t sample, Mp3SeekPlan &plan) const {
+  if (!valid() || _samplesPerFrame == 0)
+    return false;
+  uint32_t target = sample / _samplesPerFrame;
+  if (target >= frameCount())
+    return false;
+
+  // Back up until the frames before the target hold its main data, plus one
+  // frame so the IMDCT overlap going into the target is real.
+  uint32_t start = target;
+  uint32_t reservoir = 0;
+  while (start > 0 && reservoir < mainDataBegin(target))
+    reservoir += _payload(--start);
+  if (start > 0)
+    start--;
+
+  // Replay the reservoir to count the pre-roll frames that will decode
+  uint32_t decoded = 0;
+  reservoir = 0;
+  for (uint32_t i = start; i < target; i++) {
+    if (mainDataBegin(i) <= reservoir)
+      decoded++;
+    reservoir += _payload(i);
+  }
+
+  plan.frame = start;
+  plan.byteOffset = frameOffset(start);
+  plan.outputSample = (target - decoded) * _samplesPerFrame;
+  return true;
+}
+
+std::vector<uint8_t> Mp3Index::serialize() const {
+  std::vector<uint8_t> out;
+  out.reserve(SERIAL_HEADER + 4 * _frames.size());
+  for (char c : MAGIC)
+    out.push_back((uint8_t)c);
+  out.push_back(FORMAT_VERSION);
+  out.push_back(_channels);
+  out.push_back(_headerBytes);
+  out.push_back(_gapless ? 1 : 0);
+  put32(out, _sampleRate);
+  put16(out, _samplesPerFrame);
+  put16(out, _encoderDelay);
+  put16(out, _encoderPadding);
+  put16(out, 0);
+  put32(out, _sourceSize);
+  put32(out, _frames.size());
+  for (uint32_t f : _frames)
+    put32(out, f);
+  return out;
+}
+
+bool Mp3Index::deserialize(const uint8_t *data, size_t len) {
+  clear();
+  if (len < SERIAL_HEADER || memcmp(data, MAGIC, 4) != 0 ||
+      data[4] != FORMAT_VERSION)
+    return false;
+  uint32_t count = le32(data + 24);
+  if (len != SERIAL_HEADER + 4 * (size_t)count)
+    return false;
+
+  _channels = data[5];
+  _headerBytes = data[6];
+  _gapless = data[7] & 1;
+  _sampleRate = le32(data + 8);
+  _samplesPerFrame = le16(data + 12);
+  _encoderDelay = le16(data + 14);
+  _encoderPadding = le16(data + 16);
+  _sourceSize = le32(data + 20);
+  _frames.resize(count);
+  for (uint32_t i = 0; i < count; i++)
+    _frames[i] = le32(data + SERIAL_HEADER + 4 * i);
+  return true;
+}
@@ -0,0 +1,114 @@
+#ifndef MP3_INDEX_H
+#define MP3_INDEX_H
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Frame-offset index for MPEG-1/2/2.5 Layer III files.
+ *
+ * Built once per asset and stored as a sidecar (see Mp3Sidecar.h), it lets
+ * the player start decoding at any frame instead of re-reading the file from
+ * the top, and carries the LAME/Xing encoder delay and padding so priming
+ * and padding samples can be cut for gapless loops.
+ *
+ * Sample positions used here are in "decoded stream" coordinates: sample 0
+ * is the first sample Helix outputs for the first audio frame (the Xing/Info
+ * frame is not an audio frame and is never fed to the decoder).
+ */
+
+struct Mp3FrameInfo {
+  uint32_t sampleRate = 0;
+  uint16_t frameLen = 0;   // Bytes, including header and padding
+  uint16_t samples = 0;    // Per channel: 1152 (MPEG-1) or 576
+  uint8_t channels = 0;
+  uint8_t headerBytes = 0; // Header + CRC + side info
+  uint8_t version = 0;     // 1, 2 or 25 (MPEG-2.5)
+};
+
+/**
+ * @brief Decodes a 4-byte Layer III frame header.
+ * @return false for anything that is not a usable Layer III header.
+ */
+bool parseMp3FrameHeader(const uint8_t *h, Mp3FrameInfo &out);
+
+// Where to restart decoding to land exactly on a sample.
+struct Mp3SeekPlan {
+  uint32_t frame = 0;        // First frame fed to a freshly started decoder
+  uint32_t byteOffset = 0;   // File offset of that frame
+  uint32_t outputSample = 0; // Stream position of the first decoded sample
+};
+
+class Mp3Index {
+public:
+  // Samples of delay Helix (like every ISO-derived decoder) adds
+  static constexpr uint16_t DECODER_DELAY = 529;
+  // Offsets are packed with the 9-bit main_data_begin into one word
+  static constexpr uint32_t MAX_OFFSET = (1UL << 23) - 1;
+
+  using ReadFn = std::function<size_t(uint32_t offset, uint8_t *buf,
+                                      size_t len)>;
+
+  /**
+   * @brief Scans a file through @p read and fills the index.
+   * @param size File size in bytes.
+   */
+  bool build(const ReadFn &read, uint32_t size);
+
+  std::vector<uint8_t> serialize() const;
+  bool deserialize(const uint8_t *data, size_t len);
+
+  bool valid() const { return !_frames.empty(); }
+  void clear();
+
+  uint32_t frameCount() const { return _frames.size(); }
+  uint32_t frameOffset(uint32_t i) const { return _frames[i] & MAX_OFFSET; }
+  uint16_t mainDataBegin(uint32_t i) const { return _frames[i] >> 23; }
+
+  uint32_t sampleRate() const { return _sampleRate; }
+  uint8_t channels() const { return _channels; }
+  uint16_t samplesPerFrame() const { return _samplesPerFrame; }
+  uint32_t sourceSize() const { return _sourceSize; }
+  bool hasGaplessInfo() const { return _gapless; }
+  uint16_t encoderDelay() const { return _encoderDelay; }
+  uint16_t encoderPadding() const { return _encoderPadding; }
+
+  /**
+   * @brief Decoded samples to drop before the first real sample.
+   * Zero when the file has no LAME/Xing tag.
+   */
+  uint32_t primingSamples() const;
+
+  /**
+   * @brief Real samples (per channel) after priming and padding are cut.
+   */
+  uint32_t validSamples() const;
+
+  /**
+   * @brief Plans a restart that reaches @p sample exactly.
+   *
+   * Layer III frames borrow main data from earlier frames (bit reservoir)
+   * and overlap with the previous frame's IMDCT output, so decoding starts a
+   * few frames early. The plan predicts which of those pre-roll frames a
+   * fresh decoder can decode, so the caller knows the stream position of
+   * the first sample it will receive.
+   */
+  bool planSeek(uint32_t sample, Mp3SeekPlan &plan) const;
+
+private:
+  uint32_t _payload(uint32_t i) const;
+
+  std::vector<uint32_t> _frames; // offset | main_data_begin << 23
+  uint32_t _sampleRate = 0;
+  uint32_t _sourceSize = 0;
+  uint16_t _samplesPerFrame = 0;
+  uint16_t _encoderDelay = 0;
+  uint16_t _encoderPadding = 0;
+  uint8_t _channels = 0;
+  uint8_t _headerBytes = 0;
+  bool _gapless = false;
+};
+
+#endif // MP3_INDEX_H
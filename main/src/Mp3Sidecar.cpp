@@ -0,0 +1,70 @@
+#include "Mp3Sidecar.h"
+#include "Logger.h"
+#include <LittleFS.h>
+#include <vector>
+
+String mp3SidecarPath(const String &mp3Path) { return mp3Path + ".idx"; }
+
+bool buildMp3Sidecar(const String &mp3Path) {
+  File mp3 = LittleFS.open(mp3Path, "r");
+  if (!mp3)
+    return false;
+
+  unsigned long start = millis();
+  Mp3Index index;
+  bool ok = index.build(
+      [&mp3](uint32_t offset, uint8_t *buf, size_t len) -> size_t {
+        return mp3.seek(offset) ? mp3.read(buf, len) : 0;
+      },
+      mp3.size());
+  mp3.close();
+  if (!ok) {
+    Log.printf("Audio: %s has no indexable MP3 frames\n", mp3Path.c_str());
+    return false;
+  }
+
+  std::vector<uint8_t> data = index.serialize();
+  File out = LittleFS.open(mp3SidecarPath(mp3Path), "w");
+  if (!out || out.write(data.data(), data.size()) != data.size()) {
+    Log.printf("Audio: Failed to write index for %s\n", mp3Path.c_str());
+    if (out)
+      out.close();
+    LittleFS.remove(mp3SidecarPath(mp3Path));
+    return false;
+  }
+  out.close();
+
+  Log.printf("Audio: Indexed %s (%u frames, delay %u, padding %u) in %lu ms\n",
+             mp3Path.c_str(), (unsigned)index.frameCount(),
+             index.encoderDelay(), index.encoderPadding(),
+             millis() - start);
+  return true;
+}
+
+bool loadMp3Sidecar(const String &mp3Path, Mp3Index &index) {
+  index.clear();
+  File idx = LittleFS.open(mp3SidecarPath(mp3Path), "r");
+  if (!idx)
+    return false;
+  std::vector<uint8_t> data(idx.size());
+  bool ok = idx.read(data.data(), data.size()) == data.size() &&
+            index.deserialize(data.data(), data.size());
+  idx.close();
+  if (!ok)
+    return false;
+
+  // A re-uploaded MP3 with a different size makes the index stale
+  File mp3 = LittleFS.open(mp3Path, "r");
+  ok = mp3 && mp3.size() == index.sourceSize();
+  if (mp3)
+    mp3.close();
+  if (!ok)
+    index.clear();
+  return ok;
+}
+
+void ensureMp3Sidecar(const String &mp3Path) {
+  Mp3Index index;
+  if (!loadMp3Sidecar(mp3Path, index))
+    buildMp3Sidecar(mp3Path);
+}
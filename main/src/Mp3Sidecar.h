@@ -0,0 +1,30 @@
+#ifndef MP3_SIDECAR_H
+#define MP3_SIDECAR_H
+
+#include "Mp3Index.h"
+#include <Arduino.h>
+
+/**
+ * Mp3Index persistence: "/horn.mp3" is indexed into "/horn.mp3.idx". The
+ * sidecar records the source size, so a replaced MP3 invalidates it.
+ */
+
+String mp3SidecarPath(const String &mp3Path);
+
+/**
+ * @brief Scans @p mp3Path and writes its sidecar.
+ * @return true if the sidecar was written.
+ */
+bool buildMp3Sidecar(const String &mp3Path);
+
+/**
+ * @brief Loads the sidecar if it exists and matches the MP3 on disk.
+ */
+bool loadMp3Sidecar(const String &mp3Path, Mp3Index &index);
+
+/**
+ * @brief Builds the sidecar unless a valid one is already present.
+ */
+void ensureMp3Sidecar(const String &mp3Path);
+
+#endif
@@ -0,0 +1,258 @@
+#include "PerfMonitor.h"
+#include <algorithm>
+#include <cstring>
+
+uint32_t perfBucketLowUs(uint8_t bucket) {
+  if (bucket < 2)
+    return bucket;
+  // Bucket 2m starts at 2^m, and 2m + 1 half way to 2^(m + 1)
+  uint32_t low = 1u << (bucket / 2);
+  return bucket & 1 ? low + low / 2 : low;
+}
+
+void PerfHistogram::reset() {
+  count.store(0);
+  for (auto &b : buckets)
+    b.store(0);
+  sumTicks.store(0);
+  maxTicks.store(0);
+}
+
+PerfLoop &PerfMonitor::loop(const char *name) {
+  _lock();
+  PerfLoop *found = nullptr;
+  for (uint8_t i = 0; i < _loopCount && !found; i++)
+    if (strncmp(_loops[i]._name, name, sizeof(_loops[i]._name) - 1) == 0)
+      found = &_loops[i];
+  if (!found && _loopCount < MAX_LOOPS) {
+    found = &_loops[_loopCount++];
+    strncpy(found->_name, name, sizeof(found->_name) - 1);
+    found->_cyclesPerUs = getCpuFrequencyMhz();
+  }
+  _unlock();
+  return found ? *found : _spare;
+}
+
+void PerfMonitor::start() {
+  if (_timer)
+    return;
+  _lastSampleMs = millis();
+  _timer = xTimerCreate("PerfSample", pdMS_TO_TICKS(WINDOW_MS), pdTRUE,
+                        nullptr, _timerCallback);
+  if (_timer)
+    xTimerStart(_timer, 0);
+}
+
+void PerfMonitor::_timerCallback(TimerHandle_t timer) {
+  getInstance().sample();
+}
+
+void PerfMonitor::sample() {
+  // Runs on the timer task: if a report holds the lock, this window just
+  // runs on to the next tick
+  if (xSemaphoreTake(_mutex, 0) != pdTRUE)
+    return;
+  uint32_t now = millis();
+  _windowMs = now - _lastSampleMs;
+  _lastSampleMs = now;
+
+  if (_windowMs) {
+    for (uint8_t i = 0; i < _loopCount; i++) {
+      PerfLoop &l = _loops[i];
+      PerfHistogram *hists[2] = {&l.period, &l.busy};
+      for (int h = 0; h < 2; h++) {
+        uint32_t count = hists[h]->count.load(std::memory_order_acquire);
+        uint32_t sum = hists[h]->sumTicks.load(std::memory_order_relaxed);
+        uint32_t n = count - l._seenCount[h];
+        uint32_t cycles = sum - l._seenSum[h];
+        l._windowMeanUs[h] = n ? (float)cycles / n / l._cyclesPerUs : 0.0f;
+        if (h == 1) {
+          l._windowCount = n;
+          uint64_t windowCycles = (uint64_t)_windowMs * 1000 * l._cyclesPerUs;
+          l._loadPermille = (uint16_t)std::min<uint64_t>(
+              1000, (uint64_t)cycles * 1000 / windowCycles);
+        }
+        l._seenCount[h] = count;
+        l._seenSum[h] = sum;
+      }
+    }
+    _sampleTasks();
+  }
+  _unlock();
+}
+
+void PerfMonitor::_sampleTasks() {
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+  // Static: the timer task's stack is small
+  static TaskStatus_t status[MAX_TASKS];
+  static Task previous[MAX_TASKS];
+  uint32_t totalRunTime;
+  UBaseType_t n = uxTaskGetSystemState(status, MAX_TASKS, &totalRunTime);
+  // More tasks than MAX_TASKS: none are returned
+  memcpy(previous, _tasks, _taskCount * sizeof(Task));
+  uint8_t previousCount = _taskCount;
+  _taskCount = 0;
+
+  // The run-time counter is esp_timer's µs, so a window of one core's time
+  // is the window in µs
+  uint32_t windowUs = _windowMs * 1000;
+  for (UBaseType_t i = 0; i < n; i++) {
+    const TaskStatus_t &s = status[i];
+    Task &t = _tasks[_taskCount++];
+    const Task *before = nullptr;
+    for (uint8_t p = 0; p < previousCount && !before; p++)
+      if (previous[p].handle == s.xHandle)
+        before = &previous[p];
+
+    t.handle = s.xHandle;
+    strncpy(t.name, s.pcTaskName, sizeof(t.name) - 1);
+    t.name[sizeof(t.name) - 1] = 0;
+#if configTASKLIST_INCLUDE_COREID
+    t.core = s.xCoreID == tskNO_AFFINITY ? 0xFF : (uint8_t)s.xCoreID;
+#else
+    t.core = 0xFF;
+#endif
+    t.priority = (uint8_t)s.uxCurrentPriority;
+    t.runTime = s.ulRunTimeCounter;
+    // New since the last sample: its first window starts now
+    uint32_t ran = before ? s.ulRunTimeCounter - before->runTime : 0;
+    t.loadPermille = (uint16_t)std::min<uint64_t>(
+        1000, (uint64_t)ran * 1000 / windowUs);
+    t.peakPermille = std::max(t.loadPermille,
+                              before ? before->peakPermille : (uint16_t)0);
+    // In bytes on ESP-IDF, and only ever falls
+    t.stackFreeMin = s.usStackHighWaterMark;
+  }
+#endif
+}
+
+void PerfMonitor::reset() {
+  _lock();
+  for (uint8_t i = 0; i < _loopCount; i++) {
+    PerfLoop &l = _loops[i];
+    l.period.reset();
+    l.busy.reset();
+    memset(l._seenCount, 0, sizeof(l._seenCount));
+    memset(l._seenSum, 0, sizeof(l._seenSum));
+  }
+  for (uint8_t i = 0; i < _taskCount; i++)
+    _tasks[i].peakPermille = _tasks[i].loadPermille;
+  _unlock();
+}
+
+namespace {
+void histToJson(JsonObject out, const PerfHistogram &h, float meanUs,
+                uint32_t cyclesPerUs) {
+  out["count"] = h.count.load();
+  out["mean_us"] = meanUs;
+  out["max_us"] = (float)h.maxTicks.load() / cyclesPerUs;
+  JsonArray buckets = out["buckets"].to<JsonArray>();
+  for (const auto &b : h.buckets)
+    buckets.add(b.load());
+}
+
+PerfHistRecord histRecord(const PerfHistogram &h, float meanUs,
+                          uint32_t cyclesPerUs) {
+  PerfHistRecord r = {};
+  r.count = h.count.load();
+  r.meanUs = meanUs;
+  r.maxUs = (float)h.maxTicks.load() / cyclesPerUs;
+  for (uint8_t b = 0; b < PerfHistogram::BUCKETS; b++)
+    r.buckets[b] = h.buckets[b].load();
+  return r;
+}
+} // namespace
+
+void PerfMonitor::getStatus(JsonObject out) {
+  _lock();
+  out["window_ms"] = _windowMs;
+  out["uptime_ms"] = (uint32_t)millis();
+
+  JsonArray edges = out["bucket_edges_us"].to<JsonArray>();
+  for (uint8_t b = 0; b < PerfHistogram::BUCKETS; b++)
+    edges.add(perfBucketLowUs(b));
+
+  // A core's load is what its idle task did not get
+  JsonArray cores = out["cores"].to<JsonArray>();
+  for (uint8_t i = 0; i < _taskCount; i++) {
+    const Task &t = _tasks[i];
+    if (strncmp(t.name, "IDLE", 4) == 0 && t.core != 0xFF) {
+      JsonObject core = cores.add<JsonObject>();
+      core["core"] = t.core;
+      core["load_pct"] = (1000 - t.loadPermille) / 10.0f;
+    }
+  }
+
+  JsonArray tasks = out["tasks"].to<JsonArray>();
+  for (uint8_t i = 0; i < _taskCount; i++) {
+    const Task &t = _tasks[i];
+    JsonObject task = tasks.add<JsonObject>();
+    task["name"] = t.name;
+    if (t.core != 0xFF) // Unpinned: no core
+      task["core"] = t.core;
+    task["priority"] = t.priority;
+    task["load_pct"] = t.loadPermille / 10.0f;
+    task["peak_pct"] = t.peakPermille / 10.0f;
+    task["stack_free_min"] = t.stackFreeMin;
+  }
+
+  JsonArray loops = out["loops"].to<JsonArray>();
+  for (uint8_t i = 0; i < _loopCount; i++) {
+    const PerfLoop &l = _loops[i];
+    JsonObject loop = loops.add<JsonObject>();
+    loop["name"] = l._name;
+    loop["window_count"] = l._windowCount;
+    loop["load_pct"] = l._loadPermille / 10.0f;
+    histToJson(loop["period"].to<JsonObject>(), l.period, l._windowMeanUs[0],
+               l._cyclesPerUs);
+    histToJson(loop["busy"].to<JsonObject>(), l.busy, l._windowMeanUs[1],
+               l._cyclesPerUs);
+  }
+  _unlock();
+}
+
+size_t PerfMonitor::size() {
+  _lock();
+  size_t bytes = sizeof(PerfHeader) + _taskCount * sizeof(PerfTaskRecord) +
+                 _loopCount * sizeof(PerfLoopRecord);
+  _unlock();
+  return bytes;
+}
+
+bool PerfMonitor::write(Print &out) {
+  _lock();
+  PerfHeader header = {};
+  header.magic = PERF_MAGIC;
+  header.version = PERF_VERSION;
+  header.count = _taskCount + _loopCount;
+  header.tasks = _taskCount;
+  header.buckets = PerfHistogram::BUCKETS;
+  header.windowMs = _windowMs;
+  header.uptimeMs = millis();
+  bool ok = out.write((const uint8_t *)&header, sizeof(header)) ==
+            sizeof(header);
+
+  for (uint8_t i = 0; i < _taskCount && ok; i++) {
+    const Task &t = _tasks[i];
+    PerfTaskRecord r = {};
+    memcpy(r.name, t.name, sizeof(r.name));
+    r.core = t.core;
+    r.priority = t.priority;
+    r.loadPermille = t.loadPermille;
+    r.peakPermille = t.peakPermille;
+    r.stackFreeMin = t.stackFreeMin;
+    ok = out.write((const uint8_t *)&r, sizeof(r)) == sizeof(r);
+  }
+
+  for (uint8_t i = 0; i < _loopCount && ok; i++) {
+    const PerfLoop &l = _loops[i];
+    PerfLoopRecord r = {};
+    memcpy(r.name, l._name, sizeof(r.name));
+    r.loadPermille = l._loadPermille;
+    r.period = histRecord(l.period, l._windowMeanUs[0], l._cyclesPerUs);
+    r.busy = histRecord(l.busy, l._windowMeanUs[1], l._cyclesPerUs);
+    ok = out.write((const uint8_t *)&r, sizeof(r)) == sizeof(r);
+  }
+  _unlock();
+  return ok;
+}
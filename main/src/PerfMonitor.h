@@ -0,0 +1,245 @@
+#ifndef PERF_MONITOR_H
+#define PERF_MONITOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <esp_cpu.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <freertos/timers.h>
+
+/**
+ * @brief Histogram of durations in fixed half-octave buckets: bucket b
+ * starts at perfBucketLowUs(b) µs (0, 1, 2, 3, 4, 6, 8, 12, 16, 24, ...),
+ * and the last one takes everything longer. One writer at a time; any task
+ * may read.
+ *
+ * Durations are given in ticks of the caller's clock: CPU cycles for a
+ * PerfLoop, µs for LatencyMonitor (addUs()). The ticks per µs only pick the
+ * bucket; sumTicks and maxTicks stay in ticks, and readers convert them.
+ */
+struct PerfHistogram {
+  static constexpr uint8_t BUCKETS = 36; // The last starts at ~197 ms
+
+  std::atomic<uint32_t> buckets[BUCKETS] = {};
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> sumTicks{0}; // Wraps; differences over a window hold
+  std::atomic<uint32_t> maxTicks{0};
+
+  __attribute__((always_inline)) static inline uint8_t bucketOf(uint32_t us) {
+    if (us < 2)
+      return us;
+    uint8_t msb = 31 - __builtin_clz(us);
+    uint8_t b = 2 * msb + ((us >> (msb - 1)) & 1);
+    return b < BUCKETS ? b : BUCKETS - 1;
+  }
+
+  // Inline, so the 20 kHz ISR can record from IRAM
+  __attribute__((always_inline)) inline void add(uint32_t ticks,
+                                                 uint32_t ticksPerUs) {
+    auto bump = [](std::atomic<uint32_t> &v, uint32_t by) {
+      v.store(v.load(std::memory_order_relaxed) + by,
+              std::memory_order_relaxed);
+    };
+    bump(buckets[bucketOf(ticks / ticksPerUs)], 1);
+    bump(sumTicks, ticks);
+    if (ticks > maxTicks.load(std::memory_order_relaxed))
+      maxTicks.store(ticks, std::memory_order_relaxed);
+    bump(count, 1); // Last: a reader that sees it sees the rest
+  }
+  void addUs(uint32_t us) { add(us, 1); } // Ticks are then µs
+
+  void reset();
+};
+
+uint32_t perfBucketLowUs(uint8_t bucket);
+
+/**
+ * @brief One instrumented loop: how long between the starts of its
+ * iterations (the period) and how long each one works (busy).
+ *
+ * Times come from the CPU cycle counter, which is per core: the loop must
+ * run pinned, as all of ours do. A period over 17 s (2^32 cycles) wraps.
+ */
+class PerfLoop {
+public:
+  // At the top of an iteration, after any wait
+  __attribute__((always_inline)) inline void begin() {
+    uint32_t now = cycles();
+    if (_started)
+      period.add(now - _start, _cyclesPerUs);
+    _start = now;
+    _started = true;
+  }
+  // When its work is done
+  __attribute__((always_inline)) inline void end() {
+    busy.add(cycles() - _start, _cyclesPerUs);
+  }
+
+  __attribute__((always_inline)) static inline uint32_t cycles() {
+    return esp_cpu_get_cycle_count();
+  }
+
+  const char *name() const { return _name; }
+
+  PerfHistogram period;
+  PerfHistogram busy;
+
+private:
+  friend class PerfMonitor;
+
+  char _name[16] = {};
+  uint32_t _cyclesPerUs = 240;
+  uint32_t _start = 0;
+  bool _started = false;
+
+  // The last window, as PerfMonitor::sample() saw it
+  uint32_t _seenCount[2] = {};
+  uint32_t _seenSum[2] = {};
+  uint32_t _windowCount = 0;
+  float _windowMeanUs[2] = {}; // Period, busy
+  uint16_t _loadPermille = 0;  // Busy share of one core
+};
+
+// Times one iteration of @p loop: begin() now, end() at the end of scope
+class PerfScope {
+public:
+  __attribute__((always_inline)) explicit PerfScope(PerfLoop &loop)
+      : _loop(loop) {
+    _loop.begin();
+  }
+  __attribute__((always_inline)) ~PerfScope() { _loop.end(); }
+
+private:
+  PerfLoop &_loop;
+};
+
+/**
+ * @brief The /api/perf report, as downloaded with ?format=bin (little-endian,
+ * no padding): this header, `tasks` PerfTaskRecords, then the rest of the
+ * `count` records as PerfLoopRecords. It opens like a TelemetryBatch (magic,
+ * version, record count), so one host check tells the two formats apart.
+ * tools/perf_report.py decodes this layout; change PERF_VERSION with it.
+ */
+struct __attribute__((packed)) PerfHeader {
+  uint16_t magic; // "NP"
+  uint8_t version;
+  uint8_t count; // Records: tasks, then loops
+  uint8_t tasks;
+  uint8_t buckets; // Per histogram; see PerfHistogram
+  uint16_t reserved;
+  uint32_t windowMs;
+  uint32_t uptimeMs;
+};
+static_assert(sizeof(PerfHeader) == 16, "Wire layout");
+
+struct __attribute__((packed)) PerfTaskRecord {
+  char name[16];
+  uint8_t core;     // 0xFF: either
+  uint8_t priority; // Current, so raised while it lends a mutex
+  uint16_t loadPermille; // Of one core, over the last window
+  uint16_t peakPermille; // Highest window since reset
+  uint16_t reserved;
+  uint32_t stackFreeMin; // Bytes never used, since the task started
+};
+static_assert(sizeof(PerfTaskRecord) == 28, "Wire layout");
+
+struct __attribute__((packed)) PerfHistRecord {
+  uint32_t count;
+  float meanUs; // Over the last window
+  float maxUs;  // Since reset
+  uint32_t buckets[PerfHistogram::BUCKETS];
+};
+
+struct __attribute__((packed)) PerfLoopRecord {
+  char name[16];
+  uint16_t loadPermille; // Busy share of one core, over the last window
+  uint16_t reserved;
+  PerfHistRecord period;
+  PerfHistRecord busy;
+};
+static_assert(sizeof(PerfLoopRecord) == 332, "Wire layout");
+
+static constexpr uint16_t PERF_MAGIC = 0x504E;
+static constexpr uint8_t PERF_VERSION = 2;
+
+/**
+ * @brief Where the CPU goes: per-task load and stack headroom, and per-loop
+ * timing histograms.
+ *
+ * Every WINDOW_MS a timer samples FreeRTOS's run-time stats for every task,
+ * ours and the WiFi stack's alike: its share of a core over the window,
+ * the highest share seen, and its stack high-water mark. Time spent in
+ * interrupts is charged to whatever task they interrupt, which is why the
+ * 20 kHz motor ISR is a loop of its own. Without configGENERATE_RUN_TIME_STATS
+ * (the host build) there are no task records.
+ *
+ * The loops are declared with loop() and timed with PerfScope; recording is
+ * a cycle-counter read and a few relaxed stores, so it is cheap enough for
+ * the ISR. The same sample turns each loop's counters into its last
+ * window's mean period, mean busy time and load.
+ */
+class PerfMonitor {
+public:
+  static constexpr uint8_t MAX_TASKS = 24;
+  static constexpr uint8_t MAX_LOOPS = 8;
+  static constexpr uint32_t WINDOW_MS = 1000;
+  static constexpr size_t MAX_SIZE = sizeof(PerfHeader) +
+                                     MAX_TASKS * sizeof(PerfTaskRecord) +
+                                     MAX_LOOPS * sizeof(PerfLoopRecord);
+
+  static PerfMonitor &getInstance() {
+    static PerfMonitor instance;
+    return instance;
+  }
+
+  /**
+   * @brief The loop named @p name, declared on first use; the name must
+   * outlive the monitor. Past MAX_LOOPS, a spare that is never reported.
+   */
+  PerfLoop &loop(const char *name);
+
+  void start(); // Samples every WINDOW_MS from now on
+  void sample();
+  void reset(); // Histograms, peaks; from any task, so roughly at once
+
+  void getStatus(JsonObject out);
+  bool write(Print &out);
+  size_t size();
+
+  PerfMonitor(const PerfMonitor &) = delete;
+  PerfMonitor &operator=(const PerfMonitor &) = delete;
+
+private:
+  PerfMonitor() { _mutex = xSemaphoreCreateMutex(); }
+
+  struct Task {
+    TaskHandle_t handle;
+    char name[16];
+    uint8_t core;
+    uint8_t priority;
+    uint32_t runTime; // At the last sample
+    uint16_t loadPermille;
+    uint16_t peakPermille;
+    uint32_t stackFreeMin;
+  };
+
+  void _lock() { xSemaphoreTake(_mutex, portMAX_DELAY); }
+  void _unlock() { xSemaphoreGive(_mutex); }
+  void _sampleTasks();
+  static void _timerCallback(TimerHandle_t timer);
+
+  PerfLoop _loops[MAX_LOOPS];
+  uint8_t _loopCount = 0;
+  PerfLoop _spare;
+  Task _tasks[MAX_TASKS];
+  uint8_t _taskCount = 0;
+  uint32_t _lastSampleMs = 0;
+  uint32_t _windowMs = WINDOW_MS; // As measured at the last sample
+  TimerHandle_t _timer = nullptr;
+  SemaphoreHandle_t _mutex; // Declarations, samples and reports
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "RequestArena.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+size_t aligned(size_t size, size_t align) {
+  return (size + align - 1) & ~(align - 1);
+}
+} // namespace
+
+RequestArena::RequestArena(size_t capacity)
+    : _base(capacity > 0 ? (uint8_t *)malloc(capacity) : nullptr),
+      _capacity(_base ? capacity : 0) {}
+
+RequestArena::~RequestArena() { free(_base); }
+
+void *RequestArena::allocate(size_t size) {
+  size_t need = HEADER + aligned(size, ALIGN);
+  if (_top + need > _capacity) {
+    _overflows++;
+    return malloc(size);
+  }
+  uint8_t *ptr = _base + _top + HEADER;
+  _header(ptr)->size = aligned(size, ALIGN);
+  _top += need;
+  _peak = std::max(_peak, _top);
+  return ptr;
+}
+
+void RequestArena::deallocate(void *ptr) {
+  if (!ptr)
+    return;
+  if (!_owns(ptr)) {
+    free(ptr);
+    return;
+  }
+  // Only the last block can be given back before reset()
+  if (_isLast(ptr))
+    _top = (uint8_t *)ptr - HEADER - _base;
+}
+
+void *RequestArena::reallocate(void *ptr, size_t size) {
+  if (!ptr)
+    return allocate(size);
+  if (!_owns(ptr))
+    return realloc(ptr, size);
+
+  // The last block grows or shrinks where it is
+  Header *header = _header(ptr);
+  size_t end = (uint8_t *)ptr - _base + aligned(size, ALIGN);
+  if (_isLast(ptr) && end <= _capacity) {
+    header->size = aligned(size, ALIGN);
+    _top = end;
+    _peak = std::max(_peak, _top);
+    return ptr;
+  }
+  if (size <= header->size)
+    return ptr;
+
+  void *moved = allocate(size);
+  if (moved) {
+    memcpy(moved, ptr, header->size);
+    deallocate(ptr);
+  }
+  return moved;
+}
+
+void RequestArena::reset() { _top = 0; }
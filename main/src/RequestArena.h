@@ -0,0 +1,59 @@
+#ifndef REQUEST_ARENA_H
+#define REQUEST_ARENA_H
+
+#include <ArduinoJson.h>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Bump allocator over a region reserved once, for the JsonDocuments
+ * and body of one web request at a time.
+ *
+ * Allocation moves a pointer; freeing only gives the space back when it is
+ * the last block, which is how ArduinoJson grows and shrinks its pools and
+ * strings. Everything else is reclaimed at once by reset() when the reply
+ * has gone out, so requests never leave holes in the shared heap. A request
+ * that outgrows the region spills onto the heap and is counted.
+ */
+class RequestArena : public ArduinoJson::Allocator {
+public:
+  explicit RequestArena(size_t capacity); // 0: plain heap, nothing reserved
+  ~RequestArena();
+
+  void *allocate(size_t size) override;
+  void deallocate(void *ptr) override;
+  void *reallocate(void *ptr, size_t size) override;
+
+  void reset(); // All blocks in the region are released
+
+  size_t capacity() const { return _capacity; }
+  size_t used() const { return _top; }
+  size_t peak() const { return _peak; }             // Most used since boot
+  uint32_t overflows() const { return _overflows; } // Spilled allocations
+
+private:
+  struct Header {
+    size_t size;
+  };
+  static constexpr size_t ALIGN = alignof(std::max_align_t);
+  static constexpr size_t HEADER =
+      (sizeof(Header) + ALIGN - 1) & ~(ALIGN - 1);
+
+  bool _owns(const void *ptr) const {
+    return ptr >= _base && ptr < _base + _capacity;
+  }
+  Header *_header(void *ptr) const {
+    return (Header *)((uint8_t *)ptr - HEADER);
+  }
+  bool _isLast(void *ptr) const {
+    return (uint8_t *)ptr + _header(ptr)->size == _base + _top;
+  }
+
+  uint8_t *_base;
+  size_t _capacity;
+  size_t _top = 0;
+  size_t _peak = 0;
+  uint32_t _overflows = 0;
+};
+
+#endif
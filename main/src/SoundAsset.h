@@ -0,0 +1,31 @@
+#ifndef SOUND_ASSET_H
+#define SOUND_ASSET_H
+
+#include <Arduino.h>
+#include <vector>
+
+enum class SoundType : uint8_t { SIMPLE, COMPLEX_LOOP, TOGGLE, DIESEL };
+
+struct SoundAsset {
+  uint8_t id;
+  String name;
+  SoundType type;
+  // Absolute LittleFS paths, resolved once at load time
+  String fileIntro;
+  String fileLoop;
+  String fileOutro;
+  // Sustain loop inside fileLoop in frames, end exclusive. From JSON
+  // "loop_points" or the WAV smpl chunk; 0/0 loops the whole file.
+  uint32_t loopStart = 0;
+  uint32_t loopEnd = 0;
+  // DIESEL: fileIntro/fileOutro are start-up and shutdown, then one loop per
+  // notch (idle first). notchUp[i] plays going from notch i to i + 1,
+  // notchDown[i] from i + 1 to i; empty entries crossfade directly.
+  std::vector<String> notches;
+  std::vector<String> notchUp;
+  std::vector<String> notchDown;
+  uint16_t crossfadeMs = 0; // 0 = EngineSound default
+  uint8_t function = 0xFF;  // Cached CV mapping (AUDIO_MAP_BASE + id)
+};
+
+#endif
@@ -0,0 +1,382 @@
+#include "SoundManifest.h"
+#include "AudioUtils.h"
+#include "Logger.h"
+#include "Mp3Sidecar.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <cstring>
+#include <map>
+
+namespace {
+const char MAGIC[4] = {'N', 'S', 'A', 'M'};
+
+uint32_t le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+void put16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+void put32(uint8_t *p, uint32_t v) {
+  put16(p, v & 0xFFFF);
+  put16(p + 2, v >> 16);
+}
+
+bool parseSoundType(const String &type, SoundType &out) {
+  if (type == "simple")
+    out = SoundType::SIMPLE;
+  else if (type == "complex_loop")
+    out = SoundType::COMPLEX_LOOP;
+  else if (type == "toggle")
+    out = SoundType::TOGGLE;
+  else if (type == "diesel")
+    out = SoundType::DIESEL;
+  else
+    return false;
+  return true;
+}
+
+// Asset files are listed relative to the FS root in sound_assets.json
+String resolveAssetPath(const String &file) {
+  if (file.length() == 0 || file.startsWith("/"))
+    return file;
+  return "/" + file;
+}
+
+// File names from a JSON array; non-strings keep their slot as an empty path
+void parseAssetPaths(JsonArray list, std::vector<String> &out) {
+  for (JsonVariant file : list) {
+    out.push_back(file.is<const char *>() ? resolveAssetPath(file.as<String>())
+                                          : String());
+  }
+}
+
+// Builds the string table, storing each distinct string once
+class StringTable {
+public:
+  bool add(const String &s, uint16_t &offset) {
+    if (s.length() == 0) {
+      offset = SoundManifest::NO_STRING;
+      return true;
+    }
+    auto it = _offsets.find(s);
+    if (it != _offsets.end()) {
+      offset = it->second;
+      return true;
+    }
+    if (_data.size() + s.length() + 1 >= SoundManifest::NO_STRING)
+      return false;
+    offset = _data.size();
+    _offsets[s] = offset;
+    _data.insert(_data.end(), s.c_str(), s.c_str() + s.length() + 1);
+    return true;
+  }
+  const std::vector<uint8_t> &data() const { return _data; }
+
+private:
+  std::map<String, uint16_t> _offsets;
+  std::vector<uint8_t> _data;
+};
+
+// Empty for NO_STRING; false if the offset is not a string in the table
+bool readString(const uint8_t *strings, size_t size, uint16_t offset,
+                String &out) {
+  if (offset == SoundManifest::NO_STRING) {
+    out = String();
+    return true;
+  }
+  if (offset >= size || !memchr(strings + offset, 0, size - offset))
+    return false;
+  out = String((const char *)strings + offset);
+  return true;
+}
+} // namespace
+
+bool readWavLoopPoints(const String &path, uint32_t &start, uint32_t &end) {
+  File f = LittleFS.open(path, "r");
+  if (!f)
+    return false;
+
+  uint8_t hdr[12];
+  bool found = false;
+  if (f.read(hdr, 12) == 12 && memcmp(hdr, "RIFF", 4) == 0 &&
+      memcmp(hdr + 8, "WAVE", 4) == 0) {
+    size_t pos = 12;
+    while (f.seek(pos) && f.read(hdr, 8) == 8) {
+      uint32_t size = hdr[4] | (hdr[5] << 8) | (hdr[6] << 16) |
+                      ((uint32_t)hdr[7] << 24);
+      if (memcmp(hdr, "smpl", 4) == 0) {
+        uint8_t body[60];
+        size_t n = f.read(body, size < sizeof(body) ? size : sizeof(body));
+        found = parseSmplLoop(body, n, start, end);
+        break;
+      }
+      pos += 8 + size + (size & 1);
+    }
+  }
+  f.close();
+  return found;
+}
+
+bool SoundManifest::compile(String &error) {
+  File file = LittleFS.open(JSON_PATH, "r");
+  if (!file) {
+    error = "not found";
+    return false;
+  }
+  uint32_t sourceSize = file.size();
+  JsonDocument doc;
+  DeserializationError err = deserializeJson(doc, file);
+  file.close();
+  if (err) {
+    error = String("JSON parse error: ") + err.c_str();
+    return false;
+  }
+
+  std::vector<SoundAsset> assets;
+  bool haveEngine = false;
+  for (JsonObject obj : doc["assets"].as<JsonArray>()) {
+    SoundAsset asset;
+    asset.id = obj["id"];
+    asset.name = obj["name"].as<String>();
+    if (!parseSoundType(obj["type"].as<String>(), asset.type)) {
+      Log.printf("Audio: Skipping Asset %d (unknown type)\n", asset.id);
+      continue;
+    }
+
+    JsonObject files = obj["files"];
+    if (files["intro"].is<String>())
+      asset.fileIntro = resolveAssetPath(files["intro"].as<String>());
+    if (files["loop"].is<String>())
+      asset.fileLoop = resolveAssetPath(files["loop"].as<String>());
+    if (files["outro"].is<String>())
+      asset.fileOutro = resolveAssetPath(files["outro"].as<String>());
+
+    JsonObject loopPoints = obj["loop_points"];
+    if (loopPoints["end"].is<uint32_t>()) {
+      asset.loopStart = loopPoints["start"].as<uint32_t>();
+      asset.loopEnd = loopPoints["end"].as<uint32_t>();
+    } else if (!isMp3File(asset.fileLoop.c_str()) &&
+               asset.fileLoop.length() > 0) {
+      readWavLoopPoints(asset.fileLoop, asset.loopStart, asset.loopEnd);
+    }
+    if (asset.loopEnd <= asset.loopStart)
+      asset.loopStart = asset.loopEnd = 0;
+
+    if (asset.type == SoundType::DIESEL) {
+      if (haveEngine) {
+        Log.printf("Audio: Skipping Asset %d (only one diesel engine)\n",
+                   asset.id);
+        continue;
+      }
+      JsonObject transitions = obj["transitions"];
+      parseAssetPaths(obj["notches"], asset.notches);
+      parseAssetPaths(transitions["up"], asset.notchUp);
+      parseAssetPaths(transitions["down"], asset.notchDown);
+      asset.crossfadeMs = obj["crossfade_ms"].as<uint16_t>();
+      if (asset.notches.empty() || asset.notches[0].length() == 0) {
+        Log.printf("Audio: Skipping Asset %d (no idle notch)\n", asset.id);
+        continue;
+      }
+      haveEngine = true;
+    }
+
+    // MP3s uploaded before indexing existed get their sidecar here, once
+    for (const std::vector<String> *list :
+         {&asset.notches, &asset.notchUp, &asset.notchDown}) {
+      for (const String &path : *list) {
+        if (isMp3File(path.c_str()))
+          ensureMp3Sidecar(path);
+      }
+    }
+    for (const String *path :
+         {&asset.fileIntro, &asset.fileLoop, &asset.fileOutro}) {
+      if (isMp3File(path->c_str()))
+        ensureMp3Sidecar(*path);
+    }
+    assets.push_back(asset);
+  }
+
+  std::vector<uint8_t> out;
+  if (!encode(assets, sourceSize, out, error))
+    return false;
+
+  // Write aside and rename, so a power cut keeps the previous manifest
+  String tmp = String(PATH) + ".tmp";
+  File f = LittleFS.open(tmp, "w");
+  bool written = f && f.write(out.data(), out.size()) == out.size();
+  if (f)
+    f.close();
+  if (!written || !LittleFS.rename(tmp, PATH)) {
+    LittleFS.remove(tmp);
+    error = "failed to write manifest";
+    return false;
+  }
+  Log.printf("Audio: Compiled %u assets into a %u byte manifest\n",
+             (unsigned)assets.size(), (unsigned)out.size());
+  return true;
+}
+
+bool SoundManifest::load(std::vector<SoundAsset> &out) {
+  File f = LittleFS.open(PATH, "r");
+  if (!f)
+    return false;
+  std::vector<uint8_t> data(f.size());
+  bool ok = f.read(data.data(), data.size()) == data.size();
+  f.close();
+  return ok && decode(data.data(), data.size(), out);
+}
+
+bool SoundManifest::stale() {
+  File json = LittleFS.open(JSON_PATH, "r");
+  if (!json)
+    return false;
+  uint32_t sourceSize = json.size();
+  json.close();
+
+  uint8_t header[HEADER_SIZE];
+  File f = LittleFS.open(PATH, "r");
+  if (!f)
+    return true;
+  bool ok = f.read(header, sizeof(header)) == sizeof(header);
+  f.close();
+  return !ok || memcmp(header, MAGIC, 4) != 0 || header[4] != VERSION ||
+         le32(header + 12) != sourceSize;
+}
+
+bool SoundManifest::encode(const std::vector<SoundAsset> &assets,
+                           uint32_t sourceSize, std::vector<uint8_t> &out,
+                           String &error) {
+  if (assets.size() > 255) {
+    error = "too many assets";
+    return false;
+  }
+
+  StringTable strings;
+  std::vector<uint8_t> records(assets.size() * RECORD_SIZE, 0);
+  std::vector<uint16_t> lists;
+  for (size_t i = 0; i < assets.size(); i++) {
+    const SoundAsset &asset = assets[i];
+    uint8_t *r = &records[i * RECORD_SIZE];
+    uint16_t name, intro, loop, outro;
+    if (!strings.add(asset.name, name) ||
+        !strings.add(asset.fileIntro, intro) ||
+        !strings.add(asset.fileLoop, loop) ||
+        !strings.add(asset.fileOutro, outro)) {
+      error = "string table full";
+      return false;
+    }
+    r[0] = asset.id;
+    r[1] = (uint8_t)asset.type;
+    put16(r + 2, asset.crossfadeMs);
+    put16(r + 4, name);
+    put16(r + 6, intro);
+    put16(r + 8, loop);
+    put16(r + 10, outro);
+    put32(r + 12, asset.loopStart);
+    put32(r + 16, asset.loopEnd);
+    put16(r + 20, lists.size());
+
+    size_t notches = asset.notches.size();
+    if (notches == 0)
+      continue;
+    if (notches > 255) {
+      error = "too many notches";
+      return false;
+    }
+    r[22] = notches;
+    for (const std::vector<String> *list :
+         {&asset.notches, &asset.notchUp, &asset.notchDown}) {
+      size_t count = list == &asset.notches ? notches : notches - 1;
+      for (size_t n = 0; n < count; n++) {
+        uint16_t offset = NO_STRING;
+        if (n < list->size() && !strings.add((*list)[n], offset)) {
+          error = "string table full";
+          return false;
+        }
+        lists.push_back(offset);
+      }
+    }
+    if (lists.size() >= 0xFFFF) {
+      error = "too many notch files";
+      return false;
+    }
+  }
+
+  size_t stringsAt = HEADER_SIZE + records.size() + lists.size() * 2;
+  out.assign(stringsAt, 0);
+  memcpy(out.data(), MAGIC, 4);
+  out[4] = VERSION;
+  out[5] = assets.size();
+  put16(&out[6], lists.size());
+  put32(&out[8], strings.data().size());
+  put32(&out[12], sourceSize);
+  std::copy(records.begin(), records.end(), out.begin() + HEADER_SIZE);
+  for (size_t i = 0; i < lists.size(); i++)
+    put16(&out[HEADER_SIZE + records.size() + i * 2], lists[i]);
+  out.insert(out.end(), strings.data().begin(), strings.data().end());
+  put32(&out[16], audioCrc32(out.data() + HEADER_SIZE,
+                             out.size() - HEADER_SIZE));
+  return true;
+}
+
+bool SoundManifest::decode(const uint8_t *data, size_t len,
+                           std::vector<SoundAsset> &out) {
+  out.clear();
+  if (len < HEADER_SIZE || memcmp(data, MAGIC, 4) != 0 ||
+      data[4] != VERSION)
+    return false;
+  size_t count = data[5];
+  size_t listCount = le16(data + 6);
+  size_t stringsSize = le32(data + 8);
+  size_t listsAt = HEADER_SIZE + count * RECORD_SIZE;
+  size_t stringsAt = listsAt + listCount * 2;
+  if (stringsSize > len || stringsAt != len - stringsSize ||
+      le32(data + 16) !=
+          audioCrc32(data + HEADER_SIZE, len - HEADER_SIZE))
+    return false;
+
+  const uint8_t *strings = data + stringsAt;
+  out.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    const uint8_t *r = data + HEADER_SIZE + i * RECORD_SIZE;
+    SoundAsset asset;
+    asset.id = r[0];
+    asset.type = (SoundType)r[1];
+    asset.crossfadeMs = le16(r + 2);
+    asset.loopStart = le32(r + 12);
+    asset.loopEnd = le32(r + 16);
+    if (!readString(strings, stringsSize, le16(r + 4), asset.name) ||
+        !readString(strings, stringsSize, le16(r + 6), asset.fileIntro) ||
+        !readString(strings, stringsSize, le16(r + 8), asset.fileLoop) ||
+        !readString(strings, stringsSize, le16(r + 10), asset.fileOutro)) {
+      out.clear();
+      return false;
+    }
+
+    size_t first = le16(r + 20);
+    size_t notches = r[22];
+    if (notches > 0) {
+      if (first + 3 * notches - 2 > listCount) {
+        out.clear();
+        return false;
+      }
+      const uint8_t *entry = data + listsAt + first * 2;
+      for (std::vector<String> *list :
+           {&asset.notches, &asset.notchUp, &asset.notchDown}) {
+        list->resize(list == &asset.notches ? notches : notches - 1);
+        for (String &path : *list) {
+          if (!readString(strings, stringsSize, le16(entry), path)) {
+            out.clear();
+            return false;
+          }
+          entry += 2;
+        }
+      }
+    }
+    out.push_back(asset);
+  }
+  return true;
+}
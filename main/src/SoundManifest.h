@@ -0,0 +1,69 @@
+#ifndef SOUND_MANIFEST_H
+#define SOUND_MANIFEST_H
+
+#include "SoundAsset.h"
+#include <Arduino.h>
+#include <vector>
+
+/**
+ * @brief sound_assets.json compiled into a compact binary manifest.
+ *
+ * The JSON is parsed, validated and resolved once, when it is uploaded. Paths
+ * get their leading "/", WAV loop points are read from the smpl chunk, and
+ * MP3s get their sidecar. Boot then reads the manifest in one call and
+ * expands fixed-size records, with no JSON document and no file probing.
+ *
+ * Layout, little endian:
+ *   header  20 B  "NSAM", version, asset count, list count (u16), string
+ *                 table size (u32), size of the JSON it came from (u32),
+ *                 CRC-32 of everything after the header
+ *   assets  24 B  id, type (SoundType), crossfade ms (u16), name, intro,
+ *                 loop, outro (string offsets, u16), loop start, loop end
+ *                 (frames), first list entry (u16), notch count, reserved
+ *   lists    2 B  string offsets. A DIESEL asset owns notch count notch
+ *                 loops, then notch count - 1 up and as many down entries
+ *   strings       NUL-terminated, each distinct path or name stored once
+ *
+ * A string offset of NO_STRING means the slot is empty.
+ */
+class SoundManifest {
+public:
+  static constexpr const char *JSON_PATH = "/sound_assets.json";
+  static constexpr const char *PATH = "/sound_assets.bin";
+  static constexpr uint8_t VERSION = 1;
+  static constexpr size_t HEADER_SIZE = 20;
+  static constexpr size_t RECORD_SIZE = 24;
+  static constexpr uint16_t NO_STRING = 0xFFFF;
+
+  /**
+   * @brief Compiles JSON_PATH into PATH. The old manifest stays in place
+   * unless the new one was written completely.
+   * @param error Why the JSON was rejected.
+   */
+  static bool compile(String &error);
+
+  /**
+   * @brief Reads PATH in a single call and expands its records.
+   */
+  static bool load(std::vector<SoundAsset> &out);
+
+  /**
+   * @brief true when the JSON exists and the manifest is missing or was
+   * compiled from a different version of it.
+   */
+  static bool stale();
+
+  static bool encode(const std::vector<SoundAsset> &assets,
+                     uint32_t sourceSize, std::vector<uint8_t> &out,
+                     String &error);
+  static bool decode(const uint8_t *data, size_t len,
+                     std::vector<SoundAsset> &out);
+};
+
+/**
+ * @brief Sustain loop from a WAV smpl chunk, which editors usually append
+ * after the data chunk.
+ */
+bool readWavLoopPoints(const String &path, uint32_t &start, uint32_t &end);
+
+#endif
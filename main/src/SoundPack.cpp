@@ -0,0 +1,224 @@
+#include "SoundPack.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char MAGIC[4] = {'N', 'S', 'P', 'K'};
+
+uint32_t le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+String readName(const uint8_t *p) {
+  char name[SoundPack::NAME_LEN + 1];
+  memcpy(name, p, SoundPack::NAME_LEN);
+  name[SoundPack::NAME_LEN] = 0;
+  return String(name);
+}
+} // namespace
+
+bool SoundPack::mount() {
+  unmount();
+  _partition = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, PARTITION_LABEL);
+  if (!_partition) {
+    Log.println("SoundPack: No 'sounds' partition");
+    return false;
+  }
+
+  // Map only as much as the pack claims, not the whole partition
+  uint8_t header[HEADER_SIZE];
+  if (esp_partition_read(_partition, 0, header, sizeof(header)) != ESP_OK ||
+      memcmp(header, MAGIC, 4) != 0) {
+    Log.println("SoundPack: None installed");
+    return false;
+  }
+  uint32_t total = le32(header + 8);
+  if (total < HEADER_SIZE || total > _partition->size) {
+    Log.printf("SoundPack: Bad size %u\n", (unsigned)total);
+    return false;
+  }
+
+  const void *ptr = nullptr;
+  esp_err_t err = esp_partition_mmap(
+      _partition, 0, total, ESP_PARTITION_MMAP_DATA, &ptr, &_mapHandle);
+  if (err != ESP_OK) {
+    Log.printf("SoundPack: mmap failed: 0x%x\n", err);
+    return false;
+  }
+  _mapped = true;
+  if (!load((const uint8_t *)ptr, total)) {
+    unmount();
+    return false;
+  }
+  Log.printf("SoundPack: %u assets, %u files, %u bytes mapped\n",
+             (unsigned)_assets.size(), (unsigned)_files.size(),
+             (unsigned)_size);
+  return true;
+}
+
+void SoundPack::unmount() {
+  _files.clear();
+  _assets.clear();
+  _data = nullptr;
+  _size = 0;
+  if (_mapped) {
+    esp_partition_munmap(_mapHandle);
+    _mapped = false;
+  }
+}
+
+bool SoundPack::load(const uint8_t *data, size_t len) {
+  _files.clear();
+  _assets.clear();
+  _data = nullptr;
+  _size = 0;
+
+  if (len < HEADER_SIZE || memcmp(data, MAGIC, 4) != 0 ||
+      data[4] != VERSION) {
+    Log.println("SoundPack: Not a version 1 pack");
+    return false;
+  }
+  uint8_t assetCount = data[5];
+  uint16_t fileCount = le16(data + 6);
+  uint32_t total = le32(data + 8);
+  size_t tables = HEADER_SIZE + fileCount * FILE_ENTRY_SIZE +
+                  assetCount * ASSET_ENTRY_SIZE;
+  if (total > len || tables > total) {
+    Log.println("SoundPack: Truncated");
+    return false;
+  }
+  if (audioCrc32(data + HEADER_SIZE, total - HEADER_SIZE) != le32(data + 12)) {
+    Log.println("SoundPack: CRC mismatch");
+    return false;
+  }
+
+  _files.resize(fileCount);
+  const uint8_t *p = data + HEADER_SIZE;
+  for (uint16_t i = 0; i < fileCount; i++, p += FILE_ENTRY_SIZE) {
+    Entry &entry = _files[i];
+    entry.name = readName(p);
+    entry.codec = (AudioCodec)p[NAME_LEN];
+    uint32_t offset = le32(p + 32);
+    entry.size = le32(p + 36);
+    if (offset < tables || offset > total || entry.size > total - offset) {
+      Log.printf("SoundPack: File %s out of bounds\n", entry.name.c_str());
+      _files.clear();
+      return false;
+    }
+    entry.data = data + offset;
+    if (entry.codec == AudioCodec::MP3) {
+      entry.index.build(
+          [&entry](uint32_t at, uint8_t *buf, size_t n) -> size_t {
+            if (at >= entry.size)
+              return 0;
+            n = std::min(n, (size_t)(entry.size - at));
+            memcpy(buf, entry.data + at, n);
+            return n;
+          },
+          entry.size);
+    }
+  }
+
+  for (uint8_t i = 0; i < assetCount; i++, p += ASSET_ENTRY_SIZE) {
+    SoundAsset asset;
+    asset.id = p[0];
+    asset.type = (SoundType)p[1];
+    if (p[1] > (uint8_t)SoundType::TOGGLE) {
+      Log.printf("SoundPack: Skipping Asset %d (unknown type)\n", asset.id);
+      continue;
+    }
+    String *paths[3] = {&asset.fileIntro, &asset.fileLoop, &asset.fileOutro};
+    for (int f = 0; f < 3; f++) {
+      uint16_t idx = le16(p + 4 + 2 * f);
+      if (idx < fileCount)
+        *paths[f] = String(PATH_PREFIX) + _files[idx].name;
+    }
+    asset.loopStart = le32(p + 12);
+    asset.loopEnd = le32(p + 16);
+    if (asset.loopEnd <= asset.loopStart)
+      asset.loopStart = asset.loopEnd = 0;
+    asset.name = readName(p + 20);
+    _assets.push_back(asset);
+  }
+
+  _data = data;
+  _size = total;
+  return true;
+}
+
+const SoundPack::Entry *SoundPack::find(const String &path) const {
+  if (!_data || !isPackPath(path))
+    return nullptr;
+  const char *name = path.c_str() + strlen(PATH_PREFIX);
+  for (const Entry &entry : _files) {
+    if (entry.name == name)
+      return &entry;
+  }
+  return nullptr;
+}
+
+uint32_t SoundPack::partitionSize() const {
+  const esp_partition_t *part =
+      _partition ? _partition
+                 : esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                            ESP_PARTITION_SUBTYPE_ANY,
+                                            PARTITION_LABEL);
+  return part ? part->size : 0;
+}
+
+bool SoundPack::beginInstall() {
+  unmount();
+  _installError = "";
+  _installOffset = 0;
+  _erasedTo = 0;
+  _partition = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, PARTITION_LABEL);
+  if (!_partition)
+    return _failInstall("No 'sounds' partition");
+  _installing = true;
+  Log.printf("SoundPack: Installing (partition %u bytes)\n",
+             (unsigned)_partition->size);
+  return true;
+}
+
+bool SoundPack::writeInstall(const uint8_t *data, size_t len) {
+  if (!_installing)
+    return false;
+  if (len > _partition->size - _installOffset)
+    return _failInstall("Pack larger than partition");
+
+  // The first erase wipes the old header, so a broken upload never mounts
+  while (_erasedTo < _installOffset + len) {
+    uint32_t block = std::min((uint32_t)ERASE_BLOCK,
+                              (uint32_t)(_partition->size - _erasedTo));
+    if (esp_partition_erase_range(_partition, _erasedTo, block) != ESP_OK)
+      return _failInstall("Erase failed");
+    _erasedTo += block;
+  }
+  if (esp_partition_write(_partition, _installOffset, data, len) != ESP_OK)
+    return _failInstall("Write failed");
+  _installOffset += len;
+  return true;
+}
+
+bool SoundPack::endInstall() {
+  if (!_installing)
+    return false;
+  _installing = false;
+  Log.printf("SoundPack: Wrote %u bytes\n", (unsigned)_installOffset);
+  if (!mount()) {
+    _installError = "Invalid pack";
+    return false;
+  }
+  return true;
+}
+
+bool SoundPack::_failInstall(const char *reason) {
+  Log.printf("SoundPack: Install failed: %s\n", reason);
+  _installError = reason;
+  _installing = false;
+  return false;
+}
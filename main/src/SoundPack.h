@@ -0,0 +1,114 @@
+#ifndef SOUND_PACK_H
+#define SOUND_PACK_H
+
+#include "AudioUtils.h"
+#include "Mp3Index.h"
+#include "SoundAsset.h"
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <vector>
+
+/**
+ * @brief Sound assets packed into one blob on the raw "sounds" partition.
+ *
+ * The pack is memory mapped, so a voice playing one of its files hands the
+ * decoder pointers straight into the flash cache: no file system metadata
+ * and no copy per block. tools/mksoundpack.py builds it from
+ * sound_assets.json; POST /api/sounds/pack streams it into the partition.
+ *
+ * Layout, little endian:
+ *   header  16 B  "NSPK", version, asset count, file count (u16),
+ *                 total size (u32), CRC-32 of everything after the header
+ *   files   40 B  name[28], codec (AudioCodec), 3 reserved, offset, length
+ *   assets  48 B  id, type (SoundType), 2 reserved, intro/loop/outro file
+ *                 index (u16, NO_FILE if unused), 2 reserved, loop start,
+ *                 loop end (frames), name[28]
+ *   data          file bodies, each at a 4-byte aligned offset
+ *
+ * Pack files are named "pack:<name>" wherever a LittleFS path would go.
+ */
+class SoundPack {
+public:
+  static constexpr const char *PARTITION_LABEL = "sounds";
+  static constexpr const char *PATH_PREFIX = "pack:";
+  static constexpr uint8_t VERSION = 1;
+  static constexpr size_t HEADER_SIZE = 16;
+  static constexpr size_t FILE_ENTRY_SIZE = 40;
+  static constexpr size_t ASSET_ENTRY_SIZE = 48;
+  static constexpr size_t NAME_LEN = 28;
+  static constexpr uint16_t NO_FILE = 0xFFFF;
+  static constexpr size_t ERASE_BLOCK = 64 * 1024;
+
+  struct Entry {
+    String name;
+    AudioCodec codec;
+    const uint8_t *data;
+    uint32_t size;
+    Mp3Index index; // Frame index of an MP3, built once at load
+  };
+
+  static SoundPack &getInstance() {
+    static SoundPack instance;
+    return instance;
+  }
+
+  /**
+   * @brief Maps the partition and loads the pack in it, if any.
+   */
+  bool mount();
+  void unmount();
+  bool mounted() const { return _data != nullptr; }
+
+  /**
+   * @brief Validates and indexes a pack at @p data. The bytes must stay put
+   * until unmount(); mount() passes the mapping, tests a buffer.
+   */
+  bool load(const uint8_t *data, size_t len);
+
+  static bool isPackPath(const String &path) {
+    return path.startsWith(PATH_PREFIX);
+  }
+
+  /**
+   * @brief Looks up "pack:<name>". Null when not mounted or not packed.
+   */
+  const Entry *find(const String &path) const;
+
+  // Asset table, with paths already in "pack:<name>" form
+  const std::vector<SoundAsset> &assets() const { return _assets; }
+  const std::vector<Entry> &files() const { return _files; }
+  uint32_t size() const { return _size; }
+  uint32_t partitionSize() const;
+
+  /**
+   * @brief Streaming install. begin() unmounts and invalidates the current
+   * pack; write() erases each 64 KB block just before it is written; end()
+   * mounts the result. Callers must stop every voice first.
+   */
+  bool beginInstall();
+  bool writeInstall(const uint8_t *data, size_t len);
+  bool endInstall();
+  const String &installError() const { return _installError; }
+
+private:
+  SoundPack() {}
+
+  bool _failInstall(const char *reason);
+
+  const esp_partition_t *_partition = nullptr;
+  esp_partition_mmap_handle_t _mapHandle = 0;
+  bool _mapped = false;
+
+  const uint8_t *_data = nullptr;
+  uint32_t _size = 0;
+  std::vector<Entry> _files;
+  std::vector<SoundAsset> _assets;
+
+  // Install in progress
+  bool _installing = false;
+  uint32_t _installOffset = 0;
+  uint32_t _erasedTo = 0;
+  String _installError;
+};
+
+#endif
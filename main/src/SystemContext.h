@@ -13,6 +13,11 @@ struct SystemState {
   bool direction = true; // true = forward
   bool functions[29] = {false};
 
+  // Causality IDs (LatencyMonitor) of the DCC packets that last changed the
+  // speed or direction, and that last switched each function on
+  uint32_t speedCause = 0;
+  uint32_t functionCause[29] = {0};
+
   // Control Logic
   ControlSource speedSource = SOURCE_DCC;
   uint8_t lastDccSpeed = 0;
@@ -22,6 +27,10 @@ struct SystemState {
   bool wifiConnected = false;
   uint32_t lastDccPacketTime = 0;
 
+  // Published by MotorController for the engine sound, which follows the
+  // motor rather than the throttle
+  float momentumSpeed = 0.0f; // Speed after momentum (CV3), 0-255
+
   // Motor Load Factor (0.0 = No Load, 1.0 = Heavy Load)
   // Used for Audio Chuff modification
   float loadFactor = 0.0f;
@@ -0,0 +1,158 @@
+#include "Telemetry.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+Telemetry::Channel Telemetry::add(const char *name, const char *unit,
+                                  TelemetryType type, uint16_t rateHz) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  Channel c = find(name);
+  if (c == NONE && count() < MAX_CHANNELS) {
+    c = count();
+    _info[c] = {name, unit, type, rateHz};
+    // Readers only look below the count, so the entry is complete first
+    _count.store(c + 1, std::memory_order_release);
+  }
+  xSemaphoreGive(_mutex);
+  return c;
+}
+
+Telemetry::Channel Telemetry::find(const char *name) const {
+  uint8_t n = count();
+  for (Channel c = 0; c < n; c++) {
+    if (strcmp(_info[c].name, name) == 0)
+      return c;
+  }
+  return NONE;
+}
+
+void Telemetry::_store(Channel c, uint32_t raw) {
+  if (c >= count())
+    return;
+  _raw[c].store(raw, std::memory_order_relaxed);
+  // Only the channel's own task writes it, so no read-modify-write is needed
+  _updates[c].store(_updates[c].load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+}
+
+void Telemetry::publish(Channel c, float value) {
+  if (c >= count())
+    return;
+  switch (_info[c].type) {
+  case TelemetryType::F32: {
+    uint32_t raw;
+    memcpy(&raw, &value, sizeof(raw));
+    _store(c, raw);
+    break;
+  }
+  case TelemetryType::BOOL:
+    _store(c, value != 0.0f);
+    break;
+  default:
+    publish(c, value > 0.0f ? (uint32_t)lroundf(value) : 0u);
+    break;
+  }
+}
+
+void Telemetry::publish(Channel c, int value) {
+  if (c < count() && _info[c].type == TelemetryType::F32)
+    publish(c, (float)value);
+  else
+    publish(c, (uint32_t)std::max(value, 0));
+}
+
+void Telemetry::publish(Channel c, uint32_t value) {
+  if (c >= count())
+    return;
+  switch (_info[c].type) {
+  case TelemetryType::F32:
+    publish(c, (float)value);
+    break;
+  case TelemetryType::BOOL:
+    _store(c, value != 0);
+    break;
+  case TelemetryType::U8:
+    _store(c, std::min<uint32_t>(value, 255));
+    break;
+  case TelemetryType::U32:
+    _store(c, value);
+    break;
+  }
+}
+
+float Telemetry::value(Channel c) const {
+  if (c >= count())
+    return 0.0f;
+  uint32_t bits = raw(c);
+  if (_info[c].type != TelemetryType::F32)
+    return (float)bits;
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+void Telemetry::toJson(JsonObject obj, Channel c) const {
+  if (c >= count())
+    return;
+  switch (_info[c].type) {
+  case TelemetryType::BOOL:
+    obj[_info[c].name] = raw(c) != 0;
+    break;
+  case TelemetryType::F32:
+    obj[_info[c].name] = value(c);
+    break;
+  default:
+    obj[_info[c].name] = raw(c);
+    break;
+  }
+}
+
+void Telemetry::toJson(JsonObject obj) const {
+  uint8_t n = count();
+  for (Channel c = 0; c < n; c++)
+    toJson(obj, c);
+}
+
+void Telemetry::schemaJson(JsonArray arr) const {
+  uint8_t n = count();
+  for (Channel c = 0; c < n; c++) {
+    JsonObject ch = arr.add<JsonObject>();
+    ch["name"] = _info[c].name;
+    ch["unit"] = _info[c].unit;
+    ch["type"] = typeName(_info[c].type);
+    ch["rate_hz"] = _info[c].rateHz;
+  }
+}
+
+const char *Telemetry::typeName(TelemetryType type) {
+  switch (type) {
+  case TelemetryType::BOOL:
+    return "bool";
+  case TelemetryType::U8:
+    return "u8";
+  case TelemetryType::U32:
+    return "u32";
+  case TelemetryType::F32:
+    return "f32";
+  }
+  return "?";
+}
+
+void Telemetry::Subscriber::subscribe(Channel c, uint16_t decimate) {
+  if (c >= MAX_CHANNELS)
+    return;
+  _decimate[c] = decimate;
+  _seen[c] = Telemetry::getInstance().updates(c);
+}
+
+void Telemetry::Subscriber::follow(uint16_t hz) {
+  _followHz = std::max<uint16_t>(hz, 1);
+  _known = 0;
+}
+
+void Telemetry::Subscriber::_adopt(uint8_t count) {
+  Telemetry &t = Telemetry::getInstance();
+  for (Channel c = _known; c < count; c++)
+    subscribe(c, std::max(1, t.info(c).rateHz / _followHz));
+  _known = count;
+}
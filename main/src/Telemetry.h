@@ -0,0 +1,129 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+enum class TelemetryType : uint8_t { BOOL, U8, U32, F32 };
+
+/**
+ * @brief Registry of typed telemetry channels.
+ *
+ * A subsystem declares each channel once (name, unit, type, native rate) and
+ * publishes raw values into it. Publishing is two atomic stores, so real-time
+ * tasks can publish every tick; nothing is formatted until a sink asks.
+ *
+ * Sinks read the latest value of a channel, or follow it through a
+ * Subscriber, which decimates per channel. The log line, /api/telemetry,
+ * /api/telemetry/schema and the WebSocket frames all read from here, so the
+ * schema below is the one description of what the decoder reports.
+ */
+class Telemetry {
+public:
+  typedef uint8_t Channel;
+  static constexpr uint8_t MAX_CHANNELS = 32;
+  static constexpr Channel NONE = 0xFF;
+
+  struct Info {
+    const char *name; // JSON key; unique
+    const char *unit; // "" when dimensionless
+    TelemetryType type;
+    uint16_t rateHz; // How often it is published
+  };
+
+  static Telemetry &getInstance() {
+    static Telemetry instance;
+    return instance;
+  }
+
+  /**
+   * @brief Declares a channel; strings must outlive the registry. Declaring
+   * a name again returns the existing channel.
+   * @return NONE when MAX_CHANNELS are declared.
+   */
+  Channel add(const char *name, const char *unit, TelemetryType type,
+              uint16_t rateHz);
+  Channel find(const char *name) const;
+  uint8_t count() const { return _count.load(std::memory_order_acquire); }
+  const Info &info(Channel c) const { return _info[c]; }
+
+  // One task publishes each channel; the value is stored as its type
+  void publish(Channel c, float value);
+  void publish(Channel c, int value);
+  void publish(Channel c, uint32_t value);
+  void publish(Channel c, bool value) { publish(c, (uint32_t)value); }
+
+  float value(Channel c) const; // Latest, whatever its type; 0 for NONE
+  uint32_t raw(Channel c) const {
+    return c < count() ? _raw[c].load(std::memory_order_relaxed) : 0;
+  }
+  uint32_t updates(Channel c) const { // Publishes so far
+    return c < count() ? _updates[c].load(std::memory_order_acquire) : 0;
+  }
+
+  void toJson(JsonObject obj, Channel c) const; // obj[name] = latest value
+  void toJson(JsonObject obj) const;            // Every channel
+  void schemaJson(JsonArray arr) const;
+  static const char *typeName(TelemetryType type);
+
+  /**
+   * @brief A sink's view of the registry: which channels it follows, every
+   * how many publishes, and what it has already seen. Owned by one task.
+   */
+  class Subscriber {
+  public:
+    void subscribe(Channel c, uint16_t decimate = 1); // 0: unsubscribe
+    /**
+     * @brief Follows every channel, declared now or later, at about @p hz
+     * (each is decimated by its native rate over @p hz).
+     */
+    void follow(uint16_t hz);
+
+    /**
+     * @brief Calls @p fn(channel) for each followed channel that has been
+     * published its decimation's worth of times since it was last reported.
+     */
+    template <typename F> void poll(F fn) {
+      Telemetry &t = Telemetry::getInstance();
+      uint8_t n = t.count();
+      if (_followHz && _known < n)
+        _adopt(n);
+      for (Channel c = 0; c < n; c++) {
+        if (_decimate[c] == 0)
+          continue;
+        uint32_t updates = t.updates(c);
+        if (updates - _seen[c] < _decimate[c])
+          continue;
+        _seen[c] = updates;
+        fn(c);
+      }
+    }
+
+  private:
+    void _adopt(uint8_t count);
+
+    uint16_t _decimate[MAX_CHANNELS] = {}; // 0: not followed
+    uint32_t _seen[MAX_CHANNELS] = {};
+    uint16_t _followHz = 0;
+    uint8_t _known = 0; // Channels follow() has been applied to
+  };
+
+  Telemetry(const Telemetry &) = delete;
+  Telemetry &operator=(const Telemetry &) = delete;
+
+private:
+  Telemetry() { _mutex = xSemaphoreCreateMutex(); }
+
+  void _store(Channel c, uint32_t raw);
+
+  Info _info[MAX_CHANNELS];
+  std::atomic<uint32_t> _raw[MAX_CHANNELS] = {};
+  std::atomic<uint32_t> _updates[MAX_CHANNELS] = {};
+  std::atomic<uint8_t> _count{0};
+  SemaphoreHandle_t _mutex; // Declarations only
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "TelemetryStream.h"
+#include "PerfMonitor.h"
+#include <cstring>
+
+namespace {
+// Registry channel behind each TelemetryStream::Field, in order
+const char *const FRAME_CHANNELS[] = {
+    "target_speed", "zone", "forward", "moving", "stalled", "fault",
+    "duty", "current", "rpm", "ripple_freq", "ke", "learned_r"};
+} // namespace
+
+TelemetryStream::TelemetryStream() { _mutex = xSemaphoreCreateMutex(); }
+
+void TelemetryStream::startTask(Sender send) {
+  if (_task)
+    return;
+  _send = send;
+  xTaskCreatePinnedToCore(_taskEntry, "Telemetry", 3072, this,
+                          1, // Idle-level: only ever behind the web server
+                          &_task,
+                          0 // Core 0, away from the motor and audio loops
+  );
+}
+
+void TelemetryStream::_taskEntry(void *param) {
+  TelemetryStream *self = (TelemetryStream *)param;
+  TickType_t lastWake = xTaskGetTickCount();
+  PerfLoop &perfLoop = PerfMonitor::getInstance().loop("Telemetry");
+  for (;;) {
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(PERIOD_MS));
+    PerfScope perf(perfLoop);
+    self->step();
+  }
+}
+
+void TelemetryStream::publish(TelemetryFrame frame) {
+  uint32_t seq = _head.load(std::memory_order_relaxed);
+  frame.seq = seq;
+  frame.timeUs = micros();
+  _ring[seq % RING] = frame;
+  _head.store(seq + 1, std::memory_order_release);
+}
+
+void TelemetryStream::sample() {
+  Telemetry &t = Telemetry::getInstance();
+  if (!_resolved) {
+    static_assert(sizeof(FRAME_CHANNELS) / sizeof(*FRAME_CHANNELS) == FIELDS,
+                  "A channel per field");
+    for (int i = 0; i < FIELDS; i++)
+      _channels[i] = t.find(FRAME_CHANNELS[i]);
+    _resolved = true;
+  }
+
+  TelemetryFrame frame = {};
+  frame.target = t.raw(_channels[TARGET]);
+  frame.zone = t.raw(_channels[ZONE]);
+  frame.flags = (t.raw(_channels[FORWARD]) ? TELEMETRY_FORWARD : 0) |
+                (t.raw(_channels[MOVING]) ? TELEMETRY_MOVING : 0) |
+                (t.raw(_channels[STALLED]) ? TELEMETRY_STALLED : 0) |
+                (t.raw(_channels[FAULT]) ? TELEMETRY_FAULT : 0);
+  frame.duty = t.value(_channels[DUTY]);
+  frame.current = t.value(_channels[CURRENT]);
+  frame.rpm = t.value(_channels[RPM]);
+  frame.ripple = t.value(_channels[RIPPLE]);
+  frame.ke = t.value(_channels[KE]);
+  frame.resistance = t.value(_channels[RESISTANCE]);
+  publish(frame);
+}
+
+bool TelemetryStream::addClient(int fd, uint8_t decimate) {
+  _lock();
+  // A socket number comes back once its last client has gone, maybe before
+  // a send noticed; that slot is the one to reuse
+  Client *slot = nullptr;
+  for (Client &c : _clients) {
+    if (c.fd == fd || (c.fd < 0 && !slot))
+      slot = &c;
+  }
+  if (slot) {
+    Client &c = *slot;
+    c.fd = fd;
+    c.decimate = decimate > 0 ? decimate : 1;
+    c.next = _head.load(std::memory_order_acquire); // From now on
+    c.dropped = 0;
+  }
+  _unlock();
+  return slot != nullptr;
+}
+
+void TelemetryStream::setDecimation(int fd, uint8_t decimate) {
+  _lock();
+  for (Client &c : _clients) {
+    if (c.fd == fd)
+      c.decimate = decimate > 0 ? decimate : 1;
+  }
+  _unlock();
+}
+
+void TelemetryStream::removeClient(int fd) {
+  _lock();
+  for (Client &c : _clients) {
+    if (c.fd == fd)
+      c.fd = -1;
+  }
+  _unlock();
+}
+
+uint8_t TelemetryStream::clientCount() {
+  uint8_t count = 0;
+  _lock();
+  for (const Client &c : _clients)
+    count += c.fd >= 0;
+  _unlock();
+  return count;
+}
+
+size_t TelemetryStream::encode(uint8_t index, uint8_t *out, int *fd) {
+  _lock();
+  Client &c = _clients[index];
+  *fd = c.fd;
+  if (c.fd < 0) {
+    _unlock();
+    return 0;
+  }
+
+  // The slot of frame `head` may be being written, so RING - 1 are held
+  uint32_t head = _head.load(std::memory_order_acquire);
+  uint32_t lost = 0;
+  if (head - c.next >= RING) {
+    lost = head - (RING - 1) - c.next;
+    c.next += lost;
+  }
+
+  TelemetryFrame *frames = (TelemetryFrame *)(out + sizeof(TelemetryBatch));
+  uint8_t count = 0;
+  for (; c.next != head && count < MAX_BATCH; c.next++) {
+    if (c.next % c.decimate != 0)
+      continue;
+    frames[count] = _ring[c.next % RING];
+    // Overwritten while it was copied: the producer lapped this client
+    if (_head.load(std::memory_order_acquire) - c.next >= RING) {
+      lost++;
+      continue;
+    }
+    count++;
+  }
+  c.dropped += lost;
+  TelemetryBatch batch = {TELEMETRY_MAGIC, TELEMETRY_VERSION, count,
+                          c.dropped};
+  _unlock();
+
+  if (count == 0)
+    return 0;
+  memcpy(out, &batch, sizeof(batch));
+  return sizeof(TelemetryBatch) + count * sizeof(TelemetryFrame);
+}
+
+void TelemetryStream::step() {
+  static uint8_t message[MAX_MESSAGE]; // Only the task sends
+  for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+    // A full ring is a few messages; never more than that per period
+    for (size_t n = 0; n <= RING / MAX_BATCH; n++) {
+      int fd;
+      size_t len = encode(i, message, &fd);
+      if (len == 0)
+        break;
+      if (!_send(fd, message, len)) {
+        removeClient(fd);
+        break;
+      }
+    }
+  }
+}
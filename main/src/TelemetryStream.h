@@ -0,0 +1,158 @@
+#ifndef TELEMETRY_STREAM_H
+#define TELEMETRY_STREAM_H
+
+#include "Telemetry.h"
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <functional>
+
+/**
+ * @brief One control-loop sample, as sent on the wire (little-endian, no
+ * padding). Each field is a registry channel (see FRAME_CHANNELS in the
+ * .cpp). tools/telemetry_stream.py and the dashboard decode this layout;
+ * change TELEMETRY_VERSION with it.
+ */
+struct __attribute__((packed)) TelemetryFrame {
+  uint32_t seq;    // Counts every published frame, decimated or not
+  uint32_t timeUs; // micros(), wraps every 71 minutes
+  uint8_t target;  // Speed step
+  uint8_t zone;    // 0 stopped, 1 static, 2 torque, 3 velocity (PI)
+  uint8_t flags;   // TELEMETRY_*
+  uint8_t reserved;
+  float duty;    // -1..1
+  float current; // A
+  float rpm;
+  float ripple;     // Hz
+  float ke;         // BEMF constant
+  float resistance; // Learned armature resistance, ohm
+};
+static_assert(sizeof(TelemetryFrame) == 36, "Wire layout");
+
+enum : uint8_t {
+  TELEMETRY_FORWARD = 0x01,
+  TELEMETRY_MOVING = 0x02,
+  TELEMETRY_STALLED = 0x04,
+  TELEMETRY_FAULT = 0x08,
+};
+
+// Each WebSocket message: this header, then `count` frames
+struct __attribute__((packed)) TelemetryBatch {
+  uint16_t magic; // "NT"
+  uint8_t version;
+  uint8_t count;
+  uint32_t dropped; // Frames this client lost to overruns, since it joined
+};
+
+static constexpr uint16_t TELEMETRY_MAGIC = 0x544E;
+static constexpr uint8_t TELEMETRY_VERSION = 1;
+
+/**
+ * @brief Binary telemetry for WebSocket clients.
+ *
+ * The motor task samples its registry channels into a frame per control
+ * tick and queues it in a ring; that is a copy and an atomic store, so the
+ * control loop never waits on the network.
+ * A low-priority task drains the ring every PERIOD_MS and sends each client
+ * the frames it asked for (every Nth, its decimation) in one message of up
+ * to MAX_BATCH frames. A client that falls more than RING frames behind
+ * skips ahead and is told how many it lost.
+ *
+ * The ring holds a quarter second at 500 Hz, so the stream keeps up with
+ * control loops far faster than today's 50 Hz.
+ */
+class TelemetryStream {
+public:
+  static constexpr size_t RING = 128;
+  static constexpr uint8_t MAX_BATCH = 32;
+  static constexpr uint8_t MAX_CLIENTS = 2;
+  static constexpr uint32_t PERIOD_MS = 20;
+  static constexpr size_t MAX_MESSAGE =
+      sizeof(TelemetryBatch) + MAX_BATCH * sizeof(TelemetryFrame);
+
+  // Sends one binary message to a client; false if it has gone
+  typedef std::function<bool(int fd, const uint8_t *data, size_t len)> Sender;
+
+  static TelemetryStream &getInstance() {
+    static TelemetryStream instance;
+    return instance;
+  }
+
+  void startTask(Sender send);
+
+  /**
+   * @brief Stamps @p frame with its sequence number and time, and queues
+   * it. From one task only (the motor task).
+   */
+  void publish(TelemetryFrame frame);
+
+  /**
+   * @brief Publishes a frame of the latest values of the motor's registry
+   * channels. Called by the motor task after it has published them.
+   */
+  void sample();
+
+  /**
+   * @brief Starts streaming to @p fd, every @p decimate -th frame.
+   * @return false when MAX_CLIENTS are already connected.
+   */
+  bool addClient(int fd, uint8_t decimate);
+  void setDecimation(int fd, uint8_t decimate);
+  void removeClient(int fd);
+  uint8_t clientCount();
+
+  /**
+   * @brief Encodes the next message for client @p index into @p out
+   * (MAX_MESSAGE bytes). The task calls this; tests call it directly.
+   * @return Bytes written, 0 if the client is up to date.
+   */
+  size_t encode(uint8_t index, uint8_t *out, int *fd);
+
+  /**
+   * @brief Sends every client what is waiting for it. Run by the task.
+   */
+  void step();
+
+private:
+  TelemetryStream();
+
+  struct Client {
+    int fd = -1; // -1: free slot
+    uint8_t decimate = 1;
+    uint32_t next = 0; // Sequence of the next frame to look at
+    uint32_t dropped = 0;
+  };
+
+  static void _taskEntry(void *param);
+  void _lock() { xSemaphoreTake(_mutex, portMAX_DELAY); }
+  void _unlock() { xSemaphoreGive(_mutex); }
+
+  enum Field {
+    TARGET,
+    ZONE,
+    FORWARD,
+    MOVING,
+    STALLED,
+    FAULT,
+    DUTY,
+    CURRENT,
+    RPM,
+    RIPPLE,
+    KE,
+    RESISTANCE,
+    FIELDS
+  };
+  Telemetry::Channel _channels[FIELDS]; // Looked up by the first sample()
+  bool _resolved = false;
+
+  TelemetryFrame _ring[RING];
+  std::atomic<uint32_t> _head{0}; // Frames published so far
+  Client _clients[MAX_CLIENTS];
+  Sender _send;
+  SemaphoreHandle_t _mutex;
+  TaskHandle_t _task = nullptr;
+};
+
+#endif
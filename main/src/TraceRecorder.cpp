@@ -0,0 +1,248 @@
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <cstring>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+// In IRAM: interrupts record too, and may run while the flash cache is off
+IRAM_ATTR void TraceRecorder::_record(uint8_t category, uint8_t type,
+                                      const char *name, uint32_t arg) {
+  // Counted, so stop() can wait out a writer that passed the check above
+  _writers.fetch_add(1, std::memory_order_acquire);
+  if (enabled(category)) {
+    bool isr = xPortInIsrContext();
+    Ring &ring = _rings[xPortGetCoreID()];
+    uint32_t now = esp_cpu_get_cycle_count();
+    if (!isr && (!ring.anchorUs || now - ring.anchorCycles >= _anchorPeriod))
+      _anchor(ring);
+    uint32_t at = ring.head.fetch_add(1, std::memory_order_relaxed);
+    Event &e = ring.events[at % _capacity];
+    e.cycles = now;
+    e.arg = arg;
+    e.name = name;
+    e.task = isr ? nullptr : xTaskGetCurrentTaskHandle();
+    e.type = type;
+    e.category = category;
+  }
+  _writers.fetch_sub(1, std::memory_order_release);
+}
+
+void TraceRecorder::_anchor(Ring &ring) {
+  // Both clocks at one instant: nothing on this core may come between
+  portENTER_CRITICAL_SAFE(&ring.anchorLock);
+  ring.anchorCycles = esp_cpu_get_cycle_count();
+  ring.anchorUs = esp_timer_get_time();
+  portEXIT_CRITICAL_SAFE(&ring.anchorLock);
+}
+
+bool TraceRecorder::start(uint8_t categories, uint16_t events) {
+  events = std::max<uint16_t>(16, std::min(events, MAX_EVENTS));
+  _lock();
+  _stopWriters();
+  if (events != _capacity)
+    _free();
+  if (!_rings[0].events) {
+    for (Ring &ring : _rings) {
+      // Internal RAM: interrupts write it
+      ring.events = (Event *)heap_caps_malloc(
+          events * sizeof(Event), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (!_rings[0].events || !_rings[1].events) {
+      _free();
+      _unlock();
+      return false;
+    }
+    _capacity = events;
+  }
+  for (Ring &ring : _rings) {
+    ring.head.store(0);
+    ring.anchorUs = 0; // Each core anchors at its first event
+  }
+  _cyclesPerUs = getCpuFrequencyMhz();
+  _anchorPeriod = _cyclesPerUs * 1000000u; // A second
+  _lastCategories = categories;
+  _categories.store(categories, std::memory_order_release);
+  _unlock();
+  return true;
+}
+
+void TraceRecorder::stop() {
+  _lock();
+  _stopWriters();
+  _unlock();
+}
+
+void TraceRecorder::clear() {
+  _lock();
+  _stopWriters();
+  _free();
+  _unlock();
+}
+
+void TraceRecorder::_stopWriters() {
+  _categories.store(0);
+  while (_writers.load(std::memory_order_acquire))
+    vTaskDelay(1);
+}
+
+void TraceRecorder::_free() {
+  for (Ring &ring : _rings) {
+    heap_caps_free(ring.events);
+    ring.events = nullptr;
+    ring.head.store(0);
+  }
+  _capacity = 0;
+}
+
+namespace {
+// The tasks' names, by handle: from the kernel's list of live tasks where
+// there is one, as an event's task may have ended since
+#if configUSE_TRACE_FACILITY
+TaskStatus_t taskStatus[40]; // Off the worker's stack
+
+struct TaskNames {
+  UBaseType_t count = uxTaskGetSystemState(taskStatus, 40, nullptr);
+
+  const char *find(TaskHandle_t task) const {
+    for (UBaseType_t i = 0; i < count; i++)
+      if (taskStatus[i].xHandle == task)
+        return taskStatus[i].pcTaskName;
+    return "(ended)";
+  }
+};
+#else
+struct TaskNames {
+  const char *find(TaskHandle_t task) const { return pcTaskGetName(task); }
+};
+#endif
+
+template <typename T, size_t N>
+int indexOf(const T (&table)[N], size_t count, const T &value) {
+  for (size_t i = 0; i < count; i++)
+    if (table[i] == value)
+      return (int)i;
+  return -1;
+}
+} // namespace
+
+bool TraceRecorder::write(Print &out) {
+  _lock();
+  _stopWriters();
+  if (!_capacity) {
+    _unlock();
+    return false;
+  }
+
+  uint32_t first[CORES], count[CORES];
+  for (uint8_t c = 0; c < CORES; c++) {
+    uint32_t head = _rings[c].head.load();
+    count[c] = std::min<uint32_t>(head, _capacity);
+    first[c] = head - count[c];
+  }
+
+  // Names and tasks as they first appear
+  static const char *names[MAX_NAMES];
+  static TaskHandle_t tasks[MAX_TASKS];
+  size_t nameCount = 0, taskCount = 0;
+  for (uint8_t c = 0; c < CORES; c++) {
+    for (uint32_t i = first[c]; i != first[c] + count[c]; i++) {
+      const Event &e = _rings[c].events[i % _capacity];
+      if (nameCount < MAX_NAMES && indexOf(names, nameCount, e.name) < 0)
+        names[nameCount++] = e.name;
+      if (e.task && taskCount < MAX_TASKS &&
+          indexOf(tasks, taskCount, e.task) < 0)
+        tasks[taskCount++] = e.task;
+    }
+  }
+
+  TraceHeader header = {};
+  header.magic = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.cores = CORES;
+  header.cpuMhz = _cyclesPerUs;
+  header.names = nameCount;
+  header.tasks = taskCount;
+  header.categories = _lastCategories;
+  bool ok = out.write((const uint8_t *)&header, sizeof(header)) ==
+            sizeof(header);
+
+  for (uint8_t c = 0; c < CORES && ok; c++) {
+    TraceCoreRecord core = {};
+    core.anchorUs = _rings[c].anchorUs;
+    core.anchorCycles = _rings[c].anchorCycles;
+    core.events = count[c];
+    ok = out.write((const uint8_t *)&core, sizeof(core)) == sizeof(core);
+  }
+
+  for (size_t n = 0; n < nameCount && ok; n++) {
+    uint8_t len = (uint8_t)std::min<size_t>(strlen(names[n]), 255);
+    ok = out.write(&len, 1) == 1 &&
+         out.write((const uint8_t *)names[n], len) == len;
+  }
+
+  {
+    TaskNames live;
+    for (size_t t = 0; t < taskCount && ok; t++) {
+      TraceTaskRecord task = {};
+      strncpy(task.name, live.find(tasks[t]), sizeof(task.name) - 1);
+      ok = out.write((const uint8_t *)&task, sizeof(task)) == sizeof(task);
+    }
+  }
+
+  for (uint8_t c = 0; c < CORES; c++) {
+    for (uint32_t i = first[c]; i != first[c] + count[c] && ok; i++) {
+      const Event &e = _rings[c].events[i % _capacity];
+      TraceEventRecord r = {};
+      r.cycles = e.cycles;
+      r.arg = e.arg;
+      int name = indexOf(names, nameCount, e.name);
+      r.name = name < 0 ? 0xFFFF : name;
+      int task = e.task ? indexOf(tasks, taskCount, e.task) : -1;
+      r.task = task < 0 ? 0xFF : task;
+      r.type = e.type;
+      r.category = e.category;
+      ok = out.write((const uint8_t *)&r, sizeof(r)) == sizeof(r);
+    }
+  }
+  _unlock();
+  return ok;
+}
+
+void TraceRecorder::getStatus(JsonObject out) {
+  _lock();
+  uint8_t categories = _categories.load();
+  out["state"] = categories ? "recording" : _capacity ? "stopped" : "idle";
+  out["categories"] = categories ? categories : _lastCategories;
+  out["capacity"] = _capacity;
+  uint32_t events = 0;
+  bool wrapped = false;
+  for (const Ring &ring : _rings) {
+    uint32_t head = ring.head.load();
+    events += std::min<uint32_t>(head, _capacity);
+    wrapped |= head > _capacity;
+  }
+  out["events"] = events;
+  out["wrapped"] = wrapped;
+  _unlock();
+}
+
+uint8_t TraceRecorder::parseCategories(const char *list) {
+  static const struct {
+    const char *name;
+    uint8_t bit;
+  } NAMES[] = {{"isr", TRACE_ISR},     {"motor", TRACE_MOTOR},
+               {"dcc", TRACE_DCC},     {"http", TRACE_HTTP},
+               {"audio", TRACE_AUDIO}, {"all", TRACE_ISR | TRACE_DEFAULT}};
+  uint8_t bits = 0;
+  while (*list) {
+    size_t len = strcspn(list, ",");
+    for (const auto &n : NAMES) {
+      if (strlen(n.name) == len && strncmp(list, n.name, len) == 0)
+        bits |= n.bit;
+    }
+    list += len;
+    if (*list == ',')
+      list++;
+  }
+  return bits;
+}
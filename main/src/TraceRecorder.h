@@ -0,0 +1,201 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <esp_cpu.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+// What a trace records; a trace is started for any mix of them
+enum : uint8_t {
+  TRACE_ISR = 0x01,     // The 20 kHz motor ISR: fills a ring in ~25 ms
+  TRACE_MOTOR = 0x02,   // Control cycles, momentum, targets and duty
+  TRACE_DCC = 0x04,     // Decoded packets
+  TRACE_HTTP = 0x08,    // Route handlers
+  TRACE_AUDIO = 0x10,   // Rendered blocks
+  TRACE_DEFAULT = 0x1E, // All but the ISR
+};
+
+enum : uint8_t {
+  TRACE_BEGIN = 0,
+  TRACE_END = 1,
+  TRACE_INSTANT = 2,
+};
+
+/**
+ * @brief A trace, as downloaded (little-endian, no padding): this header,
+ * a TraceCoreRecord per core, the names (a length byte then the bytes,
+ * each), the tasks, then the events of core 0 and of core 1, each oldest
+ * first. tools/trace_dump.py decodes this layout; change TRACE_VERSION
+ * with it.
+ */
+struct __attribute__((packed)) TraceHeader {
+  uint32_t magic; // "NTRC"
+  uint8_t version;
+  uint8_t cores;
+  uint16_t cpuMhz; // Cycles per µs
+  uint16_t names;
+  uint16_t tasks;
+  uint8_t categories; // TRACE_* recorded
+  uint8_t reserved[3];
+};
+static_assert(sizeof(TraceHeader) == 16, "Wire layout");
+
+// Each core counts its own cycles: this ties a core's count to esp_timer's
+// µs, which both cores share
+struct __attribute__((packed)) TraceCoreRecord {
+  uint64_t anchorUs;
+  uint32_t anchorCycles;
+  uint32_t events;
+};
+static_assert(sizeof(TraceCoreRecord) == 16, "Wire layout");
+
+struct __attribute__((packed)) TraceTaskRecord {
+  char name[16];
+};
+
+struct __attribute__((packed)) TraceEventRecord {
+  uint32_t cycles; // The core's cycle count
+  uint32_t arg;    // The caller's; signed for some
+  uint16_t name;   // Index into the names; 0xFFFF: too many names
+  uint8_t task;    // Index into the tasks; 0xFF: an interrupt
+  uint8_t type;    // TRACE_BEGIN, TRACE_END or TRACE_INSTANT
+  uint8_t category;
+  uint8_t reserved[3];
+};
+static_assert(sizeof(TraceEventRecord) == 16, "Wire layout");
+
+static constexpr uint32_t TRACE_MAGIC = 0x4352544E;
+static constexpr uint8_t TRACE_VERSION = 1;
+
+/**
+ * @brief Flight recorder of begin, end and instant events from any task or
+ * interrupt, for following a change across tasks and cores: a DCC packet
+ * through momentum and MotorTask's next cycle to the bridge, or an HTTP
+ * request through the audio loop.
+ *
+ * Each core has a ring of its own, in internal RAM, that only its tasks and
+ * interrupts write; when full, the newest events overwrite the oldest. An
+ * event is a cycle count, a name, the task, and a 32-bit argument. Names
+ * are `const char *` that must live as long as the firmware: literals, or
+ * strings that are never freed.
+ *
+ * Off (the default) an event costs a load and a branch. Recording is
+ * started with start(), which allocates the rings, and write() stops it, so
+ * a download is the moment before it was asked for.
+ */
+class TraceRecorder {
+public:
+  static constexpr uint8_t CORES = 2;
+  static constexpr uint16_t DEFAULT_EVENTS = 1024; // Per core
+  static constexpr uint16_t MAX_EVENTS = 4096;
+  static constexpr uint16_t MAX_NAMES = 96;
+  static constexpr uint8_t MAX_TASKS = 32;
+
+  static TraceRecorder &getInstance() {
+    static TraceRecorder instance;
+    return instance;
+  }
+
+  __attribute__((always_inline)) inline bool enabled(uint8_t category) const {
+    return _categories.load(std::memory_order_relaxed) & category;
+  }
+
+  // From any task or interrupt
+  __attribute__((always_inline)) inline void record(uint8_t category,
+                                                    uint8_t type,
+                                                    const char *name,
+                                                    uint32_t arg = 0) {
+    if (enabled(category))
+      _record(category, type, name, arg);
+  }
+
+  /**
+   * @brief Starts a new trace of @p categories, with room for @p events per
+   * core. False if out of memory.
+   */
+  bool start(uint8_t categories = TRACE_DEFAULT,
+             uint16_t events = DEFAULT_EVENTS);
+  void stop();
+  void clear(); // Stops and frees the rings
+  bool hasTrace() const { return _capacity; }
+
+  /**
+   * @brief Stops recording and writes the trace. False if there is none or
+   * the client went away.
+   */
+  bool write(Print &out);
+  void getStatus(JsonObject out);
+
+  static uint8_t parseCategories(const char *list);
+
+  TraceRecorder(const TraceRecorder &) = delete;
+  TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+private:
+  TraceRecorder() { _mutex = xSemaphoreCreateMutex(); }
+
+  struct Event {
+    uint32_t cycles;
+    uint32_t arg;
+    const char *name;
+    TaskHandle_t task; // nullptr in an interrupt
+    uint8_t type;
+    uint8_t category;
+  };
+
+  struct Ring {
+    Event *events = nullptr;
+    std::atomic<uint32_t> head{0}; // Events ever written
+    // Refreshed about once a second, so cycle counts can be placed in time
+    // however often the 32-bit count has wrapped
+    uint32_t anchorCycles = 0;
+    int64_t anchorUs = 0;
+    portMUX_TYPE anchorLock = portMUX_INITIALIZER_UNLOCKED;
+  };
+
+  void _record(uint8_t category, uint8_t type, const char *name,
+               uint32_t arg);
+  void _anchor(Ring &ring);
+  void _stopWriters();
+  void _free();
+  void _lock() { xSemaphoreTake(_mutex, portMAX_DELAY); }
+  void _unlock() { xSemaphoreGive(_mutex); }
+
+  Ring _rings[CORES];
+  uint16_t _capacity = 0;
+  uint32_t _cyclesPerUs = 240;
+  uint32_t _anchorPeriod = 0; // Cycles between anchors
+  std::atomic<uint8_t> _categories{0};
+  std::atomic<uint32_t> _writers{0}; // In _record() now
+  uint8_t _lastCategories = 0; // Of the trace in the rings
+  SemaphoreHandle_t _mutex;
+};
+
+// Times a scope: a begin event now, and its end when the scope closes
+class TraceScope {
+public:
+  __attribute__((always_inline)) TraceScope(uint8_t category,
+                                            const char *name,
+                                            uint32_t arg = 0)
+      : _category(category), _name(name) {
+    TraceRecorder::getInstance().record(category, TRACE_BEGIN, name, arg);
+  }
+  __attribute__((always_inline)) ~TraceScope() {
+    TraceRecorder::getInstance().record(_category, TRACE_END, _name);
+  }
+
+private:
+  uint8_t _category;
+  const char *_name;
+};
+
+__attribute__((always_inline)) inline void
+traceInstant(uint8_t category, const char *name, uint32_t arg = 0) {
+  TraceRecorder::getInstance().record(category, TRACE_INSTANT, name, arg);
+}
+
+#endif
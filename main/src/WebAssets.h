@@ -192,12 +192,14 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             <!-- Debug Tab -->
             <section id="debug" class="tab-content">
                 <div class="card">
-                    <h3>Motor Self-Test</h3>
-                    <p>Runs a 3-second motor profile. Ensure track is clear.</p>
-                    <button class="btn warning" onclick="runMotorTest()">Run Test (3s)</button>
+                    <h3>Motor Capture</h3>
+                    <p>Records raw motor current around a stall, fault or manual trigger. Decode with tools/motor_capture.py.</p>
+                    <button class="btn warning" onclick="armCapture()">Arm</button>
+                    <button class="btn" onclick="triggerCapture()">Trigger Now</button>
+                    <button class="btn small" onclick="cancelCapture()">Cancel</button>
                     <div class="result-box">
-                        <textarea id="test-results" readonly placeholder="Results will appear here..."></textarea>
-                        <button class="btn small" onclick="copyTestResults()">Copy JSON</button>
+                        <span id="capture-status">Idle</span>
+                        <a id="capture-download" class="btn small" href="/api/motor/capture/data" download="capture.bin" style="display:none">Download</a>
                     </div>
                 </div>
 
@@ -678,6 +680,7 @@ document.addEventListener('DOMContentLoaded', () => {
     pollStatus();
     statusInterval = setInterval(pollStatus, 1000);
     initTelemetryChart();
+    if (currentTab === 'telemetry') openTelemetry();
 
     document.getElementById('upload-form').addEventListener('submit', handleUpload);
     
@@ -716,41 +719,55 @@ function initTelemetryChart() {
     });
 }
 
-async function updateTelemetryData() {
-    if (currentTab !== 'telemetry' || !telemetryChart) return;
-    try {
-        const response = await fetch('/api/logs?filter=[NIMRS_DATA]'); 
-        const logArray = await response.json();
-
-        let times = [], rpms = [], currents = [], zones = [], stalls = [];
-
-        logArray.forEach(line => {
-            const jsonStart = line.indexOf('{');
-            if (jsonStart > -1) {
-                try {
-                    const data = JSON.parse(line.substring(jsonStart));
-                    const tsMatch = line.match(/\[(\d+)\]/);
-                    times.push(tsMatch ? tsMatch[1] : '');
-                    rpms.push(data.rpm);
-                    currents.push(data.cur);
-                    zones.push(data.zone);
-                    stalls.push(data.stall);
-                } catch (e) {}
-            }
+// Binary frames from /ws/telemetry (layout: TelemetryFrame in the firmware)
+let telemetrySocket = null;
+let telemetryPoints = [];
+
+function decodeTelemetry(buffer) {
+    const v = new DataView(buffer);
+    if (v.byteLength < 8 || v.getUint16(0, true) !== 0x544e || v.getUint8(2) !== 1) return [];
+    const frames = [];
+    for (let i = 0, o = 8; i < v.getUint8(3); i++, o += 36) {
+        frames.push({
+            t: v.getUint32(o + 4, true),
+            zone: v.getUint8(o + 9),
+            stall: (v.getUint8(o + 10) & 0x04) ? 1 : 0,
+            cur: v.getFloat32(o + 16, true),
+            rpm: v.getFloat32(o + 20, true)
         });
-
-        // Keep last 100 points
-        const limit = 100;
-        telemetryChart.data.labels = times.slice(-limit);
-        telemetryChart.data.datasets[0].data = rpms.slice(-limit);
-        telemetryChart.data.datasets[1].data = currents.slice(-limit);
-        telemetryChart.data.datasets[2].data = zones.slice(-limit);
-        telemetryChart.data.datasets[3].data = stalls.slice(-limit);
+    }
+    return frames;
+}
+
+function openTelemetry() {
+    if (telemetrySocket || !telemetryChart) return;
+    // Every 5th control frame: 10 points a second
+    telemetrySocket = new WebSocket(`ws://${location.host}/ws/telemetry?decimate=5`);
+    telemetrySocket.binaryType = 'arraybuffer';
+    telemetrySocket.onmessage = (ev) => {
+        const frames = decodeTelemetry(ev.data);
+        if (frames.length === 0) return;
+        telemetryPoints = telemetryPoints.concat(frames).slice(-100); // Keep last 100 points
+        telemetryChart.data.labels = telemetryPoints.map(p => (p.t / 1000).toFixed(0));
+        telemetryChart.data.datasets[0].data = telemetryPoints.map(p => p.rpm);
+        telemetryChart.data.datasets[1].data = telemetryPoints.map(p => p.cur);
+        telemetryChart.data.datasets[2].data = telemetryPoints.map(p => p.zone);
+        telemetryChart.data.datasets[3].data = telemetryPoints.map(p => p.stall);
         telemetryChart.update();
-    } catch (e) {}
+    };
+    telemetrySocket.onclose = () => {
+        telemetrySocket = null;
+        // Reconnect while the tab is open
+        if (currentTab === 'telemetry') setTimeout(openTelemetry, 2000);
+    };
 }
 
-setInterval(updateTelemetryData, 500);
+function closeTelemetry() {
+    if (!telemetrySocket) return;
+    telemetrySocket.onclose = null;
+    telemetrySocket.close();
+    telemetrySocket = null;
+}
 
 // --- Tab Management ---
 function showTab(tabId) {
@@ -778,6 +795,7 @@ function showTab(tabId) {
             if (logInterval) { clearInterval(logInterval); logInterval = null; }
         }
 
+        if (tabId === 'telemetry') openTelemetry(); else closeTelemetry();
         if (tabId === 'cvs' && cvDefs.length === 0) loadAllCVs();
         if (tabId === 'files') loadFiles();
     }
@@ -1379,17 +1397,27 @@ function togglePass(btn, id='wifi-pass') {
     btn.innerText = el.type === 'password' ? 'Show' : 'Hide';
 }
 
-function runMotorTest() {
-    fetch('/api/motor/test', { method: 'POST' }).then(() => {
-        setTimeout(() => {
-            fetch('/api/motor/test').then(r=>r.text()).then(t => document.getElementById('test-results').value = t);
-        }, 4000);
+let captureTimer = null;
+function pollCapture() {
+    clearTimeout(captureTimer);
+    fetch('/api/motor/capture').then(r=>r.json()).then(d => {
+        const done = d.state === 'done';
+        document.getElementById('capture-status').innerText = done ? `Done (${d.size} bytes)` : d.state;
+        document.getElementById('capture-download').style.display = done ? '' : 'none';
+        if (d.state === 'armed' || d.state === 'triggered') captureTimer = setTimeout(pollCapture, 500);
+    });
+}
+function armCapture() {
+    fetch('/api/motor/capture?trigger=manual,stall,fault', { method: 'POST' }).then(r => {
+        if (!r.ok) return showToast("Capture busy");
+        pollCapture();
     });
 }
-function copyTestResults() {
-    document.getElementById('test-results').select();
-    document.execCommand('copy');
-    showToast("Copied");
+function triggerCapture() {
+    fetch('/api/motor/capture/trigger', { method: 'POST' }).then(pollCapture);
+}
+function cancelCapture() {
+    fetch('/api/motor/capture', { method: 'DELETE' }).then(pollCapture);
 }
 
 function measureResistance() {
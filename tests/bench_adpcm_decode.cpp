@@ -0,0 +1,163 @@
+// clang-format off
+// TEST_SOURCES: src/ImaAdpcm.cpp
+// TEST_FLAGS: -O2
+// clang-format on
+
+// Host benchmark: decode cost per output sample for the three asset codecs.
+// `tools/test_runner.py --bench` keeps the ADPCM figure (per sample) against
+// tests/bench_baseline.json; the copy is only a reference. By hand:
+//
+//   g++ -O2 -std=c++17 -Isrc tests/bench_adpcm_decode.cpp src/ImaAdpcm.cpp
+//
+// MP3 is measured only when built against the libhelix sources that ship
+// with arduino-libhelix (src/libhelix-mp3), e.g.
+//
+//   H=$HELIX/src/libhelix-mp3
+//   g++ -O2 -std=c++17 -Isrc -DBENCH_WITH_HELIX -I$H
+//       tests/bench_adpcm_decode.cpp src/ImaAdpcm.cpp $H/*.c
+//   ./a.out some_asset.mp3
+//
+// Host numbers only rank the codecs; absolute cycles on the ESP32-S3 need
+// the on-target measurement described in docs/audio-roadmap.md.
+
+#include "ImaAdpcm.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#ifdef BENCH_WITH_HELIX
+extern "C" {
+#include "mp3dec.h"
+}
+#endif
+
+namespace {
+constexpr size_t FRAMES = 22050 * 10; // 10 s mono
+constexpr int ITERATIONS = 20;
+
+template <typename F> double nsPerSample(size_t samples, F &&body) {
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < ITERATIONS; i++)
+    body();
+  auto end = std::chrono::high_resolution_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count();
+  return ns / ((double)samples * ITERATIONS);
+}
+
+volatile int32_t sink;
+size_t allocations = 0;
+
+void report(const char *name, double ns, size_t allocs, size_t ops) {
+  printf("BENCH {\"name\": \"%s\", \"ns_per_op\": %.2f, "
+         "\"allocs_per_op\": %.3f}\n",
+         name, ns, (double)allocs / ops);
+}
+
+#ifdef BENCH_WITH_HELIX
+void benchHelix(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    printf("MP3 (Helix):      cannot open %s\n", path);
+    return;
+  }
+  std::vector<uint8_t> mp3;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    mp3.insert(mp3.end(), buf, buf + n);
+  fclose(f);
+
+  HMP3Decoder dec = MP3InitDecoder();
+  std::vector<int16_t> pcm(1152 * 2);
+  size_t samples = 0;
+  double ns = nsPerSample(1, [&] {
+    unsigned char *in = mp3.data();
+    int left = (int)mp3.size();
+    while (left > 0) {
+      int sync = MP3FindSyncWord(in, left);
+      if (sync < 0)
+        break;
+      in += sync;
+      left -= sync;
+      if (MP3Decode(dec, &in, &left, pcm.data(), 0) != ERR_MP3_NONE) {
+        in++;
+        left--;
+        continue;
+      }
+      MP3FrameInfo info;
+      MP3GetLastFrameInfo(dec, &info);
+      samples += info.outputSamps;
+    }
+  });
+  MP3FreeDecoder(dec);
+  if (samples)
+    printf("MP3 (Helix):      %.2f ns/sample\n",
+           ns * ITERATIONS / ((double)samples));
+}
+#endif
+} // namespace
+
+void *operator new(size_t size) {
+  allocations++;
+  if (void *p = malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+int main(int argc, char **argv) {
+  std::vector<int16_t> pcm(FRAMES);
+  for (size_t i = 0; i < FRAMES; i++)
+    pcm[i] = (int16_t)(12000 * sin(2 * M_PI * 440.0 * i / 22050));
+
+  // Baseline: PCM WAV is a straight copy into the output buffer
+  std::vector<int16_t> out(FRAMES);
+  double wavNs = nsPerSample(FRAMES, [&] {
+    memcpy(out.data(), pcm.data(), FRAMES * sizeof(int16_t));
+    sink = out[FRAMES / 2];
+  });
+
+  const size_t blockAlign = 512;
+  size_t perBlock = imaAdpcmFramesPerBlock(blockAlign, 1);
+  size_t blocks = (FRAMES + perBlock - 1) / perBlock;
+  std::vector<uint8_t> adpcm(blocks * blockAlign);
+  ImaAdpcmState state;
+  for (size_t b = 0; b < blocks; b++) {
+    size_t first = b * perBlock;
+    imaAdpcmEncodeBlock(&pcm[first], std::min(perBlock, FRAMES - first), 1,
+                        &state, &adpcm[b * blockAlign], blockAlign);
+  }
+
+  std::vector<int16_t> block(perBlock);
+  size_t before = allocations;
+  double adpcmNs = nsPerSample(blocks * perBlock, [&] {
+    for (size_t b = 0; b < blocks; b++)
+      imaAdpcmDecodeBlock(&adpcm[b * blockAlign], blockAlign, 1,
+                          block.data());
+    sink = block[0];
+  });
+  size_t adpcmAllocs = allocations - before;
+
+  printf("WAV (PCM16 copy): %.2f ns/sample, %zu bytes\n", wavNs,
+         FRAMES * sizeof(int16_t));
+  printf("IMA-ADPCM:        %.2f ns/sample, %zu bytes\n", adpcmNs,
+         adpcm.size());
+  report("adpcm_decode_sample", adpcmNs, adpcmAllocs,
+         blocks * perBlock * ITERATIONS);
+#ifdef BENCH_WITH_HELIX
+  if (argc > 1)
+    benchHelix(argv[1]);
+  else
+    printf("MP3 (Helix):      pass an .mp3 path to measure\n");
+#else
+  (void)argc;
+  (void)argv;
+  printf("MP3 (Helix):      rebuild with -DBENCH_WITH_HELIX to measure\n");
+#endif
+  return 0;
+}
@@ -1,11 +1,39 @@
+// clang-format off
+// TEST_SOURCES:
+// TEST_FLAGS: -O2
+// clang-format on
+
+// Host benchmark: isMp3File() against the String suffix checks it replaced.
+// Both are printed as BENCH lines for `tools/test_runner.py --bench`.
+
 #include "../src/AudioUtils.h"
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <new>
 #include <string>
 #include <strings.h> // for strcasecmp
 #include <vector>
 
+size_t allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  if (void *p = malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void report(const char *name, double seconds, size_t allocs, size_t ops) {
+  printf("BENCH {\"name\": \"%s\", \"ns_per_op\": %.2f, "
+         "\"allocs_per_op\": %.3f}\n",
+         name, seconds * 1e9 / ops, (double)allocs / ops);
+}
+
 // Mock String class to simulate Arduino String overhead
 class String : public std::string {
 public:
@@ -22,6 +50,7 @@ void run_benchmark() {
   const int iterations = 1000000;
 
   // Benchmark unoptimized approach
+  size_t before1 = allocations;
   auto start1 = std::chrono::high_resolution_clock::now();
   volatile int matches1 = 0;
   for (int i = 0; i < iterations; ++i) {
@@ -32,8 +61,10 @@ void run_benchmark() {
   }
   auto end1 = std::chrono::high_resolution_clock::now();
   std::chrono::duration<double> diff1 = end1 - start1;
+  size_t allocs1 = allocations - before1;
 
   // Benchmark optimized approach
+  size_t before2 = allocations;
   auto start2 = std::chrono::high_resolution_clock::now();
   volatile int matches2 = 0;
   for (int i = 0; i < iterations; ++i) {
@@ -43,10 +74,14 @@ void run_benchmark() {
   }
   auto end2 = std::chrono::high_resolution_clock::now();
   std::chrono::duration<double> diff2 = end2 - start2;
+  size_t allocs2 = allocations - before2;
 
   std::cout << "Unoptimized (String allocation): " << diff1.count() << " s\n";
   std::cout << "Optimized (AudioUtils::isMp3File): " << diff2.count() << " s\n";
   std::cout << "Speedup: " << diff1.count() / diff2.count() << "x\n";
+  std::cout.flush();
+  report("mp3_name_string", diff1.count(), allocs1, iterations);
+  report("mp3_name_check", diff2.count(), allocs2, iterations);
 }
 
 void test_safety() {
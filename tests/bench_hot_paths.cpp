@@ -0,0 +1,160 @@
+// clang-format off
+// TEST_SOURCES: src/DspFilters.cpp src/RippleDetector.cpp src/BemfEstimator.cpp src/Logger.cpp src/Telemetry.cpp src/PerfMonitor.cpp tests/mocks/mocks.cpp
+// TEST_FLAGS: -O2 -DSKIP_MOCK_LOGGER
+// clang-format on
+
+// Host microbenchmarks for the per-tick paths: each prints one line
+//
+//   BENCH {"name": ..., "ns_per_op": ..., "allocs_per_op": ...}
+//
+// which `tools/test_runner.py --bench` compares with tests/bench_baseline.json.
+// The time is the best of several batches, to shed scheduler noise; the
+// allocations are counted through operator new, so they are exact.
+//
+// Host nanoseconds only catch regressions in our code: the ratio to the
+// baseline matters, not the number. The JSON case runs over the host
+// ArduinoJson mock, so it times Telemetry::toJson rather than the library.
+
+#include "../src/CvRegistry.h"
+#include "BemfEstimator.h"
+#include "DspFilters.h"
+#include "Logger.h"
+#include "RippleDetector.h"
+#include "Telemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+constexpr double BATCH_NS = 5e6; // Grow a batch until it takes 5 ms
+constexpr int REPEATS = 20;
+constexpr size_t ALLOC_OPS = 1000;
+constexpr size_t RIPPLE_SAMPLES = 1024; // One ADC DMA buffer; a power of 2
+constexpr float SAMPLE_RATE = 20000.0f;
+
+size_t allocations = 0;
+volatile float sink; // Keeps results observable, so the work stays
+
+template <typename Op> double timeBatch(Op &op, size_t n) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; i++)
+    op();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+template <typename Op> void bench(const char *name, Op op) {
+  op(); // Warm up caches and lazy state
+  size_t n = 1;
+  while (timeBatch(op, n) < BATCH_NS)
+    n *= 2;
+  double best = INFINITY;
+  for (int r = 0; r < REPEATS; r++)
+    best = std::min(best, timeBatch(op, n) / n);
+
+  size_t before = allocations;
+  for (size_t i = 0; i < ALLOC_OPS; i++)
+    op();
+  double allocs = (double)(allocations - before) / ALLOC_OPS;
+  printf("BENCH {\"name\": \"%s\", \"ns_per_op\": %.2f, "
+         "\"allocs_per_op\": %.3f}\n",
+         name, best, allocs);
+}
+
+// A motor current trace: DC, the commutator ripple at 400 Hz, and noise
+void fillRipple(float *buf, size_t len) {
+  uint32_t seed = 1;
+  for (size_t i = 0; i < len; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    float noise = ((seed >> 8) & 0xFF) / 255.0f - 0.5f;
+    float phase = 2.0f * (float)M_PI * 400.0f * i / SAMPLE_RATE;
+    buf[i] = 0.3f + 0.05f * sinf(phase) + 0.01f * noise;
+  }
+}
+
+// MotorTask's channels, as /api/telemetry serializes them
+void declareTelemetry() {
+  Telemetry &t = Telemetry::getInstance();
+  const char *u8s[] = {"target_speed", "zone"};
+  const char *bools[] = {"forward", "moving", "stalled", "fault"};
+  const char *floats[] = {"duty",        "current", "voltage",   "rpm",
+                          "ripple_freq", "ke",      "learned_r", "load"};
+  for (const char *name : u8s)
+    t.publish(t.add(name, "", TelemetryType::U8, 50), 42);
+  for (const char *name : bools)
+    t.publish(t.add(name, "", TelemetryType::BOOL, 50), true);
+  for (const char *name : floats)
+    t.publish(t.add(name, "", TelemetryType::F32, 50), 0.125f);
+  t.publish(t.add("raw_adc", "counts", TelemetryType::U32, 50), 2048u);
+}
+} // namespace
+
+void *operator new(size_t size) {
+  allocations++;
+  if (void *p = malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+int main() {
+  // Every case reads the same current trace; a drifting input would decay
+  // the filters into denormals and time those instead
+  static float trace[RIPPLE_SAMPLES], buf[RIPPLE_SAMPLES];
+  fillRipple(trace, RIPPLE_SAMPLES);
+  size_t at = 0;
+  auto next = [&] { return trace[at++ % RIPPLE_SAMPLES]; };
+
+  EmaFilter ema(0.1f);
+  bench("ema_update", [&] { sink = ema.update(next()); });
+
+  DcBlocker dc(0.95f);
+  bench("dc_blocker", [&] { sink = dc.process(next()); });
+
+  // processBuffer filters in place, so each pass starts from a fresh copy
+  RippleDetector ripple;
+  bench("ripple_process_buffer", [&] {
+    memcpy(buf, trace, sizeof(buf));
+    ripple.processBuffer(buf, RIPPLE_SAMPLES, SAMPLE_RATE);
+    sink = ripple.getFrequency();
+  });
+
+  BemfEstimator bemf;
+  bemf.setMotorParams(35.0f, 5);
+  bench("bemf_calculate", [&] {
+    bemf.updateLowSpeedData(6.0f, next());
+    bemf.updateRippleFreq(400.0f);
+    bemf.calculateEstimate();
+    sink = bemf.getEstimatedRpm();
+  });
+
+  unsigned long line = 0;
+  bench("logger_printf",
+        [&] { Log.printf("[Motor] tick %lu duty=%.2f\n", line++, 0.5); });
+
+  declareTelemetry();
+  bench("telemetry_json", [&] {
+    JsonDocument doc;
+    Telemetry::getInstance().toJson(doc.to<JsonObject>());
+    String out;
+    serializeJson(doc, out);
+    sink = out.length();
+  });
+
+  // The linear scan DccController and the CV routes do, for the last entry
+  volatile uint16_t id = CV_DEFS[CV_DEFS_COUNT - 1].id;
+  bench("cv_def_lookup", [&] {
+    for (size_t i = 0; i < CV_DEFS_COUNT; i++) {
+      if (CV_DEFS[i].id == id) {
+        sink = CV_DEFS[i].defaultValue;
+        break;
+      }
+    }
+  });
+  return 0;
+}
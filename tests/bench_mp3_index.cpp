@@ -0,0 +1,208 @@
+// clang-format off
+// TEST_SOURCES: src/Mp3Index.cpp
+// TEST_FLAGS: -O2
+// clang-format on
+
+// Host benchmark: MP3 frame index build cost and restart latency.
+//
+//   g++ -O2 -std=c++17 -Isrc tests/bench_mp3_index.cpp src/Mp3Index.cpp
+//   ./a.out [asset.mp3]
+//
+// Without an argument a synthetic 3-minute 128 kbps stream is used, and the
+// index build and seek plan are printed as BENCH lines for
+// `tools/test_runner.py --bench`. "Bytes
+// read" is the figure that matters on target, where every read goes through
+// LittleFS; host times only compare the approaches.
+//
+// With -DBENCH_WITH_HELIX (see bench_adpcm_decode.cpp for the build line)
+// the restart is also decoded: from the start of the file versus from the
+// index's seek plan, up to the first wanted sample.
+
+#include "Mp3Index.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#ifdef BENCH_WITH_HELIX
+extern "C" {
+#include "mp3dec.h"
+}
+#endif
+
+namespace {
+using Clock = std::chrono::high_resolution_clock;
+
+size_t allocations = 0;
+
+void report(const char *name, double ns, size_t allocs, size_t ops) {
+  printf("BENCH {\"name\": \"%s\", \"ns_per_op\": %.2f, "
+         "\"allocs_per_op\": %.3f}\n",
+         name, ns, (double)allocs / ops);
+}
+
+double usSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(Clock::now() - start)
+      .count();
+}
+
+std::vector<uint8_t> syntheticMp3(uint32_t frames) {
+  const uint8_t hdr[4] = {0xFF, 0xFB, 0x90, 0x40}; // 417-byte frames
+  std::vector<uint8_t> out;
+  out.reserve(frames * 417);
+  for (uint32_t i = 0; i < frames; i++) {
+    size_t at = out.size();
+    out.resize(at + 417, 0x11);
+    memcpy(&out[at], hdr, 4);
+    memset(&out[at + 4], 0, 32);
+    uint16_t mdb = (i * 37) % 300; // Some reservoir use
+    out[at + 4] = mdb >> 1;
+    out[at + 5] = (mdb & 1) << 7;
+  }
+  return out;
+}
+
+struct CountingReader {
+  const std::vector<uint8_t> &data;
+  size_t calls = 0;
+  size_t bytes = 0;
+  size_t operator()(uint32_t offset, uint8_t *buf, size_t len) {
+    calls++;
+    if (offset >= data.size())
+      return 0;
+    size_t n = std::min(len, data.size() - offset);
+    memcpy(buf, &data[offset], n);
+    bytes += n;
+    return n;
+  }
+};
+
+// What a restart costs without an index: hop header to header from the top
+uint32_t linearFind(CountingReader &read, uint32_t size, uint32_t frame) {
+  uint32_t pos = 0;
+  uint8_t h[4];
+  Mp3FrameInfo info;
+  for (uint32_t i = 0; i < frame && pos + 4 <= size; i++) {
+    if (read(pos, h, 4) != 4 || !parseMp3FrameHeader(h, info))
+      return 0;
+    pos += info.frameLen;
+  }
+  return pos;
+}
+
+#ifdef BENCH_WITH_HELIX
+// Decodes from byte offset until sample target is produced
+double decodeTo(const std::vector<uint8_t> &mp3, uint32_t offset,
+                uint32_t startSample, uint32_t target) {
+  HMP3Decoder dec = MP3InitDecoder();
+  std::vector<int16_t> pcm(1152 * 2);
+  unsigned char *in = const_cast<unsigned char *>(mp3.data()) + offset;
+  int left = (int)(mp3.size() - offset);
+  uint32_t produced = startSample;
+  auto start = Clock::now();
+  while (left > 0 && produced <= target) {
+    int sync = MP3FindSyncWord(in, left);
+    if (sync < 0)
+      break;
+    in += sync;
+    left -= sync;
+    if (MP3Decode(dec, &in, &left, pcm.data(), 0) == ERR_MP3_NONE) {
+      MP3FrameInfo fi;
+      MP3GetLastFrameInfo(dec, &fi);
+      produced += fi.outputSamps / fi.nChans;
+    } else if (left > 0) {
+      in++;
+      left--;
+    }
+  }
+  double us = usSince(start);
+  MP3FreeDecoder(dec);
+  return us;
+}
+#endif
+} // namespace
+
+void *operator new(size_t size) {
+  allocations++;
+  if (void *p = malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+int main(int argc, char **argv) {
+  std::vector<uint8_t> mp3;
+  if (argc > 1) {
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+      printf("cannot open %s\n", argv[1]);
+      return 1;
+    }
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+      mp3.insert(mp3.end(), buf, buf + n);
+    fclose(f);
+  } else {
+    mp3 = syntheticMp3(180 * 44100 / 1152);
+  }
+
+  CountingReader buildReader{mp3};
+  Mp3Index index;
+  size_t before = allocations;
+  auto start = Clock::now();
+  bool ok = index.build(std::ref(buildReader), mp3.size());
+  double buildUs = usSince(start);
+  size_t buildAllocs = allocations - before;
+  if (!ok) {
+    printf("no MP3 frames found\n");
+    return 1;
+  }
+  size_t sidecar = index.serialize().size();
+  printf("Index build: %u frames in %.0f us, %zu reads, %zu bytes read, "
+         "sidecar %zu bytes\n",
+         (unsigned)index.frameCount(), buildUs, buildReader.calls,
+         buildReader.bytes, sidecar);
+  printf("Gapless info: %s (delay %u, padding %u, priming %u samples)\n",
+         index.hasGaplessInfo() ? "yes" : "no", index.encoderDelay(),
+         index.encoderPadding(), (unsigned)index.primingSamples());
+
+  // Restart at 90% of the file, e.g. a loop point near the end
+  uint32_t targetFrame = index.frameCount() * 9 / 10;
+  uint32_t target = targetFrame * index.samplesPerFrame() + 100;
+
+  CountingReader linearReader{mp3};
+  start = Clock::now();
+  uint32_t linearOffset = linearFind(linearReader, mp3.size(), targetFrame);
+  double linearUs = usSince(start);
+
+  Mp3SeekPlan plan;
+  const int reps = 1000;
+  before = allocations;
+  start = Clock::now();
+  for (int i = 0; i < reps; i++)
+    index.planSeek(target, plan);
+  double planUs = usSince(start) / reps;
+  size_t planAllocs = allocations - before;
+
+  printf("Restart at frame %u: linear scan %.1f us (%zu reads, offset %u), "
+         "index %.3f us (0 reads, start frame %u, %u pre-roll)\n",
+         (unsigned)targetFrame, linearUs, linearReader.calls,
+         (unsigned)linearOffset, planUs, (unsigned)plan.frame,
+         (unsigned)(targetFrame - plan.frame));
+
+  if (argc == 1) {
+    report("mp3_index_build", buildUs * 1000, buildAllocs, 1);
+    report("mp3_plan_seek", planUs * 1000, planAllocs, reps);
+  }
+
+#ifdef BENCH_WITH_HELIX
+  printf("Decode to target: from start %.0f us, from seek plan %.0f us\n",
+         decodeTo(mp3, index.frameOffset(0), 0, target),
+         decodeTo(mp3, plan.byteOffset, plan.outputSample, target));
+#endif
+  return 0;
+}
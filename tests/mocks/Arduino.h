@@ -1,6 +1,7 @@
 #ifndef ARDUINO_MOCK_H
 #define ARDUINO_MOCK_H
 
+#include "driver/gpio.h"
 #include <cctype>
 #include <cstring>
 #include <functional>
@@ -38,11 +39,11 @@ public:
       return -1;
     return (int)found;
   }
-  int indexOf(char c) const {
-    const char *p = strchr(this->c_str(), c);
-    if (p)
-      return p - this->c_str();
-    return -1;
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t found = this->find(c, from);
+    if (found == std::string::npos)
+      return -1;
+    return (int)found;
   }
   int lastIndexOf(char c) const {
     size_t found = this->rfind(c);
@@ -92,15 +93,52 @@ public:
       return;
     this->erase(index, count);
   }
+  void replace(const String &find, const String &with) {
+    if (find.empty())
+      return;
+    for (size_t at = this->find(find); at != std::string::npos;
+         at = this->find(find, at + with.length()))
+      std::string::replace(at, find.length(), with);
+  }
+  void trim() {
+    size_t start = this->find_first_not_of(" \t\n\r");
+    if (start == std::string::npos) {
+      this->clear();
+      return;
+    }
+    size_t end = this->find_last_not_of(" \t\n\r");
+    *this = String(this->substr(start, end - start + 1));
+  }
 };
 
 #define PROGMEM
+#define IRAM_ATTR
 #define PSTR(s) s
 #define F(s) s
 
 extern unsigned long _mockMillis;
+#ifdef NIMRS_SIM
+// The simulator's virtual clock (tests/sim/SimKernel.cpp)
+unsigned long simMillis();
+unsigned long simMicros();
+void simDelay(unsigned long ms);
+inline unsigned long millis() { return simMillis(); }
+inline unsigned long micros() { return simMicros(); }
+inline void delay(unsigned long ms) { simDelay(ms); }
+#else
 inline unsigned long millis() { return _mockMillis; }
+inline unsigned long micros() { return _mockMillis * 1000; }
 inline void delay(unsigned long ms) {}
+#endif
+inline uint32_t getCpuFrequencyMhz() { return 240; }
+
+// The core's start-up hooks that main.cpp's app_main() replaces around;
+// the twin (tests/twin/twin_main.cpp) defines them
+#define ARDUINO_RUNNING_CORE 1
+void initArduino();
+void setup();
+void loop();
+void serialEventRun() __attribute__((weak));
 
 class IPAddress {
 public:
@@ -158,6 +196,8 @@ public:
   bool restartCalled = false;
   void restart() { restartCalled = true; }
   void reset() { restartCalled = false; }
+  uint32_t mockFreeHeap = 200000;
+  uint32_t getFreeHeap() { return mockFreeHeap; }
 };
 extern ESPClass ESP;
 
@@ -176,7 +216,11 @@ extern ESPClass ESP;
 extern std::string mockLogBuffer;
 
 inline void pinMode(int pin, int mode) {}
-inline void digitalWrite(int pin, int val) {}
+inline int mockPinLevel[64] = {0};
+inline void digitalWrite(int pin, int val) {
+  if (pin >= 0 && pin < 64)
+    mockPinLevel[pin] = val;
+}
 inline void analogReadResolution(int bits) {}
 inline void analogSetPinAttenuation(int pin, int attenuation) {}
 inline void ledcSetup(int channel, int freq, int resolution) {}
@@ -3,22 +3,45 @@
 
 #include "Arduino.h"
 #include <algorithm>
+#include <cstdlib>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
+namespace ArduinoJson {
+class Allocator {
+public:
+  virtual void *allocate(size_t size) = 0;
+  virtual void deallocate(void *ptr) = 0;
+  virtual void *reallocate(void *ptr, size_t new_size) = 0;
+
+protected:
+  ~Allocator() = default;
+};
+} // namespace ArduinoJson
+
 // Forward declarations
 class JsonArray;
 class JsonObject;
 
+// A scalar kept as text, or a nested array or object. Copies share the
+// nested storage, as variants of the real library refer into their document.
 struct JsonVariant {
   String val;
+  bool quoted = false; // A string: serialized in quotes, escaped
+  std::shared_ptr<std::vector<JsonVariant>> arr;
+  std::shared_ptr<std::map<std::string, JsonVariant>> obj;
+
   JsonVariant() : val("") {}
-  JsonVariant(const char *v) : val(v) {}
-  JsonVariant(String v) : val(v) {}
+  JsonVariant(const char *v) : val(v ? v : ""), quoted(v != nullptr) {}
+  JsonVariant(String v) : val(v), quoted(true) {}
   JsonVariant(int v) : val(std::to_string(v)) {}
   JsonVariant(unsigned int v) : val(std::to_string(v)) {}
+  JsonVariant(long v) : val(std::to_string(v)) {}
   JsonVariant(long unsigned int v) : val(std::to_string(v)) {}
+  JsonVariant(long long v) : val(std::to_string(v)) {}
+  JsonVariant(unsigned long long v) : val(std::to_string(v)) {}
   JsonVariant(float v) : val(std::to_string(v)) {}
   JsonVariant(double v) : val(std::to_string(v)) {}
   JsonVariant(bool v) : val(v ? "true" : "false") {}
@@ -37,7 +60,8 @@ struct JsonVariant {
   operator JsonArray() const;
   operator JsonObject() const;
 
-  template <typename T> void operator=(T v) { val = JsonVariant(v).val; }
+  template <typename T> void operator=(T v) { *this = JsonVariant(v); }
+  JsonVariant &operator=(const JsonVariant &) = default;
 };
 
 // JsonPair
@@ -75,6 +99,7 @@ public:
   template <typename T> T add() { return T(); }
 
   template <typename T> T to() { return T(); }
+  size_t size() const { return _dataPtr ? _dataPtr->size() : 0; }
 };
 
 // JsonObject Mock
@@ -143,20 +168,56 @@ public:
 };
 
 // Implement conversions
-inline JsonVariant::operator JsonArray() const { return JsonArray(); }
-inline JsonVariant::operator JsonObject() const { return JsonObject(); }
+inline JsonVariant::operator JsonArray() const { return JsonArray(arr.get()); }
+inline JsonVariant::operator JsonObject() const {
+  return JsonObject(obj.get());
+}
 
 // Implement as<T> specializations
 template <> inline String JsonVariant::as<String>() const { return val; }
 template <> inline int JsonVariant::as<int>() const { return val.toInt(); }
+template <> inline JsonArray JsonVariant::as<JsonArray>() const {
+  return JsonArray(arr.get());
+}
+template <> inline JsonObject JsonVariant::as<JsonObject>() const {
+  return JsonObject(obj.get());
+}
 template <typename T> T JsonVariant::as() const { return T(); }
 
+// Turns the variant into an empty array or object, as in the real library
+template <> inline JsonArray JsonVariant::to<JsonArray>() {
+  *this = JsonVariant();
+  arr = std::make_shared<std::vector<JsonVariant>>();
+  return JsonArray(arr.get());
+}
+template <> inline JsonObject JsonVariant::to<JsonObject>() {
+  *this = JsonVariant();
+  obj = std::make_shared<std::map<std::string, JsonVariant>>();
+  return JsonObject(obj.get());
+}
+
+template <> inline JsonArray JsonArray::add<JsonArray>() {
+  if (!_dataPtr)
+    return JsonArray();
+  _dataPtr->emplace_back();
+  return _dataPtr->back().to<JsonArray>();
+}
+template <> inline JsonObject JsonArray::add<JsonObject>() {
+  if (!_dataPtr)
+    return JsonObject();
+  _dataPtr->emplace_back();
+  return _dataPtr->back().to<JsonObject>();
+}
+
 class JsonDocument {
 public:
   std::map<std::string, JsonVariant> _data;
   std::vector<JsonVariant> _arrayData;
   bool _isArray = false;
 
+  JsonDocument() = default;
+  explicit JsonDocument(ArduinoJson::Allocator *) {}
+
   JsonVariant &operator[](String key) { return _data[(std::string)key]; }
   JsonVariant &operator[](const char *key) { return _data[(std::string)key]; }
 
@@ -179,54 +240,107 @@ template <> inline JsonObject JsonDocument::to<JsonObject>() {
   _data.clear();
   return JsonObject(&_data);
 }
+template <> inline JsonArray JsonDocument::as<JsonArray>() {
+  return _isArray ? JsonArray(&_arrayData) : JsonArray();
+}
+template <> inline JsonObject JsonDocument::as<JsonObject>() {
+  return _isArray ? JsonObject() : JsonObject(&_data);
+}
 
-inline void serializeJson(const JsonDocument &doc, String &out) {
-  if (doc._isArray) {
-    out = "[";
-    for (size_t i = 0; i < doc._arrayData.size(); ++i) {
-      if (i > 0)
-        out += ",";
-      String val = doc._arrayData[i].val;
-      bool quote = true;
-      if (val == "true" || val == "false")
-        quote = false;
-      else if (val.find_first_not_of("0123456789.-") == std::string::npos &&
-               !val.empty())
-        quote = false;
-      else if (val.startsWith("{") || val.startsWith("["))
-        quote = false;
-
-      if (quote)
-        out += "\"" + val + "\"";
-      else
-        out += val;
-    }
-    out += "]";
-  } else {
-    out = "{";
-    bool first = true;
-    for (auto const &pair : doc._data) {
-      if (!first)
-        out += ",";
-      first = false;
-      out += "\"" + String(pair.first.c_str()) + "\":";
-      String val = pair.second.val;
-      bool quote = true;
-      if (val == "true" || val == "false")
-        quote = false;
-      else if (val.find_first_not_of("0123456789.-") == std::string::npos &&
-               !val.empty())
-        quote = false;
-      else if (val.startsWith("{") || val.startsWith("["))
-        quote = false;
-
-      if (quote)
-        out += "\"" + val + "\"";
-      else
-        out += val;
+// Unquoted scalars are kept as text: a number is what parses whole as one,
+// so "nan" and "inf" are not
+inline bool isJsonNumber(const String &val) {
+  if (val.empty() ||
+      val.find_first_not_of("0123456789.-+eE") != std::string::npos)
+    return false;
+  char *end = nullptr;
+  strtod(val.c_str(), &end);
+  return *end == 0;
+}
+
+inline void serializeJsonString(const String &val, String &out) {
+  out += "\"";
+  for (char c : val) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if ((unsigned char)c < 0x20) {
+        char esc[8];
+        snprintf(esc, sizeof(esc), "\\u%04x", c);
+        out += esc;
+      } else {
+        out += c;
+      }
     }
-    out += "}";
   }
+  out += "\"";
+}
+
+inline void serializeJsonValue(const std::vector<JsonVariant> &arr,
+                               String &out);
+inline void serializeJsonValue(const std::map<std::string, JsonVariant> &obj,
+                               String &out);
+
+// Unset variants, and numbers that are not finite, come out as null
+inline void serializeJsonValue(const JsonVariant &v, String &out) {
+  if (v.arr)
+    serializeJsonValue(*v.arr, out);
+  else if (v.obj)
+    serializeJsonValue(*v.obj, out);
+  else if (v.quoted)
+    serializeJsonString(v.val, out);
+  else if (v.val == "true" || v.val == "false" || isJsonNumber(v.val))
+    out += v.val;
+  else
+    out += "null";
+}
+
+inline void serializeJsonValue(const std::vector<JsonVariant> &arr,
+                               String &out) {
+  out += "[";
+  for (size_t i = 0; i < arr.size(); ++i) {
+    if (i > 0)
+      out += ",";
+    serializeJsonValue(arr[i], out);
+  }
+  out += "]";
+}
+
+inline void serializeJsonValue(const std::map<std::string, JsonVariant> &obj,
+                               String &out) {
+  out += "{";
+  bool first = true;
+  for (auto const &pair : obj) {
+    if (!first)
+      out += ",";
+    first = false;
+    serializeJsonString(String(pair.first.c_str()), out);
+    out += ":";
+    serializeJsonValue(pair.second, out);
+  }
+  out += "}";
+}
+
+inline void serializeJson(const JsonDocument &doc, String &out) {
+  out = "";
+  if (doc._isArray)
+    serializeJsonValue(doc._arrayData, out);
+  else
+    serializeJsonValue(doc._data, out);
 }
 
 inline void serializeJson(const JsonDocument &doc, Print &out) {
@@ -235,8 +349,16 @@ inline void serializeJson(const JsonDocument &doc, Print &out) {
   out.print(s.c_str());
 }
 
-inline void serializeJson(const JsonArray &arr, String &out) { out = "[]"; }
-inline void serializeJson(const JsonObject &obj, String &out) { out = "{}"; }
+inline void serializeJson(const JsonArray &arr, String &out) {
+  out = "";
+  serializeJsonValue(arr._dataPtr ? *arr._dataPtr : std::vector<JsonVariant>(),
+                     out);
+}
+inline void serializeJson(const JsonObject &obj, String &out) {
+  out = "";
+  serializeJsonValue(
+      obj._dataPtr ? *obj._dataPtr : std::map<std::string, JsonVariant>(), out);
+}
 
 struct DeserializationError {
   enum Code { Ok, InvalidInput };
@@ -282,7 +404,8 @@ inline DeserializationError deserializeJson(JsonDocument &doc,
       break;
 
     std::string val;
-    if (s[pos] == '"') {
+    bool quoted = s[pos] == '"';
+    if (quoted) {
       size_t val_start = pos + 1;
       size_t val_end = s.find('"', val_start);
       if (val_end == std::string::npos)
@@ -297,6 +420,7 @@ inline DeserializationError deserializeJson(JsonDocument &doc,
       pos = val_end;
     }
     doc._data[key] = JsonVariant(val);
+    doc._data[key].quoted = quoted;
 
     pos = s.find_first_of(",}", pos);
     if (pos == std::string::npos || s[pos] == '}')
@@ -306,6 +430,11 @@ inline DeserializationError deserializeJson(JsonDocument &doc,
   return DeserializationError::Ok;
 }
 
+inline DeserializationError deserializeJson(JsonDocument &doc, const char *in,
+                                            size_t len) {
+  return deserializeJson(doc, String(std::string(in, len)));
+}
+
 class File;
 inline DeserializationError deserializeJson(JsonDocument &doc, File &file) {
   return DeserializationError::Ok;
@@ -9,6 +9,7 @@ public:
   AudioController();
   void loadAssets();
   void playFile(const char *file);
+  void stop();
 };
 
 #endif
@@ -0,0 +1,241 @@
+#ifndef AUDIO_FIXTURES_H
+#define AUDIO_FIXTURES_H
+
+#include "AudioUtils.h"
+#include "ImaAdpcm.h"
+#include "SoundAsset.h"
+#include "SoundPack.h"
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief File images for the audio tests: RIFF/WAVE and MP3 as the decoders
+ * meet them on LittleFS, and sound packs as tools/mksoundpack.py writes them.
+ */
+namespace AudioFixtures {
+
+inline void put16(std::vector<uint8_t> &v, uint16_t x) {
+  v.push_back(x & 0xFF);
+  v.push_back(x >> 8);
+}
+inline void put32(std::vector<uint8_t> &v, uint32_t x) {
+  put16(v, x & 0xFFFF);
+  put16(v, x >> 16);
+}
+inline void putTag(std::vector<uint8_t> &v, const char *tag) {
+  v.insert(v.end(), tag, tag + 4);
+}
+
+// RIFF, a 16-byte fmt chunk and the header of a data chunk of @p dataSize
+// bytes; the caller appends the samples
+inline std::vector<uint8_t> wavHeader(uint16_t format, uint16_t channels,
+                                      uint32_t rate, uint16_t blockAlign,
+                                      uint16_t bits, uint32_t dataSize) {
+  std::vector<uint8_t> wav;
+  putTag(wav, "RIFF");
+  put32(wav, 36 + dataSize);
+  putTag(wav, "WAVE");
+  putTag(wav, "fmt ");
+  put32(wav, 16);
+  put16(wav, format);
+  put16(wav, channels);
+  put32(wav, rate);
+  put32(wav, rate * blockAlign);
+  put16(wav, blockAlign);
+  put16(wav, bits);
+  putTag(wav, "data");
+  put32(wav, dataSize);
+  return wav;
+}
+
+// PCM16 WAV whose samples are base, base + 1, ... (channel c adds 2 * c), so
+// the output shows exactly which frame of which file was played
+inline std::vector<uint8_t> rampWav(int16_t base, uint32_t frames,
+                                    uint16_t channels = 1,
+                                    uint32_t rate = 44100) {
+  std::vector<uint8_t> wav =
+      wavHeader(1, channels, rate, 2 * channels, 16, frames * 2 * channels);
+  for (uint32_t i = 0; i < frames; i++)
+    for (uint16_t c = 0; c < channels; c++)
+      put16(wav, (uint16_t)(base + i + 2 * c));
+  return wav;
+}
+
+// PCM16 WAV holding a constant level on every channel
+inline std::vector<uint8_t> dcWav(int16_t level, uint32_t frames,
+                                  uint16_t channels = 1,
+                                  uint32_t rate = 44100) {
+  std::vector<uint8_t> wav =
+      wavHeader(1, channels, rate, 2 * channels, 16, frames * 2 * channels);
+  for (uint32_t i = 0; i < frames * channels; i++)
+    put16(wav, (uint16_t)level);
+  return wav;
+}
+
+// Appends a smpl chunk with one sustain loop over frames start..last
+// (inclusive), behind the data chunk where editors put it
+inline void putSmplLoop(std::vector<uint8_t> &wav, uint32_t start,
+                        uint32_t last) {
+  putTag(wav, "smpl");
+  put32(wav, 36 + 24);
+  for (int i = 0; i < 7; i++)
+    put32(wav, 0);
+  put32(wav, 1); // One loop
+  put32(wav, 0);
+  put32(wav, 0);
+  put32(wav, 0);
+  put32(wav, start);
+  put32(wav, last);
+  put32(wav, 0);
+  put32(wav, 0);
+  uint32_t riff = wav.size() - 8;
+  for (int i = 0; i < 4; i++)
+    wav[4 + i] = (riff >> (8 * i)) & 0xFF;
+}
+
+// Encodes PCM into a complete IMA-ADPCM .wav image with a LIST chunk of
+// @p listSize bytes in front of fmt, like files written by common editors.
+// With @p fact the frame count is declared the way wav2adpcm.py and the
+// transcoder do.
+inline std::vector<uint8_t> makeAdpcmWav(const std::vector<int16_t> &pcm,
+                                         uint8_t channels,
+                                         uint16_t blockAlign,
+                                         bool fact = false,
+                                         uint32_t listSize = 3) {
+  size_t perBlock = imaAdpcmFramesPerBlock(blockAlign, channels);
+  size_t frames = pcm.size() / channels;
+  std::vector<uint8_t> data;
+  ImaAdpcmState state[2];
+  std::vector<uint8_t> block(blockAlign);
+  for (size_t f = 0; f < frames; f += perBlock) {
+    size_t n = std::min(perBlock, frames - f);
+    assert(imaAdpcmEncodeBlock(&pcm[f * channels], n, channels, state,
+                               block.data(), blockAlign) == blockAlign);
+    data.insert(data.end(), block.begin(), block.end());
+  }
+
+  std::vector<uint8_t> wav;
+  putTag(wav, "RIFF");
+  put32(wav, 0);
+  putTag(wav, "WAVE");
+  putTag(wav, "LIST");
+  put32(wav, listSize);
+  wav.insert(wav.end(), listSize + (listSize & 1), 0); // Odd: a pad byte
+  putTag(wav, "fmt ");
+  put32(wav, 20);
+  put16(wav, WAV_FORMAT_IMA_ADPCM);
+  put16(wav, channels);
+  put32(wav, 22050);
+  put32(wav, 22050 * blockAlign / perBlock);
+  put16(wav, blockAlign);
+  put16(wav, 4);
+  put16(wav, 2);
+  put16(wav, perBlock);
+  if (fact) {
+    putTag(wav, "fact");
+    put32(wav, 4);
+    put32(wav, frames);
+  }
+  putTag(wav, "data");
+  put32(wav, data.size());
+  wav.insert(wav.end(), data.begin(), data.end());
+  return wav;
+}
+
+// MPEG-1 Layer III, 128 kbps, 44.1 kHz: 417-byte frames of 1152 samples
+constexpr uint8_t MP3_HEADER[4] = {0xFF, 0xFB, 0x90, 0x40};
+constexpr size_t MP3_FRAME_LEN = 417;
+constexpr size_t MP3_SIDE_INFO = 4 + 32;
+
+// Appends one frame with zeroed side info and @p fill as main data.
+// Returns where the frame starts.
+inline size_t putMp3Frame(std::vector<uint8_t> &v, uint8_t fill = 0) {
+  size_t at = v.size();
+  v.resize(at + MP3_FRAME_LEN, fill);
+  memcpy(&v[at], MP3_HEADER, 4);
+  memset(&v[at + 4], 0, MP3_SIDE_INFO - 4);
+  return at;
+}
+
+// Bitwise CRC-32, as zlib.crc32 computes it on the host
+inline uint32_t crc32(const std::vector<uint8_t> &data) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint8_t b : data) {
+    crc ^= b;
+    for (int i = 0; i < 8; i++)
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+inline void putPackName(std::vector<uint8_t> &v, const char *name) {
+  size_t at = v.size();
+  v.resize(at + SoundPack::NAME_LEN, 0);
+  memcpy(&v[at], name, strlen(name));
+}
+
+struct PackFile {
+  const char *name;
+  AudioCodec codec;
+  std::vector<uint8_t> data;
+};
+
+struct PackAsset {
+  uint8_t id;
+  SoundType type;
+  uint16_t intro, loop, outro; // File indices or SoundPack::NO_FILE
+  uint32_t loopStart, loopEnd;
+  const char *name;
+};
+
+// Same layout tools/mksoundpack.py writes. A nonzero @p badOffset replaces
+// every file offset.
+inline std::vector<uint8_t> makePack(const std::vector<PackFile> &files,
+                                     const std::vector<PackAsset> &assets,
+                                     uint32_t badOffset = 0) {
+  std::vector<uint8_t> body;
+  uint32_t offset = SoundPack::HEADER_SIZE +
+                    files.size() * SoundPack::FILE_ENTRY_SIZE +
+                    assets.size() * SoundPack::ASSET_ENTRY_SIZE;
+  std::vector<uint8_t> blobs;
+  for (const PackFile &f : files) {
+    while (offset % 4) {
+      blobs.push_back(0);
+      offset++;
+    }
+    putPackName(body, f.name);
+    body.push_back((uint8_t)f.codec);
+    body.insert(body.end(), 3, 0);
+    put32(body, badOffset ? badOffset : offset);
+    put32(body, f.data.size());
+    blobs.insert(blobs.end(), f.data.begin(), f.data.end());
+    offset += f.data.size();
+  }
+
+  for (const PackAsset &a : assets) {
+    body.push_back(a.id);
+    body.push_back((uint8_t)a.type);
+    put16(body, 0);
+    put16(body, a.intro);
+    put16(body, a.loop);
+    put16(body, a.outro);
+    put16(body, 0);
+    put32(body, a.loopStart);
+    put32(body, a.loopEnd);
+    putPackName(body, a.name);
+  }
+
+  body.insert(body.end(), blobs.begin(), blobs.end());
+  std::vector<uint8_t> pack = {'N', 'S', 'P', 'K', SoundPack::VERSION,
+                               (uint8_t)assets.size()};
+  put16(pack, files.size());
+  put32(pack, SoundPack::HEADER_SIZE + body.size());
+  put32(pack, crc32(body));
+  pack.insert(pack.end(), body.begin(), body.end());
+  return pack;
+}
+
+} // namespace AudioFixtures
+
+#endif
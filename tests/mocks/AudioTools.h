@@ -1,7 +1,9 @@
 #pragma once
 
 #include "Arduino.h"
+#include "AudioUtils.h"
 #include <LittleFS.h>
+#include <vector>
 
 #define TX_MODE 1
 
@@ -13,9 +15,17 @@ struct I2SConfig {
   int sample_rate;
 };
 
-class AudioStream {
+class AudioStream : public Print {
 public:
   virtual ~AudioStream() = default;
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t *data, size_t len) override {
+    bytesWritten += len;
+    written.insert(written.end(), data, data + len);
+    return len;
+  }
+  size_t bytesWritten = 0;
+  std::vector<uint8_t> written;
 };
 
 class I2SStream : public AudioStream {
@@ -32,27 +42,103 @@ public:
   void setVolume(float volume) {}
 };
 
+struct AudioInfo {
+  int sample_rate = 0;
+  int channels = 0;
+  int bits_per_sample = 0;
+  AudioInfo() = default;
+  AudioInfo(int rate, int ch, int bits)
+      : sample_rate(rate), channels(ch), bits_per_sample(bits) {}
+};
+
 class AudioDecoder {
 public:
   virtual ~AudioDecoder() = default;
+  virtual bool begin() { return true; }
+  virtual void end() {}
+  virtual size_t write(const uint8_t *data, size_t len) { return len; }
+  virtual operator bool() { return true; }
+  virtual void setOutput(Print &out) { p_print = &out; }
+  virtual AudioInfo audioInfo() { return info; }
+
+protected:
+  Print *p_print = nullptr;
+  AudioInfo info;
+  void notifyAudioChange(AudioInfo) {}
 };
 
+// Stands in for Helix: once a test sets mockInfo, input is passed through as
+// if it were already PCM16 in that format.
 class MP3DecoderHelix : public AudioDecoder {
 public:
   MP3DecoderHelix() {}
+  size_t write(const uint8_t *data, size_t len) override {
+    if (p_print && mockInfo.sample_rate != 0)
+      p_print->write(data, len);
+    return len;
+  }
+  AudioInfo audioInfo() override { return mockInfo; }
+  static inline AudioInfo mockInfo;
 };
 
+// Passes the data chunk of a PCM16 WAV through unchanged
 class WAVDecoder : public AudioDecoder {
 public:
   WAVDecoder() {}
+  bool begin() override {
+    _header.clear();
+    _inData = false;
+    return true;
+  }
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!_inData) {
+      _header.insert(_header.end(), data, data + len);
+      WavInfo wav;
+      if (!parseWavHeader(_header.data(), _header.size(), wav))
+        return len;
+      info = AudioInfo(wav.sampleRate, wav.channels, wav.bitsPerSample);
+      _inData = true;
+      _remaining = wav.dataSize;
+      if (_header.size() > wav.dataOffset)
+        _emit(_header.data() + wav.dataOffset,
+              _header.size() - wav.dataOffset);
+      return len;
+    }
+    _emit(data, len);
+    return len;
+  }
+
+private:
+  void _emit(const uint8_t *data, size_t len) {
+    len = std::min(len, _remaining);
+    _remaining -= len;
+    if (p_print && len)
+      p_print->write(data, len);
+  }
+  std::vector<uint8_t> _header;
+  size_t _remaining = 0;
+  bool _inData = false;
 };
 
 class EncodedAudioStream : public AudioStream {
 public:
-  EncodedAudioStream(VolumeStream *out, AudioDecoder *dec) {}
-  void setDecoder(AudioDecoder *dec) {}
-  void begin() {}
-  void end() {}
+  EncodedAudioStream(Print *out, AudioDecoder *dec)
+      : _out(out), lastDecoder(dec) {}
+  void setDecoder(AudioDecoder *dec) { lastDecoder = dec; }
+  void begin() {
+    lastDecoder->setOutput(*_out);
+    lastDecoder->begin();
+  }
+  void end() { lastDecoder->end(); }
+  size_t write(const uint8_t *data, size_t len) override {
+    return lastDecoder->write(data, len);
+  }
+
+private:
+  Print *_out;
+
+public:
+  AudioDecoder *lastDecoder;
 };
 
 class StreamCopy {
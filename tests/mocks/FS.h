@@ -0,0 +1,65 @@
+#ifndef FS_MOCK_H
+#define FS_MOCK_H
+
+#include "Arduino.h"
+#include <memory>
+#include <vector>
+
+class File {
+public:
+  operator bool() const { return _valid; }
+  void close() {}
+  // Content-backed files (see LittleFS.open(path, "w")) keep what is written
+  size_t write(const uint8_t *buf, size_t size) {
+    if (_content)
+      _content->insert(_content->end(), buf, buf + size);
+    return size;
+  }
+  size_t write(uint8_t c) { return write(&c, 1); }
+  const char *name() const { return _name.c_str(); }
+  size_t size() const { return _content ? _content->size() : _size; }
+  bool isDirectory() const { return _isDir; }
+  time_t getLastWrite() const { return 0; }
+  File openNextFile(); // Defined in mocks.cpp
+  File() : _name(""), _size(0), _isDir(false), _valid(false), _nextIdx(0) {}
+  File(String name, size_t size, bool isDir = false)
+      : _name(name), _size(size), _isDir(isDir), _valid(true), _nextIdx(0) {}
+  // Content-backed file for tests that read data
+  File(String name, const std::vector<uint8_t> &content)
+      : _name(name), _size(content.size()), _isDir(false), _valid(true),
+        _nextIdx(0),
+        _content(std::make_shared<std::vector<uint8_t>>(content)) {}
+
+  size_t read(uint8_t *buf, size_t len) {
+    if (!_content || _pos >= _content->size())
+      return 0;
+    size_t n = std::min(len, _content->size() - _pos);
+    memcpy(buf, _content->data() + _pos, n);
+    _pos += n;
+    return n;
+  }
+  int read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  bool seek(size_t pos) {
+    if (pos > size())
+      return false;
+    _pos = pos;
+    return true;
+  }
+  size_t position() const { return _pos; }
+  int available() const { return _pos < size() ? (int)(size() - _pos) : 0; }
+  const std::vector<uint8_t> *content() const { return _content.get(); }
+
+private:
+  String _name;
+  size_t _size;
+  bool _isDir;
+  bool _valid;
+  size_t _nextIdx;
+  std::shared_ptr<std::vector<uint8_t>> _content;
+  size_t _pos = 0;
+};
+
+#endif
@@ -2,7 +2,7 @@
 #define LITTLEFS_MOCK_H
 
 #include "Arduino.h"
-#include "WebServer.h" // For File definition
+#include "FS.h"
 #include <vector>
 
 class LittleFSClass {
@@ -13,8 +13,8 @@ public:
   bool begin(bool format = true) { return true; }
   void end() {}
   bool format() { return true; }
-  size_t totalBytes() { return 1000; }
-  size_t usedBytes() { return 100; }
+  size_t totalBytes() { return mockTotalBytes; }
+  size_t usedBytes() { return mockUsedBytes; }
 
   bool exists(const String &path) {
     callCount_exists++;
@@ -25,7 +25,28 @@ public:
     return false;
   }
 
-  bool remove(const String &path) { return true; }
+  bool remove(const String &path) {
+    for (auto it = mockFiles.begin(); it != mockFiles.end(); ++it) {
+      if (String(it->name()) == path) {
+        mockFiles.erase(it);
+        return true;
+      }
+    }
+    return true;
+  }
+
+  bool rename(const String &from, const String &to) {
+    for (auto &f : mockFiles) {
+      if (String(f.name()) == from) {
+        File moved(to, f.content() ? *f.content() : std::vector<uint8_t>());
+        remove(to);
+        remove(from);
+        mockFiles.push_back(moved);
+        return true;
+      }
+    }
+    return false;
+  }
 
   File open(const String &path, const char *mode = "r") {
     callCount_open++;
@@ -34,6 +55,13 @@ public:
     if (path == "/")
       return File("/", 0, true);
 
+    // Writes land in a fresh content-backed file that later opens can read
+    if (mode[0] == 'w') {
+      remove(path);
+      mockFiles.push_back(File(path, std::vector<uint8_t>()));
+      return mockFiles.back();
+    }
+
     for (auto &f : mockFiles) {
       if (String(f.name()) == path)
         return f;
@@ -44,6 +72,8 @@ public:
 
   // Mock file system
   std::vector<File> mockFiles;
+  size_t mockTotalBytes = 1000;
+  size_t mockUsedBytes = 100;
   String lastOpenedPath; // Added for testing
 };
 
@@ -7,8 +7,6 @@ class MotorController {
 public:
   static MotorController &getInstance();
   MotorController();
-  void startTest();
-  String getTestJSON();
 
   enum class ResistanceState { IDLE, MEASURING, DONE, ERROR };
   void measureResistance();
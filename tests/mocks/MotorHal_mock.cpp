@@ -8,5 +8,9 @@ MotorHal &MotorHal::getInstance() {
 MotorHal::MotorHal() {}
 void MotorHal::init() {}
 void MotorHal::setDuty(float duty) {}
+void MotorHal::setHardwareGain(uint8_t mode) {}
+bool MotorHal::readFault() { return false; }
+float MotorHal::getCurrentScalar() const { return 0.001f; }
+float MotorHal::getLatestCurrentAdc() const { return 0.0f; }
 size_t MotorHal::getAdcSamples(float *buffer, size_t maxLen) { return 0; }
 float MotorHal::getAdcSampleRate() const { return 20000.0f; }
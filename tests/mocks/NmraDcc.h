@@ -32,6 +32,11 @@ struct DCC_MSG {
 #define FN_BIT_03 0x08
 #define FN_BIT_04 0x10
 
+// The library's callbacks, which the decoder defines
+extern "C" {
+void notifyCVResetFactoryDefault();
+}
+
 class NmraDcc {
 public:
   // State for verification
@@ -2,6 +2,7 @@
 #define UPDATE_H
 
 #include "Arduino.h"
+#include "esp_partition.h"
 #include <stddef.h>
 #include <stdint.h>
 
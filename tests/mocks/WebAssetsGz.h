@@ -0,0 +1,17 @@
+#ifndef WEBASSETSGZ_MOCK_H
+#define WEBASSETSGZ_MOCK_H
+#include <cstddef>
+#include <cstdint>
+const uint8_t INDEX_HTML_GZ[] = {0};
+const size_t INDEX_HTML_GZ_LEN = 0;
+#define INDEX_HTML_DIGEST "0"
+const uint8_t STYLE_CSS_GZ[] = {0};
+const size_t STYLE_CSS_GZ_LEN = 0;
+#define STYLE_CSS_DIGEST "0"
+const uint8_t APP_JS_GZ[] = {0};
+const size_t APP_JS_GZ_LEN = 0;
+#define APP_JS_DIGEST "0"
+const uint8_t LAME_MIN_JS_GZ[] = {0};
+const size_t LAME_MIN_JS_GZ_LEN = 0;
+#define LAME_MIN_JS_DIGEST "0"
+#endif
@@ -2,8 +2,10 @@
 #define WEBSERVER_MOCK_H
 
 #include "Arduino.h"
+#include "FS.h"
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -30,27 +32,6 @@ struct HTTPUpload {
 #define UPLOAD_FILE_END 2
 #define CONTENT_LENGTH_UNKNOWN 0
 
-class File {
-public:
-  operator bool() const { return _valid; }
-  void close() {}
-  size_t write(const uint8_t *buf, size_t size) { return size; }
-  const char *name() const { return _name.c_str(); }
-  size_t size() const { return _size; }
-  bool isDirectory() const { return _isDir; }
-  File openNextFile(); // Defined in mocks.cpp
-  File() : _name(""), _size(0), _isDir(false), _valid(false), _nextIdx(0) {}
-  File(String name, size_t size, bool isDir = false)
-      : _name(name), _size(size), _isDir(isDir), _valid(true), _nextIdx(0) {}
-
-private:
-  String _name;
-  size_t _size;
-  bool _isDir;
-  bool _valid;
-  size_t _nextIdx;
-};
-
 class WebServer {
 public:
   WebServer(int port) : _method(HTTP_GET), lastCode(0) {}
@@ -1,3 +1,13 @@
 #pragma once
 typedef int gpio_num_t;
+typedef enum {
+  GPIO_DRIVE_CAP_0,
+  GPIO_DRIVE_CAP_1,
+  GPIO_DRIVE_CAP_2,
+  GPIO_DRIVE_CAP_3,
+} gpio_drive_cap_t;
 inline void gpio_reset_pin(gpio_num_t gpio_num) {}
+inline int gpio_set_drive_capability(gpio_num_t gpio_num,
+                                     gpio_drive_cap_t strength) {
+  return 0;
+}
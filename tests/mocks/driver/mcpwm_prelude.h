@@ -0,0 +1,9 @@
+#pragma once
+typedef struct mcpwm_timer_t *mcpwm_timer_handle_t;
+typedef struct mcpwm_oper_t *mcpwm_oper_handle_t;
+typedef struct mcpwm_cmpr_t *mcpwm_cmpr_handle_t;
+typedef struct mcpwm_gen_t *mcpwm_gen_handle_t;
+typedef struct {
+  unsigned int count_value;
+  int direction;
+} mcpwm_timer_event_data_t;
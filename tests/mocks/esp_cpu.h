@@ -0,0 +1,11 @@
+#ifndef ESP_CPU_H
+#define ESP_CPU_H
+
+#include <Arduino.h>
+
+// The cycle counter of a 240 MHz core, on the host clock
+inline uint32_t esp_cpu_get_cycle_count() {
+  return (uint32_t)(micros() * getCpuFrequencyMhz());
+}
+
+#endif
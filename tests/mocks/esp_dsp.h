@@ -0,0 +1,18 @@
+#ifndef ESP_DSP_MOCK_H
+#define ESP_DSP_MOCK_H
+
+#include "esp_err.h"
+
+// Reference (ANSI) biquad, direct form II, as in esp-dsp
+inline esp_err_t dsps_biquad_f32(const float *input, float *output, int len,
+                                 float *coef, float *w) {
+  for (int i = 0; i < len; i++) {
+    float d0 = input[i] - coef[3] * w[0] - coef[4] * w[1];
+    output[i] = coef[0] * d0 + coef[1] * w[0] + coef[2] * w[1];
+    w[1] = w[0];
+    w[0] = d0;
+  }
+  return ESP_OK;
+}
+
+#endif
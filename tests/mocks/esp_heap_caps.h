@@ -0,0 +1,30 @@
+#ifndef ESP_HEAP_CAPS_H
+#define ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// The host heap says nothing about the decoder's, so this reports a steady
+// internal RAM: heap figures in /api/status are placeholders on the host
+#define MALLOC_CAP_DEFAULT (1 << 12)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_8BIT (1 << 2)
+
+static constexpr size_t TWIN_FREE_HEAP = 200 * 1024;
+
+inline void *heap_caps_malloc(size_t size, uint32_t caps) {
+  return malloc(size);
+}
+inline void heap_caps_free(void *ptr) { free(ptr); }
+inline size_t heap_caps_get_free_size(uint32_t caps) { return TWIN_FREE_HEAP; }
+inline size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  return TWIN_FREE_HEAP;
+}
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  return TWIN_FREE_HEAP / 2;
+}
+inline int heap_caps_monitor_local_minimum_free_size_start() { return 0; }
+inline int heap_caps_monitor_local_minimum_free_size_stop() { return 0; }
+
+#endif
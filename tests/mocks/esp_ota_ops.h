@@ -5,6 +5,9 @@
 #include "esp_err.h"
 #include "esp_partition.h"
 
+#define ESP_ERR_OTA_BASE 0x1500
+#define ESP_ERR_OTA_VALIDATE_FAILED (ESP_ERR_OTA_BASE + 0x03)
+
 // OTA functions
 typedef enum {
   ESP_OTA_IMG_NEW,
@@ -22,6 +25,7 @@ const esp_partition_t *esp_ota_get_last_invalid_partition(void);
 esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
 const esp_partition_t *esp_ota_get_boot_partition(void);
 esp_err_t esp_ota_mark_app_valid_cancel_rollback(void);
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void);
 esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition,
                                       esp_ota_img_states_t *ota_state);
 
@@ -1,8 +1,11 @@
 #ifndef ESP_PARTITION_H
 #define ESP_PARTITION_H
 
+#include "esp_err.h"
+#include <stddef.h>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 typedef enum {
   ESP_PARTITION_TYPE_APP,
@@ -15,6 +18,7 @@ typedef enum {
   ESP_PARTITION_SUBTYPE_DATA_NVS,
   ESP_PARTITION_SUBTYPE_DATA_SPIFFS,
   ESP_PARTITION_SUBTYPE_DATA_COREDUMP,
+  ESP_PARTITION_SUBTYPE_ANY = 0xff,
 } esp_partition_subtype_t;
 
 typedef struct {
@@ -26,4 +30,32 @@ typedef struct {
   bool encrypted;
 } esp_partition_t;
 
+typedef enum {
+  ESP_PARTITION_MMAP_DATA,
+  ESP_PARTITION_MMAP_INST,
+} esp_partition_mmap_memory_t;
+
+typedef uint32_t esp_partition_mmap_handle_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition,
+                             size_t src_offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition,
+                              size_t dst_offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition,
+                                    size_t offset, size_t size);
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset,
+                             size_t size, esp_partition_mmap_memory_t memory,
+                             const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle);
+void esp_partition_munmap(esp_partition_mmap_handle_t handle);
+
+// Raw "sounds" data partition backed by mockSoundsFlash. Writes AND into the
+// flash like NOR does, so a missing erase shows up as corrupt data.
+extern esp_partition_t mock_sounds;
+extern std::vector<uint8_t> mockSoundsFlash;
+extern int mockPartitionMapped; // Live esp_partition_mmap handles
+
 #endif
@@ -0,0 +1,8 @@
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <Arduino.h>
+
+inline int64_t esp_timer_get_time() { return micros(); }
+
+#endif
@@ -12,4 +12,12 @@ typedef uint32_t TickType_t;
 #define pdTRUE 1
 #define pdFALSE 0
 
+// One core, no interrupts
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL_SAFE(mux) ((void)(mux))
+#define portEXIT_CRITICAL_SAFE(mux) ((void)(mux))
+inline int xPortGetCoreID() { return 0; }
+inline int xPortInIsrContext() { return 0; }
+
 #endif
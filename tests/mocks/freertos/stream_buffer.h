@@ -0,0 +1,18 @@
+#ifndef STREAM_BUFFER_MOCK_H
+#define STREAM_BUFFER_MOCK_H
+
+#include "FreeRTOS.h"
+#include <stddef.h>
+
+typedef void *StreamBufferHandle_t;
+
+inline StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t trigger) {
+  return (StreamBufferHandle_t)1;
+}
+
+inline size_t xStreamBufferReceive(StreamBufferHandle_t s, void *data,
+                                   size_t len, TickType_t ticks) {
+  return 0;
+}
+
+#endif
@@ -8,6 +8,9 @@ inline void vTaskDelay(TickType_t xTicksToDelay) {}
 inline void vTaskDelayUntil(TickType_t *pxPreviousWakeTime,
                             TickType_t xTimeIncrement) {}
 inline TickType_t xTaskGetTickCount(void) { return 0; }
+// Everything runs on the one task
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return (TaskHandle_t)1; }
+inline const char *pcTaskGetName(TaskHandle_t task) { return "main"; }
 
 inline void xTaskCreatePinnedToCore(void (*task)(void *), const char *name,
                                     uint32_t stack, void *param, uint32_t prio,
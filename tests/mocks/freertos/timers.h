@@ -0,0 +1,21 @@
+#ifndef TIMERS_MOCK_H
+#define TIMERS_MOCK_H
+
+#include "FreeRTOS.h"
+
+// Timers are created but never fire; tests call the callbacks themselves
+typedef void *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t);
+
+inline TimerHandle_t xTimerCreate(const char *name, TickType_t period,
+                                  uint32_t autoReload, void *id,
+                                  TimerCallbackFunction_t fn) {
+  return (TimerHandle_t)1;
+}
+inline int xTimerStart(TimerHandle_t timer, TickType_t ticks) { return pdTRUE; }
+inline int xTimerStop(TimerHandle_t timer, TickType_t ticks) { return pdTRUE; }
+inline int xTimerDelete(TimerHandle_t timer, TickType_t ticks) {
+  return pdTRUE;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef MBEDTLS_BASE64_H
+#define MBEDTLS_BASE64_H
+
+#include <stddef.h>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL -0x002A
+
+// mbedTLS's encoder: @p olen gets the length, or the size needed when @p dst
+// is too small; the output is NUL terminated
+inline int mbedtls_base64_encode(unsigned char *dst, size_t dlen,
+                                 size_t *olen, const unsigned char *src,
+                                 size_t slen) {
+  static const char table[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t n = (slen + 2) / 3 * 4;
+  if (dlen < n + 1) {
+    *olen = n + 1;
+    return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+  }
+  unsigned char *p = dst;
+  for (size_t i = 0; i < slen; i += 3) {
+    unsigned v = src[i] << 16;
+    if (i + 1 < slen)
+      v |= src[i + 1] << 8;
+    if (i + 2 < slen)
+      v |= src[i + 2];
+    *p++ = table[(v >> 18) & 63];
+    *p++ = table[(v >> 12) & 63];
+    *p++ = i + 1 < slen ? table[(v >> 6) & 63] : '=';
+    *p++ = i + 2 < slen ? table[v & 63] : '=';
+  }
+  *p = 0;
+  *olen = n;
+  return 0;
+}
+
+#endif
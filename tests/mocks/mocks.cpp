@@ -61,6 +61,7 @@ size_t Logger::write(const uint8_t *buffer, size_t size) {
   return size;
 }
 String Logger::getLogsJSON(const String &filter) { return "[]"; }
+void Logger::getLogsJSON(JsonArray out, const String &filter) {}
 String Logger::getLogsHTML() { return ""; }
 void Logger::clear() {}
 void Logger::_addToBuffer(const String &line) {}
@@ -74,6 +75,7 @@ AudioController &AudioController::getInstance() {
 AudioController::AudioController() {}
 void AudioController::loadAssets() {}
 void AudioController::playFile(const char *file) {}
+void AudioController::stop() {}
 #endif
 
 #ifndef SKIP_MOCK_DCC_CONTROLLER
@@ -95,8 +97,6 @@ MotorController &MotorController::getInstance() {
   return instance;
 }
 MotorController::MotorController() {}
-void MotorController::startTest() {}
-String MotorController::getTestJSON() { return "{}"; }
 void MotorController::measureResistance() {}
 MotorController::ResistanceState MotorController::getResistanceState() const {
   return ResistanceState::IDLE;
@@ -152,6 +152,8 @@ const esp_partition_t *esp_ota_get_boot_partition(void) { return mock_boot; }
 
 esp_err_t esp_ota_mark_app_valid_cancel_rollback(void) { return ESP_OK; }
 
+esp_err_t esp_ota_mark_app_invalid_rollback_and_reboot(void) { return ESP_OK; }
+
 esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition,
                                       esp_ota_img_states_t *ota_state) {
   if (ota_state)
@@ -163,6 +165,67 @@ void setMockRunningPartition(const esp_partition_t *p) { mock_running = p; }
 
 const esp_partition_t *getMockBootPartition() { return mock_boot; }
 
+// Raw data partition mock
+esp_partition_t mock_sounds = {ESP_PARTITION_TYPE_DATA,
+                               (esp_partition_subtype_t)0x40,
+                               0x5F0000,
+                               0x40000,
+                               "sounds",
+                               false};
+std::vector<uint8_t> mockSoundsFlash(0x40000, 0xFF);
+int mockPartitionMapped = 0;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label) {
+  if (type == ESP_PARTITION_TYPE_DATA && label &&
+      strcmp(label, mock_sounds.label) == 0)
+    return &mock_sounds;
+  return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition,
+                             size_t src_offset, void *dst, size_t size) {
+  if (partition != &mock_sounds || src_offset + size > partition->size)
+    return ESP_FAIL;
+  memcpy(dst, mockSoundsFlash.data() + src_offset, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition,
+                              size_t dst_offset, const void *src, size_t size) {
+  if (partition != &mock_sounds || dst_offset + size > partition->size)
+    return ESP_FAIL;
+  const uint8_t *bytes = (const uint8_t *)src;
+  for (size_t i = 0; i < size; i++)
+    mockSoundsFlash[dst_offset + i] &= bytes[i];
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition,
+                                    size_t offset, size_t size) {
+  if (partition != &mock_sounds || offset + size > partition->size ||
+      offset % 4096 != 0 || size % 4096 != 0)
+    return ESP_FAIL;
+  memset(mockSoundsFlash.data() + offset, 0xFF, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset,
+                             size_t size, esp_partition_mmap_memory_t memory,
+                             const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle) {
+  if (partition != &mock_sounds || offset + size > partition->size)
+    return ESP_FAIL;
+  *out_ptr = mockSoundsFlash.data() + offset;
+  *out_handle = ++mockPartitionMapped;
+  return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {
+  mockPartitionMapped--;
+}
+
 static esp_app_desc_t mock_app_desc = {
 
     0,      0,   {0}, "1.0.0", "nimrs-fw", "12:00:00", "2023-01-01",
@@ -0,0 +1,698 @@
+#include "SimKernel.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <thread>
+
+namespace {
+constexpr uint32_t FOREVER = 0xFFFFFFFF; // portMAX_DELAY
+constexpr uint64_t IDLE_MAX_US = 100000; // Real time: longest idle() wait
+
+uint64_t hostMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+} // namespace
+
+struct SimTask {
+  std::string name;
+  void (*fn)(void *);
+  void *arg;
+  int basePriority;
+  int priority; // Raised while it holds a mutex a higher one waits for
+  int affinity; // A core, or SimKernel::ANY_CORE
+  uint32_t stack;
+  enum State { READY, RUNNING, BLOCKED, DELETED } state = READY;
+  int core = -1;         // RUNNING: the core it holds
+  uint64_t resumeAt = 0; // RUNNING: busy until then
+  uint64_t busyLeft = 0; // READY after a preemption: busy time still owed
+  bool preempted = false;
+  int64_t readySeq = 0; // Order among ready tasks of one priority
+  uint64_t readySince = 0;
+  uint64_t wakeAt = SimKernel::NEVER; // BLOCKED: the timeout
+  std::vector<SimTask *> *waitingOn = nullptr;
+  bool timedOut = false;
+  uint32_t notify = 0;
+  std::vector<SimTask *> notifyWait; // Itself, in ulTaskNotifyTake
+  uint64_t runCost = 0;
+  SimKernel::Stats stats;
+  bool started = false; // Its thread exists
+  std::condition_variable turn;
+};
+
+// Queues, semaphores, mutexes and stream buffers: as in FreeRTOS, one kind
+// of object with a send side and a receive side
+struct SimQueue {
+  enum Kind { QUEUE, SEMAPHORE, MUTEX, STREAM } kind;
+  uint32_t length;   // Items; bytes for a stream
+  uint32_t itemSize; // 0 for semaphores
+  std::deque<uint8_t> bytes;
+  uint32_t count = 0; // Semaphores
+  size_t trigger = 1; // Streams: bytes that wake a reader
+  SimTask *holder = nullptr;
+  std::vector<SimTask *> senders;
+  std::vector<SimTask *> receivers;
+};
+
+struct SimTimer {
+  std::string name;
+  uint32_t period; // Ticks
+  bool reload;
+  void *id;
+  void (*fn)(SimTimer *);
+  uint64_t expiry = SimKernel::NEVER;
+  bool deleted = false;
+};
+
+// --- Clock and scheduler ---
+
+void SimKernel::run(uint64_t us) {
+  assert(!_running && "run() is for the test, not its tasks");
+  uint64_t end = _now + us;
+  for (;;) {
+    _dispatch();
+    uint64_t next = _nextEvent();
+    if (next > end) {
+      _now = end;
+      return;
+    }
+    assert(next > _now);
+    _now = next;
+    _expire();
+  }
+}
+
+void SimKernel::runRealTime(const std::function<bool(uint64_t maxUs)> &idle) {
+  assert(!_running && "runRealTime() is for main, not its tasks");
+  _realTime = true;
+  _hostEpoch = hostMicros() - _now;
+  for (;;) {
+    _dispatch();
+    uint64_t next = _nextEvent();
+    uint64_t wait = next > now() ? std::min(next - _now, IDLE_MAX_US) : 0;
+    _inIsr = true;
+    bool more = idle(wait);
+    _inIsr = false;
+    if (!more)
+      break;
+    now();
+    _expire();
+  }
+  _realTime = false;
+}
+
+uint64_t SimKernel::now() {
+  if (_realTime)
+    _now = std::max(_now, hostMicros() - _hostEpoch);
+  return _now;
+}
+
+void SimKernel::every(uint64_t periodUs, std::function<void()> fn) {
+  assert(periodUs > 0);
+  _periodic.push_back({periodUs, _now + periodUs, fn});
+}
+
+SimTask *SimKernel::_best(int core) const {
+  SimTask *best = nullptr;
+  for (SimTask *t : _tasks) {
+    if (t->state != SimTask::READY)
+      continue;
+    if (t->affinity != ANY_CORE && t->affinity != core)
+      continue;
+    if (!best || t->priority > best->priority ||
+        (t->priority == best->priority && t->readySeq < best->readySeq))
+      best = t;
+  }
+  return best;
+}
+
+void SimKernel::_dispatch() {
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int c = 0; c < CORES; c++) {
+      SimTask *cur = _cores[c];
+      SimTask *best = _best(c);
+      // Idle cores first, so a task free to run anywhere takes one of them
+      // rather than preempting
+      if (best && cur) {
+        bool idleElsewhere = false;
+        for (int o = 0; o < CORES; o++) {
+          if (o != c && !_cores[o] && _best(o) == best)
+            idleElsewhere = true;
+        }
+        if (idleElsewhere || best->priority <= cur->priority)
+          best = nullptr;
+      }
+      if (best) {
+        if (cur) {
+          cur->busyLeft = cur->resumeAt > _now ? cur->resumeAt - _now : 0;
+          cur->core = -1;
+          _ready(cur, true);
+          cur->preempted = true;
+        }
+        best->state = SimTask::RUNNING;
+        best->core = c;
+        best->resumeAt = _now + best->busyLeft;
+        best->busyLeft = 0;
+        if (!best->preempted) {
+          uint64_t latency = _now - best->readySince;
+          Stats &s = best->stats;
+          s.activations++;
+          s.totalLatencyUs += latency;
+          if (latency > s.maxLatencyUs) {
+            s.maxLatencyUs = latency;
+            s.maxLatencyAtUs = _now;
+          }
+        }
+        best->preempted = false;
+        _cores[c] = cur = best;
+        changed = true;
+      }
+      if (cur && cur->resumeAt <= _now) {
+        _execute(c);
+        changed = true;
+      }
+    }
+  }
+}
+
+void SimKernel::_execute(int core) {
+  SimTask *t = _cores[core];
+  _running = t;
+  std::unique_lock<std::mutex> lock(_baton);
+  _owner = t;
+  if (!t->started) {
+    t->started = true;
+    std::thread(_taskEntry, t).detach();
+  } else {
+    t->turn.notify_one();
+  }
+  _kernelTurn.wait(lock, [this] { return _owner == nullptr; });
+  _running = nullptr;
+}
+
+void SimKernel::_switchOut() {
+  SimTask *t = _running;
+  std::unique_lock<std::mutex> lock(_baton);
+  _owner = nullptr;
+  _kernelTurn.notify_one();
+  t->turn.wait(lock, [this, t] { return _owner == t; });
+}
+
+void SimKernel::_ready(SimTask *task, bool front) {
+  task->state = SimTask::READY;
+  task->readySince = _now;
+  task->readySeq = front ? --_frontSeq : (int64_t)++_readySeq;
+}
+
+void SimKernel::_preemptIfNeeded() {
+  SimTask *t = _running;
+  if (!t || _inIsr)
+    return;
+  SimTask *best = _best(t->core);
+  if (!best || best->priority <= t->priority)
+    return;
+  for (int o = 0; o < CORES; o++) {
+    if (o != t->core && !_cores[o] && _best(o) == best)
+      return; // It will take the idle core
+  }
+  _cores[t->core] = nullptr;
+  t->core = -1;
+  _ready(t, true);
+  t->preempted = true;
+  _switchOut();
+}
+
+uint64_t SimKernel::_deadline(uint32_t ticks) {
+  if (ticks == FOREVER)
+    return NEVER;
+  return ((uint64_t)tick() + ticks) * TICK_US;
+}
+
+bool SimKernel::_block(std::vector<SimTask *> *list, uint64_t wakeAt) {
+  SimTask *t = _running;
+  if (!t || _inIsr || wakeAt <= _now)
+    return false; // Only a task can wait
+  t->state = SimTask::BLOCKED;
+  t->waitingOn = list;
+  if (list)
+    list->push_back(t);
+  t->wakeAt = wakeAt;
+  t->timedOut = false;
+  _cores[t->core] = nullptr;
+  t->core = -1;
+  _switchOut();
+  if (t->runCost)
+    busy(t->runCost);
+  return !t->timedOut;
+}
+
+void SimKernel::_wake(std::vector<SimTask *> *list) {
+  if (list->empty())
+    return;
+  // The highest priority waiter, the longest waiting among equals
+  auto best = list->begin();
+  for (auto it = list->begin(); it != list->end(); ++it) {
+    if ((*it)->priority > (*best)->priority)
+      best = it;
+  }
+  SimTask *t = *best;
+  list->erase(best);
+  t->waitingOn = nullptr;
+  t->wakeAt = NEVER;
+  _ready(t);
+}
+
+uint64_t SimKernel::_nextEvent() const {
+  uint64_t next = NEVER;
+  for (SimTask *t : _tasks) {
+    if (t->state == SimTask::BLOCKED)
+      next = std::min(next, t->wakeAt);
+  }
+  for (SimTask *t : _cores) {
+    if (t && t->resumeAt > _now)
+      next = std::min(next, t->resumeAt);
+  }
+  for (const Periodic &p : _periodic)
+    next = std::min(next, p.next);
+  return next;
+}
+
+void SimKernel::_expire() {
+  // Interrupts first, so what they send is there for tasks waking now
+  _inIsr = true;
+  for (size_t i = 0; i < _periodic.size(); i++) {
+    while (_periodic[i].next <= _now) {
+      _periodic[i].fn();
+      _periodic[i].next += _periodic[i].period;
+    }
+  }
+  _inIsr = false;
+  for (SimTask *t : _tasks) {
+    if (t->state != SimTask::BLOCKED || t->wakeAt > _now)
+      continue;
+    if (t->waitingOn) {
+      auto &list = *t->waitingOn;
+      list.erase(std::find(list.begin(), list.end(), t));
+      t->waitingOn = nullptr;
+    }
+    t->timedOut = true;
+    t->wakeAt = NEVER;
+    _ready(t);
+  }
+}
+
+void SimKernel::busy(uint64_t us) {
+  SimTask *t = _running;
+  if (!t || _inIsr || us == 0)
+    return;
+  t->resumeAt = _now + us;
+  t->stats.busyUs += us;
+  _switchOut();
+}
+
+void SimKernel::setRunCost(SimTask *task, uint64_t us) { task->runCost = us; }
+
+const SimKernel::Stats &SimKernel::stats(SimTask *task) const {
+  return task->stats;
+}
+
+SimTask *SimKernel::find(const char *name) const {
+  for (SimTask *t : _tasks) {
+    if (t->state != SimTask::DELETED && t->name == name)
+      return t;
+  }
+  return nullptr;
+}
+
+void SimKernel::report() const {
+  printf("%-14s %4s %4s %8s %9s %6s %9s %9s\n", "task", "core", "prio",
+         "runs", "busy_ms", "cpu%", "avg_lat", "max_lat");
+  for (SimTask *t : _tasks) {
+    const Stats &s = t->stats;
+    double avg = s.activations ? (double)s.totalLatencyUs / s.activations : 0;
+    double cpu = _now ? 100.0 * s.busyUs / _now : 0;
+    char core[8];
+    snprintf(core, sizeof(core), "%d", t->affinity);
+    printf("%-14s %4s %4d %8u %9.1f %6.1f %9.1f %9llu\n", t->name.c_str(),
+           t->affinity == ANY_CORE ? "any" : core, t->basePriority,
+           s.activations, s.busyUs / 1000.0, cpu, avg,
+           (unsigned long long)s.maxLatencyUs);
+  }
+}
+
+void SimKernel::reset() {
+  assert(!_running);
+  for (SimTask *t : _tasks) {
+    if (!t->started)
+      delete t;
+    // A started one's thread waits on it, parked, until exit
+  }
+  for (SimQueue *q : _queues)
+    delete q;
+  for (SimTimer *t : _timers)
+    delete t;
+  _tasks.clear();
+  _queues.clear();
+  _timers.clear();
+  _periodic.clear();
+  for (SimTask *&c : _cores)
+    c = nullptr;
+  _timerDaemon = nullptr;
+  _now = 0;
+  _readySeq = 0;
+  _frontSeq = 0;
+}
+
+// --- Tasks ---
+
+void SimKernel::_taskEntry(SimTask *task) {
+  SimKernel &k = getInstance();
+  {
+    // Taking the baton's lock once orders this thread after the kernel's
+    std::unique_lock<std::mutex> lock(k._baton);
+    task->turn.wait(lock, [&k, task] { return k._owner == task; });
+  }
+  task->fn(task->arg);
+  k.deleteTask(nullptr); // Returning is a bug on the target
+}
+
+SimTask *SimKernel::createTask(void (*fn)(void *), const char *name,
+                               uint32_t stack, void *arg, int priority,
+                               int core) {
+  assert(core == ANY_CORE || (core >= 0 && core < CORES));
+  SimTask *t = new SimTask;
+  t->name = name;
+  t->fn = fn;
+  t->arg = arg;
+  t->basePriority = t->priority = priority;
+  t->affinity = core;
+  t->stack = stack;
+  _tasks.push_back(t);
+  _ready(t);
+  _preemptIfNeeded();
+  return t;
+}
+
+void SimKernel::deleteTask(SimTask *task) {
+  SimTask *t = task ? task : _running;
+  if (!t || t->state == SimTask::DELETED)
+    return;
+  if (t->waitingOn) {
+    auto &list = *t->waitingOn;
+    list.erase(std::find(list.begin(), list.end(), t));
+    t->waitingOn = nullptr;
+  }
+  if (t->core >= 0)
+    _cores[t->core] = nullptr;
+  t->core = -1;
+  t->state = SimTask::DELETED;
+  if (t == _running)
+    _switchOut(); // Never resumed: its thread waits until exit
+}
+
+int SimKernel::currentCore() const { return _running ? _running->core : 0; }
+
+void SimKernel::delayTicks(uint32_t ticks) {
+  if (ticks == 0)
+    yield();
+  else
+    _block(nullptr, _deadline(ticks));
+}
+
+bool SimKernel::delayUntilTick(uint32_t *previous, uint32_t increment) {
+  uint32_t wake = *previous + increment;
+  *previous = wake;
+  if ((int32_t)(wake - tick()) <= 0)
+    return false; // Already late: no wait
+  _block(nullptr, (uint64_t)wake * TICK_US);
+  return true;
+}
+
+void SimKernel::yield() {
+  SimTask *t = _running;
+  if (!t || _inIsr)
+    return;
+  _cores[t->core] = nullptr;
+  t->core = -1;
+  _ready(t);
+  t->preempted = true; // Still running, as far as latency goes
+  _switchOut();
+}
+
+int SimKernel::priority(SimTask *task) const {
+  SimTask *t = task ? task : _running;
+  return t ? t->priority : 0;
+}
+
+void SimKernel::setPriority(SimTask *task, int priority) {
+  SimTask *t = task ? task : _running;
+  if (!t)
+    return;
+  t->basePriority = t->priority = priority;
+  _preemptIfNeeded();
+}
+
+const char *SimKernel::name(SimTask *task) const {
+  SimTask *t = task ? task : _running;
+  return t ? t->name.c_str() : "main";
+}
+
+uint32_t SimKernel::stackSize(SimTask *task) const {
+  SimTask *t = task ? task : _running;
+  return t ? t->stack : 0;
+}
+
+void SimKernel::notifyGive(SimTask *task) {
+  task->notify++;
+  if (task->waitingOn == &task->notifyWait) {
+    _wake(&task->notifyWait);
+    _preemptIfNeeded();
+  }
+}
+
+uint32_t SimKernel::notifyTake(bool clear, uint32_t ticks) {
+  SimTask *t = _running;
+  if (!t)
+    return 0;
+  if (t->notify == 0 && ticks)
+    _block(&t->notifyWait, _deadline(ticks));
+  uint32_t value = t->notify;
+  if (value)
+    t->notify = clear ? 0 : value - 1;
+  return value;
+}
+
+// --- Queues and semaphores ---
+
+SimQueue *SimKernel::createQueue(uint32_t length, uint32_t itemSize) {
+  SimQueue *q = new SimQueue;
+  q->kind = SimQueue::QUEUE;
+  q->length = length;
+  q->itemSize = itemSize;
+  _queues.push_back(q);
+  return q;
+}
+
+SimQueue *SimKernel::createSemaphore(uint32_t max, uint32_t initial,
+                                     bool mutex) {
+  SimQueue *q = createQueue(max, 0);
+  q->kind = mutex ? SimQueue::MUTEX : SimQueue::SEMAPHORE;
+  q->count = initial;
+  return q;
+}
+
+void SimKernel::deleteQueue(SimQueue *q) {
+  _queues.erase(std::find(_queues.begin(), _queues.end(), q));
+  delete q;
+}
+
+uint32_t SimKernel::waiting(SimQueue *q) const {
+  if (q->kind == SimQueue::QUEUE)
+    return q->bytes.size() / q->itemSize;
+  if (q->kind == SimQueue::STREAM)
+    return q->bytes.size();
+  return q->count;
+}
+
+uint32_t SimKernel::spaces(SimQueue *q) const {
+  return q->length - waiting(q);
+}
+
+bool SimKernel::send(SimQueue *q, const void *item, uint32_t ticks,
+                     bool front) {
+  if (q->kind == SimQueue::MUTEX) {
+    // Only the holder gives it back, and drops what it inherited
+    if (q->holder != _running || q->count > 0)
+      return false;
+    if (q->holder)
+      q->holder->priority = q->holder->basePriority;
+    q->holder = nullptr;
+  }
+  uint64_t deadline = _deadline(ticks);
+  while (spaces(q) == 0) {
+    if (q->kind != SimQueue::QUEUE || !_block(&q->senders, deadline))
+      return false;
+  }
+  if (q->kind == SimQueue::QUEUE) {
+    const uint8_t *p = (const uint8_t *)item;
+    if (front)
+      q->bytes.insert(q->bytes.begin(), p, p + q->itemSize);
+    else
+      q->bytes.insert(q->bytes.end(), p, p + q->itemSize);
+  } else {
+    q->count++;
+  }
+  _wake(&q->receivers);
+  _preemptIfNeeded();
+  return true;
+}
+
+bool SimKernel::receive(SimQueue *q, void *item, uint32_t ticks, bool peek) {
+  uint64_t deadline = _deadline(ticks);
+  while (waiting(q) == 0) {
+    // Priority inheritance: the holder runs at the waiter's priority
+    SimTask *holder = q->holder;
+    if (holder && _running && holder->priority < _running->priority)
+      holder->priority = _running->priority;
+    if (!_block(&q->receivers, deadline))
+      return false;
+  }
+  if (q->kind == SimQueue::QUEUE) {
+    std::copy_n(q->bytes.begin(), q->itemSize, (uint8_t *)item);
+    if (!peek)
+      q->bytes.erase(q->bytes.begin(), q->bytes.begin() + q->itemSize);
+  } else if (!peek) {
+    q->count--;
+    if (q->kind == SimQueue::MUTEX)
+      q->holder = _running;
+  }
+  if (!peek) {
+    _wake(&q->senders);
+    _preemptIfNeeded();
+  }
+  return true;
+}
+
+void SimKernel::resetQueue(SimQueue *q) {
+  q->bytes.clear();
+  while (!q->senders.empty())
+    _wake(&q->senders);
+  _preemptIfNeeded();
+}
+
+SimTask *SimKernel::mutexHolder(SimQueue *q) const { return q->holder; }
+
+// --- Stream buffers ---
+
+SimQueue *SimKernel::createStream(size_t size, size_t triggerLevel) {
+  SimQueue *s = createQueue(size, 1);
+  s->kind = SimQueue::STREAM;
+  s->trigger = std::max<size_t>(triggerLevel, 1);
+  return s;
+}
+
+size_t SimKernel::streamSend(SimQueue *s, const void *data, size_t len,
+                             uint32_t ticks) {
+  uint64_t deadline = _deadline(ticks);
+  while (spaces(s) == 0) {
+    if (!_block(&s->senders, deadline))
+      return 0;
+  }
+  size_t n = std::min<size_t>(len, spaces(s));
+  const uint8_t *p = (const uint8_t *)data;
+  s->bytes.insert(s->bytes.end(), p, p + n);
+  if (s->bytes.size() >= s->trigger) {
+    _wake(&s->receivers);
+    _preemptIfNeeded();
+  }
+  return n;
+}
+
+size_t SimKernel::streamReceive(SimQueue *s, void *data, size_t len,
+                                uint32_t ticks) {
+  uint64_t deadline = _deadline(ticks);
+  while (s->bytes.size() < s->trigger) {
+    if (!_block(&s->receivers, deadline))
+      break; // Whatever is there, maybe nothing
+  }
+  size_t n = std::min(len, s->bytes.size());
+  std::copy_n(s->bytes.begin(), n, (uint8_t *)data);
+  s->bytes.erase(s->bytes.begin(), s->bytes.begin() + n);
+  if (n) {
+    _wake(&s->senders);
+    _preemptIfNeeded();
+  }
+  return n;
+}
+
+// --- Software timers ---
+
+// The timer service task: ESP-IDF runs it at priority 1 on core 0
+void SimKernel::_timerTask(void *) {
+  SimKernel &k = getInstance();
+  for (;;) {
+    uint64_t next = NEVER;
+    for (SimTimer *t : k._timers) {
+      if (!t->deleted)
+        next = std::min(next, t->expiry);
+    }
+    if (next > k._now) {
+      uint32_t ticks = next == NEVER ? FOREVER
+                                     : (next - k._now + TICK_US - 1) / TICK_US;
+      k.notifyTake(true, ticks);
+      continue;
+    }
+    for (size_t i = 0; i < k._timers.size(); i++) {
+      SimTimer *t = k._timers[i];
+      if (t->deleted || t->expiry > k._now)
+        continue;
+      t->expiry = t->reload ? t->expiry + t->period * TICK_US : NEVER;
+      t->fn(t);
+    }
+  }
+}
+
+SimTimer *SimKernel::createTimer(const char *name, uint32_t period,
+                                 bool reload, void *id,
+                                 void (*fn)(SimTimer *)) {
+  if (!_timerDaemon)
+    _timerDaemon = createTask(_timerTask, "Tmr Svc", 2048, nullptr, 1, 0);
+  SimTimer *t = new SimTimer;
+  t->name = name;
+  t->period = period;
+  t->reload = reload;
+  t->id = id;
+  t->fn = fn;
+  _timers.push_back(t);
+  return t;
+}
+
+void SimKernel::deleteTimer(SimTimer *timer) { timer->deleted = true; }
+
+void SimKernel::startTimer(SimTimer *timer, uint32_t period) {
+  if (period)
+    timer->period = period;
+  timer->expiry = ((uint64_t)tick() + timer->period) * TICK_US;
+  notifyGive(_timerDaemon);
+}
+
+void SimKernel::stopTimer(SimTimer *timer) { timer->expiry = NEVER; }
+
+bool SimKernel::timerActive(SimTimer *timer) const {
+  return !timer->deleted && timer->expiry != NEVER;
+}
+
+void *SimKernel::timerId(SimTimer *timer) const { return timer->id; }
+
+// --- Arduino's clock (tests/mocks/Arduino.h) ---
+
+unsigned long simMillis() { return SimKernel::getInstance().now() / 1000; }
+unsigned long simMicros() { return SimKernel::getInstance().now(); }
+void simDelay(unsigned long ms) {
+  SimKernel::getInstance().delayTicks(ms * 1000 / SimKernel::TICK_US);
+}
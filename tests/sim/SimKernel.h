@@ -0,0 +1,190 @@
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct SimTask;
+struct SimQueue;
+struct SimTimer;
+
+/**
+ * @brief Deterministic stand-in for the FreeRTOS scheduler, so the firmware's
+ * tasks run on the host in virtual time.
+ *
+ * Each task runs on a host thread of its own, so thread_local is per task
+ * as on ESP-IDF, but only one runs at a time: the kernel hands them a baton
+ * at its calls. Two cores pick the highest-priority ready task they may run
+ * (pinned to them, or to no core), preempting lower ones, as the ESP32 port
+ * does.
+ * Host code takes no virtual time: a task's time passes only while it is
+ * blocked, or busy() on its core. When every core is idle or busy, the
+ * clock jumps to the next wakeup, so a minute of firmware runs in
+ * milliseconds, and the same inputs always give the same schedule.
+ *
+ * Differences from the target, on purpose: equal priorities are not
+ * time-sliced, and two cores at the same instant run one after the other,
+ * core 0 first. Tasks only switch at kernel calls, so it finds scheduling
+ * and latency problems, not data races.
+ *
+ * The tests/sim/freertos headers map the FreeRTOS task, queue, semaphore,
+ * stream-buffer, timer and tick APIs onto this; build a test with
+ * `-Itests/sim -DNIMRS_SIM` and tests/sim/SimKernel.cpp, and millis(),
+ * micros() and delay() follow the virtual clock too.
+ *
+ * runRealTime() instead keeps the clock on the host's, for the twin in
+ * tests/twin, which serves real clients.
+ */
+class SimKernel {
+public:
+  static constexpr int CORES = 2;
+  static constexpr int ANY_CORE = -1;
+  static constexpr uint64_t TICK_US = 1000; // configTICK_RATE_HZ 1000
+  static constexpr uint64_t NEVER = UINT64_MAX;
+
+  struct Stats {
+    uint32_t activations = 0;    // Times it got a core
+    uint64_t busyUs = 0;         // CPU time charged (busy(), run cost)
+    uint64_t maxLatencyUs = 0;   // Longest wait from ready to running
+    uint64_t totalLatencyUs = 0; // Over all activations
+    uint64_t maxLatencyAtUs = 0; // When the longest wait ended
+  };
+
+  static SimKernel &getInstance() {
+    // Never destroyed: deleted tasks' threads wait on it until exit
+    static SimKernel *instance = new SimKernel();
+    return *instance;
+  }
+
+  uint64_t now(); // In real time, the host clock catches it up
+  uint32_t tick() { return (uint32_t)(now() / TICK_US); }
+
+  /**
+   * @brief Runs the tasks for @p us of virtual time. Tasks stay where they
+   * are between calls, so a test can run, look, and run again.
+   */
+  void run(uint64_t us);
+
+  /**
+   * @brief Runs with the virtual clock following the host's, until @p idle
+   * returns false. When no task can run, @p idle waits for up to the given
+   * microseconds, as an interrupt would: it may wake tasks with FromISR
+   * calls when, say, a socket has data. Nothing is deterministic here.
+   */
+  void runRealTime(const std::function<bool(uint64_t maxUs)> &idle);
+
+  /**
+   * @brief Calls @p fn every @p periodUs, first at now + @p periodUs, as an
+   * interrupt would: between tasks, where only FromISR calls may be made.
+   */
+  void every(uint64_t periodUs, std::function<void()> fn);
+
+  /**
+   * @brief Charges @p us of CPU time to the calling task: its core is held
+   * for that long unless a higher priority task preempts it.
+   */
+  void busy(uint64_t us);
+  /**
+   * @brief A cost model: @p us of CPU time charged each time @p task wakes
+   * from blocking, before it carries on.
+   */
+  void setRunCost(SimTask *task, uint64_t us);
+
+  const Stats &stats(SimTask *task) const;
+  SimTask *find(const char *name) const;
+  void report() const; // A table of every task's stats, to stdout
+
+  // Deletes every task and timer and rewinds the clock. Tasks that ran stay
+  // parked on their threads, so objects on their stacks are not destroyed.
+  void reset();
+
+  // The FreeRTOS side, for the headers in tests/sim/freertos
+  SimTask *createTask(void (*fn)(void *), const char *name, uint32_t stack,
+                      void *arg, int priority, int core);
+  void deleteTask(SimTask *task); // nullptr: the caller
+  SimTask *current() const { return _running; }
+  int currentCore() const;
+  bool inIsr() const { return _inIsr; }
+  void delayTicks(uint32_t ticks);
+  bool delayUntilTick(uint32_t *previous, uint32_t increment);
+  void yield();
+  int priority(SimTask *task) const;
+  void setPriority(SimTask *task, int priority);
+  const char *name(SimTask *task) const;
+  uint32_t stackSize(SimTask *task) const;
+  void notifyGive(SimTask *task);
+  uint32_t notifyTake(bool clear, uint32_t ticks);
+
+  SimQueue *createQueue(uint32_t length, uint32_t itemSize);
+  SimQueue *createSemaphore(uint32_t max, uint32_t initial, bool mutex);
+  void deleteQueue(SimQueue *q);
+  bool send(SimQueue *q, const void *item, uint32_t ticks, bool front);
+  bool receive(SimQueue *q, void *item, uint32_t ticks, bool peek);
+  uint32_t waiting(SimQueue *q) const;
+  uint32_t spaces(SimQueue *q) const;
+  void resetQueue(SimQueue *q);
+  SimTask *mutexHolder(SimQueue *q) const;
+
+  SimQueue *createStream(size_t size, size_t triggerLevel);
+  size_t streamSend(SimQueue *s, const void *data, size_t len, uint32_t ticks);
+  size_t streamReceive(SimQueue *s, void *data, size_t len, uint32_t ticks);
+
+  SimTimer *createTimer(const char *name, uint32_t period, bool reload,
+                        void *id, void (*fn)(SimTimer *));
+  void deleteTimer(SimTimer *timer);
+  void startTimer(SimTimer *timer, uint32_t period); // 0: keep the period
+  void stopTimer(SimTimer *timer);
+  bool timerActive(SimTimer *timer) const;
+  void *timerId(SimTimer *timer) const;
+
+  SimKernel(const SimKernel &) = delete;
+  SimKernel &operator=(const SimKernel &) = delete;
+
+private:
+  SimKernel() = default;
+
+  struct Periodic {
+    uint64_t period;
+    uint64_t next;
+    std::function<void()> fn;
+  };
+
+  static void _taskEntry(SimTask *task);
+  static void _timerTask(void *param);
+
+  SimTask *_best(int core) const;
+  void _dispatch();
+  void _execute(int core);
+  void _ready(SimTask *task, bool front = false);
+  bool _block(std::vector<SimTask *> *list, uint64_t wakeAt);
+  void _wake(std::vector<SimTask *> *list);
+  void _switchOut();
+  void _preemptIfNeeded();
+  uint64_t _deadline(uint32_t ticks);
+  uint64_t _nextEvent() const;
+  void _expire();
+
+  uint64_t _now = 0;
+  uint64_t _readySeq = 0;
+  int64_t _frontSeq = 0;
+  std::vector<SimTask *> _tasks; // Creation order; deleted ones stay
+  std::vector<SimQueue *> _queues;
+  std::vector<SimTimer *> _timers;
+  std::vector<Periodic> _periodic;
+  SimTask *_cores[CORES] = {};
+  SimTask *_running = nullptr; // Executing host code right now
+  SimTask *_timerDaemon = nullptr;
+  bool _inIsr = false;
+  bool _realTime = false;
+  uint64_t _hostEpoch = 0; // Host microseconds at virtual zero, in real time
+  // The baton: the task whose thread may run, or nullptr for the kernel's
+  std::mutex _baton;
+  std::condition_variable _kernelTurn;
+  SimTask *_owner = nullptr;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+// FreeRTOS on the host simulator; see tests/sim/SimKernel.h
+#include "../SimKernel.h"
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef SimTask *TaskHandle_t;
+typedef SimQueue *QueueHandle_t;
+
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)                                                      \
+  ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdTICKS_TO_MS(ticks)                                                   \
+  ((uint32_t)(((uint64_t)(ticks) * 1000) / configTICK_RATE_HZ))
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define errQUEUE_FULL pdFALSE
+#define errQUEUE_EMPTY pdFALSE
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+// Tasks only switch inside kernel calls, so critical sections are no-ops
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+#define portENTER_CRITICAL_SAFE(mux) ((void)(mux))
+#define portEXIT_CRITICAL_SAFE(mux) ((void)(mux))
+#define portYIELD_FROM_ISR(...) ((void)0)
+
+inline BaseType_t xPortGetCoreID() {
+  return SimKernel::getInstance().currentCore();
+}
+
+inline BaseType_t xPortInIsrContext() {
+  return SimKernel::getInstance().inIsr();
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef SIM_QUEUE_H
+#define SIM_QUEUE_H
+
+#include "FreeRTOS.h"
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  return SimKernel::getInstance().createQueue(length, itemSize);
+}
+
+inline void vQueueDelete(QueueHandle_t q) {
+  SimKernel::getInstance().deleteQueue(q);
+}
+
+inline BaseType_t xQueueSendToBack(QueueHandle_t q, const void *item,
+                                   TickType_t ticks) {
+  return SimKernel::getInstance().send(q, item, ticks, false);
+}
+
+inline BaseType_t xQueueSendToFront(QueueHandle_t q, const void *item,
+                                    TickType_t ticks) {
+  return SimKernel::getInstance().send(q, item, ticks, true);
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t q, const void *item,
+                             TickType_t ticks) {
+  return xQueueSendToBack(q, item, ticks);
+}
+
+inline BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item,
+                                    BaseType_t *woken) {
+  if (woken)
+    *woken = pdFALSE; // The kernel reschedules after every interrupt
+  return xQueueSendToBack(q, item, 0);
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t q, void *item,
+                                TickType_t ticks) {
+  return SimKernel::getInstance().receive(q, item, ticks, false);
+}
+
+inline BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t ticks) {
+  return SimKernel::getInstance().receive(q, item, ticks, true);
+}
+
+inline BaseType_t xQueueReceiveFromISR(QueueHandle_t q, void *item,
+                                       BaseType_t *woken) {
+  if (woken)
+    *woken = pdFALSE;
+  return xQueueReceive(q, item, 0);
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  return SimKernel::getInstance().waiting(q);
+}
+
+inline UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q) {
+  return SimKernel::getInstance().spaces(q);
+}
+
+inline BaseType_t xQueueReset(QueueHandle_t q) {
+  SimKernel::getInstance().resetQueue(q);
+  return pdPASS;
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef SIM_SEMPHR_H
+#define SIM_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return SimKernel::getInstance().createSemaphore(1, 1, true);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return SimKernel::getInstance().createSemaphore(1, 0, false);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max,
+                                                  UBaseType_t initial) {
+  return SimKernel::getInstance().createSemaphore(max, initial, false);
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t s) {
+  SimKernel::getInstance().deleteQueue(s);
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) {
+  return SimKernel::getInstance().receive(s, nullptr, ticks, false);
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  return SimKernel::getInstance().send(s, nullptr, 0, false);
+}
+
+inline BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t s,
+                                        BaseType_t *woken) {
+  if (woken)
+    *woken = pdFALSE; // The kernel reschedules after every interrupt
+  return xSemaphoreGive(s);
+}
+
+inline UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t s) {
+  return SimKernel::getInstance().waiting(s);
+}
+
+inline TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t s) {
+  return SimKernel::getInstance().mutexHolder(s);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SIM_STREAM_BUFFER_H
+#define SIM_STREAM_BUFFER_H
+
+#include "FreeRTOS.h"
+#include <stddef.h>
+
+typedef SimQueue *StreamBufferHandle_t;
+
+inline StreamBufferHandle_t xStreamBufferCreate(size_t size,
+                                                size_t triggerLevel) {
+  return SimKernel::getInstance().createStream(size, triggerLevel);
+}
+
+inline void vStreamBufferDelete(StreamBufferHandle_t s) {
+  SimKernel::getInstance().deleteQueue(s);
+}
+
+inline size_t xStreamBufferSend(StreamBufferHandle_t s, const void *data,
+                                size_t len, TickType_t ticks) {
+  return SimKernel::getInstance().streamSend(s, data, len, ticks);
+}
+
+inline size_t xStreamBufferSendFromISR(StreamBufferHandle_t s,
+                                       const void *data, size_t len,
+                                       BaseType_t *woken) {
+  if (woken)
+    *woken = pdFALSE; // The kernel reschedules after every interrupt
+  return xStreamBufferSend(s, data, len, 0);
+}
+
+inline size_t xStreamBufferReceive(StreamBufferHandle_t s, void *data,
+                                   size_t len, TickType_t ticks) {
+  return SimKernel::getInstance().streamReceive(s, data, len, ticks);
+}
+
+inline size_t xStreamBufferReceiveFromISR(StreamBufferHandle_t s, void *data,
+                                          size_t len, BaseType_t *woken) {
+  if (woken)
+    *woken = pdFALSE;
+  return xStreamBufferReceive(s, data, len, 0);
+}
+
+inline size_t xStreamBufferBytesAvailable(StreamBufferHandle_t s) {
+  return SimKernel::getInstance().waiting(s);
+}
+
+inline size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t s) {
+  return SimKernel::getInstance().spaces(s);
+}
+
+inline BaseType_t xStreamBufferReset(StreamBufferHandle_t s) {
+  SimKernel::getInstance().resetQueue(s);
+  return pdPASS;
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef SIM_TASK_H
+#define SIM_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                          uint32_t stack, void *param,
+                                          UBaseType_t priority,
+                                          TaskHandle_t *handle,
+                                          BaseType_t core) {
+  TaskHandle_t t = SimKernel::getInstance().createTask(
+      fn, name, stack, param, priority,
+      core == tskNO_AFFINITY ? SimKernel::ANY_CORE : core);
+  if (handle)
+    *handle = t;
+  return pdPASS;
+}
+
+inline BaseType_t xTaskCreateUniversal(TaskFunction_t fn, const char *name,
+                                       uint32_t stack, void *param,
+                                       UBaseType_t priority,
+                                       TaskHandle_t *handle, BaseType_t core) {
+  return xTaskCreatePinnedToCore(fn, name, stack, param, priority, handle,
+                                 core);
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name,
+                              uint32_t stack, void *param,
+                              UBaseType_t priority, TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(fn, name, stack, param, priority, handle,
+                                 tskNO_AFFINITY);
+}
+
+inline void vTaskDelete(TaskHandle_t task) {
+  SimKernel::getInstance().deleteTask(task);
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+  SimKernel::getInstance().delayTicks(ticks);
+}
+
+inline BaseType_t xTaskDelayUntil(TickType_t *previous, TickType_t increment) {
+  return SimKernel::getInstance().delayUntilTick(previous, increment);
+}
+
+inline void vTaskDelayUntil(TickType_t *previous, TickType_t increment) {
+  xTaskDelayUntil(previous, increment);
+}
+
+inline TickType_t xTaskGetTickCount() {
+  return SimKernel::getInstance().tick();
+}
+inline TickType_t xTaskGetTickCountFromISR() { return xTaskGetTickCount(); }
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return SimKernel::getInstance().current();
+}
+
+inline const char *pcTaskGetName(TaskHandle_t task) {
+  return SimKernel::getInstance().name(task);
+}
+
+inline UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+  return SimKernel::getInstance().priority(task);
+}
+
+inline void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority) {
+  SimKernel::getInstance().setPriority(task, priority);
+}
+
+// Host stack use says nothing about the target's; this is what it asked for
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return SimKernel::getInstance().stackSize(task);
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  SimKernel::getInstance().notifyGive(task);
+  return pdPASS;
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+  SimKernel::getInstance().notifyGive(task);
+  if (woken)
+    *woken = pdFALSE; // The kernel reschedules after every interrupt
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  return SimKernel::getInstance().notifyTake(clearOnExit, ticks);
+}
+
+#define taskYIELD() SimKernel::getInstance().yield()
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SIM_TIMERS_H
+#define SIM_TIMERS_H
+
+#include "FreeRTOS.h"
+
+typedef SimTimer *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t);
+
+// Callbacks run on the timer service task, as on the target
+inline TimerHandle_t xTimerCreate(const char *name, TickType_t period,
+                                  UBaseType_t autoReload, void *id,
+                                  TimerCallbackFunction_t fn) {
+  return SimKernel::getInstance().createTimer(name, period, autoReload, id,
+                                              fn);
+}
+
+inline BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks) {
+  SimKernel::getInstance().startTimer(timer, 0);
+  return pdPASS;
+}
+
+inline BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks) {
+  return xTimerStart(timer, ticks);
+}
+
+inline BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period,
+                                     TickType_t ticks) {
+  SimKernel::getInstance().startTimer(timer, period);
+  return pdPASS;
+}
+
+inline BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks) {
+  SimKernel::getInstance().stopTimer(timer);
+  return pdPASS;
+}
+
+inline BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticks) {
+  SimKernel::getInstance().deleteTimer(timer);
+  return pdPASS;
+}
+
+inline BaseType_t xTimerIsTimerActive(TimerHandle_t timer) {
+  return SimKernel::getInstance().timerActive(timer);
+}
+
+inline void *pvTimerGetTimerID(TimerHandle_t timer) {
+  return SimKernel::getInstance().timerId(timer);
+}
+
+#endif
@@ -1,12 +1,20 @@
-// TEST_SOURCES: tests/mocks/mocks.cpp
+// clang-format off
+// TEST_SOURCES: src/AudioVoice.cpp src/AudioDsp.cpp src/AudioPrefetcher.cpp src/EngineSound.cpp src/ImaAdpcm.cpp src/Mp3Index.cpp src/Mp3Sidecar.cpp src/AudioTranscoder.cpp src/SoundManifest.cpp src/SoundPack.cpp src/LatencyMonitor.cpp src/PerfMonitor.cpp src/TraceRecorder.cpp tests/mocks/mocks.cpp
 // TEST_FLAGS: -DUNIT_TEST -DSKIP_MOCK_AUDIO_CONTROLLER
+// clang-format on
 
 #include "Arduino.h"
 #include "AudioTools.h"
 #include "LittleFS.h"
 
 // Include source file directly to test internal logic
+#define private public
 #include "../src/AudioController.cpp"
+#undef private
+
+#include "AudioFixtures.h"
+
+using namespace AudioFixtures;
 
 void test_playFile_checks_exists() {
   // Setup
@@ -36,7 +44,304 @@ void test_playFile_checks_exists() {
   printf("PASS: playFile called open() but not exists()\n");
 }
 
+void test_function_dispatch_table() {
+  AudioController &audio = AudioController::getInstance();
+  SystemState &state = SystemContext::getInstance().getState();
+
+  SoundAsset whistle;
+  whistle.id = 1;
+  whistle.name = "Whistle";
+  whistle.type = SoundType::COMPLEX_LOOP;
+  whistle.fileIntro = "/whistle_start.mp3";
+  whistle.fileLoop = "/whistle_hold.mp3";
+  whistle.function = 2;
+
+  SoundAsset bell;
+  bell.id = 2;
+  bell.name = "Bell";
+  bell.type = SoundType::TOGGLE;
+  bell.fileLoop = "/bell.mp3";
+  bell.function = 30; // Unmapped
+
+  audio._assets.clear();
+  audio._assets[whistle.id] = whistle;
+  audio._assets[bell.id] = bell;
+  audio._rebuildDispatchTable();
+
+  if (audio._mappedMask != (1UL << 2) || audio._slots.size() != 1) {
+    printf("FAIL: only F2 should be bound\n");
+    exit(1);
+  }
+  if (String(audio._slots[0].startFile) != "/whistle_start.mp3") {
+    printf("FAIL: complex_loop should start with its intro\n");
+    exit(1);
+  }
+
+  // Toggling an unmapped function must not touch the filesystem
+  LittleFS.callCount_open = 0;
+  state.functions[5] = true;
+  audio.loop();
+  if (LittleFS.callCount_open != 0) {
+    printf("FAIL: unmapped function triggered playback\n");
+    exit(1);
+  }
+
+  // F2 rising edge plays the intro exactly once: its rendition is probed
+  // first, then the MP3 itself is opened
+  state.functions[2] = true;
+  audio.loop();
+  audio.loop();
+  if (LittleFS.callCount_open != 2 ||
+      LittleFS.lastOpenedPath != "/whistle_start.mp3") {
+    printf("FAIL: F2 should open the whistle intro once (opens=%d)\n",
+           LittleFS.callCount_open);
+    exit(1);
+  }
+
+  // Remapping the bell onto F2 is picked up by the CV cache refresh
+  DccController::getInstance().getDcc().setCV(CV::AUDIO_MAP_BASE + 2, 2);
+  DccController::getInstance().getDcc().setCV(CV::AUDIO_MAP_BASE + 1, 2);
+  _mockMillis += 1000;
+  state.functions[2] = false;
+  audio.loop();
+  if (audio._slots.size() != 2 ||
+      audio._slotStart[3] - audio._slotStart[2] != 2) {
+    printf("FAIL: remap should bind two slots to F2\n");
+    exit(1);
+  }
+
+  state.functions[2] = false;
+  state.functions[5] = false;
+  printf("PASS: function-indexed dispatch\n");
+}
+
+void test_adpcm_wav_selects_adpcm_decoder() {
+  AudioController &audio = AudioController::getInstance();
+
+  // 44-byte canonical header with the IMA-ADPCM format tag
+  std::vector<uint8_t> header = wavHeader(0x11, 1, 22050, 256, 4, 0);
+  LittleFS.mockFiles.clear();
+  LittleFS.mockFiles.push_back(File("/horn.wav", header));
+  audio.stop();
+  audio.playFile("/horn.wav");
+  AudioVoice &voice = audio._voices[0];
+  if (voice._active != &voice._adpcm) {
+    printf("FAIL: ADPCM .wav should use the ADPCM decoder\n");
+    exit(1);
+  }
+
+  header[20] = 1; // PCM
+  LittleFS.mockFiles[0] = File("/horn.wav", header);
+  audio.stop();
+  audio.playFile("/horn.wav");
+  if (voice._active != &voice._wav) {
+    printf("FAIL: PCM .wav should use the WAV decoder\n");
+    exit(1);
+  }
+  audio.stop();
+  printf("PASS: codec sniffing\n");
+}
+
+void test_wav_loop_points_after_data() {
+  // One frame of data, then smpl with one loop 10..19
+  std::vector<uint8_t> wav = wavHeader(1, 1, 44100, 2, 16, 2);
+  put16(wav, 0);
+  putSmplLoop(wav, 10, 19);
+  LittleFS.mockFiles.clear();
+  LittleFS.mockFiles.push_back(File("/bell.wav", wav));
+
+  uint32_t start = 0, end = 0;
+  if (!readWavLoopPoints("/bell.wav", start, end) || start != 10 ||
+      end != 20) {
+    printf("FAIL: smpl loop should be read from behind the data chunk\n");
+    exit(1);
+  }
+  printf("PASS: smpl loop points\n");
+}
+
+// Samples of the last block the mixer wrote
+std::vector<int16_t> lastBlock(AudioController &audio) {
+  const std::vector<uint8_t> &bytes = audio._volume->written;
+  size_t block = AudioController::RENDER_FRAMES * 2;
+  std::vector<int16_t> out(AudioController::RENDER_FRAMES);
+  memcpy(out.data(), bytes.data() + bytes.size() - block, block);
+  return out;
+}
+
+void test_amp_power_states() {
+  AudioController &audio = AudioController::getInstance();
+  const int sd = Pinout::AMP_SD_MODE;
+  LittleFS.mockFiles.clear();
+  LittleFS.mockFiles.push_back(File("/beep.wav", dcWav(10000, 20000)));
+  DccController::getInstance().getDcc().setCV(CV::AUDIO_AMP_HANGOVER, 5);
+  _mockMillis += 1000;
+  audio.stop();
+  audio.loop(); // Picks up the CV; idle
+  audio.loop();
+  if (mockPinLevel[sd] != LOW || audio._amp != AudioController::AmpState::OFF) {
+    printf("FAIL: amp should be off when idle\n");
+    exit(1);
+  }
+
+  // A trigger raises SD_MODE and returns; silence covers the warmup
+  audio.playFile("/beep.wav");
+  if (mockPinLevel[sd] != HIGH ||
+      audio._amp != AudioController::AmpState::WAKING) {
+    printf("FAIL: playFile should wake the amp without waiting\n");
+    exit(1);
+  }
+  audio.loop();
+  std::vector<int16_t> block = lastBlock(audio);
+  if (block[0] != 0 || block[200] != 0) {
+    printf("FAIL: warmup should be silent\n");
+    exit(1);
+  }
+
+  // First audible block fades in from zero, a block late: the limiter looks
+  // one block ahead
+  _mockMillis += AudioController::AMP_WARMUP_MS;
+  audio.loop();
+  block = lastBlock(audio);
+  if (block[0] != 0 || block[200] != 0 || !audio._master.holding()) {
+    printf("FAIL: limiter should hold the first block\n");
+    exit(1);
+  }
+  audio.loop();
+  block = lastBlock(audio);
+  if (block[0] != 0 || block[64] != 5000 || block[200] != 10000) {
+    printf("FAIL: first block should ramp in (%d %d %d)\n", block[0],
+           block[64], block[200]);
+    exit(1);
+  }
+
+  // stop() ramps out instead of cutting, and leaves the amp on
+  audio.stop();
+  block = lastBlock(audio);
+  if (block[0] != 10000 || block[64] != 5000 || block[200] != 0 ||
+      mockPinLevel[sd] != HIGH) {
+    printf("FAIL: stop should fade out and keep the amp up\n");
+    exit(1);
+  }
+
+  // A trigger inside the hangover plays at once, without a ramp
+  _mockMillis += 400;
+  audio.loop();
+  audio.playFile("/beep.wav");
+  audio.loop();
+  audio.loop();
+  block = lastBlock(audio);
+  if (audio._amp != AudioController::AmpState::ON || block[0] != 10000) {
+    printf("FAIL: trigger during hangover should not rewarm the amp\n");
+    exit(1);
+  }
+
+  // SD_MODE drops only once the hangover has run out
+  audio.stop();
+  _mockMillis += 400;
+  audio.loop();
+  if (mockPinLevel[sd] != HIGH) {
+    printf("FAIL: amp powered down before the hangover\n");
+    exit(1);
+  }
+  _mockMillis += 100;
+  audio.loop();
+  if (mockPinLevel[sd] != LOW) {
+    printf("FAIL: amp should power down after the hangover\n");
+    exit(1);
+  }
+  printf("PASS: amp power states\n");
+}
+
+void test_limiter_tail_plays_out() {
+  AudioController &audio = AudioController::getInstance();
+  LittleFS.mockFiles.clear();
+  LittleFS.mockFiles.push_back(File("/tick.wav", dcWav(10000, 100)));
+  audio.playFile("/tick.wav");
+  audio.loop(); // Warmup
+  _mockMillis += AudioController::AMP_WARMUP_MS;
+  int audible = 0;
+  for (int i = 0; i < 5; i++) {
+    size_t before = audio._volume->written.size();
+    audio.loop();
+    if (audio._volume->written.size() > before && lastBlock(audio)[99] != 0)
+      audible++;
+  }
+  // The tick, mixed into one block, comes out with the next, which the amp
+  // waits for before it idles
+  if (audible != 1 || audio._master.holding() ||
+      audio._amp != AudioController::AmpState::HANGOVER) {
+    printf("FAIL: a sound's last block should play out (%d)\n", audible);
+    exit(1);
+  }
+  printf("PASS: limiter tail plays out\n");
+}
+
+void test_pack_keeps_manifest_diesel() {
+  AudioController &audio = AudioController::getInstance();
+
+  // The manifest: a horn the pack replaces, and a diesel engine it cannot hold
+  SoundAsset horn;
+  horn.id = 3;
+  horn.name = "Horn";
+  horn.type = SoundType::SIMPLE;
+  horn.fileLoop = "/horn.wav";
+  SoundAsset diesel;
+  diesel.id = 20;
+  diesel.name = "Prime Mover";
+  diesel.type = SoundType::DIESEL;
+  diesel.notches = {"/idle.wav", "/n1.wav"};
+  diesel.crossfadeMs = 10;
+  std::vector<uint8_t> json(100, ' '), bin;
+  String error;
+  if (!SoundManifest::encode({horn, diesel}, json.size(), bin, error)) {
+    printf("FAIL: manifest should encode: %s\n", error.c_str());
+    exit(1);
+  }
+  LittleFS.mockFiles.clear();
+  LittleFS.mockFiles.push_back(File(SoundManifest::JSON_PATH, json));
+  LittleFS.mockFiles.push_back(File(SoundManifest::PATH, bin));
+  LittleFS.mockFiles.push_back(File("/idle.wav", dcWav(1000, 4410)));
+  LittleFS.mockFiles.push_back(File("/n1.wav", dcWav(2000, 4410)));
+
+  static std::vector<uint8_t> pack = makePack(
+      {{"bell.wav", AudioCodec::WAV_PCM, dcWav(3000, 100)}},
+      {{7, SoundType::TOGGLE, SoundPack::NO_FILE, 0, SoundPack::NO_FILE, 0, 0,
+        "Bell"}});
+  SoundPack &sp = SoundPack::getInstance();
+  if (!sp.load(pack.data(), pack.size())) {
+    printf("FAIL: pack should mount\n");
+    exit(1);
+  }
+
+  audio.loadAssets();
+  if (audio._assets.size() != 2 || !audio._assets.count(7) ||
+      !audio._assets.count(20)) {
+    printf("FAIL: pack assets plus the manifest's diesel engine expected\n");
+    exit(1);
+  }
+  if (!audio._engine.loaded() || audio._engine.assetId() != 20) {
+    printf("FAIL: diesel engine should load next to a sound pack\n");
+    exit(1);
+  }
+
+  sp.unmount();
+  audio.loadAssets();
+  if (audio._assets.size() != 2 || !audio._assets.count(3)) {
+    printf("FAIL: manifest should load in full without a pack\n");
+    exit(1);
+  }
+  audio.stop();
+  printf("PASS: diesel engine loads next to a sound pack\n");
+}
+
 int main() {
+  AudioController::getInstance().setup();
   test_playFile_checks_exists();
+  test_function_dispatch_table();
+  test_adpcm_wav_selects_adpcm_decoder();
+  test_wav_loop_points_after_data();
+  test_amp_power_states();
+  test_limiter_tail_plays_out();
+  test_pack_keeps_manifest_diesel();
   return 0;
 }
@@ -0,0 +1,229 @@
+// clang-format off
+// TEST_SOURCES: src/AudioDsp.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "AudioDsp.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+constexpr uint32_t RATE = 44100;
+constexpr size_t FRAMES = 256;
+
+// Peak output of a sine at @p hz, once the filters have settled
+float sinePeak(ChannelDsp &dsp, LoadTone &tone, float load, float hz,
+               float amplitude = 10000.0f) {
+  int32_t in[FRAMES];
+  float peak = 0.0f;
+  size_t t = 0;
+  for (int block = 0; block < 40; block++) {
+    for (size_t i = 0; i < FRAMES; i++, t++)
+      in[i] = lrintf(amplitude * sinf(2.0f * (float)M_PI * hz * t / RATE));
+    float bus[FRAMES] = {0};
+    dsp.process(in, bus, FRAMES, tone, load);
+    if (block >= 30)
+      for (float s : bus)
+        peak = std::max(peak, fabsf(s));
+  }
+  return peak;
+}
+} // namespace
+
+TEST_CASE(test_flat_tone_passes_through) {
+  LoadTone tone;
+  tone.configure(0.0f, RATE);
+  ChannelDsp dsp;
+  int32_t in[FRAMES];
+  for (size_t i = 0; i < FRAMES; i++)
+    in[i] = (int32_t)(i * 97 % 2000) - 1000;
+  float bus[FRAMES];
+  for (size_t i = 0; i < FRAMES; i++)
+    bus[i] = 5.0f;
+  dsp.process(in, bus, FRAMES, tone, 1.0f); // No depth, so load is moot
+  for (size_t i = 0; i < FRAMES; i++)
+    assert(lrintf(bus[i]) == in[i] + 5); // Added to what was there
+}
+
+TEST_CASE(test_load_adds_bass_and_cuts_treble) {
+  LoadTone tone;
+  tone.configure(6.0f, RATE);
+  ChannelDsp idle, busy;
+  float lowIdle = sinePeak(idle, tone, 0.0f, 50.0f);
+  float lowBusy = sinePeak(busy, tone, 1.0f, 50.0f);
+  assert(fabsf(lowIdle - 10000.0f) < 100.0f);
+  // +6 dB band and +1.5 dB gain, about 2.4x
+  assert(lowBusy > 2.2f * lowIdle && lowBusy < 2.6f * lowIdle);
+
+  idle.reset();
+  busy.reset();
+  float highIdle = sinePeak(idle, tone, 0.0f, 12000.0f);
+  float highBusy = sinePeak(busy, tone, 1.0f, 12000.0f);
+  // -3 dB band and +1.5 dB gain
+  assert(highBusy < 0.9f * highIdle && highBusy > 0.75f * highIdle);
+
+  // Half load lands in between
+  ChannelDsp half;
+  float lowHalf = sinePeak(half, tone, 0.5f, 50.0f);
+  assert(lowHalf > lowIdle * 1.2f && lowHalf < lowBusy * 0.8f);
+}
+
+TEST_CASE(test_gain_ramps_across_the_block) {
+  LoadTone tone;
+  tone.configure(24.0f, RATE); // +6 dB gain at full load
+  ChannelDsp dsp;
+  int32_t in[FRAMES];
+  for (size_t i = 0; i < FRAMES; i++)
+    in[i] = 1000;
+  float bus[FRAMES] = {0};
+  dsp.process(in, bus, FRAMES, tone, 0.0f);
+
+  // A step to full load (about 32x here) is spread evenly over the block:
+  // no sample moves by much more than its share
+  float next[FRAMES] = {0};
+  dsp.process(in, next, FRAMES, tone, 1.0f);
+  float prev = bus[FRAMES - 1];
+  float share = (next[FRAMES - 1] - prev) / FRAMES;
+  assert(share > 100.0f);
+  for (float s : next) {
+    assert(s - prev > 0.0f && s - prev < 1.5f * share);
+    prev = s;
+  }
+}
+
+TEST_CASE(test_gain_ramps_across_the_call) {
+  // Four kernel blocks in one call: the ramp spans all of them
+  constexpr size_t LONG = 4 * FRAMES;
+  LoadTone tone;
+  tone.configure(24.0f, RATE);
+  ChannelDsp dsp;
+  int32_t in[LONG];
+  for (size_t i = 0; i < LONG; i++)
+    in[i] = 1000;
+  float bus[LONG] = {0};
+  dsp.process(in, bus, LONG, tone, 0.0f);
+
+  float next[LONG] = {0};
+  dsp.process(in, next, LONG, tone, 1.0f);
+  float prev = bus[LONG - 1];
+  float share = (next[LONG - 1] - prev) / LONG;
+  assert(share > 25.0f);
+  for (float s : next) {
+    assert(s - prev > 0.0f && s - prev < 1.5f * share);
+    prev = s;
+  }
+}
+
+TEST_CASE(test_limiter_holds_the_ceiling) {
+  MasterDsp master;
+  master.configure(0.0f, RATE, FRAMES);
+  float bus[FRAMES];
+  auto fill = [&bus](float level) {
+    for (size_t i = 0; i < FRAMES; i++)
+      bus[i] = (i % 2 ? 1.0f : -1.0f) * level;
+  };
+
+  // Under the ceiling nothing changes, one block late
+  fill(20000.0f);
+  master.process(bus, FRAMES);
+  assert(bus[0] == 0.0f && master.holding());
+  fill(20000.0f);
+  master.process(bus, FRAMES);
+  assert(bus[0] == -20000.0f && bus[1] == 20000.0f);
+  assert(master.limiterGain() == 1.0f);
+
+  // Over it, the block ahead of the overshoot ramps down to meet it...
+  fill(60000.0f);
+  master.process(bus, FRAMES);
+  assert(fabsf(bus[0]) > 19000.0f && fabsf(bus[FRAMES - 1]) < 12000.0f);
+  float limited = master.limiterGain();
+  assert(limited < 0.6f);
+  // ...so that the loud block comes out under the ceiling
+  fill(1000.0f);
+  master.process(bus, FRAMES);
+  for (float s : bus)
+    assert(fabsf(s) <= MasterDsp::CEILING + 1.0f);
+  assert(fabsf(bus[0]) > 30000.0f);
+
+  // Then it lets go gradually, never jumping back to full gain
+  float last = master.limiterGain();
+  for (int block = 0; block < 300; block++) { // About 1.7 s
+    fill(1000.0f);
+    master.process(bus, FRAMES);
+    assert(master.limiterGain() > last || master.limiterGain() > 0.999f);
+    assert(master.limiterGain() - last < 0.2f);
+    last = master.limiterGain();
+  }
+  assert(last > 0.999f);
+
+  // Silence after a reset, whatever was held
+  master.reset();
+  assert(!master.holding() && master.limiterGain() == 1.0f);
+  fill(0.0f);
+  master.process(bus, FRAMES);
+  assert(bus[0] == 0.0f && !master.holding());
+}
+
+TEST_CASE(test_limiter_attack_has_no_step) {
+  MasterDsp master;
+  master.configure(0.0f, RATE, FRAMES);
+  // A 1 kHz sine that jumps from well under the ceiling to twice over it at
+  // a block boundary
+  const size_t LOUD_AT = 8 * FRAMES, TOTAL = 16 * FRAMES;
+  std::vector<float> in(TOTAL), out;
+  for (size_t t = 0; t < TOTAL; t++)
+    in[t] = (t < LOUD_AT ? 10000.0f : 62000.0f) *
+            sinf(2.0f * (float)M_PI * 1000.0f * t / RATE);
+  for (size_t at = 0; at < TOTAL; at += FRAMES) {
+    float bus[FRAMES];
+    std::copy(&in[at], &in[at] + FRAMES, bus);
+    master.process(bus, FRAMES);
+    out.insert(out.end(), bus, bus + FRAMES);
+  }
+
+  // Gain per frame, against the input it delays: it only ever glides, at
+  // the boundary before the loud block as anywhere else
+  const size_t delay = MasterDsp::LOOKAHEAD;
+  float last = 1.0f, largest = 0.0f;
+  for (size_t t = delay; t < TOTAL; t++) {
+    assert(fabsf(out[t]) <= MasterDsp::CEILING + 1.0f);
+    if (fabsf(in[t - delay]) < 3000.0f)
+      continue; // Too close to a zero crossing to divide by
+    float g = out[t] / in[t - delay];
+    largest = std::max(largest, fabsf(g - last));
+    last = g;
+  }
+  assert(last < 0.55f);    // It limits...
+  assert(largest < 0.02f); // ...without a step
+}
+
+TEST_CASE(test_high_pass_removes_dc) {
+  MasterDsp master;
+  master.configure(80.0f, RATE, FRAMES);
+  float bus[FRAMES];
+  for (int block = 0; block < 50; block++) {
+    for (size_t i = 0; i < FRAMES; i++)
+      bus[i] = 10000.0f;
+    master.process(bus, FRAMES);
+  }
+  assert(fabsf(bus[FRAMES - 1]) < 10.0f);
+}
+
+int main() {
+  RUN_TEST(test_flat_tone_passes_through);
+  RUN_TEST(test_load_adds_bass_and_cuts_treble);
+  RUN_TEST(test_gain_ramps_across_the_block);
+  RUN_TEST(test_gain_ramps_across_the_call);
+  RUN_TEST(test_limiter_holds_the_ceiling);
+  RUN_TEST(test_limiter_attack_has_no_step);
+  RUN_TEST(test_high_pass_removes_dc);
+  std::cout << "All AudioDsp tests passed!" << std::endl;
+  return 0;
+}
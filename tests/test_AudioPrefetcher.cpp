@@ -0,0 +1,171 @@
+// clang-format off
+// TEST_SOURCES: src/AudioPrefetcher.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "AudioPrefetcher.h"
+#include "../src/CvRegistry.h"
+#include "DccController.h"
+#include "LittleFS.h"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+AudioPrefetcher &prefetcher = AudioPrefetcher::getInstance();
+
+// Byte i of the file is i % 251, so any misplaced byte shows
+File makeFile(const char *path, size_t size) {
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; i++)
+    data[i] = i % 251;
+  LittleFS.mockFiles.push_back(File(path, data));
+  return LittleFS.open(path);
+}
+
+void setReadAhead(uint8_t kb) {
+  DccController::getInstance().getDcc().setCV(CV::AUDIO_READ_AHEAD, kb);
+}
+
+// Reads everything buffered, checking it continues the file from @p offset
+size_t drain(int8_t id, size_t &offset) {
+  uint8_t buf[100];
+  size_t total = 0;
+  while (size_t n = prefetcher.read(id, buf, sizeof(buf))) {
+    for (size_t i = 0; i < n; i++)
+      assert(buf[i] == (offset + i) % 251);
+    offset += n;
+    total += n;
+  }
+  return total;
+}
+
+void closeAll(std::vector<int8_t> ids) {
+  for (int8_t id : ids)
+    prefetcher.close(id);
+  while (prefetcher.step()) {
+  }
+}
+} // namespace
+
+TEST_CASE(test_off_keeps_the_file) {
+  LittleFS.mockFiles.clear();
+  setReadAhead(0);
+  File file = makeFile("/a.wav", 1000);
+  assert(prefetcher.open(file) == -1);
+  assert(file); // Still the caller's
+
+  setReadAhead(8);
+  int8_t id = prefetcher.open(file);
+  assert(id >= 0 && !file);
+  closeAll({id});
+}
+
+TEST_CASE(test_aligned_reads_and_stalls) {
+  LittleFS.mockFiles.clear();
+  setReadAhead(8);
+  File file = makeFile("/a.wav", 20000);
+  int8_t id = prefetcher.open(file);
+  assert(id >= 0);
+
+  // Only the first block is read up front
+  size_t offset = 0;
+  uint32_t stalls = prefetcher.stalls();
+  assert(drain(id, offset) == AudioPrefetcher::READ_CHUNK);
+  assert(prefetcher.pending(id));
+  uint8_t buf[16];
+  assert(prefetcher.read(id, buf, sizeof(buf)) == 0);
+  assert(prefetcher.read(id, buf, sizeof(buf)) == 0);
+  assert(prefetcher.stalls() == stalls + 1); // Once per dry spell
+
+  // The task fills the ring, one block per step
+  assert(prefetcher.step() && prefetcher.step());
+  assert(!prefetcher.step()); // Full
+  assert(drain(id, offset) == 2 * AudioPrefetcher::READ_CHUNK);
+
+  // A seek outside the ring refills from there, up to the next boundary
+  assert(prefetcher.seek(id, 1000));
+  offset = 1000;
+  assert(prefetcher.pending(id));
+  prefetcher.step();
+  assert(drain(id, offset) == AudioPrefetcher::READ_CHUNK - 1000);
+
+  // Seeks within the ring only move the cursor
+  prefetcher.step();
+  assert(prefetcher.seek(id, 5000));
+  offset = 5000;
+  assert(drain(id, offset) == 2 * AudioPrefetcher::READ_CHUNK - 5000);
+
+  // The end of the file is not a stall
+  assert(prefetcher.seek(id, 20000));
+  stalls = prefetcher.stalls();
+  assert(!prefetcher.pending(id));
+  assert(prefetcher.read(id, buf, sizeof(buf)) == 0);
+  assert(prefetcher.stalls() == stalls);
+  closeAll({id});
+}
+
+TEST_CASE(test_loop_reads_past_the_end) {
+  LittleFS.mockFiles.clear();
+  setReadAhead(8);
+  File file = makeFile("/loop.wav", 5000);
+  int8_t id = prefetcher.open(file);
+  prefetcher.setLoop(id, 44);
+  while (prefetcher.step()) {
+  }
+
+  // The pass ends at the end of the file...
+  size_t offset = 0;
+  assert(drain(id, offset) == 5000);
+  assert(!prefetcher.pending(id));
+  // ...while the task reads on from the loop start, so the seek back to it
+  // finds the next pass buffered
+  assert(prefetcher.step());
+  assert(prefetcher.seek(id, 44));
+  offset = 44;
+  assert(!prefetcher.pending(id));
+  assert(drain(id, offset) > 3000);
+
+  // A seek the task did not see coming still works, just not from the ring
+  assert(prefetcher.seek(id, 10));
+  assert(prefetcher.pending(id));
+  prefetcher.step();
+  offset = 10;
+  assert(drain(id, offset) > 0);
+  closeAll({id});
+}
+
+TEST_CASE(test_streams_are_reused) {
+  LittleFS.mockFiles.clear();
+  setReadAhead(8);
+  std::vector<int8_t> ids;
+  for (uint8_t i = 0; i < AudioPrefetcher::MAX_STREAMS; i++) {
+    File file = makeFile("/s.wav", 100);
+    ids.push_back(prefetcher.open(file));
+    assert(ids.back() >= 0);
+  }
+  File extra = makeFile("/s.wav", 100);
+  assert(prefetcher.open(extra) == -1 && extra);
+
+  // A released stream is free for the next file, task or not
+  prefetcher.close(ids[3]);
+  int8_t id = prefetcher.open(extra);
+  assert(id == ids[3]);
+  ids[3] = id;
+  closeAll(ids);
+}
+
+int main() {
+  AudioPrefetcher::getInstance().startTask();
+  RUN_TEST(test_off_keeps_the_file);
+  RUN_TEST(test_aligned_reads_and_stalls);
+  RUN_TEST(test_loop_reads_past_the_end);
+  RUN_TEST(test_streams_are_reused);
+  std::cout << "All AudioPrefetcher tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,219 @@
+// clang-format off
+// TEST_SOURCES: src/AudioTranscoder.cpp src/AudioVoice.cpp src/AudioPrefetcher.cpp src/ImaAdpcm.cpp src/Mp3Index.cpp src/Mp3Sidecar.cpp src/SoundPack.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "AudioTranscoder.h"
+#include "AudioFixtures.h"
+#include "AudioUtils.h"
+#include "AudioVoice.h"
+#include "../src/CvRegistry.h"
+#include "DccController.h"
+#include "ImaAdpcmDecoder.h"
+#include "LittleFS.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+using namespace AudioFixtures;
+
+const uint32_t FRAMES = 20;
+const uint16_t DELAY = 576;
+const uint16_t PADDING = 1500;
+const uint32_t PRIMING = DELAY + 529;
+const uint32_t VALID = FRAMES * 1152 - DELAY - PADDING;
+
+// Info frame with a LAME tag, then FRAMES audio frames. The mock Helix
+// passes bytes through as PCM, so the rendition content is predictable.
+std::vector<uint8_t> makeMp3() {
+  std::vector<uint8_t> out;
+  for (uint32_t i = 0; i <= FRAMES; i++) {
+    size_t at = putMp3Frame(out);
+    for (size_t b = MP3_SIDE_INFO; b < MP3_FRAME_LEN; b++)
+      out[at + b] = (uint8_t)(i * 7 + b);
+  }
+  uint8_t *p = &out[MP3_SIDE_INFO];
+  memset(p, 0, MP3_FRAME_LEN - MP3_SIDE_INFO);
+  memcpy(p, "Info", 4);
+  uint8_t *lame = p + 8;
+  memcpy(lame, "LAME3.100", 9);
+  lame[21] = DELAY >> 4;
+  lame[22] = ((DELAY & 0x0F) << 4) | (PADDING >> 8);
+  lame[23] = PADDING & 0xFF;
+  return out;
+}
+
+std::vector<uint8_t> mp3;
+
+void setup(uint8_t mode, uint8_t budgetUnits) {
+  LittleFS.mockFiles.clear();
+  LittleFS.mockTotalBytes = 4 * 1024 * 1024;
+  LittleFS.mockUsedBytes = 0;
+  mp3 = makeMp3();
+  LittleFS.mockFiles.push_back(File("/horn.mp3", mp3));
+  MP3DecoderHelix::mockInfo = AudioInfo(44100, 1, 16);
+  NmraDcc &dcc = DccController::getInstance().getDcc();
+  dcc.setCV(CV::AUDIO_TRANSCODE, mode);
+  dcc.setCV(CV::AUDIO_RENDITION_BUDGET, budgetUnits);
+}
+
+String status(const char *key) {
+  JsonDocument doc;
+  AudioTranscoder::getInstance().getStatus(doc.to<JsonObject>());
+  return doc[key].val;
+}
+
+void runAll() {
+  int steps = 0;
+  while (AudioTranscoder::getInstance().step())
+    assert(++steps < 10000);
+}
+
+std::vector<uint8_t> readAll(const char *path) {
+  File f = LittleFS.open(path, "r");
+  assert(f);
+  std::vector<uint8_t> data(f.size());
+  assert(f.read(data.data(), data.size()) == data.size());
+  return data;
+}
+
+struct PcmSink : public Print {
+  std::vector<int16_t> samples;
+  size_t write(uint8_t) override { return 1; }
+  size_t write(const uint8_t *data, size_t len) override {
+    const int16_t *s = (const int16_t *)data;
+    samples.insert(samples.end(), s, s + len / 2);
+    return len;
+  }
+};
+} // namespace
+
+TEST_CASE(test_pcm_rendition_is_trimmed) {
+  setup(2, 16);
+  AudioTranscoder &tc = AudioTranscoder::getInstance();
+  tc.enqueue("/horn.mp3");
+  tc.enqueue("/horn.mp3"); // Already queued
+  runAll();
+  assert(status("state") == "done");
+  assert(status("format") == "pcm");
+  assert(status("progress") == "100");
+  assert(!LittleFS.exists("/horn.mp3.wav.tmp"));
+
+  std::vector<uint8_t> wav = readAll("/horn.mp3.wav");
+  WavInfo info;
+  assert(parseWavHeader(wav.data(), wav.size(), info));
+  assert(info.formatTag == WAV_FORMAT_PCM);
+  assert(info.channels == 1);
+  assert(info.sampleRate == 44100);
+  assert(info.dataSize == VALID * 2);
+  assert(wav.size() == info.dataOffset + info.dataSize);
+
+  // The first kept sample is the one after the priming; whatever the mock
+  // decoder did not produce is padded with silence
+  const int16_t *pcm = (const int16_t *)(wav.data() + info.dataOffset);
+  size_t audio = mp3.size() - MP3_FRAME_LEN; // Info frame is never decoded
+  size_t decoded = audio / 2 - PRIMING;
+  for (size_t i = 0; i < decoded; i++) {
+    size_t at = MP3_FRAME_LEN + 2 * (PRIMING + i);
+    assert(pcm[i] == (int16_t)(mp3[at] | (mp3[at + 1] << 8)));
+  }
+  for (size_t i = decoded; i < VALID; i++)
+    assert(pcm[i] == 0);
+}
+
+TEST_CASE(test_adpcm_rendition_declares_exact_length) {
+  setup(1, 16);
+  AudioTranscoder::getInstance().enqueue("/horn.mp3");
+  runAll();
+  assert(status("format") == "adpcm");
+
+  std::vector<uint8_t> wav = readAll("/horn.mp3.wav");
+  WavInfo info;
+  assert(parseWavHeader(wav.data(), wav.size(), info));
+  assert(info.formatTag == WAV_FORMAT_IMA_ADPCM);
+  assert(info.frameCount == VALID);
+  assert(info.dataSize == ((VALID + 1016) / 1017) * 512);
+
+  PcmSink sink;
+  ImaAdpcmDecoder dec;
+  dec.setOutput(sink);
+  dec.begin();
+  dec.write(wav.data(), wav.size());
+  assert(sink.samples.size() == VALID);
+}
+
+TEST_CASE(test_space_budget) {
+  // No budget: the MP3 is left alone
+  setup(2, 0);
+  AudioTranscoder::getInstance().enqueue("/horn.mp3");
+  runAll();
+  assert(status("state") == "skipped");
+  assert(!LittleFS.exists("/horn.mp3.wav"));
+
+  // 64 KB with 40 KB already used: PCM (41 KB) does not fit, ADPCM does
+  setup(2, 1);
+  LittleFS.mockFiles.push_back(
+      File("/bell.mp3.wav", std::vector<uint8_t>(40000)));
+  AudioTranscoder::getInstance().enqueue("/horn.mp3");
+  runAll();
+  assert(status("state") == "done");
+  assert(status("format") == "adpcm");
+  assert(status("used") == String(std::to_string(40000 + 60 + 21 * 512)));
+
+  // Transcoding off: nothing is queued
+  setup(0, 16);
+  AudioTranscoder::getInstance().enqueue("/horn.mp3");
+  assert(!AudioTranscoder::getInstance().step());
+}
+
+TEST_CASE(test_cancel_removes_partial_file) {
+  setup(2, 16);
+  AudioTranscoder &tc = AudioTranscoder::getInstance();
+  tc.enqueue("/horn.mp3");
+  assert(tc.step()); // Starts the job
+  assert(tc.step());
+  assert(status("state") == "running");
+  assert(LittleFS.exists("/horn.mp3.wav.tmp"));
+
+  tc.cancel("/horn.mp3");
+  runAll();
+  assert(status("state") == "idle");
+  assert(!LittleFS.exists("/horn.mp3.wav.tmp"));
+  assert(!LittleFS.exists("/horn.mp3.wav"));
+}
+
+TEST_CASE(test_voice_plays_rendition) {
+  setup(2, 16);
+  AudioTranscoder::getInstance().enqueue("/horn.mp3");
+  runAll();
+  std::vector<uint8_t> wav = readAll("/horn.mp3.wav");
+  const int16_t *pcm = (const int16_t *)(wav.data() + 44);
+
+  // Helix would fail the test: the mock decoder is switched off
+  MP3DecoderHelix::mockInfo = AudioInfo();
+  AudioVoice voice;
+  assert(voice.startFile("/horn.mp3"));
+  assert(LittleFS.lastOpenedPath == "/horn.mp3.wav");
+  voice.service();
+  int32_t acc[64] = {0};
+  assert(voice.mix(acc, 64, 44100) == 64);
+  for (int i = 0; i < 64; i++)
+    assert(acc[i] == pcm[i]);
+}
+
+int main() {
+  RUN_TEST(test_pcm_rendition_is_trimmed);
+  RUN_TEST(test_adpcm_rendition_declares_exact_length);
+  RUN_TEST(test_space_budget);
+  RUN_TEST(test_cancel_removes_partial_file);
+  RUN_TEST(test_voice_plays_rendition);
+  std::cout << "All AudioTranscoder tests passed!" << std::endl;
+  return 0;
+}
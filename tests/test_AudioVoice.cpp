@@ -0,0 +1,235 @@
+// clang-format off
+// TEST_SOURCES: src/AudioVoice.cpp src/AudioPrefetcher.cpp src/ImaAdpcm.cpp src/Mp3Index.cpp src/Mp3Sidecar.cpp src/AudioTranscoder.cpp src/SoundPack.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "AudioVoice.h"
+#include "../src/CvRegistry.h"
+#include "AudioFixtures.h"
+#include "DccController.h"
+#include "LittleFS.h"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+using namespace AudioFixtures;
+
+const uint32_t RATE = 44100;
+
+// rampWav() as a LittleFS file, with an optional sustain loop
+File makeWav(const char *path, int16_t base, uint32_t frames,
+             uint8_t channels = 1, uint32_t rate = RATE,
+             int32_t loopStart = -1, int32_t loopLast = -1) {
+  std::vector<uint8_t> wav = rampWav(base, frames, channels, rate);
+  if (loopStart >= 0)
+    putSmplLoop(wav, loopStart, loopLast);
+  return File(path, wav);
+}
+
+// Runs the voice the way AudioController::loop does and returns the output
+std::vector<int32_t> render(AudioVoice &voice, size_t releaseAfter = SIZE_MAX,
+                            size_t block = 64) {
+  std::vector<int32_t> out;
+  while (voice.active() && out.size() < 200000) {
+    if (out.size() >= releaseAfter && !voice.released())
+      voice.release();
+    voice.service();
+    std::vector<int32_t> acc(block, 0);
+    size_t n = voice.mix(acc.data(), block, RATE);
+    out.insert(out.end(), acc.begin(), acc.begin() + n);
+  }
+  return out;
+}
+
+// Checks that out[pos..] continues with frames first..last-1 of base
+bool expectRun(const std::vector<int32_t> &out, size_t &pos, int16_t base,
+               uint32_t first, uint32_t last) {
+  for (uint32_t i = first; i < last; i++, pos++) {
+    if (pos >= out.size() || out[pos] != base + (int32_t)i) {
+      printf("\n  mismatch at %zu: got %d want %d\n", pos,
+             pos < out.size() ? out[pos] : -1, base + i);
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+TEST_CASE(test_intro_loop_outro_gapless) {
+  LittleFS.mockFiles.clear();
+  LittleFS.mockFiles.push_back(makeWav("/w_in.wav", 1000, 100));
+  LittleFS.mockFiles.push_back(makeWav("/w_loop.wav", 2000, 50));
+  LittleFS.mockFiles.push_back(makeWav("/w_out.wav", 3000, 30));
+
+  SoundAsset whistle;
+  whistle.id = 1;
+  whistle.type = SoundType::COMPLEX_LOOP;
+  whistle.fileIntro = "/w_in.wav";
+  whistle.fileLoop = "/w_loop.wav";
+  whistle.fileOutro = "/w_out.wav";
+
+  AudioVoice voice;
+  assert(voice.start(whistle));
+  assert(voice.segment() == AudioVoice::Segment::INTRO);
+  // Loop file is opened up front, not at the boundary
+  assert(LittleFS.lastOpenedPath == "/w_loop.wav");
+
+  std::vector<int32_t> out = render(voice, 400);
+  size_t pos = 0;
+  assert(expectRun(out, pos, 1000, 0, 100));
+  size_t passes = 0;
+  while (pos < out.size() && out[pos] == 2000) {
+    assert(expectRun(out, pos, 2000, 0, 50));
+    passes++;
+  }
+  assert(passes >= 6); // Held until frame 400, whole passes only
+  assert(expectRun(out, pos, 3000, 0, 30));
+  assert(pos == out.size());
+  assert(voice.underruns() == 0);
+}
+
+TEST_CASE(test_smpl_loop_points) {
+  LittleFS.mockFiles.clear();
+  LittleFS.mockFiles.push_back(makeWav("/bell.wav", 0, 200, 1, RATE, 50, 99));
+
+  // Header is in front of the data, smpl follows it
+  File f = LittleFS.open("/bell.wav");
+  std::vector<uint8_t> raw(f.size());
+  f.read(raw.data(), raw.size());
+  uint32_t start = 0, end = 0;
+  assert(parseSmplLoop(&raw[44 + 400 + 8], 60, start, end));
+  assert(start == 50 && end == 100);
+
+  SoundAsset bell;
+  bell.id = 2;
+  bell.type = SoundType::TOGGLE;
+  bell.fileLoop = "/bell.wav";
+  bell.loopStart = start;
+  bell.loopEnd = end;
+
+  AudioVoice voice;
+  assert(voice.start(bell));
+  std::vector<int32_t> out = render(voice, 300);
+
+  // Lead-in 0..99, sustain 50..99 until released, then the tail 100..199
+  size_t pos = 0;
+  assert(expectRun(out, pos, 0, 0, 100));
+  size_t passes = 0;
+  while (pos < out.size() && out[pos] == 50) {
+    assert(expectRun(out, pos, 0, 50, 100));
+    passes++;
+  }
+  assert(passes >= 4);
+  assert(expectRun(out, pos, 0, 100, 200));
+  assert(pos == out.size());
+}
+
+TEST_CASE(test_release_during_intro_skips_loop) {
+  LittleFS.mockFiles.clear();
+  LittleFS.mockFiles.push_back(makeWav("/a_in.wav", 1000, 40));
+  LittleFS.mockFiles.push_back(makeWav("/a_loop.wav", 2000, 40));
+  LittleFS.mockFiles.push_back(makeWav("/a_out.wav", 3000, 40));
+
+  SoundAsset horn;
+  horn.id = 3;
+  horn.type = SoundType::COMPLEX_LOOP;
+  horn.fileIntro = "/a_in.wav";
+  horn.fileLoop = "/a_loop.wav";
+  horn.fileOutro = "/a_out.wav";
+
+  AudioVoice voice;
+  voice.start(horn);
+  voice.release(); // Tap shorter than the intro
+  std::vector<int32_t> out = render(voice);
+  size_t pos = 0;
+  assert(expectRun(out, pos, 1000, 0, 40));
+  assert(expectRun(out, pos, 3000, 0, 40));
+  assert(pos == out.size());
+}
+
+TEST_CASE(test_stereo_downmix_and_resample) {
+  LittleFS.mockFiles.clear();
+  LittleFS.mockFiles.push_back(makeWav("/s.wav", 100, 1000, 2, RATE / 2));
+
+  AudioVoice voice;
+  assert(voice.startFile("/s.wav"));
+  std::vector<int32_t> out = render(voice);
+  // 22.05 kHz doubled to the mixer rate; L/R (x, x + 2) average to x + 1
+  assert(out.size() >= 1998 && out.size() <= 2000);
+  assert(out[0] == 101);
+  assert(out[1] == 101); // Halfway between 101 and 102, rounded down
+  assert(out[2] == 102);
+}
+
+TEST_CASE(test_missing_file) {
+  LittleFS.mockFiles.clear();
+  AudioVoice voice;
+  assert(!voice.startFile("/nope.wav"));
+  assert(!voice.active());
+}
+
+TEST_CASE(test_read_ahead_never_blocks) {
+  LittleFS.mockFiles.clear();
+  // 6 KB of audio: more than the block read when the file is opened
+  LittleFS.mockFiles.push_back(
+      makeWav("/long.wav", 0, 3000, 1, RATE, 1000, 2999));
+  SoundAsset bell;
+  bell.id = 4;
+  bell.type = SoundType::TOGGLE;
+  bell.fileLoop = "/long.wav";
+  bell.loopStart = 1000;
+  bell.loopEnd = 3000;
+
+  AudioPrefetcher &prefetcher = AudioPrefetcher::getInstance();
+  prefetcher.startTask();
+  DccController::getInstance().getDcc().setCV(CV::AUDIO_READ_AHEAD, 8);
+  AudioVoice voice;
+  assert(voice.start(bell));
+
+  // The prefetch task has not run: the voice waits instead of ending the pass
+  for (int i = 0; i < 50; i++)
+    voice.service();
+  assert(voice.segment() == AudioVoice::Segment::LOOP);
+  assert(voice.buffered() < 3000);
+  uint32_t stalls = prefetcher.stalls();
+  assert(stalls > 0);
+
+  // With the task running alongside, every pass comes from the ring
+  std::vector<int32_t> out;
+  while (voice.active() && out.size() < 200000) {
+    if (out.size() >= 12000 && !voice.released())
+      voice.release();
+    prefetcher.step();
+    voice.service();
+    std::vector<int32_t> acc(64, 0);
+    size_t n = voice.mix(acc.data(), 64, RATE);
+    out.insert(out.end(), acc.begin(), acc.begin() + n);
+  }
+  size_t pos = 0;
+  assert(expectRun(out, pos, 0, 0, 3000));
+  size_t passes = 0;
+  while (pos < out.size() && out[pos] == 1000) {
+    assert(expectRun(out, pos, 0, 1000, 3000));
+    passes++;
+  }
+  assert(passes >= 4 && pos == out.size());
+  assert(prefetcher.stalls() == stalls && voice.underruns() == 0);
+  DccController::getInstance().getDcc().setCV(CV::AUDIO_READ_AHEAD, 0);
+}
+
+int main() {
+  RUN_TEST(test_intro_loop_outro_gapless);
+  RUN_TEST(test_smpl_loop_points);
+  RUN_TEST(test_release_during_intro_skips_loop);
+  RUN_TEST(test_stereo_downmix_and_resample);
+  RUN_TEST(test_missing_file);
+  RUN_TEST(test_read_ahead_never_blocks);
+  std::cout << "All AudioVoice tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,58 @@
+// clang-format off
+// TEST_SOURCES: src/BootTimeline.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "BootTimeline.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+TEST_CASE(test_first_mark_counts) {
+  BootTimeline &boot = BootTimeline::getInstance();
+  assert(!boot.reached(BOOT_SETUP));
+  _mockMillis = 0;
+  boot.mark(BOOT_SETUP); // At 0 µs: still reached
+  assert(boot.reached(BOOT_SETUP) && boot.us(BOOT_SETUP) == 1);
+
+  _mockMillis = 120;
+  boot.mark(BOOT_DCC);
+  _mockMillis = 500;
+  boot.mark(BOOT_DCC); // Again, later: ignored
+  assert(boot.us(BOOT_DCC) == 120000);
+}
+
+TEST_CASE(test_status) {
+  BootTimeline &boot = BootTimeline::getInstance();
+  _mockMillis = 1800;
+  boot.mark(BOOT_READY);
+
+  JsonDocument doc;
+  boot.getStatus(doc.to<JsonObject>());
+  assert((int)doc["dcc_ms"] == 120);
+  assert((int)doc["ready_ms"] == 1800);
+  assert(((String)doc["wifi_ms"]).length() == 0); // Not reached
+  assert((int)doc["target_ms"] == BootTimeline::TARGET_MS);
+  assert((bool)doc["target_met"]);
+  boot.log();
+}
+
+TEST_CASE(test_phase_names) {
+  for (uint8_t p = 0; p < BOOT_PHASES; p++)
+    assert(strcmp(BootTimeline::phaseName((BootPhase)p), "?") != 0);
+  assert(strcmp(BootTimeline::phaseName(BOOT_FIRST_RESPONSE),
+                "first_response") == 0);
+}
+
+int main() {
+  RUN_TEST(test_first_mark_counts);
+  RUN_TEST(test_status);
+  RUN_TEST(test_phase_names);
+  std::cout << "All BootTimeline tests passed!" << std::endl;
+  return 0;
+}
@@ -1,6 +1,6 @@
 // clang-format off
 // TEST_FLAGS: -DSKIP_MOCK_DCC_CONTROLLER
-// TEST_SOURCES: src/DccController.cpp src/BootLoopDetector.cpp tests/mocks/mocks.cpp
+// TEST_SOURCES: src/DccController.cpp src/BootLoopDetector.cpp src/MotorCapture.cpp src/BootTimeline.cpp src/LatencyMonitor.cpp src/PerfMonitor.cpp src/TraceRecorder.cpp tests/mocks/mocks.cpp
 // clang-format on
 #include <cassert>
 #include <iostream>
@@ -0,0 +1,166 @@
+// clang-format off
+// TEST_SOURCES: src/EngineSound.cpp src/AudioTranscoder.cpp src/AudioVoice.cpp src/AudioPrefetcher.cpp src/ImaAdpcm.cpp src/Mp3Index.cpp src/Mp3Sidecar.cpp src/SoundPack.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "EngineSound.h"
+#include "AudioFixtures.h"
+#include "ImaAdpcm.h"
+#include "LittleFS.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+using namespace AudioFixtures;
+
+constexpr uint32_t RATE = 44100;
+constexpr uint16_t CROSSFADE_MS = 10; // 441 frames at RATE
+
+void addDc(const char *path, int16_t level, uint32_t frames,
+           uint16_t channels = 1) {
+  LittleFS.mockFiles.push_back(
+      File(path, dcWav(level, frames, channels, RATE)));
+}
+
+std::vector<int32_t> render(EngineSound &engine, size_t frames) {
+  std::vector<int32_t> out(frames, 0);
+  for (size_t at = 0; at < frames; at += 64)
+    engine.mix(out.data() + at, std::min<size_t>(64, frames - at), RATE);
+  return out;
+}
+
+SoundAsset dieselAsset() {
+  SoundAsset asset;
+  asset.id = 20;
+  asset.name = "Prime Mover";
+  asset.type = SoundType::DIESEL;
+  asset.notches = {"/idle.wav", "/n1.wav", "/n2.wav"};
+  asset.crossfadeMs = CROSSFADE_MS;
+  return asset;
+}
+
+void setupFiles() {
+  LittleFS.mockFiles.clear();
+  addDc("/idle.wav", 1000, 4410);
+  addDc("/n1.wav", 2000, 4410);
+  addDc("/n2.wav", 3000, 4410);
+}
+} // namespace
+
+TEST_CASE(test_load_decodes_layers) {
+  setupFiles();
+  // Stereo PCM is downmixed, ADPCM is expanded to PCM up front
+  LittleFS.mockFiles.pop_back();
+  addDc("/n2.wav", 3000, 4410, 2);
+  std::vector<int16_t> pcm(505, -500);
+  std::vector<uint8_t> adpcm = wavHeader(0x11, 1, RATE, 256, 4, 256);
+  ImaAdpcmState st;
+  adpcm.resize(adpcm.size() + 256);
+  imaAdpcmEncodeBlock(pcm.data(), 505, 1, &st, &adpcm[adpcm.size() - 256],
+                      256);
+  LittleFS.mockFiles.push_back(File("/up0.wav", adpcm));
+
+  EngineSound engine;
+  SoundAsset asset = dieselAsset();
+  asset.notchUp = {"/up0.wav"};
+  asset.fileOutro = "/shutdown.mp3"; // Optional layer without a rendition
+  assert(engine.load(asset));
+  assert(engine.notchCount() == 3 && engine.assetId() == 20);
+  assert(engine.preloadBytes() == (3 * 4410 + 505) * 2);
+
+  // A missing notch loop rejects the engine
+  asset.notches.push_back("/missing.wav");
+  assert(!engine.load(asset));
+  assert(!engine.loaded() && engine.preloadBytes() == 0);
+}
+
+TEST_CASE(test_notch_changes_crossfade_without_io) {
+  setupFiles();
+  _mockMillis = 1000;
+  EngineSound engine;
+  assert(engine.load(dieselAsset()));
+  engine.start();
+
+  // No start-up sample: idle fades in over the crossfade
+  std::vector<int32_t> out = render(engine, 441 + 64);
+  assert(std::abs(out[0]) < 50);
+  assert(out[441 + 10] == 1000);
+
+  LittleFS.callCount_open = 0;
+  _mockMillis += 1000;
+  // Throttle open, momentum still at zero: notch 1 ahead of the train
+  engine.update(128, 0.0f, 0.0f, 1000, 0);
+  assert(engine.notch() == 1);
+  out = render(engine, 441 + 64);
+  // Equal power: both layers at 0.707 half way through
+  assert(std::abs(out[220] - (int32_t)(0.7071f * 3000)) < 40);
+  assert(out[441 + 10] == 2000);
+
+  // The notch time holds the next step back
+  engine.update(255, 255.0f, 0.0f, 1000, 0);
+  assert(engine.notch() == 1);
+  _mockMillis += 1000;
+  engine.update(255, 255.0f, 0.0f, 1000, 0);
+  assert(engine.notch() == 2);
+  // and nothing steps during a crossfade
+  _mockMillis += 1000;
+  engine.update(0, 0.0f, 0.0f, 1000, 0);
+  assert(engine.notch() == 2);
+  out = render(engine, 441 + 64);
+  assert(out[441 + 10] == 3000);
+  assert(LittleFS.callCount_open == 0);
+
+  // Load holds notches up while cruising; one step down at a time
+  engine.update(128, 128.0f, 1.0f, 1000, 2);
+  assert(engine.notch() == 2);
+  engine.update(0, 0.0f, 0.0f, 1000, 2);
+  assert(engine.notch() == 1);
+}
+
+TEST_CASE(test_transition_and_shutdown) {
+  setupFiles();
+  addDc("/up0.wav", 5000, 2000);
+  addDc("/stop.wav", 700, 1000);
+  _mockMillis = 5000;
+  EngineSound engine;
+  SoundAsset asset = dieselAsset();
+  asset.notchUp = {"/up0.wav"};
+  asset.fileOutro = "/stop.wav";
+  assert(engine.load(asset));
+  engine.start();
+  render(engine, 1000);
+
+  // idle -> rev-up sample -> notch 1 loop
+  engine.update(20, 10.0f, 0.0f, 0, 0);
+  assert(engine.notch() == 1);
+  std::vector<int32_t> out = render(engine, 2100);
+  assert(out[1000] == 5000); // Transition at full level
+  // The loop fades in as the transition runs out. The handover starts on
+  // the first block with no more than a crossfade left: 400 frames here.
+  assert(std::abs(out[1800] - (int32_t)(0.7071f * 7000)) < 60);
+  assert(out[2050] == 2000);
+  assert(engine.running());
+
+  engine.release();
+  out = render(engine, 1200);
+  assert(out[600] == 700); // Shutdown alone once the loop has faded
+  assert(!engine.active() && !engine.running());
+  out = render(engine, 64);
+  assert(out[0] == 0);
+}
+
+int main() {
+  RUN_TEST(test_load_decodes_layers);
+  RUN_TEST(test_notch_changes_crossfade_without_io);
+  RUN_TEST(test_transition_and_shutdown);
+  std::cout << "All EngineSound tests passed!" << std::endl;
+  return 0;
+}
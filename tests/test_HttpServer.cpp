@@ -0,0 +1,174 @@
+// clang-format off
+// TEST_SOURCES: src/HttpServer.cpp src/RequestArena.cpp src/TraceRecorder.cpp tests/twin/EspHttpServer.cpp tests/mocks/mocks.cpp tests/sim/SimKernel.cpp
+// TEST_FLAGS: -Itests/twin -Itests/sim -DNIMRS_SIM -pthread
+// clang-format on
+
+// HttpServer on the twin's loopback esp_http_server, with a plain socket
+// client on a host thread: conditional GETs of a LittleFS file and of an
+// embedded asset, as the dashboard makes them.
+
+#include "HttpServer.h"
+#include "SimKernel.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cassert>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+const uint16_t PORT = 20000 + getpid() % 10000;
+const char *ASSET_TAG = "\"build-1234\"";
+
+HttpServer server(80);
+std::atomic<bool> serving(false);
+std::atomic<bool> done(false);
+
+struct Reply {
+  int code = 0;
+  std::string etag;
+  std::string body;
+};
+
+// One request on a fresh connection, read to the end of its body
+Reply get(const char *path, const char *ifNoneMatch = nullptr) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  assert(connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0);
+
+  std::string request = std::string("GET ") + path + " HTTP/1.1\r\n";
+  request += "Host: localhost\r\n";
+  if (ifNoneMatch)
+    request += std::string("If-None-Match: ") + ifNoneMatch + "\r\n";
+  request += "\r\n";
+  assert(send(fd, request.data(), request.size(), 0) ==
+         (ssize_t)request.size());
+
+  std::string in;
+  char buf[1024];
+  size_t headEnd = std::string::npos, length = 0;
+  while (headEnd == std::string::npos || in.size() < headEnd + 4 + length) {
+    ssize_t got = recv(fd, buf, sizeof(buf), 0);
+    assert(got > 0);
+    in.append(buf, got);
+    if (headEnd == std::string::npos &&
+        (headEnd = in.find("\r\n\r\n")) != std::string::npos) {
+      size_t at = in.find("Content-Length: ");
+      if (at != std::string::npos && at < headEnd)
+        length = strtoul(in.c_str() + at + 16, nullptr, 10);
+    }
+  }
+  close(fd);
+
+  Reply reply;
+  reply.code = atoi(in.c_str() + in.find(' ') + 1);
+  size_t at = in.find("ETag: ");
+  if (at != std::string::npos && at < headEnd)
+    reply.etag = in.substr(at + 6, in.find("\r\n", at) - at - 6);
+  reply.body = in.substr(headEnd + 4, length);
+  return reply;
+}
+
+void putFile(const char *path, const char *content) {
+  LittleFS.remove(path);
+  LittleFS.mockFiles.push_back(
+      File(path, std::vector<uint8_t>(content, content + strlen(content))));
+}
+
+void loopTask(void *) {
+  // The static file catch-all and an embedded asset, as ConnectivityManager
+  // registers them
+  server.on("/asset", HTTP_GET, [] {
+    if (server.notModified(ASSET_TAG))
+      return;
+    server.sendHeader("ETag", ASSET_TAG);
+    server.send(200, "text/plain", "asset");
+  });
+  server.onNotFound(
+      [] {
+        File file = LittleFS.open(server.uri(), "r");
+        if (!file) {
+          server.send(404, "text/plain", "404: Not Found");
+          return;
+        }
+        server.serveFile(file, "audio/wav");
+        file.close();
+      },
+      4096);
+  server.begin();
+  serving = true;
+  for (;;) {
+    server.poll();
+    vTaskDelay(1);
+  }
+}
+} // namespace
+
+TEST_CASE(test_file_is_sent_with_its_tag) {
+  putFile("/horn.wav", "HONK");
+  Reply r = get("/horn.wav");
+  assert(r.code == 200 && r.body == "HONK");
+  assert(r.etag == "\"4-0\""); // Size and write time
+}
+
+TEST_CASE(test_unchanged_file_is_not_modified) {
+  Reply first = get("/horn.wav");
+  Reply again = get("/horn.wav", first.etag.c_str());
+  assert(again.code == 304 && again.body.empty());
+  assert(again.etag == first.etag);
+  assert(get("/horn.wav", "*").code == 304);
+}
+
+TEST_CASE(test_changed_file_is_sent_again) {
+  Reply first = get("/horn.wav");
+  putFile("/horn.wav", "HOOONK");
+  Reply again = get("/horn.wav", first.etag.c_str());
+  assert(again.code == 200 && again.body == "HOOONK");
+  assert(again.etag != first.etag);
+}
+
+TEST_CASE(test_asset_tag) {
+  Reply r = get("/asset");
+  assert(r.code == 200 && r.etag == ASSET_TAG);
+  assert(get("/asset", ASSET_TAG).code == 304);
+  // One of several tags the client holds
+  assert(get("/asset", "\"old\", \"build-1234\"").code == 304);
+  assert(get("/asset", "\"old\"").code == 200);
+  assert(get("/missing.wav").code == 404);
+}
+
+int main() {
+  signal(SIGPIPE, SIG_IGN);
+  httpd_twin_map_port(80, PORT);
+  xTaskCreatePinnedToCore(loopTask, "loopTask", 8192, nullptr, 1, nullptr, 1);
+
+  std::thread client([] {
+    while (!serving)
+      usleep(1000);
+    RUN_TEST(test_file_is_sent_with_its_tag);
+    RUN_TEST(test_unchanged_file_is_not_modified);
+    RUN_TEST(test_changed_file_is_sent_again);
+    RUN_TEST(test_asset_tag);
+    done = true;
+  });
+  SimKernel::getInstance().runRealTime([](uint64_t maxUs) {
+    httpd_twin_poll(std::min<uint64_t>(maxUs, 10000));
+    return !done;
+  });
+  client.join();
+  std::cout << "All HttpServer tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,244 @@
+// clang-format off
+// TEST_SOURCES: src/ImaAdpcm.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "AudioFixtures.h"
+#include "AudioUtils.h"
+#include "ImaAdpcm.h"
+#include "ImaAdpcmDecoder.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+using namespace AudioFixtures;
+
+std::vector<int16_t> sine(size_t frames, uint8_t channels) {
+  std::vector<int16_t> pcm(frames * channels);
+  for (size_t i = 0; i < frames; i++)
+    for (uint8_t c = 0; c < channels; c++)
+      pcm[i * channels + c] =
+          (int16_t)(12000 * sin(2 * M_PI * (440.0 + 110 * c) * i / 22050));
+  return pcm;
+}
+
+// Skips the first frames while the step index adapts up from zero
+double snrDb(const std::vector<int16_t> &ref, const int16_t *out, size_t n) {
+  double sig = 0, err = 0;
+  for (size_t i = 64; i < n; i++) {
+    sig += (double)ref[i] * ref[i];
+    double d = (double)ref[i] - out[i];
+    err += d * d;
+  }
+  return 10 * log10(sig / (err + 1));
+}
+
+class PcmSink : public Print {
+public:
+  std::vector<uint8_t> bytes;
+  size_t write(uint8_t c) override {
+    bytes.push_back(c);
+    return 1;
+  }
+  size_t write(const uint8_t *buf, size_t size) override {
+    bytes.insert(bytes.end(), buf, buf + size);
+    return size;
+  }
+};
+} // namespace
+
+TEST_CASE(test_frames_per_block) {
+  assert(imaAdpcmFramesPerBlock(256, 1) == 505);
+  assert(imaAdpcmFramesPerBlock(512, 1) == 1017);
+  assert(imaAdpcmFramesPerBlock(1024, 2) == 1017);
+  assert(imaAdpcmFramesPerBlock(3, 1) == 0);
+  assert(imaAdpcmFramesPerBlock(256, 0) == 0);
+}
+
+TEST_CASE(test_roundtrip_mono) {
+  const uint16_t blockAlign = 256;
+  size_t perBlock = imaAdpcmFramesPerBlock(blockAlign, 1);
+  std::vector<int16_t> pcm = sine(perBlock, 1);
+
+  ImaAdpcmState state[1];
+  std::vector<uint8_t> block(blockAlign);
+  assert(imaAdpcmEncodeBlock(pcm.data(), perBlock, 1, state, block.data(),
+                             blockAlign) == blockAlign);
+
+  std::vector<int16_t> out(perBlock);
+  assert(imaAdpcmDecodeBlock(block.data(), blockAlign, 1, out.data()) ==
+         perBlock);
+  assert(out[0] == pcm[0]); // Header sample is exact
+  double snr = snrDb(pcm, out.data(), perBlock);
+  std::cout << "(SNR " << snr << " dB) ";
+  assert(snr > 35.0);
+}
+
+TEST_CASE(test_roundtrip_stereo) {
+  const uint16_t blockAlign = 512;
+  size_t perBlock = imaAdpcmFramesPerBlock(blockAlign, 2);
+  std::vector<int16_t> pcm = sine(perBlock, 2);
+
+  ImaAdpcmState state[2];
+  std::vector<uint8_t> block(blockAlign);
+  imaAdpcmEncodeBlock(pcm.data(), perBlock, 2, state, block.data(),
+                      blockAlign);
+  std::vector<int16_t> out(perBlock * 2);
+  assert(imaAdpcmDecodeBlock(block.data(), blockAlign, 2, out.data()) ==
+         perBlock);
+  assert(snrDb(pcm, out.data(), out.size()) > 35.0);
+}
+
+TEST_CASE(test_decode_short_block) {
+  const uint16_t blockAlign = 256;
+  std::vector<int16_t> pcm = sine(505, 2);
+  ImaAdpcmState state[2];
+  std::vector<uint8_t> block(blockAlign);
+  imaAdpcmEncodeBlock(pcm.data(), 505, 2, state, block.data(), blockAlign);
+
+  // Header, 2 stereo words and half a third: the frames actually written
+  std::vector<int16_t> out(505 * 2);
+  assert(imaAdpcmDecodeBlock(block.data(), 8 + 16 + 4, 2, out.data()) == 17);
+  assert(imaAdpcmDecodeBlock(block.data(), 8, 2, out.data()) == 1);
+  // Too short for the channels' headers
+  assert(imaAdpcmDecodeBlock(block.data(), 7, 2, out.data()) == 0);
+  assert(imaAdpcmDecodeBlock(block.data(), 3, 1, out.data()) == 0);
+  assert(imaAdpcmDecodeBlock(block.data(), blockAlign, 0, out.data()) == 0);
+}
+
+TEST_CASE(test_detect_codec) {
+  std::vector<uint8_t> adpcm = makeAdpcmWav(sine(100, 1), 1, 256);
+  WavInfo info;
+  assert(parseWavHeader(adpcm.data(), adpcm.size(), info));
+  assert(info.formatTag == WAV_FORMAT_IMA_ADPCM);
+  assert(info.channels == 1);
+  assert(info.sampleRate == 22050);
+  assert(info.blockAlign == 256);
+  assert(info.dataOffset == 12 + 12 + 28 + 8);
+  assert(info.dataSize == 256);
+
+  assert(detectAudioCodec("/horn.wav", adpcm.data(), 64) ==
+         AudioCodec::WAV_IMA_ADPCM);
+  adpcm[32] = WAV_FORMAT_PCM; // fmt tag low byte
+  assert(detectAudioCodec("/horn.wav", adpcm.data(), 64) ==
+         AudioCodec::WAV_PCM);
+  assert(detectAudioCodec("/horn.mp3", nullptr, 0) == AudioCodec::MP3);
+  assert(detectAudioCodec("/horn.wav", nullptr, 0) == AudioCodec::UNKNOWN);
+  // A rendition stored for an MP3 is sniffed, not trusted by name
+  assert(detectAudioCodec("/horn.mp3", adpcm.data(), 64) ==
+         AudioCodec::WAV_PCM);
+
+  const uint8_t junk[16] = {'I', 'D', '3'};
+  assert(!parseWavHeader(junk, sizeof(junk), info));
+}
+
+TEST_CASE(test_streaming_decoder) {
+  const size_t frames = 3000; // Several blocks, last one padded
+  std::vector<int16_t> pcm = sine(frames, 1);
+  std::vector<uint8_t> wav = makeAdpcmWav(pcm, 1, 256);
+
+  PcmSink sink;
+  ImaAdpcmDecoder dec;
+  dec.setOutput(sink);
+  dec.begin();
+  // Odd chunk sizes split both the header and block boundaries
+  for (size_t pos = 0; pos < wav.size(); pos += 37)
+    assert(dec.write(&wav[pos], std::min<size_t>(37, wav.size() - pos)) ==
+           std::min<size_t>(37, wav.size() - pos));
+
+  assert(dec.audioInfo().sample_rate == 22050);
+  assert(dec.audioInfo().channels == 1);
+  size_t blocks = (frames + 504) / 505;
+  assert(sink.bytes.size() == blocks * 505 * sizeof(int16_t));
+  const int16_t *out = (const int16_t *)sink.bytes.data();
+  assert(snrDb(pcm, out, frames) > 35.0);
+  dec.end();
+  assert(!dec);
+}
+
+TEST_CASE(test_streaming_decoder_truncated_tail) {
+  std::vector<int16_t> pcm = sine(505 + 100, 1);
+  std::vector<uint8_t> wav = makeAdpcmWav(pcm, 1, 256);
+  // Cut the final block after its header and 10 words of codes
+  size_t cut = 256 - 4 - 40;
+  wav.resize(wav.size() - cut);
+  uint32_t dataSize = 256 + 4 + 40;
+  memcpy(&wav[wav.size() - dataSize - 4], &dataSize, 4);
+
+  PcmSink sink;
+  ImaAdpcmDecoder dec;
+  dec.setOutput(sink);
+  dec.begin();
+  dec.write(wav.data(), wav.size());
+  assert(sink.bytes.size() == (505 + 81) * sizeof(int16_t));
+}
+
+TEST_CASE(test_streaming_decoder_fact_trims_padding) {
+  std::vector<int16_t> pcm = sine(3000, 1);
+  std::vector<uint8_t> wav = makeAdpcmWav(pcm, 1, 256, true);
+  WavInfo info;
+  assert(parseWavHeader(wav.data(), wav.size(), info));
+  assert(info.frameCount == 3000);
+
+  PcmSink sink;
+  ImaAdpcmDecoder dec;
+  dec.setOutput(sink);
+  dec.begin();
+  dec.write(wav.data(), wav.size());
+  assert(sink.bytes.size() == 3000 * sizeof(int16_t));
+}
+
+TEST_CASE(test_streaming_decoder_large_list) {
+  // The data chunk starts some 4 KB in, past anything worth buffering
+  std::vector<int16_t> pcm = sine(1000, 1);
+  std::vector<uint8_t> wav = makeAdpcmWav(pcm, 1, 256, true, 4001);
+
+  PcmSink sink;
+  ImaAdpcmDecoder dec;
+  dec.setOutput(sink);
+  dec.begin();
+  for (size_t pos = 0; pos < wav.size(); pos += 37)
+    dec.write(&wav[pos], std::min<size_t>(37, wav.size() - pos));
+  assert(dec.audioInfo().sample_rate == 22050);
+  assert(sink.bytes.size() == 1000 * sizeof(int16_t));
+  assert(snrDb(pcm, (const int16_t *)sink.bytes.data(), 1000) > 35.0);
+
+  // And all in one write
+  PcmSink whole;
+  dec.setOutput(whole);
+  dec.begin();
+  dec.write(wav.data(), wav.size());
+  assert(whole.bytes == sink.bytes);
+}
+
+TEST_CASE(test_streaming_decoder_rejects_non_wav) {
+  PcmSink sink;
+  ImaAdpcmDecoder dec;
+  dec.setOutput(sink);
+  dec.begin();
+  std::vector<uint8_t> junk(4096, 0xFF);
+  assert(dec.write(junk.data(), junk.size()) == junk.size());
+  assert(sink.bytes.empty());
+}
+
+int main() {
+  RUN_TEST(test_frames_per_block);
+  RUN_TEST(test_roundtrip_mono);
+  RUN_TEST(test_roundtrip_stereo);
+  RUN_TEST(test_decode_short_block);
+  RUN_TEST(test_detect_codec);
+  RUN_TEST(test_streaming_decoder);
+  RUN_TEST(test_streaming_decoder_truncated_tail);
+  RUN_TEST(test_streaming_decoder_fact_trims_padding);
+  RUN_TEST(test_streaming_decoder_large_list);
+  RUN_TEST(test_streaming_decoder_rejects_non_wav);
+  std::cout << "All ImaAdpcm tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,86 @@
+// clang-format off
+// TEST_SOURCES: src/LatencyMonitor.cpp src/PerfMonitor.cpp src/TraceRecorder.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "LatencyMonitor.h"
+#include <cassert>
+#include <iostream>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+TEST_CASE(test_stamp_to_record) {
+  LatencyMonitor &lat = LatencyMonitor::getInstance();
+  lat.reset();
+  _mockMillis = 1000;
+  uint32_t speed = lat.stamp();
+  uint32_t func = lat.stamp();
+  assert(speed && func && speed != func);
+
+  _mockMillis += 12;
+  lat.record(LATENCY_SPEED, speed);
+  _mockMillis += 30;
+  lat.record(LATENCY_FUNCTION, func);
+  lat.record(LATENCY_SPEED, 0); // No cause: not timed
+
+  LatencySummary s = lat.summary(LATENCY_SPEED);
+  assert(s.count == 1 && s.maxUs == 12000);
+  assert(s.p50Us == 12000 && s.p99Us == 12000);
+  LatencySummary f = lat.summary(LATENCY_FUNCTION);
+  assert(f.count == 1 && f.maxUs == 42000);
+
+  lat.reset();
+  assert(lat.summary(LATENCY_SPEED).count == 0);
+  assert(lat.summary(LATENCY_SPEED).p99Us == 0);
+}
+
+TEST_CASE(test_forgotten_cause) {
+  LatencyMonitor &lat = LatencyMonitor::getInstance();
+  lat.reset();
+  uint32_t old = lat.stamp();
+  for (uint8_t i = 0; i < LatencyMonitor::SLOTS; i++)
+    lat.stamp();
+  lat.record(LATENCY_SPEED, old); // Its slot was reused
+  assert(lat.summary(LATENCY_SPEED).count == 0);
+}
+
+TEST_CASE(test_percentiles) {
+  // 98 at 1 ms and 2 at 100 ms: the median in 1 ms's bucket, p99 in 100's
+  PerfHistogram h;
+  for (int i = 0; i < 98; i++)
+    h.addUs(1000);
+  h.addUs(100000);
+  h.addUs(100000);
+  uint32_t p50 = LatencyMonitor::percentileUs(h, 50);
+  uint32_t p99 = LatencyMonitor::percentileUs(h, 99);
+  assert(p50 >= 768 && p50 <= 1024);
+  assert(p99 >= 98304 && p99 <= 100000); // Capped at the max
+  assert(LatencyMonitor::percentileUs(h, 100) == 100000);
+  assert(LatencyMonitor::percentileUs(PerfHistogram(), 50) == 0);
+}
+
+TEST_CASE(test_status) {
+  LatencyMonitor &lat = LatencyMonitor::getInstance();
+  lat.reset();
+  _mockMillis = 2000;
+  uint32_t cause = lat.stamp();
+  _mockMillis += 5;
+  lat.record(LATENCY_SPEED, cause);
+  JsonDocument doc;
+  lat.getStatus(doc.to<JsonObject>());
+  assert((int)doc["speed_count"] == 1);
+  assert((int)doc["speed_max_us"] == 5000);
+  assert((int)doc["function_count"] == 0);
+}
+
+int main() {
+  RUN_TEST(test_stamp_to_record);
+  RUN_TEST(test_forgotten_cause);
+  RUN_TEST(test_percentiles);
+  RUN_TEST(test_status);
+  std::cout << "All LatencyMonitor tests passed!" << std::endl;
+  return 0;
+}
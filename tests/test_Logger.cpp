@@ -1,5 +1,5 @@
 // clang-format off
-// TEST_SOURCES: src/Logger.cpp tests/mocks/mocks.cpp
+// TEST_SOURCES: src/Logger.cpp src/PerfMonitor.cpp tests/mocks/mocks.cpp
 // TEST_FLAGS: -DSKIP_MOCK_LOGGER
 // clang-format on
 #include "../src/Logger.h"
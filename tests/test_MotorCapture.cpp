@@ -0,0 +1,182 @@
+// clang-format off
+// TEST_SOURCES: src/MotorCapture.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "MotorCapture.h"
+#include "TelemetryStream.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+class Blob : public Print {
+public:
+  std::vector<uint8_t> bytes;
+  size_t write(uint8_t c) override {
+    bytes.push_back(c);
+    return 1;
+  }
+  size_t write(const uint8_t *data, size_t len) override {
+    bytes.insert(bytes.end(), data, data + len);
+    return len;
+  }
+};
+
+struct Decoded {
+  CaptureHeader header;
+  std::vector<CaptureCycle> cycles;
+  std::vector<uint16_t> samples;
+};
+
+Decoded decode(const Blob &blob) {
+  Decoded d;
+  memcpy(&d.header, blob.bytes.data(), sizeof(d.header));
+  assert(d.header.magic == CAPTURE_MAGIC);
+  assert(d.header.version == CAPTURE_VERSION);
+  size_t at = sizeof(d.header);
+  d.cycles.resize(d.header.cycles);
+  memcpy(d.cycles.data(), blob.bytes.data() + at,
+         d.cycles.size() * sizeof(CaptureCycle));
+  at += d.cycles.size() * sizeof(CaptureCycle);
+  d.samples.resize(d.header.samples);
+  memcpy(d.samples.data(), blob.bytes.data() + at,
+         d.samples.size() * sizeof(uint16_t));
+  assert(at + d.samples.size() * sizeof(uint16_t) == blob.bytes.size());
+  return d;
+}
+
+// One motor tick: `n` samples all holding `t`, then its state
+void tick(uint16_t t, size_t n = 400, uint8_t flags = 0, uint8_t zone = 3) {
+  std::vector<float> raw(n, (float)t);
+  MotorCapture &capture = MotorCapture::getInstance();
+  capture.addSamples(raw.data(), raw.size(), 20000.0f);
+  CaptureCycle cycle = {};
+  cycle.target = (uint8_t)t;
+  cycle.flags = flags;
+  cycle.zone = zone;
+  capture.endCycle(cycle);
+}
+} // namespace
+
+TEST_CASE(test_stall_keeps_pre_and_post_window) {
+  MotorCapture &capture = MotorCapture::getInstance();
+  assert(capture.arm(CAPTURE_STALL, 5, 3));
+  assert(!capture.arm(CAPTURE_STALL, 5, 3)); // Already running
+
+  uint16_t t = 0;
+  for (; t < 30; t++)
+    tick(t);
+  assert(capture.state() == MotorCapture::State::ARMED);
+  tick(t++, 400, TELEMETRY_STALLED); // Rising edge: tick 30
+  assert(capture.state() == MotorCapture::State::TRIGGERED);
+  tick(t++, 400, TELEMETRY_STALLED); // Still stalled: not a new trigger
+  tick(t++);
+  tick(t++);
+  assert(capture.state() == MotorCapture::State::DONE);
+  tick(t++); // Ignored once done
+
+  Blob blob;
+  assert(capture.write(blob));
+  assert(blob.bytes.size() == capture.size());
+  Decoded d = decode(blob);
+  assert(d.header.fired == CAPTURE_STALL);
+  assert(d.header.cycles == 5 + 1 + 3);
+  assert(d.header.triggerCycle == 5);
+  assert(d.header.sampleRateHz == 20000);
+  assert(d.cycles[5].target == 30 && d.cycles.back().target == 33);
+  assert(d.cycles[5].triggers == CAPTURE_STALL);
+  // Each tick's samples follow from where its record says
+  for (const CaptureCycle &c : d.cycles) {
+    assert(c.samples == 400);
+    assert(d.samples[c.firstSample] == c.target);
+    assert(d.samples[c.firstSample + c.samples - 1] == c.target);
+  }
+  assert(d.samples.size() == 9 * 400);
+  capture.cancel();
+  assert(capture.state() == MotorCapture::State::IDLE);
+}
+
+TEST_CASE(test_triggers_from_other_tasks_and_zones) {
+  MotorCapture &capture = MotorCapture::getInstance();
+  capture.trigger(CAPTURE_CV_WRITE); // Not armed: dropped
+  assert(capture.arm(CAPTURE_CV_WRITE | CAPTURE_ZONE, 2, 0));
+  tick(0);
+  tick(1);
+  assert(capture.state() == MotorCapture::State::ARMED);
+  capture.trigger(CAPTURE_CV_WRITE);
+  tick(2);
+  assert(capture.state() == MotorCapture::State::DONE); // No post window
+
+  Blob blob;
+  capture.write(blob);
+  Decoded d = decode(blob);
+  assert(d.header.fired == CAPTURE_CV_WRITE && d.header.cycles == 3);
+
+  assert(capture.arm(CAPTURE_ZONE, 0, 0));
+  tick(0, 400, 0, 0); // The first tick has nothing to compare with
+  assert(capture.state() == MotorCapture::State::ARMED);
+  tick(1, 400, 0, 2);
+  assert(capture.state() == MotorCapture::State::DONE);
+  capture.cancel();
+}
+
+TEST_CASE(test_overwritten_samples_drop_their_ticks) {
+  MotorCapture &capture = MotorCapture::getInstance();
+  // Ticks with more samples than the ring holds for a full pre window
+  size_t big = MotorCapture::SAMPLES / 10;
+  assert(capture.arm(CAPTURE_MANUAL, 20, 0));
+  for (uint16_t t = 0; t < 20; t++)
+    tick(t, big);
+  capture.trigger(CAPTURE_MANUAL);
+  tick(20, big);
+  assert(capture.state() == MotorCapture::State::DONE);
+
+  Blob blob;
+  capture.write(blob);
+  Decoded d = decode(blob);
+  assert(d.header.cycles < 21);
+  assert(d.cycles.back().target == 20);
+  assert(d.header.triggerCycle == d.header.cycles - 1);
+  assert(d.samples.size() <= MotorCapture::SAMPLES);
+  assert(d.cycles[0].firstSample == 0);
+  for (const CaptureCycle &c : d.cycles)
+    assert(d.samples[c.firstSample] == c.target);
+  capture.cancel();
+}
+
+TEST_CASE(test_cancel_while_armed_waits_for_the_task) {
+  MotorCapture &capture = MotorCapture::getInstance();
+  assert(capture.arm(CAPTURE_STALL, 1, 1));
+  tick(0);
+  capture.cancel();
+  assert(capture.state() == MotorCapture::State::ARMED);
+  tick(1); // The task lets go
+  assert(capture.state() == MotorCapture::State::IDLE);
+  Blob blob;
+  assert(!capture.write(blob) && capture.size() == 0);
+}
+
+TEST_CASE(test_trigger_names) {
+  assert(MotorCapture::parseTriggers("stall,fault") ==
+         (CAPTURE_STALL | CAPTURE_FAULT));
+  assert(MotorCapture::parseTriggers("manual,cv,zone,bogus") ==
+         (CAPTURE_MANUAL | CAPTURE_CV_WRITE | CAPTURE_ZONE));
+  assert(MotorCapture::parseTriggers("") == 0);
+}
+
+int main() {
+  RUN_TEST(test_stall_keeps_pre_and_post_window);
+  RUN_TEST(test_triggers_from_other_tasks_and_zones);
+  RUN_TEST(test_overwritten_samples_drop_their_ticks);
+  RUN_TEST(test_cancel_while_armed_waits_for_the_task);
+  RUN_TEST(test_trigger_names);
+  std::cout << "All MotorCapture tests passed!" << std::endl;
+  return 0;
+}
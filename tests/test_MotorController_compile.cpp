@@ -2,7 +2,7 @@
 #include <iostream>
 
 // clang-format off
-// TEST_SOURCES: src/MotorController.cpp src/MotorTask.cpp src/BemfEstimator.cpp src/DspFilters.cpp src/RippleDetector.cpp src/DccController.cpp src/BootLoopDetector.cpp tests/mocks/MotorHal_mock.cpp tests/mocks/mocks.cpp
+// TEST_SOURCES: src/MotorController.cpp src/MotorTask.cpp src/TelemetryStream.cpp src/Telemetry.cpp src/MotorCapture.cpp src/BemfEstimator.cpp src/DspFilters.cpp src/RippleDetector.cpp src/DccController.cpp src/BootLoopDetector.cpp src/PerfMonitor.cpp src/BootTimeline.cpp src/LatencyMonitor.cpp src/TraceRecorder.cpp tests/mocks/MotorHal_mock.cpp tests/mocks/mocks.cpp
 // TEST_FLAGS: -DUNIT_TEST -DSKIP_MOCK_MOTOR_CONTROLLER -DSKIP_MOCK_DCC_CONTROLLER
 // clang-format on
 
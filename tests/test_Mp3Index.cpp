@@ -0,0 +1,211 @@
+// clang-format off
+// TEST_SOURCES: src/Mp3Index.cpp
+// clang-format on
+
+#include "Mp3Index.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+// MPEG-1 Layer III, 128 kbps, 44.1 kHz, joint stereo, no CRC: 417 bytes
+const uint8_t HDR[4] = {0xFF, 0xFB, 0x90, 0x40};
+const size_t FRAME_LEN = 417;
+const size_t SIDE_INFO = 4 + 32;
+
+void appendFrame(std::vector<uint8_t> &out, uint16_t mainDataBegin) {
+  size_t at = out.size();
+  out.resize(at + FRAME_LEN, 0x11);
+  memcpy(&out[at], HDR, 4);
+  memset(&out[at + 4], 0, 32);
+  out[at + 4] = mainDataBegin >> 1;
+  out[at + 5] = (mainDataBegin & 1) << 7;
+}
+
+void appendInfoFrame(std::vector<uint8_t> &out, uint32_t frames,
+                     uint16_t delay, uint16_t padding) {
+  size_t at = out.size();
+  appendFrame(out, 0);
+  uint8_t *p = &out[at + SIDE_INFO];
+  memset(p, 0, FRAME_LEN - SIDE_INFO);
+  memcpy(p, "Info", 4);
+  p[7] = 0x0F; // Frames, bytes, TOC, quality
+  p[8] = frames >> 24;
+  p[9] = frames >> 16;
+  p[10] = frames >> 8;
+  p[11] = frames;
+  uint8_t *lame = p + 8 + 4 + 4 + 100 + 4;
+  memcpy(lame, "LAME3.100", 9);
+  lame[21] = delay >> 4;
+  lame[22] = ((delay & 0x0F) << 4) | (padding >> 8);
+  lame[23] = padding & 0xFF;
+}
+
+// ID3v2 tag, Info frame, audio frames with a run of junk in the middle and
+// an ID3v1 tag at the end, like a typical LAME-encoded asset
+std::vector<uint8_t> makeMp3(uint32_t frames, bool withInfo = true,
+                             uint16_t (*mdb)(uint32_t) = nullptr) {
+  std::vector<uint8_t> out = {'I', 'D', '3', 3, 0, 0, 0, 0, 0, 100};
+  out.resize(out.size() + 100, 0);
+  if (withInfo)
+    appendInfoFrame(out, frames, 576, 1500);
+  for (uint32_t i = 0; i < frames; i++) {
+    appendFrame(out, mdb ? mdb(i) : 0);
+    if (i == 10)
+      out.resize(out.size() + 7, 0x00);
+  }
+  const char tag[4] = "TAG";
+  out.insert(out.end(), tag, tag + 3);
+  out.resize(out.size() + 125, 0x20);
+  return out;
+}
+
+Mp3Index::ReadFn reader(const std::vector<uint8_t> &data) {
+  return [&data](uint32_t offset, uint8_t *buf, size_t len) -> size_t {
+    if (offset >= data.size())
+      return 0;
+    size_t n = std::min(len, data.size() - offset);
+    memcpy(buf, &data[offset], n);
+    return n;
+  };
+}
+} // namespace
+
+TEST_CASE(test_parse_frame_header) {
+  Mp3FrameInfo info;
+  assert(parseMp3FrameHeader(HDR, info));
+  assert(info.version == 1);
+  assert(info.sampleRate == 44100);
+  assert(info.samples == 1152);
+  assert(info.channels == 2);
+  assert(info.frameLen == FRAME_LEN);
+  assert(info.headerBytes == SIDE_INFO);
+
+  // MPEG-2, 64 kbps, 22.05 kHz, mono, with CRC
+  const uint8_t v2[4] = {0xFF, 0xF2, 0x80, 0xC0};
+  assert(parseMp3FrameHeader(v2, info));
+  assert(info.version == 2);
+  assert(info.sampleRate == 22050);
+  assert(info.samples == 576);
+  assert(info.channels == 1);
+  assert(info.frameLen == 72 * 64000 / 22050);
+  assert(info.headerBytes == 4 + 2 + 9);
+
+  const uint8_t layer2[4] = {0xFF, 0xFD, 0x90, 0x40};
+  const uint8_t badRate[4] = {0xFF, 0xFB, 0x9C, 0x40};
+  const uint8_t noSync[4] = {'I', 'D', '3', 3};
+  assert(!parseMp3FrameHeader(layer2, info));
+  assert(!parseMp3FrameHeader(badRate, info));
+  assert(!parseMp3FrameHeader(noSync, info));
+}
+
+TEST_CASE(test_build_skips_tags_and_reads_gapless_info) {
+  std::vector<uint8_t> mp3 = makeMp3(40);
+  Mp3Index index;
+  assert(index.build(reader(mp3), mp3.size()));
+  assert(index.frameCount() == 40);
+  assert(index.sampleRate() == 44100);
+  assert(index.samplesPerFrame() == 1152);
+  assert(index.hasGaplessInfo());
+  assert(index.encoderDelay() == 576);
+  assert(index.encoderPadding() == 1500);
+  assert(index.primingSamples() == 576 + Mp3Index::DECODER_DELAY);
+  assert(index.validSamples() == 40 * 1152 - 576 - 1500);
+
+  // ID3v2 (110) + Info frame, then contiguous frames until the junk
+  assert(index.frameOffset(0) == 110 + FRAME_LEN);
+  assert(index.frameOffset(10) == 110 + 11 * FRAME_LEN);
+  assert(index.frameOffset(11) == 110 + 12 * FRAME_LEN + 7);
+  assert(index.frameOffset(39) == 110 + 40 * FRAME_LEN + 7);
+}
+
+TEST_CASE(test_build_without_info_frame) {
+  std::vector<uint8_t> mp3 = makeMp3(5, false);
+  Mp3Index index;
+  assert(index.build(reader(mp3), mp3.size()));
+  assert(index.frameCount() == 5);
+  assert(!index.hasGaplessInfo());
+  assert(index.primingSamples() == 0);
+  assert(index.validSamples() == 5 * 1152);
+
+  std::vector<uint8_t> junk(2000, 0x55);
+  assert(!index.build(reader(junk), junk.size()));
+}
+
+uint16_t reservoirPattern(uint32_t i) {
+  // Frame 20 borrows 500 bytes (more than one frame's payload); frame 18
+  // borrows 450, more than frame 17 alone provides
+  switch (i) {
+  case 18:
+    return 450;
+  case 19:
+    return 0;
+  case 20:
+    return 500;
+  default:
+    return 0;
+  }
+}
+
+TEST_CASE(test_plan_seek_accounts_for_reservoir) {
+  std::vector<uint8_t> mp3 = makeMp3(40, true, reservoirPattern);
+  Mp3Index index;
+  assert(index.build(reader(mp3), mp3.size()));
+  assert(index.mainDataBegin(20) == 500);
+
+  // Frame 20 needs 500 bytes: frames 19 and 18 (381 each), then one more
+  // for the IMDCT overlap. Of 17, 18, 19 a fresh decoder drops 18.
+  Mp3SeekPlan plan;
+  assert(index.planSeek(20 * 1152 + 100, plan));
+  assert(plan.frame == 17);
+  assert(plan.byteOffset == index.frameOffset(17));
+  assert(plan.outputSample == (20 - 2) * 1152);
+
+  // No reservoir use: just the overlap frame
+  assert(index.planSeek(5 * 1152, plan));
+  assert(plan.frame == 4);
+  assert(plan.outputSample == 4 * 1152);
+
+  assert(index.planSeek(0, plan));
+  assert(plan.frame == 0 && plan.outputSample == 0);
+  assert(!index.planSeek(40 * 1152, plan));
+}
+
+TEST_CASE(test_serialize_roundtrip) {
+  std::vector<uint8_t> mp3 = makeMp3(12, true, reservoirPattern);
+  Mp3Index index;
+  assert(index.build(reader(mp3), mp3.size()));
+  std::vector<uint8_t> bytes = index.serialize();
+  assert(bytes.size() == 28 + 4 * 12);
+
+  Mp3Index copy;
+  assert(copy.deserialize(bytes.data(), bytes.size()));
+  assert(copy.frameCount() == 12);
+  assert(copy.sourceSize() == mp3.size());
+  assert(copy.encoderDelay() == 576 && copy.encoderPadding() == 1500);
+  for (uint32_t i = 0; i < 12; i++) {
+    assert(copy.frameOffset(i) == index.frameOffset(i));
+    assert(copy.mainDataBegin(i) == index.mainDataBegin(i));
+  }
+
+  bytes.pop_back();
+  assert(!copy.deserialize(bytes.data(), bytes.size()));
+  assert(!copy.valid());
+}
+
+int main() {
+  RUN_TEST(test_parse_frame_header);
+  RUN_TEST(test_build_skips_tags_and_reads_gapless_info);
+  RUN_TEST(test_build_without_info_frame);
+  RUN_TEST(test_plan_seek_accounts_for_reservoir);
+  RUN_TEST(test_serialize_roundtrip);
+  std::cout << "All Mp3Index tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,158 @@
+// clang-format off
+// TEST_SOURCES: src/PerfMonitor.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "PerfMonitor.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+class Blob : public Print {
+public:
+  std::vector<uint8_t> bytes;
+  size_t write(uint8_t c) override {
+    bytes.push_back(c);
+    return 1;
+  }
+  size_t write(const uint8_t *data, size_t len) override {
+    bytes.insert(bytes.end(), data, data + len);
+    return len;
+  }
+};
+
+struct Decoded {
+  PerfHeader header;
+  std::vector<PerfLoopRecord> loops;
+};
+
+Decoded decode(const Blob &blob) {
+  Decoded d;
+  memcpy(&d.header, blob.bytes.data(), sizeof(d.header));
+  assert(d.header.magic == PERF_MAGIC);
+  assert(d.header.version == PERF_VERSION);
+  assert(d.header.buckets == PerfHistogram::BUCKETS);
+  assert(d.header.tasks == 0); // No run-time stats on the host
+  d.loops.resize(d.header.count - d.header.tasks);
+  memcpy(d.loops.data(), blob.bytes.data() + sizeof(d.header),
+         d.loops.size() * sizeof(PerfLoopRecord));
+  assert(sizeof(d.header) + d.loops.size() * sizeof(PerfLoopRecord) ==
+         blob.bytes.size());
+  return d;
+}
+
+const PerfLoopRecord *find(const Decoded &d, const char *name) {
+  for (const auto &l : d.loops)
+    if (strncmp(l.name, name, sizeof(l.name)) == 0)
+      return &l;
+  return nullptr;
+}
+
+// `n` iterations, one every `periodMs`, each busy for `busyMs`
+void run(PerfLoop &loop, int n, uint32_t periodMs, uint32_t busyMs) {
+  for (int i = 0; i < n; i++) {
+    {
+      PerfScope perf(loop);
+      _mockMillis += busyMs;
+    }
+    _mockMillis += periodMs - busyMs;
+  }
+}
+} // namespace
+
+TEST_CASE(test_buckets) {
+  // Each bucket takes from its own edge up to the next one's
+  for (uint8_t b = 0; b < PerfHistogram::BUCKETS; b++) {
+    assert(PerfHistogram::bucketOf(perfBucketLowUs(b)) == b);
+    if (b + 1 < PerfHistogram::BUCKETS)
+      assert(PerfHistogram::bucketOf(perfBucketLowUs(b + 1) - 1) == b);
+  }
+  assert(perfBucketLowUs(9) == 24);
+  assert(PerfHistogram::bucketOf(20000) == 28); // 16384..24575
+  assert(PerfHistogram::bucketOf(UINT32_MAX) == PerfHistogram::BUCKETS - 1);
+}
+
+TEST_CASE(test_loop_timing) {
+  PerfMonitor &perf = PerfMonitor::getInstance();
+  _mockMillis = 1000;
+  perf.start();
+  PerfLoop &loop = perf.loop("Motor");
+  assert(&perf.loop("Motor") == &loop);
+
+  run(loop, 50, 20, 3); // A second of a 50 Hz loop
+  perf.sample();
+
+  Blob blob;
+  assert(perf.write(blob));
+  assert(blob.bytes.size() == perf.size());
+  Decoded d = decode(blob);
+  assert(d.header.windowMs == 1000);
+  const PerfLoopRecord *r = find(d, "Motor");
+  assert(r);
+  // The first iteration has no period to measure
+  assert(r->period.count == 49);
+  assert(r->period.buckets[PerfHistogram::bucketOf(20000)] == 49);
+  assert(r->period.meanUs == 20000.0f);
+  assert(r->busy.count == 50);
+  assert(r->busy.buckets[PerfHistogram::bucketOf(3000)] == 50);
+  assert(r->busy.maxUs == 3000.0f);
+  assert(r->loadPermille == 150);
+
+  // A slow iteration moves the maximum but not the next window's mean much
+  run(loop, 1, 20, 12);
+  run(loop, 49, 20, 3);
+  perf.sample();
+  blob.bytes.clear();
+  perf.write(blob);
+  r = find(decode(blob), "Motor");
+  assert(r->busy.count == 100);
+  assert(r->busy.maxUs == 12000.0f);
+  assert(r->busy.meanUs == 3180.0f);
+  assert(r->loadPermille == 159);
+
+  perf.reset();
+  blob.bytes.clear();
+  perf.write(blob);
+  r = find(decode(blob), "Motor");
+  assert(r->period.count == 0 && r->busy.count == 0);
+  assert(r->busy.maxUs == 0.0f);
+}
+
+TEST_CASE(test_loop_limit) {
+  PerfMonitor &perf = PerfMonitor::getInstance();
+  const char *names[] = {"L1", "L2", "L3", "L4", "L5", "L6", "L7", "L8"};
+  for (const char *name : names)
+    perf.loop(name);
+  // Past MAX_LOOPS: still something to time, but not reported
+  PerfLoop &spare = perf.loop("Extra");
+  assert(strcmp(spare.name(), "Extra") != 0);
+  run(spare, 3, 10, 1);
+
+  Blob blob;
+  perf.write(blob);
+  Decoded d = decode(blob);
+  assert(d.loops.size() == PerfMonitor::MAX_LOOPS);
+  assert(find(d, "Motor") && find(d, "L7") && !find(d, "L8"));
+}
+
+TEST_CASE(test_json) {
+  JsonDocument doc;
+  PerfMonitor::getInstance().getStatus(doc.to<JsonObject>());
+  assert((int)doc["window_ms"] == 1000);
+}
+
+int main() {
+  RUN_TEST(test_buckets);
+  RUN_TEST(test_loop_timing);
+  RUN_TEST(test_loop_limit);
+  RUN_TEST(test_json);
+  std::cout << "All PerfMonitor tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,89 @@
+// clang-format off
+// TEST_SOURCES: src/RequestArena.cpp
+// clang-format on
+
+#include "RequestArena.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+TEST_CASE(test_allocations_bump_and_reset) {
+  RequestArena arena(1024);
+  void *a = arena.allocate(10);
+  void *b = arena.allocate(30);
+  assert(a && b && b > a);
+  assert((uintptr_t)b % alignof(std::max_align_t) == 0);
+  size_t used = arena.used();
+  assert(used >= 40 && used < 1024);
+
+  arena.deallocate(a); // Not the last block: kept until reset
+  assert(arena.used() == used);
+  arena.reset();
+  assert(arena.used() == 0);
+  assert(arena.allocate(10) == a); // The same space again
+  assert(arena.peak() == used);
+  assert(arena.overflows() == 0);
+}
+
+TEST_CASE(test_last_block_is_returned_and_grows_in_place) {
+  RequestArena arena(1024);
+  void *a = arena.allocate(16);
+  size_t afterA = arena.used();
+  void *b = arena.allocate(16);
+  memset(b, 0x5a, 16);
+
+  // A growing string or pool stays where it is
+  assert(arena.reallocate(b, 200) == b);
+  assert(((uint8_t *)b)[15] == 0x5a);
+  assert(arena.reallocate(b, 8) == b); // And shrinks too
+  arena.deallocate(b);
+  assert(arena.used() == afterA);
+
+  // An earlier block moves, keeping its content
+  memset(a, 0x33, 16);
+  arena.allocate(16);
+  void *moved = arena.reallocate(a, 64);
+  assert(moved != a && ((uint8_t *)moved)[15] == 0x33);
+}
+
+TEST_CASE(test_overflow_spills_to_the_heap) {
+  RequestArena arena(128);
+  void *big = arena.allocate(512);
+  assert(big != nullptr);
+  assert(arena.overflows() == 1);
+  assert(arena.used() == 0);
+  memset(big, 1, 512);
+  big = arena.reallocate(big, 1024); // Still the heap's
+  assert(big != nullptr);
+  arena.deallocate(big);
+
+  // A block in the region that outgrows it moves out
+  void *small = arena.allocate(32);
+  memset(small, 7, 32);
+  void *grown = arena.reallocate(small, 4096);
+  assert(grown != small && ((uint8_t *)grown)[31] == 7);
+  arena.deallocate(grown);
+  assert(arena.overflows() == 2);
+}
+
+TEST_CASE(test_zero_capacity_is_the_plain_heap) {
+  RequestArena heap(0);
+  void *p = heap.allocate(64);
+  assert(p != nullptr && heap.capacity() == 0);
+  heap.deallocate(p);
+}
+
+int main() {
+  RUN_TEST(test_allocations_bump_and_reset);
+  RUN_TEST(test_last_block_is_returned_and_grows_in_place);
+  RUN_TEST(test_overflow_spills_to_the_heap);
+  RUN_TEST(test_zero_capacity_is_the_plain_heap);
+  std::cout << "All RequestArena tests passed!" << std::endl;
+  return 0;
+}
@@ -1,5 +1,5 @@
 // clang-format off
-// TEST_SOURCES: src/ConnectivityManager.cpp src/BootLoopDetector.cpp tests/mocks/mocks.cpp
+// TEST_SOURCES: src/ConnectivityManager.cpp src/BootLoopDetector.cpp src/Mp3Index.cpp src/Mp3Sidecar.cpp src/AudioPrefetcher.cpp src/AudioTranscoder.cpp src/ImaAdpcm.cpp src/SoundManifest.cpp src/SoundPack.cpp src/PerfMonitor.cpp src/BootTimeline.cpp src/LatencyMonitor.cpp src/TraceRecorder.cpp tests/mocks/mocks.cpp
 // clang-format on
 #include <cassert>
 #include <iostream>
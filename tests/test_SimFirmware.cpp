@@ -0,0 +1,144 @@
+// clang-format off
+// TEST_SOURCES: src/MotorTask.cpp src/TelemetryStream.cpp src/Telemetry.cpp src/MotorCapture.cpp src/Logger.cpp src/BemfEstimator.cpp src/DspFilters.cpp src/RippleDetector.cpp src/PerfMonitor.cpp src/BootTimeline.cpp src/LatencyMonitor.cpp src/TraceRecorder.cpp tests/mocks/MotorHal_mock.cpp tests/mocks/mocks.cpp tests/sim/SimKernel.cpp
+// TEST_FLAGS: -Itests/sim -DNIMRS_SIM -DUNIT_TEST -DSKIP_MOCK_MOTOR_CONTROLLER -DSKIP_MOCK_LOGGER
+// clang-format on
+
+// The motor, telemetry and logger tasks, as built for the target, run
+// together on the simulator: their schedule and latencies are what the
+// decoder's would be, with CPU costs from the model below.
+
+#include "LatencyMonitor.h"
+#include "Logger.h"
+#include "MotorTask.h"
+#include "TelemetryStream.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+SimKernel &sim() { return SimKernel::getInstance(); }
+
+std::vector<TelemetryFrame> frames;
+uint32_t dropped = 0;
+volatile uint8_t command = 0; // Speed step for the control plane to apply
+volatile uint32_t cause = 0;   // And the causality ID it carries
+
+bool receive(int fd, const uint8_t *data, size_t len) {
+  TelemetryBatch batch;
+  memcpy(&batch, data, sizeof(batch));
+  assert(len == sizeof(batch) + batch.count * sizeof(TelemetryFrame));
+  for (uint8_t i = 0; i < batch.count; i++) {
+    TelemetryFrame f;
+    memcpy(&f, data + sizeof(batch) + i * sizeof(f), sizeof(f));
+    frames.push_back(f);
+  }
+  dropped = batch.dropped;
+  return true;
+}
+
+// Stand-ins for main.cpp's tasks, which pull in the network stack
+void controlPlane(void *) {
+  for (;;) {
+    MotorTask::getInstance().setTargetSpeed(command, true, cause);
+    cause = 0;
+    vTaskDelay(pdMS_TO_TICKS(1));
+  }
+}
+
+void arduinoLoop(void *) {
+  for (;;) {
+    Log.printf("loop at %lu ms\n", millis());
+    vTaskDelay(pdMS_TO_TICKS(100));
+  }
+}
+
+void boot() {
+  static bool booted = false;
+  if (booted)
+    return;
+  booted = true;
+  // In app_main's order
+  Log.startTask();
+  MotorTask::getInstance().start();
+  TelemetryStream::getInstance().startTask(receive);
+  TelemetryStream::getInstance().addClient(1, 1);
+  xTaskCreatePinnedToCore(controlPlane, "ControlPlane", 16384, NULL, 5, NULL,
+                          0);
+  xTaskCreateUniversal(arduinoLoop, "loopTask", 8192, NULL, 1, NULL, 1);
+}
+} // namespace
+
+TEST_CASE(test_tasks_keep_their_periods) {
+  boot();
+  sim().run(10 * 1000000);
+
+  TaskHandle_t motor = sim().find("MotorTask");
+  TaskHandle_t logger = sim().find("LoggerTask");
+  assert(motor && logger && sim().find("Telemetry"));
+  // 50 Hz, never late: nothing outranks it on core 1
+  assert(sim().stats(motor).activations == 1 + 500);
+  assert(sim().stats(motor).maxLatencyUs == 0);
+  // One wakeup per line the loop logged
+  assert(sim().stats(logger).activations == 1 + 101);
+
+  // Every control tick reached the client, in order, 20 ms apart
+  assert(frames.size() == 500 && dropped == 0);
+  for (size_t i = 1; i < frames.size(); i++) {
+    assert(frames[i].seq == frames[i - 1].seq + 1);
+    assert(frames[i].timeUs - frames[i - 1].timeUs == 20000);
+  }
+}
+
+TEST_CASE(test_command_reaches_the_wire_within_a_tick) {
+  boot();
+  frames.clear();
+  uint32_t sent = micros();
+  command = 40;
+  cause = LatencyMonitor::getInstance().stamp();
+  sim().run(100000);
+  auto first = frames.begin();
+  while (first != frames.end() && first->target != 40)
+    ++first;
+  assert(first != frames.end());
+  assert(first->timeUs - sent <= 20000);
+
+  // The same, as the motor task timed it
+  LatencySummary latency =
+      LatencyMonitor::getInstance().summary(LATENCY_SPEED);
+  assert(latency.count == 1);
+  assert(latency.maxUs <= 20000 && latency.maxUs <= first->timeUs - sent);
+}
+
+TEST_CASE(test_motor_cost_delays_core_1_only) {
+  boot();
+  TaskHandle_t motor = sim().find("MotorTask");
+  TaskHandle_t loop = sim().find("loopTask");
+  TaskHandle_t control = sim().find("ControlPlane");
+  assert(sim().stats(loop).maxLatencyUs == 0);
+
+  // 5 ms per motor tick. The loop wakes every 100 ms, on a motor tick, on
+  // the same core, so it waits those 5 ms; core 0 does not notice.
+  sim().setRunCost(motor, 5000);
+  sim().run(10 * 1000000);
+  sim().report();
+  assert(sim().stats(loop).maxLatencyUs == 5000);
+  assert(sim().stats(sim().find("LoggerTask")).maxLatencyUs == 0);
+  assert(sim().stats(control).maxLatencyUs == 0);
+  assert(sim().stats(motor).maxLatencyUs == 0);
+  sim().setRunCost(motor, 0);
+}
+
+int main() {
+  RUN_TEST(test_tasks_keep_their_periods);
+  RUN_TEST(test_command_reaches_the_wire_within_a_tick);
+  RUN_TEST(test_motor_cost_delays_core_1_only);
+  std::cout << "All SimFirmware tests passed!" << std::endl;
+  return 0;
+}
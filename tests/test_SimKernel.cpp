@@ -0,0 +1,242 @@
+// clang-format off
+// TEST_SOURCES: tests/sim/SimKernel.cpp tests/mocks/mocks.cpp
+// TEST_FLAGS: -Itests/sim -DNIMRS_SIM
+// clang-format on
+
+#include <Arduino.h>
+#include <cassert>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/stream_buffer.h>
+#include <freertos/task.h>
+#include <freertos/timers.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  SimKernel::getInstance().reset();                                            \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+SimKernel &sim() { return SimKernel::getInstance(); }
+
+std::vector<std::string> trace; // "<ms> <event>"
+void note(const char *event) {
+  trace.push_back(std::to_string(millis()) + " " + event);
+}
+
+void periodic(void *) {
+  TickType_t last = xTaskGetTickCount();
+  for (;;) {
+    vTaskDelayUntil(&last, pdMS_TO_TICKS(20));
+    note("tick");
+    sim().busy(2000);
+  }
+}
+
+void hog(void *) {
+  note("hog start");
+  sim().busy(50000); // 50 ms of work
+  note("hog done");
+  vTaskDelete(NULL);
+}
+} // namespace
+
+TEST_CASE(test_priority_preempts_busy_work) {
+  trace.clear();
+  xTaskCreatePinnedToCore(hog, "hog", 2048, NULL, 1, NULL, 1);
+  xTaskCreatePinnedToCore(periodic, "periodic", 2048, NULL, 10, NULL, 1);
+  sim().run(100000);
+
+  // The 50 ms of work loses 2 ms at 20 and 40 ms, so it ends at 54
+  std::vector<std::string> expect = {"0 hog start", "20 tick", "40 tick",
+                                     "54 hog done", "60 tick", "80 tick",
+                                     "100 tick"};
+  assert(trace == expect);
+  TaskHandle_t p = sim().find("periodic");
+  assert(sim().stats(p).activations == 6); // The first call, then 5 ticks
+  assert(sim().stats(p).maxLatencyUs == 0);
+  assert(sim().stats(p).busyUs == 5 * 2000);
+}
+
+TEST_CASE(test_affinity_and_idle_cores) {
+  trace.clear();
+  // Pinned to core 1: waits behind the hog, though core 0 is free
+  xTaskCreatePinnedToCore(hog, "hog", 2048, NULL, 5, NULL, 1);
+  xTaskCreatePinnedToCore(
+      [](void *) {
+        note(xPortGetCoreID() == 1 ? "pinned on 1" : "pinned elsewhere");
+        vTaskDelete(NULL);
+      },
+      "pinned", 2048, NULL, 1, NULL, 1);
+  // Free to run anywhere: takes core 0 at once
+  xTaskCreate(
+      [](void *) {
+        note(xPortGetCoreID() == 0 ? "free on 0" : "free elsewhere");
+        vTaskDelete(NULL);
+      },
+      "free", 2048, NULL, 1, NULL);
+  sim().run(60000);
+  std::vector<std::string> expect = {"0 free on 0", "0 hog start",
+                                     "50 hog done", "50 pinned on 1"};
+  assert(trace == expect);
+}
+
+TEST_CASE(test_queue_blocks_and_times_out) {
+  static QueueHandle_t q;
+  static std::vector<int> got;
+  static int timeouts;
+  q = xQueueCreate(2, sizeof(int));
+  got.clear();
+  timeouts = 0;
+  xTaskCreatePinnedToCore(
+      [](void *) {
+        for (;;) {
+          int v;
+          if (xQueueReceive(q, &v, pdMS_TO_TICKS(15)) == pdTRUE)
+            got.push_back(v * 1000 + (int)millis());
+          else
+            timeouts++;
+        }
+      },
+      "consumer", 2048, NULL, 3, NULL, 0);
+  xTaskCreatePinnedToCore(
+      [](void *) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        for (int i = 1; i <= 3; i++)
+          xQueueSend(q, &i, portMAX_DELAY);
+        vTaskDelete(NULL);
+      },
+      "producer", 2048, NULL, 2, NULL, 1);
+  sim().run(40000);
+  // Each send wakes the consumer on the other core at once
+  std::vector<int> expect = {1010, 2010, 3010};
+  assert(got == expect);
+  assert(timeouts == 2); // At 25 and 40 ms
+  assert(uxQueueMessagesWaiting(q) == 0 && uxQueueSpacesAvailable(q) == 2);
+}
+
+TEST_CASE(test_mutex_inherits_priority) {
+  static SemaphoreHandle_t m;
+  trace.clear();
+  m = xSemaphoreCreateMutex();
+  // Low takes the mutex for 10 ms; high wants it at 2 ms; medium would run
+  // 20 ms from 3 ms and, without inheritance, keep low (and high) waiting
+  xTaskCreatePinnedToCore(
+      [](void *) {
+        xSemaphoreTake(m, portMAX_DELAY);
+        sim().busy(10000);
+        note("low gives");
+        xSemaphoreGive(m);
+        vTaskDelete(NULL);
+      },
+      "low", 2048, NULL, 1, NULL, 1);
+  xTaskCreatePinnedToCore(
+      [](void *) {
+        vTaskDelay(2);
+        xSemaphoreTake(m, portMAX_DELAY);
+        note("high takes");
+        xSemaphoreGive(m);
+        vTaskDelete(NULL);
+      },
+      "high", 2048, NULL, 10, NULL, 1);
+  xTaskCreatePinnedToCore(
+      [](void *) {
+        vTaskDelay(3);
+        sim().busy(20000);
+        note("medium done");
+        vTaskDelete(NULL);
+      },
+      "medium", 2048, NULL, 5, NULL, 1);
+  sim().run(50000);
+  std::vector<std::string> expect = {"10 low gives", "10 high takes",
+                                     "30 medium done"};
+  assert(trace == expect);
+  assert(xSemaphoreGetMutexHolder(m) == nullptr);
+}
+
+TEST_CASE(test_isr_feeds_stream_buffer_and_notifies) {
+  static StreamBufferHandle_t s;
+  static TaskHandle_t waiter;
+  static size_t received;
+  static uint32_t notified;
+  s = xStreamBufferCreate(64 * sizeof(float), sizeof(float));
+  received = 0;
+  notified = 0;
+  xTaskCreatePinnedToCore(
+      [](void *) {
+        float buf[64];
+        TickType_t last = xTaskGetTickCount();
+        for (;;) {
+          vTaskDelayUntil(&last, pdMS_TO_TICKS(20));
+          received += xStreamBufferReceive(s, buf, sizeof(buf), 0);
+        }
+      },
+      "reader", 2048, NULL, 10, NULL, 1);
+  xTaskCreatePinnedToCore(
+      [](void *) {
+        for (;;)
+          notified += ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      },
+      "waiter", 2048, NULL, 2, &waiter, 0);
+  // A 1 kHz "ADC interrupt", and a 10 Hz one that notifies
+  sim().every(1000, [] {
+    float v = 1.0f;
+    xStreamBufferSendFromISR(s, &v, sizeof(v), NULL);
+  });
+  sim().every(100000, [] { vTaskNotifyGiveFromISR(waiter, NULL); });
+  sim().run(1000000);
+  assert(received == 1000 * sizeof(float));
+  assert(notified == 10);
+  assert(sim().stats(waiter).activations == 11);
+}
+
+TEST_CASE(test_timers_run_on_the_service_task) {
+  static int fired;
+  static std::string where;
+  fired = 0;
+  TimerHandle_t t = xTimerCreate(
+      "t", pdMS_TO_TICKS(100), pdTRUE, (void *)&fired, [](TimerHandle_t t) {
+        (*(int *)pvTimerGetTimerID(t))++;
+        where = pcTaskGetName(NULL);
+      });
+  xTimerStart(t, 0);
+  sim().run(350000);
+  assert(fired == 3 && where == "Tmr Svc");
+  xTimerStop(t, 0);
+  assert(!xTimerIsTimerActive(t));
+  sim().run(200000);
+  assert(fired == 3);
+}
+
+TEST_CASE(test_runs_are_deterministic) {
+  std::vector<std::string> first;
+  for (int run = 0; run < 2; run++) {
+    sim().reset();
+    trace.clear();
+    xTaskCreatePinnedToCore(hog, "hog", 2048, NULL, 1, NULL, 1);
+    xTaskCreatePinnedToCore(periodic, "periodic", 2048, NULL, 10, NULL, 1);
+    xTaskCreate(periodic, "anywhere", 2048, NULL, 10, NULL);
+    sim().run(500000);
+    if (run == 0)
+      first = trace;
+  }
+  assert(trace == first && trace.size() > 40);
+}
+
+int main() {
+  RUN_TEST(test_priority_preempts_busy_work);
+  RUN_TEST(test_affinity_and_idle_cores);
+  RUN_TEST(test_queue_blocks_and_times_out);
+  RUN_TEST(test_mutex_inherits_priority);
+  RUN_TEST(test_isr_feeds_stream_buffer_and_notifies);
+  RUN_TEST(test_timers_run_on_the_service_task);
+  RUN_TEST(test_runs_are_deterministic);
+  std::cout << "All SimKernel tests passed!" << std::endl;
+  return 0;
+}
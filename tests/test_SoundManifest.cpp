@@ -0,0 +1,151 @@
+// clang-format off
+// TEST_SOURCES: src/SoundManifest.cpp src/Mp3Index.cpp src/Mp3Sidecar.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "AudioUtils.h"
+#include "LittleFS.h"
+#include "SoundManifest.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+std::vector<SoundAsset> sampleAssets() {
+  SoundAsset horn;
+  horn.id = 1;
+  horn.name = "Horn";
+  horn.type = SoundType::COMPLEX_LOOP;
+  horn.fileIntro = "/horn_start.wav";
+  horn.fileLoop = "/horn_loop.wav";
+  horn.fileOutro = "/horn_end.wav";
+  horn.loopStart = 100;
+  horn.loopEnd = 9000;
+
+  SoundAsset bell;
+  bell.id = 2;
+  bell.name = "Bell";
+  bell.type = SoundType::TOGGLE;
+  bell.fileLoop = "/horn_loop.wav"; // Shared with the horn
+
+  SoundAsset engine;
+  engine.id = 20;
+  engine.name = "Prime Mover";
+  engine.type = SoundType::DIESEL;
+  engine.fileIntro = "/start.wav";
+  engine.notches = {"/idle.wav", "/n1.wav", "/n2.wav"};
+  engine.notchUp = {"/up0.wav"}; // Short list: the rest stays empty
+  engine.crossfadeMs = 300;
+  return {horn, bell, engine};
+}
+
+void setCrc(std::vector<uint8_t> &bin) {
+  uint32_t crc = audioCrc32(bin.data() + SoundManifest::HEADER_SIZE,
+                            bin.size() - SoundManifest::HEADER_SIZE);
+  for (int i = 0; i < 4; i++)
+    bin[16 + i] = crc >> (8 * i);
+}
+} // namespace
+
+TEST_CASE(test_roundtrip_interns_strings) {
+  std::vector<uint8_t> bin;
+  String error;
+  assert(SoundManifest::encode(sampleAssets(), 1234, bin, error));
+
+  // 3 fixed records, 3 + 2 + 2 list entries, and the shared loop file once
+  size_t strings = bin[8] | (bin[9] << 8);
+  assert(bin.size() == SoundManifest::HEADER_SIZE +
+                           3 * SoundManifest::RECORD_SIZE + 7 * 2 + strings);
+  std::string table((const char *)bin.data() + bin.size() - strings, strings);
+  assert(table.find("/horn_loop.wav") == table.rfind("/horn_loop.wav"));
+
+  std::vector<SoundAsset> out;
+  assert(SoundManifest::decode(bin.data(), bin.size(), out));
+  assert(out.size() == 3);
+  assert(out[0].id == 1 && out[0].name == "Horn");
+  assert(out[0].type == SoundType::COMPLEX_LOOP);
+  assert(out[0].fileIntro == "/horn_start.wav");
+  assert(out[0].fileOutro == "/horn_end.wav");
+  assert(out[0].loopStart == 100 && out[0].loopEnd == 9000);
+  assert(out[1].fileIntro.length() == 0 && out[1].fileLoop == "/horn_loop.wav");
+  assert(out[1].notches.empty());
+
+  const SoundAsset &engine = out[2];
+  assert(engine.type == SoundType::DIESEL && engine.crossfadeMs == 300);
+  assert(engine.notches.size() == 3 && engine.notches[2] == "/n2.wav");
+  assert(engine.notchUp.size() == 2 && engine.notchUp[0] == "/up0.wav");
+  assert(engine.notchUp[1].length() == 0);
+  assert(engine.notchDown.size() == 2 && engine.notchDown[0].length() == 0);
+}
+
+TEST_CASE(test_rejects_damaged_manifest) {
+  std::vector<uint8_t> bin;
+  String error;
+  assert(SoundManifest::encode(sampleAssets(), 1234, bin, error));
+  std::vector<SoundAsset> out;
+
+  std::vector<uint8_t> bad = bin;
+  bad[SoundManifest::HEADER_SIZE + 1] ^= 1; // Payload no longer matches CRC
+  assert(!SoundManifest::decode(bad.data(), bad.size(), out));
+
+  bad = bin;
+  bad[4] = SoundManifest::VERSION + 1;
+  assert(!SoundManifest::decode(bad.data(), bad.size(), out));
+
+  assert(!SoundManifest::decode(bin.data(), bin.size() - 1, out));
+  assert(!SoundManifest::decode(bin.data(), 8, out));
+
+  // A name offset past the table, with a valid CRC
+  bad = bin;
+  bad[SoundManifest::HEADER_SIZE + 4] = 0xF0;
+  bad[SoundManifest::HEADER_SIZE + 5] = 0x0F;
+  setCrc(bad);
+  assert(!SoundManifest::decode(bad.data(), bad.size(), out));
+  assert(out.empty());
+
+  // Notch lists that run past the list table
+  bad = bin;
+  bad[SoundManifest::HEADER_SIZE + 2 * SoundManifest::RECORD_SIZE + 22] = 4;
+  setCrc(bad);
+  assert(!SoundManifest::decode(bad.data(), bad.size(), out));
+}
+
+TEST_CASE(test_load_reads_once_and_tracks_source) {
+  LittleFS.mockFiles.clear();
+  std::vector<uint8_t> bin;
+  String error;
+  std::vector<uint8_t> json(1234, ' ');
+  assert(SoundManifest::encode(sampleAssets(), json.size(), bin, error));
+
+  // No JSON: nothing to compile, whatever the manifest says
+  assert(!SoundManifest::stale());
+  LittleFS.mockFiles.push_back(File(SoundManifest::JSON_PATH, json));
+  assert(SoundManifest::stale()); // No manifest yet
+  LittleFS.mockFiles.push_back(File(SoundManifest::PATH, bin));
+  assert(!SoundManifest::stale());
+
+  LittleFS.callCount_open = 0;
+  std::vector<SoundAsset> out;
+  assert(SoundManifest::load(out) && out.size() == 3);
+  assert(LittleFS.callCount_open == 1);
+
+  // A JSON of another size replaced behind the firmware's back
+  LittleFS.remove(SoundManifest::JSON_PATH);
+  json.push_back('\n');
+  LittleFS.mockFiles.push_back(File(SoundManifest::JSON_PATH, json));
+  assert(SoundManifest::stale());
+}
+
+int main() {
+  RUN_TEST(test_roundtrip_interns_strings);
+  RUN_TEST(test_rejects_damaged_manifest);
+  RUN_TEST(test_load_reads_once_and_tracks_source);
+  std::cout << "All SoundManifest tests passed!" << std::endl;
+  return 0;
+}
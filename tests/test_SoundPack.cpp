@@ -0,0 +1,193 @@
+// clang-format off
+// TEST_SOURCES: src/SoundPack.cpp src/AudioVoice.cpp src/AudioPrefetcher.cpp src/AudioTranscoder.cpp src/ImaAdpcm.cpp src/Mp3Index.cpp src/Mp3Sidecar.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "AudioFixtures.h"
+#include "AudioVoice.h"
+#include "LittleFS.h"
+#include "SoundPack.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+using namespace AudioFixtures;
+
+// Three frames of constant main data
+std::vector<uint8_t> makeMp3() {
+  std::vector<uint8_t> mp3;
+  for (int i = 0; i < 3; i++)
+    putMp3Frame(mp3, 0x11);
+  return mp3;
+}
+
+// A whistle with a sustain loop and a bell that reuses the whistle's outro
+// file
+std::vector<uint8_t> makePack(const std::vector<PackFile> &files,
+                              uint32_t badOffset = 0) {
+  const uint16_t none = SoundPack::NO_FILE;
+  return AudioFixtures::makePack(
+      files,
+      {{1, SoundType::COMPLEX_LOOP, 0, 1, 2, 10, 90, "Steam Whistle"},
+       {7, SoundType::TOGGLE, none, 2, none, 0, 0, "Bell"}},
+      badOffset);
+}
+
+std::vector<PackFile> defaultFiles() {
+  return {{"start.wav", AudioCodec::WAV_PCM, rampWav(1000, 100)},
+          {"hold.mp3", AudioCodec::MP3, makeMp3()},
+          {"end.wav", AudioCodec::WAV_PCM, rampWav(5000, 51)}};
+}
+
+bool installInChunks(const std::vector<uint8_t> &pack, size_t chunk) {
+  SoundPack &sp = SoundPack::getInstance();
+  if (!sp.beginInstall())
+    return false;
+  for (size_t at = 0; at < pack.size(); at += chunk) {
+    size_t n = std::min(chunk, pack.size() - at);
+    if (!sp.writeInstall(pack.data() + at, n))
+      return false;
+  }
+  return sp.endInstall();
+}
+} // namespace
+
+TEST_CASE(test_load_reads_tables) {
+  std::vector<uint8_t> pack = makePack(defaultFiles());
+  SoundPack &sp = SoundPack::getInstance();
+  assert(sp.load(pack.data(), pack.size()));
+  assert(sp.mounted());
+  assert(sp.size() == pack.size());
+
+  assert(sp.assets().size() == 2);
+  const SoundAsset &whistle = sp.assets()[0];
+  assert(whistle.id == 1);
+  assert(whistle.type == SoundType::COMPLEX_LOOP);
+  assert(whistle.name == "Steam Whistle");
+  assert(whistle.fileIntro == "pack:start.wav");
+  assert(whistle.fileLoop == "pack:hold.mp3");
+  assert(whistle.fileOutro == "pack:end.wav");
+  assert(whistle.loopStart == 10 && whistle.loopEnd == 90);
+  const SoundAsset &bell = sp.assets()[1];
+  assert(bell.fileIntro.length() == 0);
+  assert(bell.fileLoop == "pack:end.wav");
+
+  // Entries point into the pack itself; MP3s come with their frame index
+  const SoundPack::Entry *wav = sp.find("pack:start.wav");
+  assert(wav && wav->codec == AudioCodec::WAV_PCM);
+  assert(wav->data >= pack.data() && wav->data + wav->size <= &pack.back() + 1);
+  assert(((wav->data - pack.data()) & 3) == 0);
+  assert(memcmp(wav->data, "RIFF", 4) == 0);
+  const SoundPack::Entry *mp3 = sp.find("pack:hold.mp3");
+  assert(mp3 && mp3->index.valid() && mp3->index.frameCount() == 3);
+
+  assert(!sp.find("pack:missing.wav"));
+  assert(!sp.find("/start.wav"));
+  sp.unmount();
+  assert(!sp.find("pack:start.wav"));
+}
+
+TEST_CASE(test_load_rejects_damage) {
+  SoundPack &sp = SoundPack::getInstance();
+  std::vector<uint8_t> pack = makePack(defaultFiles());
+
+  std::vector<uint8_t> flipped = pack;
+  flipped[pack.size() - 1] ^= 1;
+  assert(!sp.load(flipped.data(), flipped.size()));
+  assert(!sp.mounted());
+
+  assert(!sp.load(pack.data(), pack.size() - 1)); // Truncated
+
+  std::vector<uint8_t> old = pack;
+  old[4] = SoundPack::VERSION + 1;
+  assert(!sp.load(old.data(), old.size()));
+
+  std::vector<uint8_t> outside = makePack(defaultFiles(), 0x7FFFFFF0);
+  assert(!sp.load(outside.data(), outside.size()));
+  std::vector<uint8_t> intoTables = makePack(defaultFiles(), 8);
+  assert(!sp.load(intoTables.data(), intoTables.size()));
+}
+
+TEST_CASE(test_install_streams_into_partition) {
+  SoundPack &sp = SoundPack::getInstance();
+  std::fill(mockSoundsFlash.begin(), mockSoundsFlash.end(), 0xFF);
+  assert(!sp.mount()); // Blank partition
+
+  // Chunks that straddle erase blocks
+  std::vector<uint8_t> big = defaultFiles()[0].data;
+  big.resize(100000, 0x55);
+  std::vector<PackFile> files = defaultFiles();
+  files[2].data = big;
+  std::vector<uint8_t> pack = makePack(files);
+  assert(installInChunks(pack, 1460));
+  assert(sp.mounted());
+  assert(mockPartitionMapped == 1);
+  assert(memcmp(mockSoundsFlash.data(), pack.data(), pack.size()) == 0);
+
+  // Zero copy: entries point into the mapped flash
+  const SoundPack::Entry *end = sp.find("pack:end.wav");
+  assert(end && end->size == big.size());
+  assert(end->data > mockSoundsFlash.data() &&
+         end->data + end->size <= mockSoundsFlash.data() + pack.size());
+
+  // A new install drops the old pack as soon as it starts
+  std::vector<uint8_t> small = makePack(defaultFiles());
+  assert(sp.beginInstall());
+  assert(!sp.mounted() && mockPartitionMapped == 0);
+  assert(sp.writeInstall(small.data(), 100));
+  assert(!sp.mount());
+  assert(sp.beginInstall());
+  assert(sp.writeInstall(small.data(), small.size()));
+  assert(sp.endInstall());
+  assert(sp.find("pack:end.wav")->size == 51 * 2 + 44);
+
+  // Too large for the partition, or not a pack at all
+  std::vector<uint8_t> huge(mock_sounds.size + 1, 0);
+  assert(!installInChunks(huge, 4096));
+  assert(sp.installError() == "Pack larger than partition");
+  assert(!installInChunks(std::vector<uint8_t>(5000, 0x42), 4096));
+  assert(sp.installError() == "Invalid pack");
+  assert(!sp.mounted() && mockPartitionMapped == 0);
+}
+
+TEST_CASE(test_voice_plays_from_pack) {
+  SoundPack &sp = SoundPack::getInstance();
+  std::fill(mockSoundsFlash.begin(), mockSoundsFlash.end(), 0xFF);
+  assert(installInChunks(makePack(defaultFiles()), 4096));
+
+  LittleFS.mockFiles.clear();
+  LittleFS.callCount_open = 0;
+  AudioVoice voice;
+  assert(voice.startFile("pack:end.wav"));
+  std::vector<int32_t> out;
+  while (voice.active() && out.size() < 1000) {
+    voice.service();
+    int32_t acc[16] = {0};
+    size_t n = voice.mix(acc, 16, 44100);
+    out.insert(out.end(), acc, acc + n);
+  }
+  assert(out.size() == 51);
+  for (size_t i = 0; i < out.size(); i++)
+    assert(out[i] == 5000 + (int32_t)i);
+  assert(LittleFS.callCount_open == 0); // Never touched the file system
+
+  assert(!voice.startFile("pack:missing.wav"));
+  sp.unmount();
+  assert(!voice.startFile("pack:end.wav"));
+}
+
+int main() {
+  RUN_TEST(test_load_reads_tables);
+  RUN_TEST(test_load_rejects_damage);
+  RUN_TEST(test_install_streams_into_partition);
+  RUN_TEST(test_voice_plays_from_pack);
+  std::cout << "All SoundPack tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,122 @@
+// clang-format off
+// TEST_SOURCES: src/Telemetry.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "Telemetry.h"
+#include <cassert>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+TEST_CASE(test_channels_are_declared_once) {
+  Telemetry &t = Telemetry::getInstance();
+  Telemetry::Channel rpm = t.add("rpm", "rpm", TelemetryType::F32, 50);
+  assert(rpm != Telemetry::NONE);
+  assert(t.add("rpm", "rpm", TelemetryType::F32, 50) == rpm);
+  assert(t.find("rpm") == rpm);
+  assert(t.find("missing") == Telemetry::NONE);
+  assert(String(t.info(rpm).unit) == "rpm");
+  assert(t.info(rpm).rateHz == 50);
+}
+
+TEST_CASE(test_values_are_stored_as_their_type) {
+  Telemetry &t = Telemetry::getInstance();
+  Telemetry::Channel duty = t.add("duty", "", TelemetryType::F32, 50);
+  Telemetry::Channel step = t.add("step", "", TelemetryType::U8, 50);
+  Telemetry::Channel flag = t.add("flag", "", TelemetryType::BOOL, 50);
+
+  t.publish(duty, -0.25f);
+  assert(t.value(duty) == -0.25f);
+  t.publish(step, 300); // Clamped to the type
+  assert(t.raw(step) == 255);
+  t.publish(step, 12.6f);
+  assert(t.raw(step) == 13);
+  t.publish(step, -4);
+  assert(t.raw(step) == 0);
+  t.publish(flag, true);
+  assert(t.raw(flag) == 1 && t.value(flag) == 1.0f);
+
+  assert(t.updates(duty) == 1 && t.updates(step) == 3);
+  assert(t.value(Telemetry::NONE) == 0.0f); // Unknown channels read as 0
+  t.publish(Telemetry::NONE, 1.0f);         // and ignore publishes
+}
+
+TEST_CASE(test_subscriber_decimates_per_channel) {
+  Telemetry &t = Telemetry::getInstance();
+  Telemetry::Channel fast = t.add("fast", "", TelemetryType::U32, 100);
+  Telemetry::Channel slow = t.add("slow", "", TelemetryType::U32, 10);
+
+  Telemetry::Subscriber sink;
+  sink.subscribe(fast, 10);
+  sink.subscribe(slow, 1);
+
+  std::vector<Telemetry::Channel> got;
+  auto collect = [&](Telemetry::Channel c) { got.push_back(c); };
+  sink.poll(collect);
+  assert(got.empty()); // Nothing published since subscribing
+
+  for (uint32_t i = 0; i < 9; i++)
+    t.publish(fast, i);
+  t.publish(slow, 1u);
+  sink.poll(collect);
+  assert(got.size() == 1 && got[0] == slow);
+
+  got.clear();
+  t.publish(fast, 9u); // The tenth
+  sink.poll(collect);
+  assert(got.size() == 1 && got[0] == fast);
+  assert(t.raw(fast) == 9);
+
+  got.clear();
+  sink.subscribe(fast, 0); // Unsubscribed
+  for (uint32_t i = 0; i < 20; i++)
+    t.publish(fast, i);
+  sink.poll(collect);
+  assert(got.empty());
+}
+
+TEST_CASE(test_follow_takes_later_channels_by_rate) {
+  Telemetry &t = Telemetry::getInstance();
+  Telemetry::Subscriber sink;
+  sink.follow(10);
+
+  Telemetry::Channel late = t.add("late", "", TelemetryType::U32, 50);
+  int seen = 0;
+  auto count = [&](Telemetry::Channel c) { seen += c == late; };
+  sink.poll(count); // Adopts it, every 50 / 10 = 5th publish
+  for (uint32_t i = 0; i < 4; i++)
+    t.publish(late, i);
+  sink.poll(count);
+  assert(seen == 0);
+  t.publish(late, 4u);
+  sink.poll(count);
+  assert(seen == 1);
+}
+
+TEST_CASE(test_json_reports_every_channel) {
+  Telemetry &t = Telemetry::getInstance();
+  Telemetry::Channel flag = t.find("flag");
+  t.publish(flag, false);
+
+  JsonDocument values;
+  t.toJson(values.to<JsonObject>());
+  assert(values._data.size() == t.count());
+  assert(values._data["flag"].val == "false");
+  assert(values._data["step"].val == "0");
+  assert(String(Telemetry::typeName(TelemetryType::F32)) == "f32");
+}
+
+int main() {
+  RUN_TEST(test_channels_are_declared_once);
+  RUN_TEST(test_values_are_stored_as_their_type);
+  RUN_TEST(test_subscriber_decimates_per_channel);
+  RUN_TEST(test_follow_takes_later_channels_by_rate);
+  RUN_TEST(test_json_reports_every_channel);
+  std::cout << "All Telemetry tests passed!" << std::endl;
+  return 0;
+}
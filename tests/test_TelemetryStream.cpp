@@ -0,0 +1,167 @@
+// clang-format off
+// TEST_SOURCES: src/TelemetryStream.cpp src/Telemetry.cpp src/PerfMonitor.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "TelemetryStream.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+uint8_t message[TelemetryStream::MAX_MESSAGE];
+
+void publish(TelemetryStream &stream, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    TelemetryFrame f = {};
+    f.rpm = (float)i;
+    stream.publish(f);
+  }
+}
+
+// Decodes what encode() wrote
+std::vector<TelemetryFrame> frames(size_t len, TelemetryBatch *batch) {
+  memcpy(batch, message, sizeof(*batch));
+  assert(batch->magic == TELEMETRY_MAGIC);
+  assert(batch->version == TELEMETRY_VERSION);
+  assert(len == sizeof(*batch) + batch->count * sizeof(TelemetryFrame));
+  std::vector<TelemetryFrame> out(batch->count);
+  memcpy(out.data(), message + sizeof(*batch), len - sizeof(*batch));
+  return out;
+}
+
+void drain(TelemetryStream &stream) {
+  int fd;
+  for (uint8_t i = 0; i < TelemetryStream::MAX_CLIENTS; i++)
+    while (stream.encode(i, message, &fd) > 0) {
+    }
+}
+} // namespace
+
+TEST_CASE(test_frames_reach_a_client_in_order) {
+  TelemetryStream &stream = TelemetryStream::getInstance();
+  publish(stream, 3); // Before it joined: not sent
+  assert(stream.addClient(7, 1));
+  publish(stream, 10);
+
+  int fd = -1;
+  size_t len = stream.encode(0, message, &fd);
+  assert(fd == 7 && len > 0);
+  TelemetryBatch batch;
+  std::vector<TelemetryFrame> got = frames(len, &batch);
+  assert(got.size() == 10 && batch.dropped == 0);
+  for (size_t i = 0; i < got.size(); i++) {
+    assert(got[i].seq == 3 + i);
+    assert(got[i].rpm == (float)i);
+  }
+  assert(stream.encode(0, message, &fd) == 0); // Up to date
+  stream.removeClient(7);
+}
+
+TEST_CASE(test_decimation_sends_every_nth) {
+  TelemetryStream &stream = TelemetryStream::getInstance();
+  drain(stream);
+  assert(stream.addClient(3, 4));
+  publish(stream, 20);
+  int fd;
+  TelemetryBatch batch;
+  std::vector<TelemetryFrame> got =
+      frames(stream.encode(0, message, &fd), &batch);
+  assert(got.size() == 5);
+  for (const TelemetryFrame &f : got)
+    assert(f.seq % 4 == 0);
+
+  stream.setDecimation(3, 10);
+  publish(stream, 20);
+  got = frames(stream.encode(0, message, &fd), &batch);
+  assert(got.size() == 2);
+  stream.removeClient(3);
+}
+
+TEST_CASE(test_slow_client_skips_ahead_and_is_told) {
+  TelemetryStream &stream = TelemetryStream::getInstance();
+  assert(stream.addClient(5, 1));
+  publish(stream, TelemetryStream::RING + 50);
+
+  int fd;
+  TelemetryBatch batch;
+  size_t total = 0;
+  uint32_t last = 0;
+  size_t len;
+  while ((len = stream.encode(0, message, &fd)) > 0) {
+    std::vector<TelemetryFrame> got = frames(len, &batch);
+    assert(got.size() <= TelemetryStream::MAX_BATCH);
+    for (const TelemetryFrame &f : got) {
+      assert(total == 0 || f.seq == last + 1);
+      last = f.seq;
+      total++;
+    }
+  }
+  // Everything still in the ring arrived; the rest was counted
+  assert(total == TelemetryStream::RING - 1);
+  assert(batch.dropped == 51);
+  stream.removeClient(5);
+}
+
+TEST_CASE(test_client_limit_and_failed_sends) {
+  TelemetryStream &stream = TelemetryStream::getInstance();
+  assert(stream.addClient(1, 1));
+  assert(stream.addClient(2, 1));
+  assert(!stream.addClient(3, 1)); // Full
+  assert(stream.addClient(1, 2));  // A reused socket takes its own slot
+  assert(stream.clientCount() == 2);
+
+  std::vector<int> sentTo;
+  stream.startTask([&](int fd, const uint8_t *data, size_t len) {
+    sentTo.push_back(fd);
+    return fd != 2; // Client 2 went away
+  });
+  publish(stream, 5);
+  stream.step();
+  assert(sentTo.size() == 2);
+  assert(stream.clientCount() == 1);
+  assert(stream.addClient(3, 1)); // Its slot is free again
+
+  stream.removeClient(1);
+  stream.removeClient(3);
+  assert(stream.clientCount() == 0);
+}
+
+TEST_CASE(test_sample_reads_the_registry) {
+  Telemetry &t = Telemetry::getInstance();
+  Telemetry::Channel rpm = t.add("rpm", "rpm", TelemetryType::F32, 50);
+  Telemetry::Channel moving = t.add("moving", "", TelemetryType::BOOL, 50);
+  Telemetry::Channel target =
+      t.add("target_speed", "step", TelemetryType::U8, 50);
+  t.publish(rpm, 1200.0f);
+  t.publish(moving, true);
+  t.publish(target, 40);
+
+  TelemetryStream &stream = TelemetryStream::getInstance();
+  assert(stream.addClient(9, 1));
+  stream.sample();
+  int fd;
+  TelemetryBatch batch;
+  std::vector<TelemetryFrame> got =
+      frames(stream.encode(0, message, &fd), &batch);
+  assert(got.size() == 1);
+  assert(got[0].rpm == 1200.0f && got[0].target == 40);
+  assert(got[0].flags == TELEMETRY_MOVING); // Unregistered channels read 0
+  stream.removeClient(9);
+}
+
+int main() {
+  RUN_TEST(test_frames_reach_a_client_in_order);
+  RUN_TEST(test_decimation_sends_every_nth);
+  RUN_TEST(test_slow_client_skips_ahead_and_is_told);
+  RUN_TEST(test_client_limit_and_failed_sends);
+  RUN_TEST(test_sample_reads_the_registry);
+  std::cout << "All TelemetryStream tests passed!" << std::endl;
+  return 0;
+}
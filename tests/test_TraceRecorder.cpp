@@ -0,0 +1,160 @@
+// clang-format off
+// TEST_SOURCES: src/TraceRecorder.cpp tests/mocks/mocks.cpp
+// clang-format on
+
+#include "TraceRecorder.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+namespace {
+class Blob : public Print {
+public:
+  std::vector<uint8_t> bytes;
+  size_t write(uint8_t c) override {
+    bytes.push_back(c);
+    return 1;
+  }
+  size_t write(const uint8_t *data, size_t len) override {
+    bytes.insert(bytes.end(), data, data + len);
+    return len;
+  }
+};
+
+struct Decoded {
+  TraceHeader header;
+  TraceCoreRecord cores[2];
+  std::vector<std::string> names;
+  std::vector<std::string> tasks;
+  std::vector<TraceEventRecord> events;
+
+  std::string name(const TraceEventRecord &e) const { return names[e.name]; }
+};
+
+Decoded decode(const Blob &blob) {
+  Decoded d;
+  const uint8_t *at = blob.bytes.data();
+  memcpy(&d.header, at, sizeof(d.header));
+  assert(d.header.magic == TRACE_MAGIC);
+  assert(d.header.version == TRACE_VERSION);
+  assert(d.header.cores == 2);
+  at += sizeof(d.header);
+  memcpy(d.cores, at, sizeof(d.cores));
+  at += sizeof(d.cores);
+  for (uint16_t n = 0; n < d.header.names; n++) {
+    d.names.emplace_back((const char *)at + 1, at[0]);
+    at += 1 + at[0];
+  }
+  for (uint16_t t = 0; t < d.header.tasks; t++) {
+    TraceTaskRecord task;
+    memcpy(&task, at, sizeof(task));
+    d.tasks.emplace_back(task.name);
+    at += sizeof(task);
+  }
+  d.events.resize(d.cores[0].events + d.cores[1].events);
+  memcpy(d.events.data(), at, d.events.size() * sizeof(TraceEventRecord));
+  at += d.events.size() * sizeof(TraceEventRecord);
+  assert(at == blob.bytes.data() + blob.bytes.size());
+  return d;
+}
+
+Decoded download() {
+  Blob blob;
+  assert(TraceRecorder::getInstance().write(blob));
+  return decode(blob);
+}
+} // namespace
+
+TEST_CASE(test_scopes_and_instants) {
+  TraceRecorder &trace = TraceRecorder::getInstance();
+  _mockMillis = 5000;
+  assert(!trace.enabled(TRACE_MOTOR));
+  assert(trace.start());
+  {
+    TraceScope scope(TRACE_MOTOR, "motor.cycle", 7);
+    _mockMillis += 2;
+    traceInstant(TRACE_MOTOR, "motor.duty", (uint32_t)-250);
+  }
+  traceInstant(TRACE_ISR, "motor.isr"); // Not asked for
+  _mockMillis += 1;
+  traceInstant(TRACE_DCC, "dcc.speed", 42);
+
+  Decoded d = download();
+  assert(d.header.categories == TRACE_DEFAULT);
+  assert(d.header.cpuMhz == 240);
+  assert(d.cores[0].events == 4 && d.cores[1].events == 0);
+  assert(d.cores[0].anchorUs == 5000000);
+  assert(d.tasks.size() == 1 && d.tasks[0] == "main");
+
+  const TraceEventRecord *e = d.events.data();
+  assert(d.name(e[0]) == "motor.cycle" && e[0].type == TRACE_BEGIN);
+  assert(e[0].arg == 7 && e[0].task == 0 && e[0].category == TRACE_MOTOR);
+  assert(d.name(e[1]) == "motor.duty" && e[1].type == TRACE_INSTANT);
+  assert((int32_t)e[1].arg == -250);
+  assert(d.name(e[2]) == "motor.cycle" && e[2].type == TRACE_END);
+  assert(d.name(e[3]) == "dcc.speed" && e[3].arg == 42);
+  // Cycles at 240 per µs from the anchor
+  assert(e[0].cycles == d.cores[0].anchorCycles);
+  assert(e[2].cycles - e[0].cycles == 2000 * 240);
+  assert(e[3].cycles - e[2].cycles == 1000 * 240);
+
+  // Downloading stopped it
+  assert(!trace.enabled(TRACE_MOTOR));
+  traceInstant(TRACE_MOTOR, "motor.cycle");
+  assert(download().events.size() == 4);
+}
+
+TEST_CASE(test_ring_keeps_newest) {
+  TraceRecorder &trace = TraceRecorder::getInstance();
+  assert(trace.start(TRACE_HTTP, 16));
+  const char *names[] = {"a", "b", "c", "d", "e"};
+  for (uint32_t i = 0; i < 20; i++)
+    traceInstant(TRACE_HTTP, names[i % 5], i);
+
+  JsonDocument doc;
+  trace.getStatus(doc.to<JsonObject>());
+  assert((int)doc["events"] == 16);
+  assert((bool)doc["wrapped"]);
+
+  Decoded d = download();
+  assert(d.events.size() == 16);
+  assert(d.events[0].arg == 4 && d.events[15].arg == 19);
+  assert(d.name(d.events[0]) == "e");
+  assert(d.names.size() == 5);
+}
+
+TEST_CASE(test_clear) {
+  TraceRecorder &trace = TraceRecorder::getInstance();
+  assert(trace.hasTrace());
+  trace.clear();
+  assert(!trace.hasTrace());
+  Blob blob;
+  assert(!trace.write(blob));
+  assert(blob.bytes.empty());
+}
+
+TEST_CASE(test_parse_categories) {
+  assert(TraceRecorder::parseCategories("motor,dcc") ==
+         (TRACE_MOTOR | TRACE_DCC));
+  assert(TraceRecorder::parseCategories("isr,bogus") == TRACE_ISR);
+  assert(TraceRecorder::parseCategories("all") ==
+         (TRACE_ISR | TRACE_DEFAULT));
+  assert(TraceRecorder::parseCategories("") == 0);
+}
+
+int main() {
+  RUN_TEST(test_scopes_and_instants);
+  RUN_TEST(test_ring_keeps_newest);
+  RUN_TEST(test_clear);
+  RUN_TEST(test_parse_categories);
+  std::cout << "All TraceRecorder tests passed!" << std::endl;
+  return 0;
+}
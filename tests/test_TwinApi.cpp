@@ -0,0 +1,270 @@
+// clang-format off
+// TEST_SOURCES: main/main.cpp src/AudioController.cpp src/AudioDsp.cpp src/AudioPrefetcher.cpp src/AudioTranscoder.cpp src/AudioVoice.cpp src/BemfEstimator.cpp src/BootLoopDetector.cpp src/ConnectivityManager.cpp src/DccController.cpp src/DspFilters.cpp src/EngineSound.cpp src/HttpServer.cpp src/ImaAdpcm.cpp src/LightingController.cpp src/Logger.cpp src/MotorCapture.cpp src/MotorController.cpp src/MotorTask.cpp src/Mp3Index.cpp src/Mp3Sidecar.cpp src/PerfMonitor.cpp src/RequestArena.cpp src/RippleDetector.cpp src/SoundManifest.cpp src/SoundPack.cpp src/Telemetry.cpp src/TelemetryStream.cpp src/BootTimeline.cpp src/LatencyMonitor.cpp src/TraceRecorder.cpp tests/twin/EspHttpServer.cpp tests/twin/MotorPlant.cpp tests/mocks/mocks.cpp tests/sim/SimKernel.cpp
+// TEST_FLAGS: -Itests/twin -Itests/sim -DNIMRS_SIM -DUNIT_TEST -DSKIP_MOCK_AUDIO_CONTROLLER -DSKIP_MOCK_DCC_CONTROLLER -DSKIP_MOCK_MOTOR_CONTROLLER -DSKIP_MOCK_LOGGER -pthread
+// clang-format on
+
+// The twin's firmware, started as tests/twin/twin_main.cpp starts it, with
+// a plain socket client on a host thread: what the dashboard fetches must
+// parse as JSON, as the browser's JSON.parse() would parse it.
+
+#include "SimKernel.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <Arduino.h>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cassert>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#define TEST_CASE(name) void name()
+#define RUN_TEST(name)                                                         \
+  std::cout << "Running " << #name << "... ";                                  \
+  name();                                                                      \
+  std::cout << "PASSED" << std::endl;
+
+extern "C" void app_main();
+extern "C" void notifyCVResetFactoryDefault(); // DccController.cpp
+
+// What the Arduino core's main.cpp provides around app_main()
+TaskHandle_t loopTaskHandle = NULL;
+void initArduino() {}
+void serialEventRun() { vTaskDelay(1); }
+
+namespace {
+const uint16_t PORT = 20000 + getpid() % 10000;
+
+std::atomic<bool> done(false);
+
+// The server starts from the firmware's loop, some time after boot
+int connectWhenServing() {
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (int tries = 0; tries < 1000; tries++) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0)
+      return fd;
+    close(fd);
+    usleep(10000);
+  }
+  assert(false);
+  return -1;
+}
+
+// One authenticated GET on a connection the server closes after it. Returns
+// the body, with any chunked framing removed.
+std::string get(const char *path, int &code) {
+  int fd = connectWhenServing();
+
+  std::string request = std::string("GET ") + path + " HTTP/1.1\r\n";
+  request += "Host: localhost\r\n";
+  request += "Authorization: Basic YWRtaW46YWRtaW4=\r\n"; // admin:admin
+  request += "Connection: close\r\n\r\n";
+  assert(send(fd, request.data(), request.size(), 0) ==
+         (ssize_t)request.size());
+
+  std::string in;
+  char buf[4096];
+  ssize_t got;
+  while ((got = recv(fd, buf, sizeof(buf), 0)) > 0)
+    in.append(buf, got);
+  close(fd);
+
+  code = atoi(in.c_str() + in.find(' ') + 1);
+  size_t headEnd = in.find("\r\n\r\n");
+  assert(headEnd != std::string::npos);
+  std::string head = in.substr(0, headEnd);
+  std::string body = in.substr(headEnd + 4);
+  if (head.find("Transfer-Encoding: chunked") == std::string::npos)
+    return body;
+  std::string out;
+  size_t at = 0;
+  for (;;) {
+    size_t len = strtoul(body.c_str() + at, nullptr, 16);
+    at = body.find("\r\n", at) + 2;
+    if (len == 0)
+      return out;
+    out += body.substr(at, len);
+    at += len + 2;
+  }
+}
+
+// Strict RFC 8259 parser that only checks the syntax
+struct JsonChecker {
+  const std::string &s;
+  size_t at = 0;
+
+  void space() {
+    while (at < s.size() && strchr(" \t\r\n", s[at]))
+      at++;
+  }
+  bool literal(const char *word) {
+    size_t n = strlen(word);
+    if (s.compare(at, n, word) != 0)
+      return false;
+    at += n;
+    return true;
+  }
+  bool digits() {
+    size_t from = at;
+    while (at < s.size() && isdigit((unsigned char)s[at]))
+      at++;
+    return at > from;
+  }
+  bool number() {
+    if (s[at] == '-')
+      at++;
+    if (s[at] == '0')
+      at++;
+    else if (!digits())
+      return false;
+    if (s[at] == '.' && (++at, !digits()))
+      return false;
+    if (s[at] == 'e' || s[at] == 'E') {
+      at++;
+      if (s[at] == '+' || s[at] == '-')
+        at++;
+      if (!digits())
+        return false;
+    }
+    return true;
+  }
+  bool string() {
+    if (s[at++] != '"')
+      return false;
+    while (at < s.size() && s[at] != '"') {
+      if ((unsigned char)s[at] < 0x20)
+        return false;
+      if (s[at] == '\\') {
+        at++;
+        if (at < s.size() && s[at] == 'u')
+          at += 4;
+        else if (at >= s.size() || !strchr("\"\\/bfnrt", s[at]))
+          return false;
+      }
+      at++;
+    }
+    return at++ < s.size();
+  }
+  template <typename Item> bool list(char open, char close, Item item) {
+    at++;
+    space();
+    if (at < s.size() && s[at] == close)
+      return ++at;
+    for (;;) {
+      space();
+      if (!item())
+        return false;
+      space();
+      if (at >= s.size())
+        return false;
+      if (s[at] == close)
+        return ++at;
+      if (s[at++] != ',')
+        return false;
+    }
+  }
+  bool value() {
+    space();
+    if (at >= s.size())
+      return false;
+    switch (s[at]) {
+    case '{':
+      return list('{', '}', [this] {
+        if (at >= s.size() || !string())
+          return false;
+        space();
+        return at < s.size() && s[at++] == ':' && value();
+      });
+    case '[':
+      return list('[', ']', [this] { return value(); });
+    case '"':
+      return string();
+    case 't':
+      return literal("true");
+    case 'f':
+      return literal("false");
+    case 'n':
+      return literal("null");
+    default:
+      return number();
+    }
+  }
+};
+
+bool isJson(const std::string &body) {
+  JsonChecker checker{body};
+  if (!checker.value())
+    return false;
+  checker.space();
+  return checker.at == body.size();
+}
+
+std::string getJson(const char *path) {
+  int code = 0;
+  std::string body = get(path, code);
+  if (code != 200 || !isJson(body)) {
+    std::cout << "\n  " << path << " (" << code << "): " << body.substr(0, 200)
+              << std::endl;
+    assert(false);
+  }
+  return body;
+}
+} // namespace
+
+TEST_CASE(test_checker) {
+  assert(isJson("{\"a\":[1,-2.5e3,\"x\\\"y\",true,null,{}],\"b\":[]}"));
+  assert(!isJson("{\"functions\":\"\"")); // Unterminated
+  assert(!isJson("[[0] Boot: Running]"));
+  assert(!isJson("{\"a\":nan}"));
+}
+
+TEST_CASE(test_status_is_json) {
+  std::string body = getJson("/api/status");
+  // Nested values are arrays and objects, not empty strings
+  assert(body.find("\"functions\":[false,") != std::string::npos);
+}
+
+TEST_CASE(test_logs_are_json) {
+  std::string body = getJson("/api/logs");
+  // Each line a quoted string, with its "[ms]" prefix inside the quotes
+  assert(body.compare(0, 3, "[\"[") == 0);
+  getJson("/api/logs?type=data");
+}
+
+TEST_CASE(test_dashboard_endpoints_are_json) {
+  for (const char *path : {"/api/perf", "/api/latency", "/api/sounds/pack",
+                           "/api/boot", "/api/http", "/api/cv/all",
+                           "/api/telemetry/schema", "/api/files/list"})
+    getJson(path);
+}
+
+int main() {
+  signal(SIGPIPE, SIG_IGN);
+  httpd_twin_map_port(80, PORT);
+  app_main();
+  notifyCVResetFactoryDefault();
+
+  std::thread client([] {
+    RUN_TEST(test_checker);
+    RUN_TEST(test_status_is_json);
+    RUN_TEST(test_logs_are_json);
+    RUN_TEST(test_dashboard_endpoints_are_json);
+    done = true;
+  });
+  SimKernel::getInstance().runRealTime([](uint64_t maxUs) {
+    httpd_twin_poll(std::min<uint64_t>(maxUs, 10000));
+    return !done;
+  });
+  client.join();
+  std::cout << "All twin API tests passed!" << std::endl;
+  return 0;
+}
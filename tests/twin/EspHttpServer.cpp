@@ -0,0 +1,880 @@
+#include "SimKernel.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <esp_http_server.h>
+#include <fcntl.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <map>
+#include <mbedtls/base64.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+// esp_http_server on host sockets. As on the target, one server task reads
+// each request and runs its handler; a handler may hand the request to
+// another task with httpd_req_async_handler_begin(). Sockets are
+// non-blocking: a task that would block waits on a semaphore instead, which
+// httpd_twin_poll(), the simulator's idle wait, gives when the socket is
+// ready. So only the task waits, and the others run meanwhile.
+
+namespace {
+constexpr size_t MAX_HEAD = 8192; // Request line and headers
+constexpr size_t RECV_CHUNK = 2048;
+constexpr const char *WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+struct Server;
+
+struct Session {
+  Server *server;
+  int fd;
+  std::string in; // Received but not yet read
+  bool busy = false;     // A request is being handled
+  bool signaled = false; // Readable, and the server task told so
+  bool ws = false;
+  bool closing = false; // Close once the request in hand is done
+  const httpd_uri_t *wsRoute = nullptr;
+  uint32_t lastUsed = 0;
+};
+
+// A request and its response, as httpd_req_t::aux
+struct Request {
+  Session *session;
+  std::vector<std::pair<std::string, std::string>> headers;
+  size_t bodyLeft = 0;
+  bool keepAlive = true;
+  bool async = false;
+  std::string status = "200 OK";
+  std::string type = "text/html";
+  std::vector<std::pair<std::string, std::string>> respHeaders;
+  bool headSent = false;
+  bool done = false;
+  bool failed = false; // The socket is gone
+  // A WebSocket frame, its header read by the server
+  httpd_ws_frame_t frame = {};
+  uint8_t mask[4] = {};
+  bool masked = false;
+  size_t frameLeft = 0;
+};
+
+struct Work {
+  httpd_work_fn_t fn;
+  void *arg;
+};
+
+struct Server {
+  httpd_config_t config;
+  int listenFd = -1;
+  std::deque<std::string> uris; // Keep the handlers' uri strings alive
+  std::vector<httpd_uri_t> routes;
+  std::vector<Session *> sessions;
+  SemaphoreHandle_t wake; // Something for the server task to do
+  QueueHandle_t work;
+  uint32_t uses = 0;
+};
+
+// A task waiting for a socket to become ready
+struct Waiter {
+  int fd;
+  short events;
+  SemaphoreHandle_t ready;
+};
+
+std::vector<Server *> servers;
+std::vector<Waiter *> waiters;
+std::map<uint16_t, uint16_t> portMap;
+
+const char *const METHOD_NAMES[] = {"DELETE", "GET", "HEAD", "POST", "PUT",
+                                    "CONNECT", "OPTIONS"};
+
+Request &state(httpd_req_t *r) { return *(Request *)r->aux; }
+
+// --- Socket I/O, as the calling task ---
+
+bool waitFor(int fd, short events, uint16_t timeoutS) {
+  Waiter w = {fd, events, xSemaphoreCreateBinary()};
+  waiters.push_back(&w);
+  bool ok = xSemaphoreTake(w.ready, pdMS_TO_TICKS(timeoutS * 1000)) == pdTRUE;
+  auto it = std::find(waiters.begin(), waiters.end(), &w);
+  if (it != waiters.end())
+    waiters.erase(it);
+  vSemaphoreDelete(w.ready);
+  return ok;
+}
+
+// Up to @p len bytes from the socket itself, waiting for some
+int receiveSocket(Session &s, char *buf, size_t len) {
+  for (;;) {
+    ssize_t n = recv(s.fd, buf, len, MSG_DONTWAIT);
+    if (n > 0)
+      return n;
+    if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+      return HTTPD_SOCK_ERR_FAIL;
+    if (!waitFor(s.fd, POLLIN, s.server->config.recv_wait_timeout))
+      return HTTPD_SOCK_ERR_TIMEOUT;
+  }
+}
+
+// Up to @p len bytes: what is buffered first, else what the socket has
+int receive(Session &s, char *buf, size_t len) {
+  if (s.in.empty())
+    return receiveSocket(s, buf, len);
+  size_t n = std::min(len, s.in.size());
+  memcpy(buf, s.in.data(), n);
+  s.in.erase(0, n);
+  return n;
+}
+
+// Reads more into the session's buffer; false when the socket has gone
+bool fill(Session &s) {
+  char buf[RECV_CHUNK];
+  int n = receiveSocket(s, buf, sizeof(buf));
+  if (n <= 0)
+    return false;
+  s.in.append(buf, n);
+  return true;
+}
+
+bool sendAll(Session &s, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(s.fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n > 0) {
+      data += n;
+      len -= n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (!waitFor(s.fd, POLLOUT, s.server->config.send_wait_timeout))
+        return false;
+    } else if (n < 0 && errno != EINTR) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// --- WebSocket ---
+
+// SHA-1, for the handshake's Sec-WebSocket-Accept only
+void sha1(const std::string &msg, uint8_t out[20]) {
+  uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                   0xC3D2E1F0};
+  std::string m = msg;
+  uint64_t bits = (uint64_t)msg.size() * 8;
+  m += (char)0x80;
+  while (m.size() % 64 != 56)
+    m += (char)0;
+  for (int i = 7; i >= 0; i--)
+    m += (char)(bits >> (i * 8));
+  auto rol = [](uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+  for (size_t chunk = 0; chunk < m.size(); chunk += 64) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+      const uint8_t *p = (const uint8_t *)m.data() + chunk + i * 4;
+      w[i] = (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+    }
+    for (int i = 16; i < 80; i++)
+      w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t t = rol(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = rol(b, 30);
+      b = a;
+      a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+  for (int i = 0; i < 20; i++)
+    out[i] = h[i / 4] >> (24 - (i % 4) * 8);
+}
+
+bool sendFrame(Session &s, httpd_ws_type_t type, const uint8_t *data,
+               size_t len) {
+  uint8_t head[10];
+  size_t n = 2;
+  head[0] = 0x80 | type;
+  if (len < 126) {
+    head[1] = len;
+  } else if (len < 65536) {
+    head[1] = 126;
+    head[2] = len >> 8;
+    head[3] = len;
+    n = 4;
+  } else {
+    head[1] = 127;
+    for (int i = 0; i < 8; i++)
+      head[2 + i] = (uint64_t)len >> (56 - i * 8);
+    n = 10;
+  }
+  return sendAll(s, (const char *)head, n) &&
+         sendAll(s, (const char *)data, len);
+}
+
+// Reads a frame's header into @p r; false when the socket has gone
+bool readFrameHeader(Session &s, Request &r) {
+  while (s.in.size() < 2) {
+    if (!fill(s))
+      return false;
+  }
+  const uint8_t *p = (const uint8_t *)s.in.data();
+  size_t need = 2 + ((p[1] & 0x7F) == 126 ? 2 : 0) +
+                ((p[1] & 0x7F) == 127 ? 8 : 0) + (p[1] & 0x80 ? 4 : 0);
+  while (s.in.size() < need) {
+    if (!fill(s))
+      return false;
+  }
+  p = (const uint8_t *)s.in.data();
+  r.frame.final = p[0] & 0x80;
+  r.frame.type = (httpd_ws_type_t)(p[0] & 0x0F);
+  uint64_t len = p[1] & 0x7F;
+  size_t at = 2;
+  if (len == 126) {
+    len = p[2] << 8 | p[3];
+    at = 4;
+  } else if (len == 127) {
+    len = 0;
+    for (int i = 0; i < 8; i++)
+      len = len << 8 | p[2 + i];
+    at = 10;
+  }
+  r.masked = p[1] & 0x80;
+  if (r.masked)
+    memcpy(r.mask, p + at, 4);
+  r.frame.len = len;
+  r.frameLeft = len;
+  s.in.erase(0, need);
+  return true;
+}
+
+// --- Requests ---
+
+const char *findHeader(Request &r, const char *field) {
+  for (const auto &h : r.headers) {
+    if (strcasecmp(h.first.c_str(), field) == 0)
+      return h.second.c_str();
+  }
+  return nullptr;
+}
+
+bool sendHead(httpd_req_t *req, bool chunked, size_t length) {
+  Request &r = state(req);
+  std::string head = "HTTP/1.1 " + r.status + "\r\nContent-Type: " + r.type;
+  if (chunked)
+    head += "\r\nTransfer-Encoding: chunked";
+  else
+    head += "\r\nContent-Length: " + std::to_string(length);
+  for (const auto &h : r.respHeaders)
+    head += "\r\n" + h.first + ": " + h.second;
+  head += "\r\n\r\n";
+  r.headSent = true;
+  if (!sendAll(*r.session, head.data(), head.size()))
+    r.failed = true;
+  return !r.failed;
+}
+
+void closeSession(Server &srv, Session *s) {
+  close(s->fd);
+  srv.sessions.erase(
+      std::find(srv.sessions.begin(), srv.sessions.end(), s));
+  delete s;
+}
+
+// After the handler: the unread body is dropped, and the socket kept for
+// the next request unless the client or an error says otherwise
+void finish(Server &srv, httpd_req_t *req) {
+  Request &r = state(req);
+  Session &s = *r.session;
+  char buf[RECV_CHUNK];
+  while (r.bodyLeft > 0 && !r.failed) {
+    int n = receive(s, buf, std::min(sizeof(buf), r.bodyLeft));
+    if (n <= 0)
+      r.failed = true;
+    else
+      r.bodyLeft -= n;
+  }
+  s.busy = false;
+  s.lastUsed = ++srv.uses;
+  bool close = r.failed || !r.keepAlive || s.closing;
+  delete &r;
+  if (close)
+    closeSession(srv, &s);
+  else if (!s.in.empty())
+    xSemaphoreGive(srv.wake); // A pipelined request is waiting
+}
+
+const httpd_uri_t *match(Server &srv, const char *path, size_t len,
+                         int method, bool *uriKnown) {
+  *uriKnown = false;
+  for (const httpd_uri_t &route : srv.routes) {
+    bool hit = srv.config.uri_match_fn
+                   ? srv.config.uri_match_fn(route.uri, path, len)
+                   : strlen(route.uri) == len &&
+                         strncmp(route.uri, path, len) == 0;
+    if (!hit)
+      continue;
+    *uriKnown = true;
+    if (route.method == method)
+      return &route;
+  }
+  return nullptr;
+}
+
+void sendError(httpd_req_t *req, const char *status) {
+  httpd_resp_set_status(req, status);
+  httpd_resp_set_type(req, "text/plain");
+  httpd_resp_sendstr(req, status);
+}
+
+void handleFrame(Server &srv, Session &s) {
+  Request *r = new Request();
+  r->session = &s;
+  s.busy = true;
+  httpd_req_t req = {};
+  req.handle = &srv;
+  req.method = 0; // Not HTTP_GET: a frame, not the handshake
+  req.aux = r;
+  req.user_ctx = s.wsRoute->user_ctx;
+  bool ok = readFrameHeader(s, *r);
+  if (ok && r->frame.type == HTTPD_WS_TYPE_CLOSE) {
+    sendFrame(s, HTTPD_WS_TYPE_CLOSE, nullptr, 0);
+    ok = false;
+  } else if (ok && r->frame.type == HTTPD_WS_TYPE_PING) {
+    std::vector<uint8_t> payload(r->frame.len);
+    r->frame.payload = payload.data();
+    ok = httpd_ws_recv_frame(&req, &r->frame, payload.size()) == ESP_OK &&
+         sendFrame(s, HTTPD_WS_TYPE_PONG, payload.data(), payload.size());
+  } else if (ok && r->frame.type != HTTPD_WS_TYPE_PONG) {
+    ok = s.wsRoute->handler(&req) == ESP_OK;
+  }
+  // Whatever of the payload the handler left
+  char buf[RECV_CHUNK];
+  while (ok && r->frameLeft > 0) {
+    int n = receive(s, buf, std::min(sizeof(buf), r->frameLeft));
+    ok = n > 0;
+    r->frameLeft -= ok ? n : 0;
+  }
+  r->failed = !ok;
+  r->bodyLeft = 0;
+  finish(srv, &req);
+}
+
+void handleRequest(Server &srv, Session &s) {
+  s.busy = true;
+  size_t end;
+  while ((end = s.in.find("\r\n\r\n")) == std::string::npos) {
+    if (s.in.size() > MAX_HEAD || !fill(s)) {
+      closeSession(srv, &s);
+      return;
+    }
+  }
+  std::string head = s.in.substr(0, end);
+  s.in.erase(0, end + 4);
+
+  Request *r = new Request();
+  r->session = &s;
+  httpd_req_t req = {};
+  req.handle = &srv;
+  req.aux = r;
+
+  size_t eol = head.find("\r\n");
+  std::string line = head.substr(0, eol);
+  size_t sp1 = line.find(' '), sp2 = line.rfind(' ');
+  std::string method = line.substr(0, sp1);
+  std::string uri = sp1 < sp2 ? line.substr(sp1 + 1, sp2 - sp1 - 1) : "/";
+  req.method = -1;
+  for (size_t i = 0; i < sizeof(METHOD_NAMES) / sizeof(*METHOD_NAMES); i++) {
+    if (method == METHOD_NAMES[i])
+      req.method = i;
+  }
+  if (method == "PATCH")
+    req.method = HTTP_PATCH;
+  snprintf(req.uri, sizeof(req.uri), "%s", uri.c_str());
+  while (eol != std::string::npos) {
+    size_t next = head.find("\r\n", eol + 2);
+    std::string h = head.substr(eol + 2, next == std::string::npos
+                                             ? std::string::npos
+                                             : next - eol - 2);
+    size_t colon = h.find(':');
+    if (colon != std::string::npos) {
+      size_t v = h.find_first_not_of(' ', colon + 1);
+      r->headers.emplace_back(h.substr(0, colon),
+                              v == std::string::npos ? "" : h.substr(v));
+    }
+    eol = next;
+  }
+  const char *length = findHeader(*r, "Content-Length");
+  req.content_len = length ? strtoul(length, nullptr, 10) : 0;
+  r->bodyLeft = req.content_len;
+  const char *connection = findHeader(*r, "Connection");
+  r->keepAlive = line.find("HTTP/1.0") == std::string::npos;
+  if (connection && strcasestr(connection, "close"))
+    r->keepAlive = false;
+  if (connection && strcasestr(connection, "keep-alive"))
+    r->keepAlive = true;
+
+  const char *query = strchr(req.uri, '?');
+  size_t pathLen = query ? query - req.uri : strlen(req.uri);
+  bool uriKnown;
+  const httpd_uri_t *route =
+      match(srv, req.uri, pathLen, req.method, &uriKnown);
+  if (!route) {
+    sendError(&req, uriKnown ? "405 Method Not Allowed" : "404 Not Found");
+    finish(srv, &req);
+    return;
+  }
+  req.user_ctx = route->user_ctx;
+
+  const char *key = findHeader(*r, "Sec-WebSocket-Key");
+  if (route->is_websocket && key) {
+    uint8_t digest[20];
+    sha1(std::string(key) + WS_GUID, digest);
+    unsigned char accept[32];
+    size_t len;
+    mbedtls_base64_encode(accept, sizeof(accept), &len, digest, 20);
+    std::string reply = "HTTP/1.1 101 Switching Protocols\r\n"
+                        "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                        "Sec-WebSocket-Accept: " +
+                        std::string((char *)accept, len) + "\r\n\r\n";
+    r->headSent = r->done = true;
+    bool ok = sendAll(s, reply.data(), reply.size()) &&
+              route->handler(&req) == ESP_OK;
+    s.ws = ok;
+    s.wsRoute = route;
+    r->failed = !ok;
+    finish(srv, &req);
+    return;
+  }
+
+  if (route->handler(&req) != ESP_OK)
+    r->failed = true; // esp_http_server closes the socket on an error
+  if (!r->async)
+    finish(srv, &req);
+}
+
+void acceptClients(Server &srv) {
+  for (;;) {
+    int fd = accept(srv.listenFd, nullptr, nullptr);
+    if (fd < 0)
+      return;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (srv.sessions.size() >= srv.config.max_open_sockets) {
+      // The least recently used idle one makes way, or the newcomer goes
+      Session *lru = nullptr;
+      for (Session *s : srv.sessions) {
+        if (!s->busy && (!lru || s->lastUsed < lru->lastUsed))
+          lru = s;
+      }
+      if (!srv.config.lru_purge_enable || !lru) {
+        close(fd);
+        continue;
+      }
+      closeSession(srv, lru);
+    }
+    Session *s = new Session();
+    s->server = &srv;
+    s->fd = fd;
+    s->lastUsed = ++srv.uses;
+    srv.sessions.push_back(s);
+  }
+}
+
+void serverTask(void *param) {
+  Server &srv = *(Server *)param;
+  for (;;) {
+    xSemaphoreTake(srv.wake, portMAX_DELAY);
+    Work work;
+    while (xQueueReceive(srv.work, &work, 0) == pdTRUE)
+      work.fn(work.arg);
+    acceptClients(srv);
+    // One request per ready socket per round, so none starves the rest
+    std::vector<Session *> ready;
+    for (Session *s : srv.sessions) {
+      if (!s->busy && (s->signaled || !s->in.empty()))
+        ready.push_back(s);
+    }
+    for (Session *s : ready) {
+      s->signaled = false;
+      if (s->in.empty()) {
+        char c;
+        ssize_t n = recv(s->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+          closeSession(srv, s);
+          continue;
+        }
+        if (n < 0)
+          continue; // Nothing after all
+      }
+      if (s->ws)
+        handleFrame(srv, *s);
+      else
+        handleRequest(srv, *s);
+    }
+  }
+}
+
+Session *findSession(Server &srv, int fd) {
+  for (Session *s : srv.sessions) {
+    if (s->fd == fd)
+      return s;
+  }
+  return nullptr;
+}
+} // namespace
+
+const char *http_method_str(enum http_method m) {
+  if (m == HTTP_PATCH)
+    return "PATCH";
+  if (m >= 0 && m < (int)(sizeof(METHOD_NAMES) / sizeof(*METHOD_NAMES)))
+    return METHOD_NAMES[m];
+  return "<unknown>";
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+  uint16_t port = config->server_port;
+  if (portMap.count(port))
+    port = portMap[port];
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  // Loopback only: the firmware's default credentials are public
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(fd, 16) != 0) {
+    // The decoder would log this and run on; a twin nobody can reach is of
+    // no use, so it stops
+    fprintf(stderr, "httpd: cannot listen on %u: %s\n", port,
+            strerror(errno));
+    exit(1);
+  }
+  printf("httpd: serving http://localhost:%u/\n", port);
+  fflush(stdout);
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  Server *srv = new Server();
+  srv->config = *config;
+  srv->listenFd = fd;
+  srv->wake = xSemaphoreCreateBinary();
+  srv->work = xQueueCreate(16, sizeof(Work));
+  servers.push_back(srv);
+  int core = config->core_id == 0x7FFFFFFF ? tskNO_AFFINITY : config->core_id;
+  xTaskCreatePinnedToCore(serverTask, "httpd", config->stack_size, srv,
+                          config->task_priority, NULL, core);
+  *handle = srv;
+  return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+  Server *srv = (Server *)handle;
+  close(srv->listenFd);
+  srv->listenFd = -1;
+  return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
+                                     const httpd_uri_t *uri_handler) {
+  Server &srv = *(Server *)handle;
+  if (srv.routes.size() >= srv.config.max_uri_handlers)
+    return ESP_FAIL;
+  srv.uris.push_back(uri_handler->uri);
+  httpd_uri_t route = *uri_handler;
+  route.uri = srv.uris.back().c_str();
+  srv.routes.push_back(route);
+  return ESP_OK;
+}
+
+// As esp_http_server's: a trailing '*' takes any rest, a '?' makes the
+// character before it optional
+bool httpd_uri_match_wildcard(const char *tpl, const char *uri, size_t len) {
+  const size_t tplLen = strlen(tpl);
+  size_t exact = tplLen;
+  const char last = tplLen > 0 ? tpl[tplLen - 1] : 0;
+  const char prevLast = tplLen > 1 ? tpl[tplLen - 2] : 0;
+  const bool asterisk = last == '*' || (prevLast == '*' && last == '?');
+  const bool quest = last == '?' || (prevLast == '?' && last == '*');
+  if (exact < (size_t)(asterisk + quest * 2))
+    return false;
+  exact -= asterisk + quest * 2;
+  if (len < exact)
+    return false;
+  if (!quest) {
+    if (!asterisk && len != exact)
+      return false;
+    return strncmp(tpl, uri, exact) == 0;
+  }
+  if (len > exact && tpl[exact] != uri[exact])
+    return false;
+  if (strncmp(tpl, uri, exact) != 0)
+    return false;
+  return asterisk || len <= exact + 1;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *r) { return state(r).session->fd; }
+
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len) {
+  Request &rq = state(r);
+  if (rq.bodyLeft == 0)
+    return 0;
+  int n = receive(*rq.session, buf, std::min(buf_len, rq.bodyLeft));
+  if (n > 0)
+    rq.bodyLeft -= n;
+  else if (n != HTTPD_SOCK_ERR_TIMEOUT)
+    rq.failed = true;
+  return n;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field) {
+  const char *v = findHeader(state(r), field);
+  return v ? strlen(v) : 0;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field,
+                                      char *val, size_t val_size) {
+  const char *v = findHeader(state(r), field);
+  if (!v || val_size == 0)
+    return ESP_FAIL;
+  snprintf(val, val_size, "%s", v);
+  return strlen(v) < val_size ? ESP_OK : ESP_FAIL;
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t *r) {
+  const char *q = strchr(r->uri, '?');
+  return q ? strlen(q + 1) : 0;
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf,
+                                      size_t buf_len) {
+  const char *q = strchr(r->uri, '?');
+  if (!q || buf_len == 0)
+    return ESP_FAIL;
+  snprintf(buf, buf_len, "%s", q + 1);
+  return strlen(q + 1) < buf_len ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out) {
+  httpd_req_t *copy = new httpd_req_t;
+  memcpy((void *)copy, r, sizeof(*r));
+  state(r).async = true;
+  *out = copy;
+  return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r) {
+  Server &srv = *(Server *)r->handle;
+  finish(srv, r);
+  delete r;
+  xSemaphoreGive(srv.wake); // The socket is the server's again
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status) {
+  state(r).status = status;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type) {
+  state(r).type = type;
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field,
+                             const char *value) {
+  state(r).respHeaders.emplace_back(field, value);
+  return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len) {
+  Request &rq = state(r);
+  if (buf_len == HTTPD_RESP_USE_STRLEN)
+    buf_len = buf ? strlen(buf) : 0;
+  if (rq.headSent || !sendHead(r, false, buf_len))
+    return ESP_FAIL;
+  rq.done = true;
+  if (buf_len > 0 && !sendAll(*rq.session, buf, buf_len))
+    rq.failed = true;
+  return rq.failed ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf,
+                                ssize_t buf_len) {
+  Request &rq = state(r);
+  if (rq.failed || rq.done)
+    return ESP_FAIL;
+  if (buf_len == HTTPD_RESP_USE_STRLEN)
+    buf_len = buf ? strlen(buf) : 0;
+  if (!rq.headSent && !sendHead(r, true, 0))
+    return ESP_FAIL;
+  if (!buf || buf_len == 0) {
+    rq.done = true;
+    if (!sendAll(*rq.session, "0\r\n\r\n", 5))
+      rq.failed = true;
+    return rq.failed ? ESP_FAIL : ESP_OK;
+  }
+  char size[16];
+  int n = snprintf(size, sizeof(size), "%zx\r\n", (size_t)buf_len);
+  if (!sendAll(*rq.session, size, n) ||
+      !sendAll(*rq.session, buf, buf_len) ||
+      !sendAll(*rq.session, "\r\n", 2))
+    rq.failed = true;
+  return rq.failed ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t httpd_resp_sendstr(httpd_req_t *r, const char *str) {
+  return httpd_resp_send(r, str, HTTPD_RESP_USE_STRLEN);
+}
+
+int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len) {
+  Request &rq = state(r);
+  rq.headSent = rq.done = true; // The caller writes the whole response
+  if (!sendAll(*rq.session, buf, buf_len)) {
+    rq.failed = true;
+    return HTTPD_SOCK_ERR_FAIL;
+  }
+  return buf_len;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *pkt,
+                              size_t max_len) {
+  Request &r = state(req);
+  pkt->final = r.frame.final;
+  pkt->type = r.frame.type;
+  pkt->len = r.frame.len;
+  if (max_len == 0)
+    return ESP_OK; // The header only
+  if (r.frameLeft > max_len || r.frameLeft != r.frame.len)
+    return ESP_FAIL;
+  for (size_t got = 0; got < r.frame.len;) {
+    int n = receive(*r.session, (char *)pkt->payload + got,
+                    r.frame.len - got);
+    if (n <= 0)
+      return ESP_FAIL;
+    got += n;
+    r.frameLeft -= n;
+  }
+  if (r.masked) {
+    for (size_t i = 0; i < r.frame.len; i++)
+      pkt->payload[i] ^= r.mask[i % 4];
+  }
+  return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd,
+                                    httpd_ws_frame_t *frame) {
+  Server &srv = *(Server *)hd;
+  Session *s = findSession(srv, fd);
+  if (!s || !s->ws)
+    return ESP_FAIL;
+  if (!sendFrame(*s, frame->type, frame->payload, frame->len)) {
+    s->closing = true;
+    if (!s->busy)
+      closeSession(srv, s);
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd) {
+  Session *s = findSession(*(Server *)hd, fd);
+  if (!s)
+    return HTTPD_WS_CLIENT_INVALID;
+  return s->ws ? HTTPD_WS_CLIENT_WEBSOCKET : HTTPD_WS_CLIENT_HTTP;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work,
+                           void *arg) {
+  Server &srv = *(Server *)handle;
+  Work w = {work, arg};
+  if (xQueueSend(srv.work, &w, portMAX_DELAY) != pdTRUE)
+    return ESP_FAIL;
+  xSemaphoreGive(srv.wake);
+  return ESP_OK;
+}
+
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds,
+                                int *client_fds) {
+  Server &srv = *(Server *)handle;
+  size_t n = std::min(*fds, srv.sessions.size());
+  for (size_t i = 0; i < n; i++)
+    client_fds[i] = srv.sessions[i]->fd;
+  *fds = n;
+  return ESP_OK;
+}
+
+void httpd_twin_map_port(uint16_t port, uint16_t hostPort) {
+  portMap[port] = hostPort;
+}
+
+void httpd_twin_poll(uint64_t maxUs) {
+  // What each polled descriptor wakes: a server, a session or a waiter
+  std::vector<pollfd> fds;
+  std::vector<Server *> forServer;
+  std::vector<Session *> forSession;
+  std::vector<Waiter *> forWaiter;
+  auto add = [&](int fd, short events, Server *srv, Session *s, Waiter *w) {
+    fds.push_back({fd, events, 0});
+    forServer.push_back(srv);
+    forSession.push_back(s);
+    forWaiter.push_back(w);
+  };
+  for (Server *srv : servers) {
+    if (srv->listenFd >= 0)
+      add(srv->listenFd, POLLIN, srv, nullptr, nullptr);
+    for (Session *s : srv->sessions) {
+      if (!s->busy && !s->signaled)
+        add(s->fd, POLLIN, srv, s, nullptr);
+    }
+  }
+  for (Waiter *w : waiters)
+    add(w->fd, w->events, nullptr, nullptr, w);
+
+  timespec timeout = {(time_t)(maxUs / 1000000),
+                      (long)(maxUs % 1000000) * 1000};
+  if (ppoll(fds.data(), fds.size(), &timeout, nullptr) <= 0)
+    return;
+  for (size_t i = 0; i < fds.size(); i++) {
+    if (!fds[i].revents)
+      continue;
+    if (forWaiter[i]) {
+      waiters.erase(std::find(waiters.begin(), waiters.end(), forWaiter[i]));
+      xSemaphoreGiveFromISR(forWaiter[i]->ready, NULL);
+      continue;
+    }
+    if (forSession[i])
+      forSession[i]->signaled = true;
+    xSemaphoreGiveFromISR(forServer[i]->wake, NULL);
+  }
+}
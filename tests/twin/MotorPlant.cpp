@@ -0,0 +1,88 @@
+// MotorHal for the twin: instead of the MCPWM bridge and the ADC, a DC
+// motor model on the track voltage. Every millisecond, as an interrupt, it
+// steps the model and queues that millisecond's 20 current samples, with
+// the commutator ripple, so MotorTask's BEMF and ripple paths see a motor
+// that spins up, slows down and reverses with the duty it sets.
+
+#include "../src/MotorHal.h"
+#include "../src/PerfMonitor.h"
+#include "../src/TraceRecorder.h"
+#include "SimKernel.h"
+#include <cmath>
+
+namespace {
+constexpr float TRACK_V = 16.0f;
+constexpr float R_OHM = 10.0f;      // Armature resistance
+constexpr float KE = 0.022f;        // V per rad/s, and N·m per A
+constexpr float J = 1e-5f;          // Rotor inertia: ~200 ms to speed
+constexpr float LOAD = 1.3e-5f;     // N·m per rad/s, a train's drag
+constexpr int SEGMENTS = 5;         // Commutator ripples per turn
+constexpr float RIPPLE = 0.3f;      // Of the mean current
+// Flat out it draws ~0.3 A at ~500 rad/s, so ~400 Hz of ripple: within
+// RippleDetector's 500 Hz and over its 50 mA threshold
+constexpr float SAMPLE_HZ = 20000.0f;
+constexpr uint64_t STEP_US = 1000;
+constexpr size_t SAMPLES_PER_STEP = (size_t)(SAMPLE_HZ * STEP_US / 1e6f);
+
+struct Plant {
+  float omega = 0.0f; // rad/s, signed
+  float angle = 0.0f; // Commutator phase
+  uint32_t seed = 1;
+} plant;
+
+// ADC counts for @p amps at gain 1 (see MotorHal::getCurrentScalar)
+float toAdc(float amps) { return amps * 2.520f * 4095.0f / 3.3f; }
+} // namespace
+
+MotorHal &MotorHal::getInstance() {
+  static MotorHal instance;
+  return instance;
+}
+
+MotorHal::MotorHal()
+    : _timer(NULL), _oper(NULL), _genA(NULL), _genB(NULL), _cmprA(NULL),
+      _cmprB(NULL), _lastGain(255), _currentDuty(0.0f), _adcStreamBuffer(NULL),
+      _lastCurrentAdc(0.0f) {}
+
+void MotorHal::init() {
+  _adcStreamBuffer = xStreamBufferCreate(4096, sizeof(float));
+  _lastGain = 1;
+  PerfLoop &perfLoop = PerfMonitor::getInstance().loop("MotorIsr");
+  SimKernel::getInstance().every(STEP_US, [this, &perfLoop] {
+    PerfScope perf(perfLoop);
+    TraceScope trace(TRACE_ISR, "motor.isr");
+    float dt = STEP_US / 1e6f / SAMPLES_PER_STEP;
+    float v = std::min(1.0f, std::max(-1.0f, _currentDuty)) * TRACK_V;
+    for (size_t i = 0; i < SAMPLES_PER_STEP; i++) {
+      float amps = (v - KE * plant.omega) / R_OHM;
+      plant.omega += (KE * amps - LOAD * plant.omega) / J * dt;
+      plant.angle += plant.omega * dt;
+
+      plant.seed = plant.seed * 1664525u + 1013904223u;
+      float noise = ((plant.seed >> 8) & 0xFF) / 255.0f - 0.5f;
+      float ripple = 1.0f + RIPPLE * sinf(SEGMENTS * plant.angle);
+      // The shunt amplifier reads the magnitude, as the bridge's does
+      float sample = toAdc(fabsf(amps) * ripple) + 4.0f * noise;
+      _lastCurrentAdc = sample;
+      xStreamBufferSendFromISR(_adcStreamBuffer, &sample, sizeof(sample),
+                               nullptr);
+    }
+  });
+}
+
+void MotorHal::setDuty(float duty) { _currentDuty = duty; }
+void MotorHal::setHardwareGain(uint8_t mode) { _lastGain = mode; }
+bool MotorHal::readFault() { return false; }
+
+float MotorHal::getCurrentScalar() const { return 3.3f / 4095.0f / 2.520f; }
+float MotorHal::getLatestCurrentAdc() const { return _lastCurrentAdc; }
+
+size_t MotorHal::getAdcSamples(float *buffer, size_t maxLen) {
+  if (!_adcStreamBuffer)
+    return 0;
+  size_t bytes =
+      xStreamBufferReceive(_adcStreamBuffer, buffer, maxLen * sizeof(float), 0);
+  return bytes / sizeof(float);
+}
+
+float MotorHal::getAdcSampleRate() const { return SAMPLE_HZ; }
@@ -0,0 +1,147 @@
+#ifndef ESP_HTTP_SERVER_H
+#define ESP_HTTP_SERVER_H
+
+// The part of ESP-IDF's esp_http_server that HttpServer uses, served from
+// host sockets by tests/twin/EspHttpServer.cpp. The server runs as a task
+// on the simulator, so requests are handled on the firmware's own tasks.
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+enum http_method {
+  HTTP_DELETE = 0,
+  HTTP_GET = 1,
+  HTTP_HEAD = 2,
+  HTTP_POST = 3,
+  HTTP_PUT = 4,
+  HTTP_OPTIONS = 6,
+  HTTP_PATCH = 28,
+};
+typedef enum http_method httpd_method_t;
+const char *http_method_str(enum http_method m);
+
+typedef void *httpd_handle_t;
+
+#define HTTPD_MAX_URI_LEN 512
+#define HTTPD_RESP_USE_STRLEN -1
+#define HTTPD_SOCK_ERR_FAIL -1
+#define HTTPD_SOCK_ERR_INVALID -2
+#define HTTPD_SOCK_ERR_TIMEOUT -3
+
+typedef struct httpd_req {
+  httpd_handle_t handle;
+  int method;
+  char uri[HTTPD_MAX_URI_LEN + 1]; // const in ESP-IDF
+  size_t content_len;
+  void *aux; // The server's request state
+  void *user_ctx;
+  void *sess_ctx;
+  void (*free_ctx)(void *ctx);
+  bool ignore_sess_ctx_changes;
+} httpd_req_t;
+
+typedef esp_err_t (*httpd_uri_handler_t)(httpd_req_t *r);
+typedef bool (*httpd_uri_match_func_t)(const char *reference_uri,
+                                       const char *uri_to_match,
+                                       size_t match_upto);
+
+typedef struct httpd_uri {
+  const char *uri;
+  httpd_method_t method;
+  httpd_uri_handler_t handler;
+  void *user_ctx;
+  bool is_websocket;
+  bool handle_ws_control_frames;
+  const char *supported_subprotocol;
+} httpd_uri_t;
+
+typedef struct httpd_config {
+  unsigned task_priority;
+  size_t stack_size;
+  int core_id;
+  uint16_t server_port;
+  uint16_t max_open_sockets;
+  uint16_t max_uri_handlers;
+  uint16_t max_resp_headers;
+  uint16_t recv_wait_timeout; // Seconds
+  uint16_t send_wait_timeout;
+  bool lru_purge_enable;
+  httpd_uri_match_func_t uri_match_fn;
+} httpd_config_t;
+
+#define HTTPD_DEFAULT_CONFIG()                                                 \
+  {                                                                            \
+    5, 4096, 0x7FFFFFFF, 80, 7, 8, 8, 5, 5, false, nullptr                     \
+  }
+
+typedef enum {
+  HTTPD_WS_TYPE_CONTINUE = 0x0,
+  HTTPD_WS_TYPE_TEXT = 0x1,
+  HTTPD_WS_TYPE_BINARY = 0x2,
+  HTTPD_WS_TYPE_CLOSE = 0x8,
+  HTTPD_WS_TYPE_PING = 0x9,
+  HTTPD_WS_TYPE_PONG = 0xA
+} httpd_ws_type_t;
+
+typedef struct httpd_ws_frame {
+  bool final;
+  bool fragmented;
+  httpd_ws_type_t type;
+  uint8_t *payload;
+  size_t len;
+} httpd_ws_frame_t;
+
+typedef enum {
+  HTTPD_WS_CLIENT_INVALID = 0x0,
+  HTTPD_WS_CLIENT_HTTP = 0x1,
+  HTTPD_WS_CLIENT_WEBSOCKET = 0x2,
+} httpd_ws_client_info_t;
+
+typedef void (*httpd_work_fn_t)(void *arg);
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle,
+                                     const httpd_uri_t *uri_handler);
+bool httpd_uri_match_wildcard(const char *reference_uri,
+                              const char *uri_to_match, size_t match_upto);
+
+int httpd_req_to_sockfd(httpd_req_t *r);
+int httpd_req_recv(httpd_req_t *r, char *buf, size_t buf_len);
+size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field);
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field,
+                                      char *val, size_t val_size);
+size_t httpd_req_get_url_query_len(httpd_req_t *r);
+esp_err_t httpd_req_get_url_query_str(httpd_req_t *r, char *buf,
+                                      size_t buf_len);
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out);
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r);
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status);
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field,
+                             const char *value);
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf,
+                                ssize_t buf_len);
+esp_err_t httpd_resp_sendstr(httpd_req_t *r, const char *str);
+int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len);
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *pkt,
+                              size_t max_len);
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd,
+                                    httpd_ws_frame_t *frame);
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd);
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work,
+                           void *arg);
+esp_err_t httpd_get_client_list(httpd_handle_t handle, size_t *fds,
+                                int *client_fds);
+
+// Twin only: the host port a server asking for @p port listens on, as 80
+// needs root; and the wait for sockets, for SimKernel::runRealTime()
+void httpd_twin_map_port(uint16_t port, uint16_t hostPort);
+void httpd_twin_poll(uint64_t maxUs);
+
+#endif
@@ -0,0 +1,72 @@
+// clang-format off
+// TEST_SOURCES: main/main.cpp src/AudioController.cpp src/AudioDsp.cpp src/AudioPrefetcher.cpp src/AudioTranscoder.cpp src/AudioVoice.cpp src/BemfEstimator.cpp src/BootLoopDetector.cpp src/ConnectivityManager.cpp src/DccController.cpp src/DspFilters.cpp src/EngineSound.cpp src/HttpServer.cpp src/ImaAdpcm.cpp src/LightingController.cpp src/Logger.cpp src/MotorCapture.cpp src/MotorController.cpp src/MotorTask.cpp src/Mp3Index.cpp src/Mp3Sidecar.cpp src/PerfMonitor.cpp src/RequestArena.cpp src/RippleDetector.cpp src/SoundManifest.cpp src/SoundPack.cpp src/Telemetry.cpp src/TelemetryStream.cpp src/BootTimeline.cpp src/LatencyMonitor.cpp src/TraceRecorder.cpp tests/twin/EspHttpServer.cpp tests/twin/MotorPlant.cpp tests/mocks/mocks.cpp tests/sim/SimKernel.cpp
+// TEST_FLAGS: -Itests/twin -Itests/sim -DNIMRS_SIM -DUNIT_TEST -DSKIP_MOCK_AUDIO_CONTROLLER -DSKIP_MOCK_DCC_CONTROLLER -DSKIP_MOCK_MOTOR_CONTROLLER -DSKIP_MOCK_LOGGER -pthread
+// clang-format on
+
+// The digital twin: main/main.cpp and every firmware module, as built for
+// the decoder, on the simulator in real time. The HTTP API and the
+// WebSocket streams are served on a localhost port from host sockets, the
+// motor is tests/twin/MotorPlant.cpp, and flash, NVS and audio are the
+// RAM-backed mocks. `tools/test_runner.py --twin` builds and starts it.
+//
+//   twin [--port 8080]
+//
+// The schedule is the simulator's: tasks switch only at kernel calls, so
+// the twin is for the API and the dashboard, not for timing (see
+// tests/sim/SimKernel.h).
+
+#include "SimKernel.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <Arduino.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" void app_main();
+extern "C" void notifyCVResetFactoryDefault(); // DccController.cpp
+
+// What the Arduino core's main.cpp provides around app_main()
+TaskHandle_t loopTaskHandle = NULL;
+void initArduino() {}
+
+// The core runs this after every loop(). On the decoder loopTask spins at
+// priority 1 and the tick preempts it; simulated tasks only switch at
+// kernel calls, so here it gives up the core for a tick instead.
+void serialEventRun() { vTaskDelay(1); }
+
+namespace {
+volatile sig_atomic_t stopRequested = 0;
+
+void onSignal(int) { stopRequested = 1; }
+} // namespace
+
+int main(int argc, char **argv) {
+  uint16_t port = 8080;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+      port = (uint16_t)atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--port N]\n", argv[0]);
+      return 2;
+    }
+  }
+  httpd_twin_map_port(80, port);
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  signal(SIGPIPE, SIG_IGN); // A client gone mid-response is a send error
+
+  app_main();
+  // The mock decoder's CVs start out blank: give it the registry's defaults,
+  // as a new decoder gets at its first reset
+  notifyCVResetFactoryDefault();
+  printf("Twin: running, Ctrl-C stops\n");
+  fflush(stdout);
+  SimKernel::getInstance().runRealTime([](uint64_t maxUs) {
+    httpd_twin_poll(maxUs);
+    return !stopRequested;
+  });
+  return 0;
+}
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""
+Compresses the dashboard assets for the firmware.
+
+Reads the R"rawliteral(...)rawliteral" strings of the asset headers
+(WebAssets.h, LameJs.h) and writes one header holding each of them gzipped,
+with its length and a digest of the content for the ETag. Run by the build;
+the output is not checked in.
+
+Usage:
+    embed_web_assets.py <output_header> <input_header>...
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+ASSET = re.compile(
+    r'const char (\w+)\[\] PROGMEM = R"rawliteral\((.*?)\)rawliteral";',
+    re.DOTALL,
+)
+
+
+def byte_rows(data, per_row=16):
+    for i in range(0, len(data), per_row):
+        yield ", ".join(f"0x{b:02x}" for b in data[i : i + per_row])
+
+
+def main():
+    if len(sys.argv) < 3:
+        print("Usage: embed_web_assets.py <output_header> <input_header>...")
+        sys.exit(1)
+
+    output_path = sys.argv[1]
+    lines = [
+        "// Generated by tools/embed_web_assets.py. Do not edit.",
+        "#ifndef WEB_ASSETS_GZ_H",
+        "#define WEB_ASSETS_GZ_H",
+        "#include <Arduino.h>",
+        "",
+    ]
+    for input_path in sys.argv[2:]:
+        with open(input_path, "r", encoding="utf-8") as f:
+            text = f.read()
+        found = ASSET.findall(text)
+        if not found:
+            print(f"Error: no assets in {input_path}")
+            sys.exit(1)
+        for name, content in found:
+            raw = content.encode("utf-8")
+            # mtime 0 keeps the bytes, and so the firmware, reproducible
+            packed = gzip.compress(raw, compresslevel=9, mtime=0)
+            digest = hashlib.sha1(raw).hexdigest()[:8]
+            lines.append(f"const uint8_t {name}_GZ[] PROGMEM = {{")
+            lines.extend(f"    {row}," for row in byte_rows(packed))
+            lines.append("};")
+            lines.append(f"const size_t {name}_GZ_LEN = {len(packed)};")
+            lines.append(f'#define {name}_DIGEST "{digest}"')
+            lines.append("")
+            print(f"{name}: {len(raw)} -> {len(packed)} bytes")
+    lines.append("#endif")
+
+    dir_name = os.path.dirname(output_path)
+    if dir_name:
+        os.makedirs(dir_name, exist_ok=True)
+    with open(output_path, "w", encoding="utf-8") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
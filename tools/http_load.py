@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+"""
+NIMRS HTTP Load Test
+Drives the decoder's web server with concurrent clients and reports
+requests/second and latency percentiles per path.
+
+Usage:
+    ./tools/http_load.py <IP_ADDRESS> [options]
+
+Examples:
+    # API and a static file, 4 keep-alive clients for 20 s
+    ./tools/http_load.py 192.168.1.100 --path /api/status --path /horn.wav
+
+    # Add 2 clients that trickle their request a byte a second
+    ./tools/http_load.py 192.168.1.100 --slow-clients 2
+
+    # Record a run, then compare a later one against it
+    ./tools/http_load.py 192.168.1.100 --save before.json
+    ./tools/http_load.py 192.168.1.100 --compare before.json
+"""
+
+import argparse
+import base64
+import http.client
+import json
+import socket
+import sys
+import threading
+import time
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    k = (len(sorted_values) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(sorted_values) - 1)
+    return sorted_values[lo] + (sorted_values[hi] - sorted_values[lo]) * (k - lo)
+
+
+class Client(threading.Thread):
+    """Requests the paths in turn until the deadline, on one connection."""
+
+    def __init__(self, args, offset, deadline, results, lock):
+        super().__init__(daemon=True)
+        self.args = args
+        self.offset = offset
+        self.deadline = deadline
+        self.results = results
+        self.lock = lock
+        self.headers = {}
+        if args.user:
+            token = base64.b64encode(f"{args.user}:{args.password}".encode())
+            self.headers["Authorization"] = "Basic " + token.decode()
+        if not args.keepalive:
+            self.headers["Connection"] = "close"
+
+    def connect(self):
+        return http.client.HTTPConnection(
+            self.args.host, self.args.port, timeout=self.args.timeout
+        )
+
+    def run(self):
+        conn = None
+        i = self.offset
+        while time.monotonic() < self.deadline:
+            path = self.args.path[i % len(self.args.path)]
+            i += 1
+            if conn is None:
+                conn = self.connect()
+            start = time.monotonic()
+            try:
+                conn.request("GET", path, headers=self.headers)
+                resp = conn.getresponse()
+                size = len(resp.read())
+                ok = 200 <= resp.status < 400
+                if not self.args.keepalive or resp.will_close:
+                    conn.close()
+                    conn = None
+            except (OSError, http.client.HTTPException):
+                ok, size = False, 0
+                if conn:
+                    conn.close()
+                conn = None
+            took = (time.monotonic() - start) * 1000.0
+            with self.lock:
+                entry = self.results.setdefault(
+                    path, {"ms": [], "errors": 0, "bytes": 0}
+                )
+                if ok:
+                    entry["ms"].append(took)
+                    entry["bytes"] += size
+                else:
+                    entry["errors"] += 1
+        if conn:
+            conn.close()
+
+
+class SlowClient(threading.Thread):
+    """Sends a request one byte a second, holding a socket the whole run."""
+
+    def __init__(self, args, deadline):
+        super().__init__(daemon=True)
+        self.args = args
+        self.deadline = deadline
+
+    def run(self):
+        request = (
+            f"GET /api/status HTTP/1.1\r\nHost: {self.args.host}\r\n"
+            "X-Padding: " + "x" * 64 + "\r\n\r\n"
+        ).encode()
+        while time.monotonic() < self.deadline:
+            try:
+                with socket.create_connection(
+                    (self.args.host, self.args.port), timeout=5
+                ) as sock:
+                    for b in request:
+                        if time.monotonic() >= self.deadline:
+                            return
+                        sock.sendall(bytes([b]))
+                        time.sleep(1.0)
+                    sock.recv(4096)
+            except OSError:
+                time.sleep(1.0)
+
+
+def summarise(results, duration):
+    summary = {}
+    for path, entry in results.items():
+        ms = sorted(entry["ms"])
+        summary[path] = {
+            "requests": len(ms),
+            "errors": entry["errors"],
+            "rps": len(ms) / duration,
+            "kib_s": entry["bytes"] / 1024.0 / duration,
+            "p50_ms": percentile(ms, 50),
+            "p90_ms": percentile(ms, 90),
+            "p99_ms": percentile(ms, 99),
+            "max_ms": ms[-1] if ms else 0.0,
+        }
+    return summary
+
+
+def print_summary(summary, baseline=None):
+    print(
+        f"{'path':<28} {'req/s':>8} {'KiB/s':>8} {'p50':>8} "
+        f"{'p90':>8} {'p99':>8} {'max':>8} {'err':>5}"
+    )
+    for path, s in sorted(summary.items()):
+        print(
+            f"{path:<28} {s['rps']:8.1f} {s['kib_s']:8.1f} "
+            f"{s['p50_ms']:8.1f} {s['p90_ms']:8.1f} {s['p99_ms']:8.1f} "
+            f"{s['max_ms']:8.1f} {s['errors']:5d}"
+        )
+        if baseline and path in baseline:
+            b = baseline[path]
+            print(
+                f"{'  before':<28} {b['rps']:8.1f} {b['kib_s']:8.1f} "
+                f"{b['p50_ms']:8.1f} {b['p90_ms']:8.1f} {b['p99_ms']:8.1f} "
+                f"{b['max_ms']:8.1f} {b['errors']:5d}"
+            )
+    print("(latencies in ms)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="NIMRS HTTP load test")
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument(
+        "--path",
+        action="append",
+        help="Path to request, repeatable (default /api/status)",
+    )
+    parser.add_argument("--clients", type=int, default=4)
+    parser.add_argument("--duration", type=float, default=20.0)
+    parser.add_argument("--slow-clients", type=int, default=0)
+    parser.add_argument(
+        "--no-keepalive",
+        dest="keepalive",
+        action="store_false",
+        help="New connection for every request",
+    )
+    parser.add_argument("--timeout", type=float, default=10.0)
+    parser.add_argument("--user", default="")
+    parser.add_argument("--password", default="")
+    parser.add_argument("--save", help="Write the summary to this JSON file")
+    parser.add_argument("--compare", help="Summary JSON of an earlier run")
+    args = parser.parse_args()
+    if not args.path:
+        args.path = ["/api/status"]
+
+    baseline = None
+    if args.compare:
+        with open(args.compare) as f:
+            baseline = json.load(f)["paths"]
+
+    results, lock = {}, threading.Lock()
+    deadline = time.monotonic() + args.duration
+    threads = [SlowClient(args, deadline) for _ in range(args.slow_clients)]
+    threads += [
+        Client(args, i, deadline, results, lock) for i in range(args.clients)
+    ]
+    print(
+        f"{args.clients} clients ({'keep-alive' if args.keepalive else 'close'})"
+        f", {args.slow_clients} slow, {args.duration:.0f} s against "
+        f"{args.host}:{args.port}"
+    )
+    started = time.monotonic()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join(args.duration + args.timeout + 5)
+    summary = summarise(results, time.monotonic() - started)
+
+    print_summary(summary, baseline)
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(
+                {
+                    "clients": args.clients,
+                    "slow_clients": args.slow_clients,
+                    "keepalive": args.keepalive,
+                    "duration": args.duration,
+                    "paths": summary,
+                },
+                f,
+                indent=2,
+            )
+    return 0 if all(s["requests"] > 0 for s in summary.values()) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""Build a sound pack for the raw "sounds" partition from sound_assets.json.
+
+Every file the assets reference is stored once, 4-byte aligned, next to a
+table of assets with their types and loop points. The firmware maps the
+partition and decodes straight out of flash; the layout is documented in
+main/src/SoundPack.h.
+
+Loop points come from "loop_points" in the JSON or, for a WAV loop file,
+from its smpl chunk, exactly as the firmware would read them from LittleFS.
+
+Install with:
+  curl -u user:pass -F file=@sounds.pack http://nimrs.local/api/sounds/pack
+
+Usage: mksoundpack.py [--dir DIR] [--size BYTES] sound_assets.json output
+"""
+
+import argparse
+import json
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b"NSPK"
+VERSION = 1
+HEADER_SIZE = 16
+FILE_ENTRY_SIZE = 40
+ASSET_ENTRY_SIZE = 48
+NAME_LEN = 28
+NO_FILE = 0xFFFF
+ALIGN = 4
+PARTITION_SIZE = 0x200000  # "sounds" in partitions.csv
+
+# Mirrors SoundType and AudioCodec in main/src
+TYPES = {"simple": 0, "complex_loop": 1, "toggle": 2}
+CODEC_UNKNOWN, CODEC_PCM, CODEC_ADPCM, CODEC_MP3 = range(4)
+
+
+def riff_chunks(data):
+    """Yields (tag, body) for each chunk of a RIFF/WAVE file."""
+    if len(data) < 12 or data[:4] != b"RIFF" or data[8:12] != b"WAVE":
+        return
+    pos = 12
+    while pos + 8 <= len(data):
+        tag = data[pos : pos + 4]
+        size = struct.unpack_from("<I", data, pos + 4)[0]
+        yield tag, data[pos + 8 : pos + 8 + size]
+        pos += 8 + size + (size & 1)
+
+
+def detect_codec(name, data):
+    for tag, body in riff_chunks(data):
+        if tag == b"fmt " and len(body) >= 2:
+            fmt = struct.unpack_from("<H", body)[0]
+            return {1: CODEC_PCM, 0x11: CODEC_ADPCM}.get(fmt, CODEC_UNKNOWN)
+    return CODEC_MP3 if name.lower().endswith(".mp3") else CODEC_UNKNOWN
+
+
+def smpl_loop(data):
+    """Sustain loop as (start, end exclusive) from a smpl chunk, or None."""
+    for tag, body in riff_chunks(data):
+        if tag == b"smpl" and len(body) >= 36 + 24:
+            if struct.unpack_from("<I", body, 28)[0] == 0:
+                return None
+            first, last = struct.unpack_from("<II", body, 36 + 8)
+            return (first, last + 1) if last >= first else None
+    return None
+
+
+def fixed_name(text, what):
+    raw = text.encode("utf-8")
+    if len(raw) > NAME_LEN:
+        print(f"Warning: {what} '{text}' truncated to {NAME_LEN} bytes")
+        raw = raw[:NAME_LEN]
+    return raw.ljust(NAME_LEN, b"\0")
+
+
+def build(config, base_dir):
+    files = []  # (name, codec, data)
+    by_name = {}
+    assets = []
+
+    def add_file(name):
+        name = name.lstrip("/")
+        if name not in by_name:
+            if len(name.encode("utf-8")) > NAME_LEN:
+                print(f"Error: file name '{name}' is longer than {NAME_LEN}")
+                sys.exit(1)
+            with open(os.path.join(base_dir, name), "rb") as f:
+                data = f.read()
+            codec = detect_codec(name, data)
+            if codec == CODEC_UNKNOWN:
+                print(f"Warning: {name} is not PCM/ADPCM WAV or MP3")
+            by_name[name] = len(files)
+            files.append((name, codec, data))
+        return by_name[name]
+
+    for obj in config.get("assets", []):
+        if obj.get("type") == "diesel":
+            print(
+                f"Skipping asset {obj.get('id')}: diesel engines load from "
+                "sound_assets.json on LittleFS, next to the pack"
+            )
+            continue
+        if obj.get("type") not in TYPES:
+            print(f"Skipping asset {obj.get('id')} (unknown type)")
+            continue
+        slots = []
+        for key in ("intro", "loop", "outro"):
+            name = obj.get("files", {}).get(key)
+            slots.append(add_file(name) if name else NO_FILE)
+
+        start, end = 0, 0
+        points = obj.get("loop_points", {})
+        if "end" in points:
+            start, end = points.get("start", 0), points["end"]
+        elif slots[1] != NO_FILE and files[slots[1]][1] != CODEC_MP3:
+            start, end = smpl_loop(files[slots[1]][2]) or (0, 0)
+        if end <= start:
+            start, end = 0, 0
+
+        assets.append(
+            struct.pack("<BBH3HH", obj["id"], TYPES[obj["type"]], 0, *slots, 0)
+            + struct.pack("<II", start, end)
+            + fixed_name(obj.get("name", ""), "asset name")
+        )
+
+    if len(assets) > 255:
+        print("Error: a pack holds at most 255 assets")
+        sys.exit(1)
+
+    tables = HEADER_SIZE + FILE_ENTRY_SIZE * len(files)
+    tables += ASSET_ENTRY_SIZE * len(assets)
+    offset = tables
+    entries, blobs = bytearray(), bytearray()
+    for name, codec, data in files:
+        pad = -offset % ALIGN
+        blobs += b"\0" * pad
+        offset += pad
+        entries += fixed_name(name, "file name")
+        entries += struct.pack("<B3xII", codec, offset, len(data))
+        blobs += data
+        offset += len(data)
+
+    body = bytes(entries) + b"".join(assets) + bytes(blobs)
+    header = MAGIC + struct.pack(
+        "<BBHII",
+        VERSION,
+        len(assets),
+        len(files),
+        HEADER_SIZE + len(body),
+        zlib.crc32(body) & 0xFFFFFFFF,
+    )
+    return header + body, files, len(assets)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("config", help="sound_assets.json")
+    parser.add_argument("output")
+    parser.add_argument(
+        "--dir", help="where the audio files are (default: next to the JSON)"
+    )
+    parser.add_argument(
+        "--size", type=int, default=PARTITION_SIZE, help="partition size"
+    )
+    args = parser.parse_args()
+
+    with open(args.config) as f:
+        config = json.load(f)
+    base_dir = args.dir or os.path.dirname(os.path.abspath(args.config))
+
+    try:
+        pack, files, asset_count = build(config, base_dir)
+    except FileNotFoundError as e:
+        print(f"Error: {e.filename} not found")
+        sys.exit(1)
+
+    if len(pack) > args.size:
+        print(f"Error: pack is {len(pack)} bytes, partition holds {args.size}")
+        sys.exit(1)
+
+    with open(args.output, "wb") as f:
+        f.write(pack)
+
+    codecs = ["?", "pcm", "adpcm", "mp3"]
+    for name, codec, data in files:
+        print(f"  {name:<{NAME_LEN}} {codecs[codec]:>5} {len(data):>8} bytes")
+    print(
+        f"{args.output}: {asset_count} assets, {len(files)} files, "
+        f"{len(pack)} bytes ({100 * len(pack) / args.size:.0f}% of partition)"
+    )
+
+
+if __name__ == "__main__":
+    main()
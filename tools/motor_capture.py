@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+"""
+NIMRS motor capture: client and decoder.
+
+The decoder records raw motor current samples and per-tick control state
+around a trigger (stall, fault, zone change, CV write or manual). The blob
+from /api/motor/capture/data is a 20-byte header, `cycles` 40-byte tick
+records, then `samples` uint16 ADC counts, all little-endian; the layout is
+CaptureHeader and CaptureCycle in main/src/MotorCapture.h.
+
+As a tool:
+    ./tools/motor_capture.py 192.168.1.100 arm [--trigger stall,fault]
+    ./tools/motor_capture.py 192.168.1.100 trigger
+    ./tools/motor_capture.py 192.168.1.100 status
+    ./tools/motor_capture.py 192.168.1.100 fetch -o capture.bin [--wait]
+    ./tools/motor_capture.py - decode capture.bin [--samples]
+
+decode prints the tick records as CSV, or with --samples one line per sample
+with its time, tick and current in amps.
+"""
+
+import argparse
+import base64
+import json
+import struct
+import sys
+import time
+import urllib.request
+from collections import namedtuple
+
+MAGIC = 0x5041434E  # "NCAP"
+VERSION = 1
+
+HEADER = struct.Struct("<IBBHIIHH")
+CYCLE = struct.Struct("<IIHBBBBH6f")
+
+MANUAL, STALL, FAULT, ZONE, CV_WRITE = 0x01, 0x02, 0x04, 0x08, 0x10
+
+Header = namedtuple(
+    "Header", "magic version fired cycles samples sample_rate_hz trigger_cycle"
+)
+Cycle = namedtuple(
+    "Cycle",
+    "time_us first_sample samples target zone flags triggers "
+    "duty current rpm ripple amps_per_count offset",
+)
+
+
+def decode(blob):
+    """Returns (Header, [Cycle], [sample counts]) for one capture blob."""
+    if len(blob) < HEADER.size:
+        raise ValueError("Short capture")
+    fields = HEADER.unpack_from(blob)
+    header = Header(*fields[:7])
+    if header.magic != MAGIC or header.version != VERSION:
+        raise ValueError(f"Not a capture v{VERSION}: {header.magic:#x}")
+    at = HEADER.size
+    if len(blob) != at + header.cycles * CYCLE.size + header.samples * 2:
+        raise ValueError("Length does not match the header")
+    cycles = []
+    for _ in range(header.cycles):
+        values = list(CYCLE.unpack_from(blob, at))
+        del values[7]  # reserved
+        cycles.append(Cycle(*values))
+        at += CYCLE.size
+    samples = list(struct.unpack_from(f"<{header.samples}H", blob, at))
+    return header, cycles, samples
+
+
+def amps(cycle, count):
+    """A raw sample of @p cycle in amps, as the firmware would compute it."""
+    return max(0.0, count - cycle.offset) * cycle.amps_per_count
+
+
+class CaptureClient:
+    def __init__(self, host, port=80, user="", password=""):
+        self.base = f"http://{host}:{port}/api/motor/capture"
+        self.auth = None
+        if user:
+            token = base64.b64encode(f"{user}:{password}".encode()).decode()
+            self.auth = f"Basic {token}"
+
+    def _request(self, path="", method="GET"):
+        request = urllib.request.Request(self.base + path, method=method)
+        if self.auth:
+            request.add_header("Authorization", self.auth)
+        with urllib.request.urlopen(request, timeout=10) as response:
+            return response.read()
+
+    def arm(self, trigger="manual,stall,fault", pre=20, post=15):
+        query = f"?trigger={trigger}&pre={pre}&post={post}"
+        return json.loads(self._request(query, "POST"))
+
+    def trigger(self):
+        self._request("/trigger", "POST")
+
+    def cancel(self):
+        self._request("", "DELETE")
+
+    def status(self):
+        return json.loads(self._request())
+
+    def wait(self, poll=0.5):
+        while True:
+            status = self.status()
+            if status["state"] not in ("armed", "triggered"):
+                return status
+            time.sleep(poll)
+
+    def data(self):
+        return self._request("/data")
+
+
+def print_decoded(blob, samples):
+    header, cycles, counts = decode(blob)
+    print(
+        f"# fired={header.fired:#x} cycles={header.cycles} "
+        f"samples={header.samples} rate={header.sample_rate_hz} Hz "
+        f"trigger_cycle={header.trigger_cycle}"
+    )
+    if not samples:
+        print(",".join(Cycle._fields))
+        for cycle in cycles:
+            print(",".join(str(v) for v in cycle))
+        return
+    print("t_s,cycle,count,amps")
+    period = 1.0 / header.sample_rate_hz if header.sample_rate_hz else 0.0
+    for n, cycle in enumerate(cycles):
+        for i in range(cycle.first_sample, cycle.first_sample + cycle.samples):
+            if i < len(counts):
+                c = counts[i]
+                print(f"{i * period:.6f},{n},{c},{amps(cycle, c):.4f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="NIMRS motor capture")
+    parser.add_argument("host", help="Decoder address ('-' for decode)")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--user", default="")
+    parser.add_argument("--password", default="")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    arm = sub.add_parser("arm", help="Start a capture")
+    arm.add_argument("--trigger", default="manual,stall,fault")
+    arm.add_argument("--pre", type=int, default=20)
+    arm.add_argument("--post", type=int, default=15)
+    sub.add_parser("trigger", help="Fire the manual trigger")
+    sub.add_parser("cancel", help="Drop the capture")
+    sub.add_parser("status", help="Show the capture state")
+    fetch = sub.add_parser("fetch", help="Download a finished capture")
+    fetch.add_argument("-o", "--output", default="capture.bin")
+    fetch.add_argument("--wait", action="store_true", help="Wait until done")
+    dec = sub.add_parser("decode", help="Print a downloaded capture as CSV")
+    dec.add_argument("file")
+    dec.add_argument("--samples", action="store_true")
+    args = parser.parse_args()
+
+    if args.command == "decode":
+        with open(args.file, "rb") as f:
+            print_decoded(f.read(), args.samples)
+        return 0
+
+    client = CaptureClient(args.host, args.port, args.user, args.password)
+    if args.command == "arm":
+        print(json.dumps(client.arm(args.trigger, args.pre, args.post)))
+    elif args.command == "trigger":
+        client.trigger()
+    elif args.command == "cancel":
+        client.cancel()
+    elif args.command == "status":
+        print(json.dumps(client.status()))
+    elif args.command == "fetch":
+        status = client.wait() if args.wait else client.status()
+        if status["state"] != "done":
+            print(f"No finished capture ({status['state']})", file=sys.stderr)
+            return 1
+        blob = client.data()
+        decode(blob)  # Validate before saving
+        with open(args.output, "wb") as f:
+            f.write(blob)
+        print(f"{len(blob)} bytes to {args.output}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
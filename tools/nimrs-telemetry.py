@@ -1,34 +1,22 @@
 #!/usr/bin/env python3
 """
 NIMRS Telemetry Tool
-Connects to the NIMRS Decoder HTTP API and streams motor telemetry data in real-time.
+Connects to the NIMRS Decoder telemetry WebSocket and shows motor telemetry
+in real-time.
 
 Usage:
-    ./tools/nimrs-telemetry.py <IP_ADDRESS>
+    ./tools/nimrs-telemetry.py <IP_ADDRESS> [DECIMATE]
 
 Example:
     ./tools/nimrs-telemetry.py 192.168.1.100
 """
 
+import os
 import sys
 import time
-import json
-import urllib.request
-import urllib.error
-import socket
 
-
-def get_logs(ip):
-    url = f"http://{ip}/api/logs?type=data"
-    try:
-        with urllib.request.urlopen(url, timeout=1) as response:
-            data = json.load(response)
-            return data
-    except (urllib.error.URLError, socket.timeout, ConnectionResetError) as e:
-        # Don't spam errors, just return empty to retry
-        return []
-    except json.JSONDecodeError:
-        return []
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from telemetry_stream import STALLED, TelemetryClient  # noqa: E402
 
 
 def draw_bar(label, value, max_val, width=10, color_code=""):
@@ -51,7 +39,7 @@ def draw_bar(label, value, max_val, width=10, color_code=""):
 
 def main():
     if len(sys.argv) < 2:
-        print("Usage: ./tools/nimrs-telemetry.py <IP_ADDRESS>")
+        print("Usage: ./tools/nimrs-telemetry.py <IP_ADDRESS> [DECIMATE]")
         sys.exit(1)
 
     ip = sys.argv[1]
@@ -76,57 +64,41 @@ def main():
     print("-" * 65)
     print("Press Ctrl+C to exit.")
 
-    last_processed_line = None
+    decimate = int(sys.argv[2]) if len(sys.argv) > 2 else 5  # 10 Hz
 
     try:
         while True:
-            logs = get_logs(ip)
-
-            # Find the *latest* telemetry line
-            telemetry_line = None
-            for line in reversed(logs):
-                if "[NIMRS_DATA]" in line:
-                    telemetry_line = line
-                    break
-
-            if telemetry_line and telemetry_line != last_processed_line:
-                last_processed_line = telemetry_line
-                try:
-                    # Expected: [NIMRS_DATA],target,speed,pwm,avg_i,fast_i,peak
-                    parts = telemetry_line.split("[NIMRS_DATA],")[1].split(",")
-
-                    target = int(parts[0])
-                    speed = float(parts[1])
-                    pwm = int(parts[2])
-                    avg_i = float(parts[3])
-                    fast_i = float(parts[4])
-                    peak_adc = int(parts[5])
-
-                    # Status Indicator
-                    if avg_i > 1.2:
-                        status = f"{RED}[WARN] {RESET}"
-                    else:
-                        status = f"{GREEN}[OK]   {RESET}"
-
-                    # Move cursor to line 4
-                    sys.stdout.write("\033[4;1H")
-
-                    # Construct and print the dashboard
-                    print(f"{draw_bar('TARGET', target, 28, 30, BLUE)}")
-                    print(f"{draw_bar('SPEED ', speed, 28, 30, GREEN)}")
-                    print(f"{draw_bar('POWER ', pwm, 1023, 30, YELLOW)}")
-
-                    print(
-                        f"{draw_bar('AMPS  ', avg_i, 2.0, 30, RED)} | FAST: {fast_i:.3f} | PEAK: {peak_adc:4d}"
-                    )
-                    print(f"                                      | {status}      ")
-
-                    sys.stdout.flush()
-
-                except (IndexError, ValueError):
-                    pass
-
-            time.sleep(0.1)
+            try:
+                with TelemetryClient(ip, decimate=decimate) as client:
+                    for frame in client.frames():
+                        if frame.flags & STALLED:
+                            status = f"{RED}[STALL]{RESET}"
+                        elif frame.current > 1.2:
+                            status = f"{RED}[WARN] {RESET}"
+                        else:
+                            status = f"{GREEN}[OK]   {RESET}"
+
+                        # Move cursor to line 4
+                        sys.stdout.write("\033[4;1H")
+
+                        # Construct and print the dashboard
+                        print(f"{draw_bar('TARGET', frame.target, 126, 30, BLUE)}")
+                        print(f"{draw_bar('RPM   ', frame.rpm, 10000, 30, GREEN)}")
+                        print(
+                            f"{draw_bar('DUTY %', abs(frame.duty) * 100, 100, 30, YELLOW)}"
+                        )
+                        print(
+                            f"{draw_bar('AMPS  ', frame.current, 2.0, 30, RED)} "
+                            f"| ZONE: {frame.zone} | RIPPLE: {frame.ripple:6.1f} Hz"
+                        )
+                        print(
+                            f"                                      | {status} "
+                            f"dropped {client.dropped}   "
+                        )
+                        sys.stdout.flush()
+            except (OSError, ConnectionError, ValueError):
+                # Decoder rebooting or out of range: try again shortly
+                time.sleep(1.0)
 
     except KeyboardInterrupt:
         print(f"{SHOW_CURSOR}\nExiting...")
@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+"""
+NIMRS CPU report: client and decoder for /api/perf.
+
+The decoder samples every task's CPU load and stack high-water mark once a
+second, and keeps period and busy-time histograms for its instrumented
+loops (the motor ISR, MotorTask, ControlPlane, loopTask, ...). The blob from
+/api/perf?format=bin is a 16-byte header, `tasks` 28-byte task records, then
+the rest of its `count` records as 332-byte loop records, all little-endian;
+the layout is PerfHeader, PerfTaskRecord and PerfLoopRecord in
+main/src/PerfMonitor.h. The header opens like a telemetry stream message
+(magic, version, record count; see tools/telemetry_stream.py).
+
+As a tool:
+    ./tools/perf_report.py 192.168.1.100 show [--watch 2]
+    ./tools/perf_report.py 192.168.1.100 fetch -o perf.bin
+    ./tools/perf_report.py 192.168.1.100 reset
+    ./tools/perf_report.py - decode perf.bin
+
+show and decode print the tasks by load, then each loop's period and busy
+time: the last window's mean, percentiles since reset (read off the
+histogram, so to within a bucket) and the maximum.
+"""
+
+import argparse
+import base64
+import struct
+import sys
+import time
+import urllib.request
+from collections import namedtuple
+
+MAGIC = 0x504E  # "NP"
+VERSION = 2
+BUCKETS = 36
+
+HEADER = struct.Struct("<HBBBBxxII")
+TASK = struct.Struct("<16sBBHHHI")
+HIST = struct.Struct(f"<Iff{BUCKETS}I")
+LOOP = struct.Struct("<16sHH")
+
+Header = namedtuple("Header", "magic version count tasks buckets window_ms uptime_ms")
+Task = namedtuple("Task", "name core priority load peak stack_free_min")
+Hist = namedtuple("Hist", "count mean_us max_us buckets")
+Loop = namedtuple("Loop", "name load period busy")
+
+
+def bucket_low_us(bucket):
+    """Where bucket @p bucket starts, as perfBucketLowUs() has it."""
+    if bucket < 2:
+        return bucket
+    low = 1 << (bucket // 2)
+    return low + low // 2 if bucket & 1 else low
+
+
+def percentile(hist, fraction):
+    """The upper edge of the bucket holding @p fraction of the counts."""
+    total = sum(hist.buckets)
+    if not total:
+        return 0.0
+    seen = 0
+    for b, n in enumerate(hist.buckets):
+        seen += n
+        if seen >= fraction * total:
+            return bucket_low_us(b + 1) if b + 1 < BUCKETS else hist.max_us
+    return hist.max_us
+
+
+def _name(raw):
+    return raw.split(b"\0", 1)[0].decode(errors="replace")
+
+
+def _hist(blob, at):
+    values = HIST.unpack_from(blob, at)
+    return Hist(values[0], values[1], values[2], list(values[3:]))
+
+
+def decode(blob):
+    """Returns (Header, [Task], [Loop]) for one report blob."""
+    if len(blob) < HEADER.size:
+        raise ValueError("Short report")
+    header = Header(*HEADER.unpack_from(blob))
+    if header.magic != MAGIC or header.version != VERSION:
+        raise ValueError(f"Not a perf report v{VERSION}: {header.magic:#x}")
+    if header.tasks > header.count:
+        raise ValueError("More tasks than records")
+    if header.buckets != BUCKETS:
+        raise ValueError(f"{header.buckets} buckets, expected {BUCKETS}")
+    loop_size = LOOP.size + 2 * HIST.size
+    at = HEADER.size
+    loop_count = header.count - header.tasks
+    if len(blob) != at + header.tasks * TASK.size + loop_count * loop_size:
+        raise ValueError("Length does not match the header")
+    tasks = []
+    for _ in range(header.tasks):
+        name, core, prio, load, peak, _, stack = TASK.unpack_from(blob, at)
+        core = None if core == 0xFF else core
+        tasks.append(Task(_name(name), core, prio, load / 10, peak / 10, stack))
+        at += TASK.size
+    loops = []
+    for _ in range(loop_count):
+        name, load, _ = LOOP.unpack_from(blob, at)
+        period = _hist(blob, at + LOOP.size)
+        busy = _hist(blob, at + LOOP.size + HIST.size)
+        loops.append(Loop(_name(name), load / 10, period, busy))
+        at += loop_size
+    return header, tasks, loops
+
+
+def cores(tasks):
+    """{core: load %}, from what each core's idle task did not get."""
+    return {
+        t.core: 100.0 - t.load
+        for t in tasks
+        if t.name.startswith("IDLE") and t.core is not None
+    }
+
+
+def print_report(blob):
+    header, tasks, loops = decode(blob)
+    load = ", ".join(f"core {c} {v:.1f}%" for c, v in sorted(cores(tasks).items()))
+    print(
+        f"# uptime {header.uptime_ms / 1000:.1f} s, "
+        f"window {header.window_ms} ms{', ' + load if load else ''}"
+    )
+    if tasks:
+        print(
+            f"{'task':16} {'core':>4} {'prio':>4} {'load%':>6} {'peak%':>6} "
+            f"{'stack_free':>10}"
+        )
+        for t in sorted(tasks, key=lambda t: -t.load):
+            core = "-" if t.core is None else t.core
+            print(
+                f"{t.name:16} {core:>4} {t.priority:>4} {t.load:6.1f} "
+                f"{t.peak:6.1f} {t.stack_free_min:10}"
+            )
+    if loops:
+        print()
+        print(
+            f"{'loop':16} {'':6} {'count':>9} {'mean_us':>9} {'p50':>8} "
+            f"{'p99':>8} {'max_us':>9} {'load%':>6}"
+        )
+        for l in loops:
+            for kind, h in (("period", l.period), ("busy", l.busy)):
+                load = f"{l.load:6.1f}" if kind == "busy" else ""
+                print(
+                    f"{l.name if kind == 'period' else '':16} {kind:6} "
+                    f"{h.count:9} {h.mean_us:9.1f} {percentile(h, 0.5):8.0f} "
+                    f"{percentile(h, 0.99):8.0f} {h.max_us:9.1f} {load}"
+                )
+
+
+class PerfClient:
+    def __init__(self, host, port=80, user="", password=""):
+        self.base = f"http://{host}:{port}/api/perf"
+        self.auth = None
+        if user:
+            token = base64.b64encode(f"{user}:{password}".encode()).decode()
+            self.auth = f"Basic {token}"
+
+    def _request(self, path="", method="GET"):
+        request = urllib.request.Request(self.base + path, method=method)
+        if self.auth:
+            request.add_header("Authorization", self.auth)
+        with urllib.request.urlopen(request, timeout=10) as response:
+            return response.read()
+
+    def data(self):
+        return self._request("?format=bin")
+
+    def reset(self):
+        self._request("", "DELETE")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="NIMRS CPU report")
+    parser.add_argument("host", help="Decoder address ('-' for decode)")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--user", default="")
+    parser.add_argument("--password", default="")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    show = sub.add_parser("show", help="Print the report")
+    show.add_argument("--watch", type=float, help="Repeat every N seconds")
+    fetch = sub.add_parser("fetch", help="Save the binary report")
+    fetch.add_argument("-o", "--output", default="perf.bin")
+    sub.add_parser("reset", help="Clear the histograms and peaks")
+    dec = sub.add_parser("decode", help="Print a saved report")
+    dec.add_argument("file")
+    args = parser.parse_args()
+
+    if args.command == "decode":
+        with open(args.file, "rb") as f:
+            print_report(f.read())
+        return 0
+
+    client = PerfClient(args.host, args.port, args.user, args.password)
+    if args.command == "show":
+        while True:
+            print_report(client.data())
+            if not args.watch:
+                break
+            time.sleep(args.watch)
+            print()
+    elif args.command == "fetch":
+        blob = client.data()
+        decode(blob)  # Validate before saving
+        with open(args.output, "wb") as f:
+            f.write(blob)
+        print(f"{len(blob)} bytes to {args.output}")
+    elif args.command == "reset":
+        client.reset()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
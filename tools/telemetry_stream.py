@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+"""
+NIMRS binary telemetry: decoder and WebSocket client.
+
+The decoder streams control frames on ws://<ip>/ws/telemetry. Each binary
+message is an 8-byte header followed by `count` 36-byte frames, all
+little-endian; the layout is TelemetryFrame in main/src/TelemetryStream.h.
+
+As a library:
+    from telemetry_stream import TelemetryClient
+    with TelemetryClient("192.168.1.100", decimate=1) as client:
+        for frame in client.frames():
+            print(frame.seq, frame.rpm)
+
+As a tool, prints frames as CSV, or with --rate the achieved frame rate, or
+with --schema every channel the firmware publishes (/api/telemetry/schema):
+    ./tools/telemetry_stream.py 192.168.1.100 [--decimate N] [--rate]
+    ./tools/telemetry_stream.py 192.168.1.100 --schema
+"""
+
+import argparse
+import base64
+import json
+import os
+import socket
+import struct
+import sys
+import time
+import urllib.request
+from collections import namedtuple
+
+MAGIC = 0x544E  # "NT"
+VERSION = 1
+
+HEADER = struct.Struct("<HBBI")
+FRAME = struct.Struct("<IIBBBx6f")
+
+FORWARD, MOVING, STALLED, FAULT = 0x01, 0x02, 0x04, 0x08
+
+Frame = namedtuple(
+    "Frame",
+    "seq time_us target zone flags duty current rpm ripple ke resistance",
+)
+
+
+def decode(message):
+    """Returns (dropped, [Frame]) for one binary message."""
+    if len(message) < HEADER.size:
+        raise ValueError("Short message")
+    magic, version, count, dropped = HEADER.unpack_from(message)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError(f"Not telemetry v{VERSION}: {magic:#x} v{version}")
+    if len(message) != HEADER.size + count * FRAME.size:
+        raise ValueError("Length does not match the frame count")
+    frames = [
+        Frame(*FRAME.unpack_from(message, HEADER.size + i * FRAME.size))
+        for i in range(count)
+    ]
+    return dropped, frames
+
+
+def schema(host, port=80, user="", password=""):
+    """Returns the firmware's channel list: [{name, unit, type, rate_hz}]."""
+    request = urllib.request.Request(f"http://{host}:{port}/api/telemetry/schema")
+    if user:
+        token = base64.b64encode(f"{user}:{password}".encode()).decode()
+        request.add_header("Authorization", f"Basic {token}")
+    with urllib.request.urlopen(request, timeout=5) as response:
+        return json.load(response)
+
+
+class TelemetryClient:
+    """Minimal WebSocket client (RFC 6455), enough for the stream."""
+
+    def __init__(self, host, port=80, decimate=1, user="", password=""):
+        self.host = host
+        self.port = port
+        self.decimate = decimate
+        self.user = user
+        self.password = password
+        self.sock = None
+        self.dropped = 0  # As last reported by the decoder
+
+    def __enter__(self):
+        self.connect()
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def connect(self):
+        self.sock = socket.create_connection((self.host, self.port), timeout=5)
+        key = base64.b64encode(os.urandom(16)).decode()
+        request = (
+            f"GET /ws/telemetry?decimate={self.decimate} HTTP/1.1\r\n"
+            f"Host: {self.host}\r\n"
+            "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+            f"Sec-WebSocket-Key: {key}\r\nSec-WebSocket-Version: 13\r\n"
+        )
+        if self.user:
+            token = base64.b64encode(f"{self.user}:{self.password}".encode())
+            request += f"Authorization: Basic {token.decode()}\r\n"
+        self.sock.sendall((request + "\r\n").encode())
+        response = b""
+        while b"\r\n\r\n" not in response:
+            chunk = self.sock.recv(1024)
+            if not chunk:
+                raise ConnectionError("Closed during the handshake")
+            response += chunk
+        if b" 101 " not in response.split(b"\r\n", 1)[0]:
+            raise ConnectionError(response.split(b"\r\n", 1)[0].decode())
+        self._buffer = response.split(b"\r\n\r\n", 1)[1]
+
+    def set_decimation(self, decimate):
+        self._send(0x1, str(decimate).encode())
+
+    def close(self):
+        if self.sock:
+            try:
+                self._send(0x8, b"")
+            except OSError:
+                pass
+            self.sock.close()
+            self.sock = None
+
+    def frames(self):
+        """Yields frames as they arrive, until the connection closes."""
+        while True:
+            opcode, payload = self._receive()
+            if opcode == 0x8:
+                return
+            if opcode == 0x9:
+                self._send(0xA, payload)  # Pong
+            elif opcode == 0x2:
+                self.dropped, frames = decode(payload)
+                yield from frames
+
+    def _send(self, opcode, payload):
+        # Client frames are masked
+        mask = os.urandom(4)
+        head = bytes([0x80 | opcode])
+        if len(payload) < 126:
+            head += bytes([0x80 | len(payload)])
+        else:
+            head += bytes([0x80 | 126]) + struct.pack(">H", len(payload))
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.sendall(head + mask + masked)
+
+    def _read(self, n):
+        while len(self._buffer) < n:
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError("Connection closed")
+            self._buffer += chunk
+        data, self._buffer = self._buffer[:n], self._buffer[n:]
+        return data
+
+    def _receive(self):
+        first, second = self._read(2)
+        length = second & 0x7F
+        if length == 126:
+            (length,) = struct.unpack(">H", self._read(2))
+        elif length == 127:
+            (length,) = struct.unpack(">Q", self._read(8))
+        return first & 0x0F, self._read(length)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="NIMRS telemetry stream")
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--decimate", type=int, default=1)
+    parser.add_argument("--user", default="")
+    parser.add_argument("--password", default="")
+    parser.add_argument(
+        "--rate", action="store_true", help="Report frames/s instead of data"
+    )
+    parser.add_argument(
+        "--schema", action="store_true", help="List the telemetry channels"
+    )
+    args = parser.parse_args()
+
+    if args.schema:
+        for ch in schema(args.host, args.port, args.user, args.password):
+            print(f"{ch['name']:16} {ch['type']:4} {ch['rate_hz']:4} Hz  {ch['unit']}")
+        return 0
+
+    with TelemetryClient(
+        args.host, args.port, args.decimate, args.user, args.password
+    ) as client:
+        client.sock.settimeout(None)
+        if not args.rate:
+            print(",".join(Frame._fields))
+        count, start = 0, time.monotonic()
+        try:
+            for frame in client.frames():
+                if not args.rate:
+                    print(",".join(str(v) for v in frame))
+                    continue
+                count += 1
+                elapsed = time.monotonic() - start
+                if elapsed >= 1.0:
+                    print(f"{count / elapsed:7.1f} frames/s, {client.dropped} dropped")
+                    count, start = 0, time.monotonic()
+        except KeyboardInterrupt:
+            pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,12 +1,220 @@
 #!/usr/bin/env python3
+import argparse
+import json
 import os
 import sys
 import glob
 import re
 import subprocess
 
+BASELINE = "tests/bench_baseline.json"
+RESULTS = "tests/bin/bench_results.json"
+DEFAULT_TOLERANCE = 1.0  # ns/op may double before it fails
+BENCH_RUNS = 3
+TWIN_MAIN = "tests/twin/twin_main.cpp"
+TWIN_GEN = "tests/bin/twin"  # Generated headers, ahead of the mocks
+DEFAULT_TWIN_PORT = 8080
+
+
+def read_metadata(content):
+    """Returns (TEST_SOURCES or None when absent, TEST_FLAGS) of a source."""
+    sources = None
+    flags = []
+    # [ \t], not \s: an empty TEST_SOURCES must not run into the next line
+    match = re.search(r"//[ \t]*TEST_SOURCES:[ \t]*(.*)", content)
+    if match:
+        sources = match.group(1).split()
+    match = re.search(r"//[ \t]*TEST_FLAGS:[ \t]*(.*)", content)
+    if match:
+        flags = match.group(1).split()
+    return sources, flags
+
+
+def compile_test(cxx, cxxflags, source, sources, extra_flags):
+    """Builds tests/bin/<name>; returns its path, or None on failure."""
+    name = os.path.basename(source).replace(".cpp", "")
+    output_bin = os.path.join("tests/bin", name)
+    # Split flags safely? Assumes space separation
+    # TEST_FLAGS go first, so their -I directories (tests/sim) shadow
+    # the mocks
+    cmd = [cxx] + extra_flags + cxxflags.split() + ["-o", output_bin, source] + sources
+
+    print(f"  Compiling: {' '.join(cmd)}")
+    result = subprocess.run(cmd, capture_output=True, text=True)
+
+    if result.returncode != 0:
+        print(f"  COMPILATION FAILED:")
+        print(result.stderr)
+        return None
+    return output_bin
+
+
+def compare(results, baseline, tolerance):
+    """Returns the regressions of @p results against @p baseline.
+
+    Time regresses past baseline * (1 + tolerance); allocations are
+    deterministic, so any increase regresses.
+    """
+    regressions = []
+    for name, now in sorted(results.items()):
+        base = baseline.get(name)
+        if base is None:
+            print(f"  {name}: {now['ns_per_op']:.2f} ns/op (new, no baseline)")
+            continue
+        ratio = now["ns_per_op"] / base["ns_per_op"] if base["ns_per_op"] else 1
+        line = (
+            f"  {name}: {now['ns_per_op']:.2f} ns/op ({ratio:.2f}x), "
+            f"{now['allocs_per_op']:g} allocs/op (was {base['allocs_per_op']:g})"
+        )
+        if ratio > 1 + tolerance:
+            regressions.append(f"{name}: {ratio:.2f}x slower")
+            line += "  SLOWER"
+        if now["allocs_per_op"] > base["allocs_per_op"] + 1e-9:
+            regressions.append(f"{name}: allocates more")
+            line += "  ALLOCATES"
+        print(line)
+    for name in sorted(set(baseline) - set(results)):
+        print(f"  {name}: in the baseline but not measured")
+    return regressions
+
+
+def run_benchmarks(cxx, cxxflags, args):
+    """Builds and runs every tests/bench_*.cpp, from its TEST_SOURCES."""
+    results = {}
+    failed = []
+    for bench_file in sorted(glob.glob("tests/bench_*.cpp")):
+        with open(bench_file, "r") as f:
+            sources, extra_flags = read_metadata(f.read())
+        name = os.path.basename(bench_file).replace(".cpp", "")
+        if sources is None:
+            # Not skipped quietly: a bench nobody runs rots
+            print(f"\n[{name}] No TEST_SOURCES line; add one (may be empty)")
+            failed.append(name)
+            continue
+        print(f"\n[{name}] Processing...")
+        output_bin = compile_test(cxx, cxxflags, bench_file, sources, extra_flags)
+        if output_bin is None:
+            failed.append(name)
+            continue
+        # Each case keeps its best time over the runs: noise only adds
+        for _ in range(BENCH_RUNS):
+            run = subprocess.run(
+                [os.path.abspath(output_bin)], capture_output=True, text=True
+            )
+            if run.returncode != 0:
+                print(run.stdout + run.stderr)
+                failed.append(name)
+                break
+            for line in run.stdout.splitlines():
+                if not line.startswith("BENCH "):
+                    continue
+                entry = json.loads(line[len("BENCH ") :])
+                best = results.setdefault(entry.pop("name"), entry)
+                best["ns_per_op"] = min(best["ns_per_op"], entry["ns_per_op"])
+                best["allocs_per_op"] = max(
+                    best["allocs_per_op"], entry["allocs_per_op"]
+                )
+
+    with open(RESULTS, "w") as f:
+        json.dump(results, f, indent=2, sort_keys=True)
+        f.write("\n")
+    print(f"\nWrote {len(results)} results to {RESULTS}")
+    if failed:
+        print(f"FAILURES: {', '.join(failed)}")
+        return 1
+
+    if args.update_baseline:
+        with open(BASELINE, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print(f"Updated {BASELINE}")
+        return 0
+    if not os.path.exists(BASELINE):
+        print(f"No {BASELINE}; run with --update-baseline to record one")
+        return 0
+    with open(BASELINE, "r") as f:
+        baseline = json.load(f)
+    print(f"Against {BASELINE}, tolerance {args.tolerance:.0%}:")
+    regressions = compare(results, baseline, args.tolerance)
+    if regressions:
+        print(f"REGRESSIONS: {len(regressions)}")
+        for r in regressions:
+            print(f" - {r}")
+        return 1
+    print("No regressions.")
+    return 0
+
+
+def embed_twin_assets():
+    """Gzips the dashboard into TWIN_GEN/WebAssetsGz.h, as the build does."""
+    os.makedirs(TWIN_GEN, exist_ok=True)
+    inputs = ["src/WebAssets.h"]
+    if os.path.exists("src/LameJs.h"):
+        inputs.append("src/LameJs.h")
+    else:
+        # Fetched by tools/generate_lamejs_header.py; without it only the
+        # dashboard's in-browser MP3 encoding is missing
+        stand_in = os.path.join(TWIN_GEN, "LameJs.h")
+        with open(stand_in, "w") as f:
+            f.write(
+                "const char LAME_MIN_JS[] PROGMEM = "
+                'R"rawliteral(console.warn("lame.min.js not embedded");'
+                ')rawliteral";\n'
+            )
+        inputs.append(stand_in)
+    cmd = [sys.executable, "tools/embed_web_assets.py"]
+    cmd += [os.path.join(TWIN_GEN, "WebAssetsGz.h")] + inputs
+    return subprocess.run(cmd, capture_output=True, text=True).returncode == 0
+
+
+def run_twin(cxx, cxxflags, args):
+    """Builds the firmware as a host process and serves it until Ctrl-C."""
+    with open(TWIN_MAIN, "r") as f:
+        sources, extra_flags = read_metadata(f.read())
+    if not embed_twin_assets():
+        print("Embedding the web assets failed")
+        return 1
+    print("[twin] Building the firmware for the host...")
+    output_bin = compile_test(
+        cxx, cxxflags, TWIN_MAIN, sources, ["-I" + TWIN_GEN] + extra_flags
+    )
+    if output_bin is None:
+        return 1
+    try:
+        return subprocess.call([os.path.abspath(output_bin), "--port", str(args.port)])
+    except KeyboardInterrupt:
+        return 0
+
 
 def main():
+    parser = argparse.ArgumentParser(description="Host tests and benchmarks")
+    parser.add_argument(
+        "--bench", action="store_true", help="Run tests/bench_*.cpp instead"
+    )
+    parser.add_argument(
+        "--update-baseline",
+        action="store_true",
+        help=f"With --bench, store the results as {BASELINE}",
+    )
+    parser.add_argument(
+        "--tolerance",
+        type=float,
+        default=DEFAULT_TOLERANCE,
+        help="With --bench, allowed slowdown as a fraction (1.0 = twice as slow)",
+    )
+    parser.add_argument(
+        "--twin",
+        action="store_true",
+        help="Build the firmware for the host and serve its API and dashboard",
+    )
+    parser.add_argument(
+        "--port",
+        type=int,
+        default=DEFAULT_TWIN_PORT,
+        help="With --twin, the localhost port to serve on",
+    )
+    args = parser.parse_args()
+
     # Setup environment
     cxx = os.environ.get("CXX", "g++")
     # Default flags from Makefile: -std=c++17 -Itests/mocks -Itests/mocks/freertos -Isrc -Wall
@@ -25,14 +233,6 @@ def main():
         with open("config.h", "w") as dst:
             dst.write(content)
 
-    # Locate tests
-    test_files = glob.glob("tests/test_*.cpp")
-    if not test_files:
-        print("No tests found in tests/")
-        sys.exit(0)
-
-    print(f"Found {len(test_files)} tests.")
-
     # Ensure config.h exists for tests
     config_created = False
     if not os.path.exists("config.h"):
@@ -43,6 +243,23 @@ def main():
             )
         config_created = True
 
+    if args.bench or args.twin:
+        if args.twin:
+            status = run_twin(cxx, cxxflags, args)
+        else:
+            status = run_benchmarks(cxx, cxxflags, args)
+        if config_created:
+            os.remove("config.h")
+        sys.exit(status)
+
+    # Locate tests
+    test_files = glob.glob("tests/test_*.cpp")
+    if not test_files:
+        print("No tests found in tests/")
+        sys.exit(0)
+
+    print(f"Found {len(test_files)} tests.")
+
     failed_tests = []
 
     for test_file in test_files:
@@ -57,19 +274,12 @@ def main():
         with open(test_file, "r") as f:
             content = f.read()
             # Check for metadata
-            match = re.search(r"//\s*TEST_SOURCES:\s*(.*)", content)
-            if match:
+            meta_sources, extra_flags = read_metadata(content)
+            if meta_sources is not None:
                 has_metadata = True
-                sources_str = match.group(1).strip()
-                if sources_str:
-                    sources = sources_str.split()
+                sources = meta_sources
                 print(f"  Metadata found: {sources}")
-
-            match_flags = re.search(r"//\s*TEST_FLAGS:\s*(.*)", content)
-            if match_flags:
-                flags_str = match_flags.group(1).strip()
-                if flags_str:
-                    extra_flags = flags_str.split()
+            if extra_flags:
                 print(f"  Flags found: {extra_flags}")
 
             if not has_metadata:
@@ -99,31 +309,9 @@ def main():
 
                 print(f"  Heuristics resolved: {sources}")
 
-            # Check for flags
-            match_flags = re.search(r"//\s*TEST_FLAGS:\s*(.*)", content)
-            if match_flags:
-                flags_str = match_flags.group(1).strip()
-                if flags_str:
-                    extra_flags = flags_str.split()
-                print(f"  Flags found: {extra_flags}")
-
         # Compile
-        output_bin = os.path.join("tests/bin", test_name)
-        # Split flags safely? Assumes space separation
-        cmd = (
-            [cxx]
-            + cxxflags.split()
-            + extra_flags
-            + ["-o", output_bin, test_file]
-            + sources
-        )
-
-        print(f"  Compiling: {' '.join(cmd)}")
-        result = subprocess.run(cmd, capture_output=True, text=True)
-
-        if result.returncode != 0:
-            print(f"  COMPILATION FAILED:")
-            print(result.stderr)
+        output_bin = compile_test(cxx, cxxflags, test_file, sources, extra_flags)
+        if output_bin is None:
             failed_tests.append(test_name)
             continue
 
@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+"""
+NIMRS event trace: client, decoder and Chrome trace converter.
+
+The decoder records begin, end and instant events from its tasks and
+interrupts into a ring per core (see main/src/TraceRecorder.h). The blob
+from /api/trace/data is a 16-byte header, a 16-byte clock anchor per core,
+the event names (a length byte then the bytes), 16-byte task names, then the
+16-byte events of core 0 and of core 1, each oldest first, all
+little-endian.
+
+Each core counts its own cycles, so event times are placed through that
+core's anchor: an esp_timer µs reading taken with a cycle count at most a
+second before the core's last event. Going back from there, gaps between a
+core's consecutive events are taken to be under 8.9 s (2^31 cycles).
+
+As a tool:
+    ./tools/trace_dump.py 192.168.1.100 start [--categories motor,dcc,http]
+    ./tools/trace_dump.py 192.168.1.100 status
+    ./tools/trace_dump.py 192.168.1.100 fetch -o trace.json [--raw trace.bin]
+    ./tools/trace_dump.py 192.168.1.100 clear
+    ./tools/trace_dump.py - convert trace.bin -o trace.json
+
+fetch stops the recording. Open the JSON in https://ui.perfetto.dev or
+chrome://tracing: a track per task, and one per core for interrupts.
+"""
+
+import argparse
+import base64
+import json
+import struct
+import sys
+import urllib.request
+from collections import namedtuple
+
+MAGIC = 0x4352544E  # "NTRC"
+VERSION = 1
+
+HEADER = struct.Struct("<IBBHHHB3x")
+CORE = struct.Struct("<QII")
+TASK = struct.Struct("<16s")
+EVENT = struct.Struct("<IIHBBB3x")
+
+BEGIN, END, INSTANT = 0, 1, 2
+ISR_TASK = 0xFF
+CATEGORIES = {0x01: "isr", 0x02: "motor", 0x04: "dcc", 0x08: "http", 0x10: "audio"}
+
+Header = namedtuple("Header", "magic version cores cpu_mhz names tasks categories")
+Core = namedtuple("Core", "anchor_us anchor_cycles events")
+Event = namedtuple("Event", "core time_us name task type category arg")
+
+
+def _signed(value):
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def decode(blob):
+    """Returns (Header, [task name], [Event]) with times in µs of esp_timer."""
+    if len(blob) < HEADER.size:
+        raise ValueError("Short trace")
+    header = Header(*HEADER.unpack_from(blob))
+    if header.magic != MAGIC or header.version != VERSION:
+        raise ValueError(f"Not a trace v{VERSION}: {header.magic:#x}")
+    at = HEADER.size
+    cores = []
+    for _ in range(header.cores):
+        cores.append(Core(*CORE.unpack_from(blob, at)))
+        at += CORE.size
+    names = []
+    for _ in range(header.names):
+        length = blob[at]
+        names.append(blob[at + 1 : at + 1 + length].decode(errors="replace"))
+        at += 1 + length
+    tasks = []
+    for _ in range(header.tasks):
+        (raw,) = TASK.unpack_from(blob, at)
+        tasks.append(raw.split(b"\0", 1)[0].decode(errors="replace"))
+        at += TASK.size
+    if len(blob) != at + sum(c.events for c in cores) * EVENT.size:
+        raise ValueError("Length does not match the header")
+
+    events = []
+    mhz = header.cpu_mhz or 240
+    for n, core in enumerate(cores):
+        raw = [EVENT.unpack_from(blob, at + i * EVENT.size) for i in range(core.events)]
+        at += core.events * EVENT.size
+        if not raw:
+            continue
+        # Unwrap the 32-bit counts: the newest against the anchor, then back
+        cycles = [0] * len(raw)
+        last = raw[-1][0]
+        cycles[-1] = core.anchor_cycles + _signed(
+            (last - core.anchor_cycles) & 0xFFFFFFFF
+        )
+        for i in range(len(raw) - 2, -1, -1):
+            step = _signed((raw[i + 1][0] - raw[i][0]) & 0xFFFFFFFF)
+            cycles[i] = cycles[i + 1] - step
+        for (_, arg, name, task, kind, category), c in zip(raw, cycles):
+            time_us = core.anchor_us + (c - core.anchor_cycles) / mhz
+            label = names[name] if name < len(names) else "?"
+            events.append(Event(n, time_us, label, task, kind, category, _signed(arg)))
+    return header, tasks, events
+
+
+def to_chrome(header, tasks, events):
+    """The trace as a Chrome trace event dict, times from the first event."""
+    out = []
+    pid = 1
+    out.append(
+        {"name": "process_name", "ph": "M", "pid": pid, "args": {"name": "NIMRS"}}
+    )
+    for t, name in enumerate(tasks):
+        out.append(
+            {
+                "name": "thread_name",
+                "ph": "M",
+                "pid": pid,
+                "tid": t,
+                "args": {"name": name},
+            }
+        )
+    for core in range(header.cores):
+        out.append(
+            {
+                "name": "thread_name",
+                "ph": "M",
+                "pid": pid,
+                "tid": 1000 + core,
+                "args": {"name": f"ISR core {core}"},
+            }
+        )
+
+    start = min((e.time_us for e in events), default=0)
+    open_scopes = {}
+    ordered = sorted(enumerate(events), key=lambda p: (p[1].time_us, p[0]))
+    for _, e in ordered:
+        tid = 1000 + e.core if e.task == ISR_TASK else e.task
+        record = {
+            "name": e.name,
+            "cat": CATEGORIES.get(e.category, str(e.category)),
+            "ts": round(e.time_us - start, 3),
+            "pid": pid,
+            "tid": tid,
+        }
+        if e.type == BEGIN:
+            record["ph"] = "B"
+            open_scopes[tid] = open_scopes.get(tid, 0) + 1
+        elif e.type == END:
+            # The ring may have lost the begin
+            if not open_scopes.get(tid):
+                continue
+            open_scopes[tid] -= 1
+            record["ph"] = "E"
+        else:
+            record["ph"] = "i"
+            record["s"] = "t"
+        if e.type != END:
+            record["args"] = {"arg": e.arg, "core": e.core}
+        out.append(record)
+    return {"traceEvents": out, "displayTimeUnit": "ns"}
+
+
+class TraceClient:
+    def __init__(self, host, port=80, user="", password=""):
+        self.base = f"http://{host}:{port}/api/trace"
+        self.auth = None
+        if user:
+            token = base64.b64encode(f"{user}:{password}".encode()).decode()
+            self.auth = f"Basic {token}"
+
+    def _request(self, path="", method="GET"):
+        request = urllib.request.Request(self.base + path, method=method)
+        if self.auth:
+            request.add_header("Authorization", self.auth)
+        with urllib.request.urlopen(request, timeout=10) as response:
+            return response.read()
+
+    def start(self, categories="motor,dcc,http,audio", events=1024):
+        query = f"?categories={categories}&events={events}"
+        return json.loads(self._request(query, "POST"))
+
+    def status(self):
+        return json.loads(self._request())
+
+    def data(self):
+        return self._request("/data")
+
+    def clear(self):
+        self._request("", "DELETE")
+
+
+def save_chrome(blob, path):
+    header, tasks, events = decode(blob)
+    with open(path, "w") as f:
+        json.dump(to_chrome(header, tasks, events), f)
+    print(f"{len(events)} events from {len(tasks)} tasks to {path}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="NIMRS event trace")
+    parser.add_argument("host", help="Decoder address ('-' for convert)")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--user", default="")
+    parser.add_argument("--password", default="")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    start = sub.add_parser("start", help="Start recording")
+    start.add_argument("--categories", default="motor,dcc,http,audio")
+    start.add_argument("--events", type=int, default=1024, help="Per core")
+    sub.add_parser("status", help="Show the recorder state")
+    fetch = sub.add_parser("fetch", help="Stop and download as Chrome JSON")
+    fetch.add_argument("-o", "--output", default="trace.json")
+    fetch.add_argument("--raw", help="Also save the blob here")
+    sub.add_parser("clear", help="Stop and free the rings")
+    conv = sub.add_parser("convert", help="Turn a saved blob into Chrome JSON")
+    conv.add_argument("file")
+    conv.add_argument("-o", "--output", default="trace.json")
+    args = parser.parse_args()
+
+    if args.command == "convert":
+        with open(args.file, "rb") as f:
+            save_chrome(f.read(), args.output)
+        return 0
+
+    client = TraceClient(args.host, args.port, args.user, args.password)
+    if args.command == "start":
+        print(json.dumps(client.start(args.categories, args.events)))
+    elif args.command == "status":
+        print(json.dumps(client.status()))
+    elif args.command == "fetch":
+        blob = client.data()
+        if args.raw:
+            with open(args.raw, "wb") as f:
+                f.write(blob)
+        save_chrome(blob, args.output)
+    elif args.command == "clear":
+        client.clear()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
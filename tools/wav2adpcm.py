@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+"""Convert sound assets to IMA-ADPCM .wav for the decoder's low-CPU path.
+
+Input is a PCM16 WAV; anything else (MP3, float WAV, other rates) is first
+run through ffmpeg when it is on PATH. The output keeps a .wav extension so
+sound_assets.json entries do not need to change; the firmware sniffs the
+format tag at playback time.
+
+Usage: wav2adpcm.py [--rate HZ] [--mono] [--block BYTES] input output.wav
+"""
+
+import argparse
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import wave
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37,
+    41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173,
+    190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+    7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500,
+    20350, 22385, 24623, 27086, 29794, 32767,
+]  # fmt: skip
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+WAVE_FORMAT_IMA_ADPCM = 0x0011
+
+
+class Channel:
+    """Encoder state mirroring ImaAdpcmState in main/src/ImaAdpcm.h."""
+
+    def __init__(self):
+        self.predictor = 0
+        self.index = 0
+
+    def encode(self, sample):
+        step = STEP_TABLE[self.index]
+        diff = sample - self.predictor
+        code = 0
+        if diff < 0:
+            code = 8
+            diff = -diff
+        if diff >= step:
+            code |= 4
+            diff -= step
+        if diff >= step >> 1:
+            code |= 2
+            diff -= step >> 1
+        if diff >= step >> 2:
+            code |= 1
+
+        # Reconstruct exactly as the decoder will
+        delta = step >> 3
+        if code & 4:
+            delta += step
+        if code & 2:
+            delta += step >> 1
+        if code & 1:
+            delta += step >> 2
+        pred = self.predictor - delta if code & 8 else self.predictor + delta
+        self.predictor = max(-32768, min(32767, pred))
+        self.index = max(0, min(88, self.index + INDEX_TABLE[code & 7]))
+        return code
+
+
+def frames_per_block(block_align, channels):
+    return (block_align - 4 * channels) * 2 // channels + 1
+
+
+def encode(samples, channels, block_align):
+    """samples: interleaved int16 list. Returns encoded bytes."""
+    state = [Channel() for _ in range(channels)]
+    per_block = frames_per_block(block_align, channels)
+    frames = len(samples) // channels
+    out = bytearray()
+
+    for start in range(0, frames, per_block):
+        def sample(f, c):
+            f = min(start + f, frames - 1)
+            return samples[f * channels + c]
+
+        for c in range(channels):
+            first = sample(0, c)
+            state[c].predictor = first
+            out += struct.pack("<hBB", first, state[c].index, 0)
+        for f in range(1, per_block, 8):
+            for c in range(channels):
+                for b in range(4):
+                    lo = state[c].encode(sample(f + 2 * b, c))
+                    hi = state[c].encode(sample(f + 2 * b + 1, c))
+                    out.append(lo | (hi << 4))
+    return bytes(out)
+
+
+def write_adpcm_wav(path, data, channels, rate, block_align, frames):
+    per_block = frames_per_block(block_align, channels)
+    byte_rate = rate * block_align // per_block
+    fmt = struct.pack(
+        "<HHIIHHHH",
+        WAVE_FORMAT_IMA_ADPCM,
+        channels,
+        rate,
+        byte_rate,
+        block_align,
+        4,
+        2,
+        per_block,
+    )
+    fact = struct.pack("<I", frames)
+    body = b"WAVE"
+    body += b"fmt " + struct.pack("<I", len(fmt)) + fmt
+    body += b"fact" + struct.pack("<I", len(fact)) + fact
+    body += b"data" + struct.pack("<I", len(data)) + data
+    if len(data) & 1:
+        body += b"\0"
+    with open(path, "wb") as f:
+        f.write(b"RIFF" + struct.pack("<I", len(body)) + body)
+
+
+def read_pcm16(path):
+    with wave.open(path, "rb") as w:
+        if w.getsampwidth() != 2:
+            raise wave.Error("not 16-bit PCM")
+        raw = w.readframes(w.getnframes())
+        count = len(raw) // 2
+        samples = list(struct.unpack(f"<{count}h", raw[: count * 2]))
+        return samples, w.getnchannels(), w.getframerate()
+
+
+def transcode(src, rate, mono):
+    """Use ffmpeg to produce a PCM16 WAV. Returns a temp path."""
+    if not shutil.which("ffmpeg"):
+        print(f"Error: {src} is not PCM16 WAV and ffmpeg is not installed")
+        sys.exit(1)
+    fd, tmp = tempfile.mkstemp(suffix=".wav")
+    os.close(fd)
+    cmd = ["ffmpeg", "-y", "-loglevel", "error", "-i", src, "-c:a", "pcm_s16le"]
+    if rate:
+        cmd += ["-ar", str(rate)]
+    if mono:
+        cmd += ["-ac", "1"]
+    subprocess.run(cmd + [tmp], check=True)
+    return tmp
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input")
+    parser.add_argument("output")
+    parser.add_argument("--rate", type=int, help="resample (needs ffmpeg)")
+    parser.add_argument("--mono", action="store_true", help="downmix to mono")
+    parser.add_argument(
+        "--block", type=int, default=512, help="block size per channel"
+    )
+    args = parser.parse_args()
+
+    tmp = None
+    try:
+        samples, channels, rate = read_pcm16(args.input)
+        if (args.rate and args.rate != rate) or (args.mono and channels > 1):
+            raise wave.Error("needs resampling")
+    except (wave.Error, EOFError):
+        tmp = transcode(args.input, args.rate, args.mono)
+        samples, channels, rate = read_pcm16(tmp)
+    finally:
+        if tmp:
+            os.remove(tmp)
+
+    if channels > 2:
+        print("Error: only mono and stereo are supported")
+        sys.exit(1)
+
+    block_align = args.block * channels
+    if (block_align - 4 * channels) % (4 * channels):
+        print("Error: --block must be a multiple of 4")
+        sys.exit(1)
+
+    frames = len(samples) // channels
+    data = encode(samples, channels, block_align)
+    write_adpcm_wav(args.output, data, channels, rate, block_align, frames)
+
+    pcm_bytes = frames * channels * 2
+    print(
+        f"{args.input}: {frames} frames, {channels} ch @ {rate} Hz, "
+        f"{pcm_bytes} -> {len(data)} bytes ({pcm_bytes / max(1, len(data)):.1f}:1)"
+    )
+
+
+if __name__ == "__main__":
+    main()